@@ -100,6 +100,11 @@
 #include <time.h>
 #include <fcntl.h>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TELETONE_SSE2 1
+#endif
+
 
 static teletone_detection_descriptor_t dtmf_detect_row[GRID_FACTOR];
 static teletone_detection_descriptor_t dtmf_detect_col[GRID_FACTOR];
@@ -133,6 +138,86 @@ TELETONE_API(void) teletone_goertzel_update(teletone_goertzel_state_t *goertzel_
 #pragma warning(disable:4244)
 #endif
 
+/* 
+ * Filter bank form of the Goertzel recurrence.  Every filter of a detector sees the same samples,
+ * so the state is unpacked into flat arrays and all filters advance together on each sample.
+ * The arithmetic is the scalar update's exactly: fac*v2 - v1 + x in double, rounded to float,
+ * which keeps the results bit for bit identical to the one-filter-at-a-time loop.
+ */
+#define GOERTZEL_BANK_LANES 20	/* 16 DTMF filters or TELETONE_MAX_TONES, rounded up to a multiple of 4 */
+
+typedef struct {
+	double fac[GOERTZEL_BANK_LANES];
+	float v2[GOERTZEL_BANK_LANES];
+	float v3[GOERTZEL_BANK_LANES];
+	int lanes;
+} goertzel_bank_t;
+
+static void goertzel_bank_load(goertzel_bank_t *bank, int lane, const teletone_goertzel_state_t *gs, int count)
+{
+	int x;
+
+	for (x = 0; x < count; x++) {
+		bank->fac[lane + x] = gs[x].fac;
+		bank->v2[lane + x] = gs[x].v2;
+		bank->v3[lane + x] = gs[x].v3;
+	}
+}
+
+static void goertzel_bank_store(const goertzel_bank_t *bank, int lane, teletone_goertzel_state_t *gs, int count)
+{
+	int x;
+
+	for (x = 0; x < count; x++) {
+		gs[x].v2 = bank->v2[lane + x];
+		gs[x].v3 = bank->v3[lane + x];
+	}
+}
+
+static void goertzel_bank_update(goertzel_bank_t *bank, int16_t sample_buffer[], int samples, float *energy)
+{
+	int j, x, lanes = bank->lanes;
+	float famp, v1;
+#ifdef TELETONE_SSE2
+	int vlanes = lanes & ~3;
+	__m128d fac[GOERTZEL_BANK_LANES / 2];
+
+	for (x = 0; x < vlanes; x += 2) {
+		fac[x / 2] = _mm_loadu_pd(&bank->fac[x]);
+	}
+#else
+	int vlanes = 0;
+#endif
+
+	for (j = 0; j < samples; j++) {
+		famp = sample_buffer[j];
+		*energy += famp*famp;
+
+#ifdef TELETONE_SSE2
+		{
+			__m128d amp = _mm_set1_pd(famp);
+
+			for (x = 0; x < vlanes; x += 4) {
+				__m128 v2 = _mm_loadu_ps(&bank->v2[x]);
+				__m128 v3 = _mm_loadu_ps(&bank->v3[x]);
+				__m128d lo, hi;
+
+				lo = _mm_add_pd(_mm_sub_pd(_mm_mul_pd(fac[x / 2], _mm_cvtps_pd(v3)), _mm_cvtps_pd(v2)), amp);
+				hi = _mm_add_pd(_mm_sub_pd(_mm_mul_pd(fac[x / 2 + 1], _mm_cvtps_pd(_mm_movehl_ps(v3, v3))), _mm_cvtps_pd(_mm_movehl_ps(v2, v2))), amp);
+
+				_mm_storeu_ps(&bank->v2[x], v3);
+				_mm_storeu_ps(&bank->v3[x], _mm_movelh_ps(_mm_cvtpd_ps(lo), _mm_cvtpd_ps(hi)));
+			}
+		}
+#endif
+		for (x = vlanes; x < lanes; x++) {
+			v1 = bank->v2[x];
+			bank->v2[x] = bank->v3[x];
+			bank->v3[x] = (float)(bank->fac[x]*bank->v2[x] - v1 + famp);
+		}
+	}
+}
+
 #define teletone_goertzel_result(gs) (double)(((gs)->v3 * (gs)->v3 + (gs)->v2 * (gs)->v2 - (gs)->v2 * (gs)->v3 * (gs)->fac))
 
 TELETONE_API(void) teletone_dtmf_detect_init (teletone_dtmf_detect_state_t *dtmf_detect_state, int sample_rate)
@@ -213,10 +298,10 @@ TELETONE_API(int) teletone_multi_tone_detect (teletone_multi_tone_t *mt,
 								int16_t sample_buffer[],
 								int samples)
 {
-	int sample, limit = 0, j, x = 0;
-	float v1, famp;
+	int sample, limit = 0, x = 0;
 	float eng_sum = 0, eng_all[TELETONE_MAX_TONES] = {0.0};
-	int gtest = 0, see_hit = 0;
+	int gtest = 0, see_hit = 0, tones;
+	goertzel_bank_t bank;
 
 	for (sample = 0;  sample >= 0 && sample < samples; sample = limit) {
 		mt->total_samples++;
@@ -230,22 +315,21 @@ TELETONE_API(int) teletone_multi_tone_detect (teletone_multi_tone_t *mt,
 			limit = samples;
 		}
 
-		for (j = sample;  j < limit;  j++) {
-			famp = sample_buffer[j];
-			
-			mt->energy += famp*famp;
+		/* gs2 is seeded from the same descriptor as gs and fed the same samples so it always
+		   holds the same values, run the bank on gs and mirror the result */
+		tones = mt->tone_count < TELETONE_MAX_TONES ? mt->tone_count : TELETONE_MAX_TONES;
+		goertzel_bank_load(&bank, 0, mt->gs, tones);
 
-			for(x = 0; x < TELETONE_MAX_TONES && x < mt->tone_count; x++) {
-				v1 = mt->gs[x].v2;
-				mt->gs[x].v2 = mt->gs[x].v3;
-				mt->gs[x].v3 = (float)(mt->gs[x].fac * mt->gs[x].v2 - v1 + famp);
-	
-				v1 = mt->gs2[x].v2;
-				mt->gs2[x].v2 = mt->gs2[x].v3;
-				mt->gs2[x].v3 = (float)(mt->gs2[x].fac*mt->gs2[x].v2 - v1 + famp);
-			}
+		/* pad to whole vectors, the spare lanes are never read back */
+		for (bank.lanes = tones; bank.lanes & 3; bank.lanes++) {
+			bank.fac[bank.lanes] = 0;
+			bank.v2[bank.lanes] = bank.v3[bank.lanes] = 0;
 		}
 
+		goertzel_bank_update(&bank, sample_buffer + sample, limit - sample, &mt->energy);
+		goertzel_bank_store(&bank, 0, mt->gs, tones);
+		goertzel_bank_store(&bank, 0, mt->gs2, tones);
+
 		mt->current_sample += (limit - sample);
 		if (mt->current_sample < mt->min_samples) {
 			continue;
@@ -305,15 +389,13 @@ TELETONE_API(int) teletone_dtmf_detect (teletone_dtmf_detect_state_t *dtmf_detec
 {
 	float row_energy[GRID_FACTOR];
 	float col_energy[GRID_FACTOR];
-	float famp;
-	float v1;
 	int i;
-	int j;
 	int sample;
 	int best_row;
 	int best_col;
 	char hit;
 	int limit;
+	goertzel_bank_t bank;
 
 	hit = 0;
 	for (sample = 0;  sample < samples;	 sample = limit) {
@@ -324,31 +406,19 @@ TELETONE_API(int) teletone_dtmf_detect (teletone_dtmf_detect_state_t *dtmf_detec
 			limit = samples;
 		}
 
-		for (j = sample;  j < limit;  j++) {
-			int x = 0;
-			famp = sample_buffer[j];
-			
-			dtmf_detect_state->energy += famp*famp;
+		/* rows, columns and both second harmonics advance together as one 16 filter bank */
+		bank.lanes = GRID_FACTOR * 4;
+		goertzel_bank_load(&bank, 0, dtmf_detect_state->row_out, GRID_FACTOR);
+		goertzel_bank_load(&bank, GRID_FACTOR, dtmf_detect_state->col_out, GRID_FACTOR);
+		goertzel_bank_load(&bank, GRID_FACTOR * 2, dtmf_detect_state->row_out2nd, GRID_FACTOR);
+		goertzel_bank_load(&bank, GRID_FACTOR * 3, dtmf_detect_state->col_out2nd, GRID_FACTOR);
 
-			for(x = 0; x < GRID_FACTOR; x++) {
-				v1 = dtmf_detect_state->row_out[x].v2;
-				dtmf_detect_state->row_out[x].v2 = dtmf_detect_state->row_out[x].v3;
-				dtmf_detect_state->row_out[x].v3 = (float)(dtmf_detect_state->row_out[x].fac*dtmf_detect_state->row_out[x].v2 - v1 + famp);
-	
-				v1 = dtmf_detect_state->col_out[x].v2;
-				dtmf_detect_state->col_out[x].v2 = dtmf_detect_state->col_out[x].v3;
-				dtmf_detect_state->col_out[x].v3 = (float)(dtmf_detect_state->col_out[x].fac*dtmf_detect_state->col_out[x].v2 - v1 + famp);
-
-				v1 = dtmf_detect_state->col_out2nd[x].v2;
-				dtmf_detect_state->col_out2nd[x].v2 = dtmf_detect_state->col_out2nd[x].v3;
-				dtmf_detect_state->col_out2nd[x].v3 = (float)(dtmf_detect_state->col_out2nd[x].fac*dtmf_detect_state->col_out2nd[x].v2 - v1 + famp);
-		
-				v1 = dtmf_detect_state->row_out2nd[x].v2;
-				dtmf_detect_state->row_out2nd[x].v2 = dtmf_detect_state->row_out2nd[x].v3;
-				dtmf_detect_state->row_out2nd[x].v3 = (float)(dtmf_detect_state->row_out2nd[x].fac*dtmf_detect_state->row_out2nd[x].v2 - v1 + famp);
-			}
+		goertzel_bank_update(&bank, sample_buffer + sample, limit - sample, &dtmf_detect_state->energy);
 
-		}
+		goertzel_bank_store(&bank, 0, dtmf_detect_state->row_out, GRID_FACTOR);
+		goertzel_bank_store(&bank, GRID_FACTOR, dtmf_detect_state->col_out, GRID_FACTOR);
+		goertzel_bank_store(&bank, GRID_FACTOR * 2, dtmf_detect_state->row_out2nd, GRID_FACTOR);
+		goertzel_bank_store(&bank, GRID_FACTOR * 3, dtmf_detect_state->col_out2nd, GRID_FACTOR);
 
 		dtmf_detect_state->current_sample += (limit - sample);
 		if (dtmf_detect_state->current_sample < BLOCK_LEN) {
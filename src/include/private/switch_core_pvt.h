@@ -102,6 +102,39 @@ typedef enum {
 } switch_session_flag_t;
 
 
+typedef enum {
+	SWITCH_LATENCY_READ,
+	SWITCH_LATENCY_DECODE,
+	SWITCH_LATENCY_ENCODE,
+	SWITCH_LATENCY_RESAMPLE,
+	SWITCH_LATENCY_BUGS,
+	SWITCH_LATENCY_WRITE,
+	SWITCH_LATENCY_TIMER,
+	SWITCH_LATENCY_STAGE_MAX
+} switch_latency_stage_t;
+
+typedef enum {
+	SWITCH_LATENCY_SIDE_READ,
+	SWITCH_LATENCY_SIDE_WRITE,
+	SWITCH_LATENCY_SIDES
+} switch_latency_side_t;
+
+typedef struct switch_latency_hist switch_latency_hist_t;
+typedef struct switch_latency_session switch_latency_session_t;
+
+#define SWITCH_LATENCY_EVENT "core::media_latency"
+
+/* histogram layout shared by the latency stats and the profiler counters:
+   16 exact microsecond buckets then 8 per power of two up to 2^27us */
+#define SWITCH_LATENCY_EXACT 16
+#define SWITCH_LATENCY_SUB_BITS 3
+#define SWITCH_LATENCY_MAX_EXP 27
+#define SWITCH_LATENCY_BUCKETS (SWITCH_LATENCY_EXACT + (SWITCH_LATENCY_MAX_EXP - 4) * (1 << SWITCH_LATENCY_SUB_BITS))
+
+/* costs one load and a branch per stage while media-latency-stats is off */
+#define switch_latency_start(_t) _t = runtime.latency_enabled ? switch_time_now() : 0
+#define switch_latency_stop(_session, _side, _stage, _t) if (_t) { switch_core_latency_add(_session, _side, _stage, switch_time_now() - _t); _t = 0; }
+
 struct switch_core_session {
 	switch_memory_pool_t *pool;
 	switch_thread_t *thread;
@@ -166,11 +199,14 @@ struct switch_core_session {
 	uint32_t track_duration;
 	uint32_t track_id;
 	switch_log_level_t loglevel;
+	switch_size_t mem_bytes;
+	uint8_t mem_tracked;
+	switch_latency_session_t *latency;
 };
 
 struct switch_media_bug {
-	switch_buffer_t *raw_write_buffer;
-	switch_buffer_t *raw_read_buffer;
+	switch_ringbuffer_t *raw_write_buffer;
+	switch_ringbuffer_t *raw_read_buffer;
 	switch_frame_t *read_replace_frame_in;
 	switch_frame_t *read_replace_frame_out;
 	switch_frame_t *write_replace_frame_in;
@@ -229,6 +265,22 @@ struct switch_runtime {
 	uint32_t runlevel;
 	uint32_t tipping_point;
 	int32_t timer_affinity;
+	uint32_t transcode_threads;
+	uint32_t transcode_batch;
+	uint32_t transcode_budget;
+	int32_t transcode_affinity;
+	char *transcode_codecs;
+	uint32_t db_pool_max;
+	uint32_t db_pool_wait;
+	uint32_t db_pool_health_interval;
+	uint32_t rtp_pool_min;
+	uint32_t rtp_pool_max;
+	uint32_t rtp_pool_lead;
+	uint32_t memory_arenas;
+	uint32_t memory_arena_max_free;
+	switch_bool_t memory_telemetry;
+	int latency_enabled;
+	uint32_t latency_event_interval;
 	switch_profile_timer_t *profile_timer;
 	double profile_time;
 	double min_idle_time;
@@ -253,6 +305,26 @@ switch_status_t switch_core_sqldb_start(switch_memory_pool_t *pool, switch_bool_
 void switch_core_sqldb_stop(void);
 void switch_core_session_init(switch_memory_pool_t *pool);
 void switch_core_session_uninit(void);
+void switch_core_codec_pool_init(switch_memory_pool_t *pool);
+void switch_core_codec_pool_uninit(void);
+void switch_core_frame_init(switch_memory_pool_t *pool);
+void switch_core_latency_init(switch_memory_pool_t *pool);
+void switch_core_latency_add(switch_core_session_t *session, switch_latency_side_t side, switch_latency_stage_t stage, switch_time_t usec);
+void switch_core_latency_session_end(switch_core_session_t *session);
+uint32_t switch_core_latency_bucket(switch_time_t usec);
+uint32_t switch_core_latency_bucket_value(uint32_t idx);
+void switch_core_profile_init(switch_memory_pool_t *pool);
+void switch_core_profile_shutdown(void);
+void switch_core_frame_uninit(void);
+void switch_core_transcode_init(switch_memory_pool_t *pool);
+void switch_core_transcode_shutdown(void);
+switch_bool_t switch_core_transcode_wanted(switch_codec_t *codec);
+switch_status_t switch_core_transcode_frame(int encode, switch_codec_t *codec, switch_codec_t *other_codec,
+											void *in_data, uint32_t in_len, uint32_t in_rate,
+											void *out_data, uint32_t *out_len, uint32_t *out_rate, unsigned int *flag);
 void switch_core_state_machine_init(switch_memory_pool_t *pool);
 switch_memory_pool_t *switch_core_memory_init(void);
+void switch_core_memory_arena_init(void);
+void switch_core_memory_session_start(switch_core_session_t *session);
+void switch_core_memory_session_end(switch_core_session_t *session);
 void switch_core_memory_stop(void);
@@ -120,6 +120,7 @@
 #include "switch_module_interfaces.h"
 #include "switch_channel.h"
 #include "switch_buffer.h"
+#include "switch_ringbuffer.h"
 #include "switch_event.h"
 #include "switch_resample.h"
 #include "switch_ivr.h"
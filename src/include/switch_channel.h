@@ -90,6 +90,34 @@ SWITCH_DECLARE(switch_status_t) switch_channel_wait_for_flag(switch_channel_t *c
 															 switch_channel_flag_t want_flag,
 															 switch_bool_t pres, uint32_t to, switch_channel_t *super_channel);
 
+/*!
+  \brief Create a waiter that can be attached to channels to sleep until one of them changes state or flags
+  \param waiter the new waiter, holding one reference for the caller
+  \return SWITCH_STATUS_SUCCESS if the waiter was created
+*/
+SWITCH_DECLARE(switch_status_t) switch_channel_waiter_create(switch_channel_waiter_t **waiter);
+/*!
+  \brief Drop a reference to a waiter, channels it is still attached to hold their own
+  \param waiter the waiter, set to NULL
+*/
+SWITCH_DECLARE(void) switch_channel_waiter_release(switch_channel_waiter_t **waiter);
+SWITCH_DECLARE(void) switch_channel_waiter_signal(switch_channel_waiter_t *waiter);
+/*!
+  \brief Sleep until an attached channel changes or the timeout expires
+  \param waiter the waiter
+  \param ms the longest time to sleep in milliseconds
+  \return SWITCH_STATUS_SUCCESS if something changed since the last wait, SWITCH_STATUS_TIMEOUT otherwise
+*/
+SWITCH_DECLARE(switch_status_t) switch_channel_waiter_wait(switch_channel_waiter_t *waiter, uint32_t ms);
+/*!
+  \brief Have state and flag changes on a channel signal a waiter
+  \param channel the channel
+  \param waiter the waiter
+  \return SWITCH_STATUS_FALSE if the channel has no room for another waiter
+*/
+SWITCH_DECLARE(switch_status_t) switch_channel_attach_waiter(switch_channel_t *channel, switch_channel_waiter_t *waiter);
+SWITCH_DECLARE(void) switch_channel_detach_waiter(switch_channel_t *channel, switch_channel_waiter_t *waiter);
+
 SWITCH_DECLARE(switch_channel_state_t) switch_channel_perform_set_state(switch_channel_t *channel,
 																		const char *file, const char *func, int line, switch_channel_state_t state);
 
@@ -225,6 +225,13 @@ SWITCH_DECLARE(void) switch_core_media_bug_set_read_replace_frame(_In_ switch_me
 SWITCH_DECLARE(switch_status_t) switch_core_media_bug_remove(_In_ switch_core_session_t *session, _Inout_ switch_media_bug_t **bug);
 SWITCH_DECLARE(uint32_t) switch_core_media_bug_prune(switch_core_session_t *session);
 
+/*!
+  \brief Count the media bugs attached to a session
+  \param session the session to check
+  \return the number of bugs
+*/
+SWITCH_DECLARE(uint32_t) switch_core_media_bug_count(switch_core_session_t *session);
+
 /*!
   \brief Remove media bug callback
   \param bug bug to remove
@@ -463,6 +470,20 @@ SWITCH_DECLARE(switch_status_t) switch_core_perform_destroy_memory_pool(_Inout_
 */
 #define switch_core_destroy_memory_pool(p) switch_core_perform_destroy_memory_pool(p, __FILE__, __SWITCH_FUNC__, __LINE__)
 
+SWITCH_DECLARE(switch_status_t) switch_core_perform_new_clearable_memory_pool(_Out_ switch_memory_pool_t **pool, _In_ switch_memory_pool_t *parent,
+																			  _In_z_ const char *file, _In_z_ const char *func, _In_ int line);
+/*! 
+  \brief Create a pool under parent that can be handed to switch_core_memory_pool_clear, its lock lives in parent
+  \return SWITCH_STATUS_SUCCESS on success
+*/
+#define switch_core_new_clearable_memory_pool(p, parent) switch_core_perform_new_clearable_memory_pool(p, parent, __FILE__, __SWITCH_FUNC__, __LINE__)
+
+/*! 
+  \brief Run the cleanups of a pool from switch_core_new_clearable_memory_pool and give back all but its first block
+  \param pool the pool to clear, nothing may be using it
+*/
+SWITCH_DECLARE(void) switch_core_memory_pool_clear(_In_ switch_memory_pool_t *pool);
+
 
 SWITCH_DECLARE(void) switch_core_memory_pool_set_data(switch_memory_pool_t *pool, const char *key, void *data);
 SWITCH_DECLARE(void *) switch_core_memory_pool_get_data(switch_memory_pool_t *pool, const char *key);
@@ -1391,6 +1412,18 @@ SWITCH_DECLARE(switch_status_t) switch_core_codec_decode(switch_codec_t *codec,
 */
 SWITCH_DECLARE(switch_status_t) switch_core_codec_destroy(switch_codec_t *codec);
 
+/*! 
+  \brief Report how often codec handles were served from the per-implementation pool of parked memory pools
+  \param stream the stream to write the counters to
+*/
+SWITCH_DECLARE(void) switch_core_codec_pool_status(switch_stream_handle_t *stream);
+
+/*! 
+  \brief Report queue depth and per codec throughput of the transcoding worker pool
+  \param stream the stream to write the report to
+*/
+SWITCH_DECLARE(void) switch_core_transcode_status(switch_stream_handle_t *stream);
+
 /*! 
   \brief Assign the read codec to a given session
   \param session session to add the codec to
@@ -1972,6 +2005,58 @@ SWITCH_DECLARE(void) switch_core_memory_reclaim(void);
 SWITCH_DECLARE(void) switch_core_memory_reclaim_events(void);
 SWITCH_DECLARE(void) switch_core_memory_reclaim_logger(void);
 SWITCH_DECLARE(void) switch_core_memory_reclaim_all(void);
+/*! 
+  \brief Turn per call site accounting of session pool allocations on or off
+  \param on SWITCH_TRUE to start collecting
+*/
+SWITCH_DECLARE(void) switch_core_memory_telemetry(switch_bool_t on);
+SWITCH_DECLARE(void) switch_core_memory_telemetry_reset(void);
+/*! 
+  \brief Write the arena and allocation telemetry report to a stream
+  \param stream the stream to write to
+  \param top how many call sites to list, 0 for all of them
+*/
+SWITCH_DECLARE(void) switch_core_memory_report(switch_stream_handle_t *stream, uint32_t top);
+/*! 
+  \brief Turn media path latency histograms on or off
+  \param on SWITCH_TRUE to start timing the media stages
+*/
+SWITCH_DECLARE(void) switch_core_latency_enable(switch_bool_t on);
+SWITCH_DECLARE(void) switch_core_latency_reset(void);
+/*! 
+  \brief Write the media latency percentiles to a stream
+  \param stream the stream to write to
+  \param uuid a session to report on, NULL for the totals
+  \return SWITCH_STATUS_SUCCESS if there was something to report on
+*/
+SWITCH_DECLARE(switch_status_t) switch_core_latency_report(switch_stream_handle_t *stream, const char *uuid);
+/*! 
+  \brief Find or register a hot path profiling counter
+  \param subsystem the owner of the counter (event, sql, rtp ...)
+  \param name the name of the counter within the subsystem
+  \return the counter, the same one for every call with the same names
+  \note counters live until shutdown, every switch_core_profile_* call accepts NULL
+*/
+SWITCH_DECLARE(switch_profile_counter_t *) switch_core_profile_counter(const char *subsystem, const char *name);
+SWITCH_DECLARE(switch_bool_t) switch_core_profile_enabled(void);
+SWITCH_DECLARE(void) switch_core_profile_enable(switch_bool_t on);
+SWITCH_DECLARE(void) switch_core_profile_reset(void);
+SWITCH_DECLARE(void) switch_core_profile_count(switch_profile_counter_t *counter, uint32_t n);
+/*! 
+  \brief Count one pass through a profiled section and record how long it took
+  \param counter the counter to add to
+  \param usec the time spent in microseconds
+*/
+SWITCH_DECLARE(void) switch_core_profile_time(switch_profile_counter_t *counter, switch_time_t usec);
+SWITCH_DECLARE(void) switch_core_profile_depth(switch_profile_counter_t *counter, uint32_t depth);
+/*! 
+  \brief Write the rates, latency percentiles and queue depths of the profiling counters to a stream
+  \param stream the stream to write to
+  \param subsystem only report this subsystem, NULL for all of them
+*/
+SWITCH_DECLARE(void) switch_core_profile_report(switch_stream_handle_t *stream, const char *subsystem);
+#define switch_core_profile_start(_t) _t = switch_core_profile_enabled() ? switch_time_now() : 0
+#define switch_core_profile_stop(_counter, _t) if (_t) { switch_core_profile_time(_counter, switch_time_now() - _t); _t = 0; }
 SWITCH_DECLARE(void) switch_core_setrlimits(void);
 SWITCH_DECLARE(void) switch_time_sync(void);
 /*! 
@@ -2040,7 +2125,7 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_preprocess_session(switch_core_sessio
 		 switch_cache_db_odbc_options_t odbc_options;
 	 } switch_cache_db_connection_options_t;
 
-	 typedef struct {
+	 typedef struct switch_cache_db_handle {
 		 char name[CACHE_DB_LEN];
 		 switch_cache_db_handle_type_t type;
 		 switch_cache_db_native_handle_t native_handle;
@@ -2052,6 +2137,11 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_preprocess_session(switch_core_sessio
 		 unsigned long hash;
 		 char creator[CACHE_DB_LEN];
 		 char last_user[CACHE_DB_LEN];
+		 /* pool bookkeeping, owned by switch_core_sqldb.c */
+		 void *dsn_pool;
+		 switch_thread_id_t owner;
+		 uint32_t refs;
+		 struct switch_cache_db_handle *next;
 	 } switch_cache_db_handle_t;
 
 
@@ -2102,6 +2192,41 @@ SWITCH_DECLARE(void) switch_cache_db_flush_handles(void);
 SWITCH_DECLARE(const char *) switch_core_banner(void);
 SWITCH_DECLARE(switch_bool_t) switch_core_session_in_thread(switch_core_session_t *session);
 
+/*!
+  \brief Create a durable delivery spool, replaying any records left undelivered in its directory
+  \param spool the new spool
+  \param name the spool name, used to name the journal files
+  \param dir the directory holding the journal
+  \param threads the number of sender threads
+  \param batch the number of records a sender thread takes from the queue at once
+  \param backoff_min the delay in ms after the first failed delivery
+  \param backoff_max the ceiling in ms the delay doubles up to on repeated failures
+  \param send_func called from the sender threads to deliver one nul terminated record
+  \param cleanup_func called when a sender thread exits to release whatever it stored in thread_data
+  \param user_data passed to the callbacks
+  \return SWITCH_STATUS_SUCCESS if the spool is running
+*/
+SWITCH_DECLARE(switch_status_t) switch_cdr_spool_create(switch_cdr_spool_t **spool, const char *name, const char *dir,
+														uint32_t threads, uint32_t batch, uint32_t backoff_min, uint32_t backoff_max,
+														switch_cdr_spool_send_func_t send_func, switch_cdr_spool_cleanup_func_t cleanup_func,
+														void *user_data);
+/*!
+  \brief Append a record to the spool journal and queue it for delivery
+  \param spool the spool
+  \param uuid the uuid of the call the record belongs to
+  \param leg the call leg ('a' or 'b')
+  \param data the record
+  \param len the length of data
+  \return SWITCH_STATUS_SUCCESS once the record is on disk
+*/
+SWITCH_DECLARE(switch_status_t) switch_cdr_spool_write(switch_cdr_spool_t *spool, const char *uuid, char leg, const char *data, switch_size_t len);
+SWITCH_DECLARE(void) switch_cdr_spool_status(switch_cdr_spool_t *spool, switch_stream_handle_t *stream);
+/*!
+  \brief Stop the sender threads and close the spool, undelivered records stay in the journal
+  \param spool the spool
+*/
+SWITCH_DECLARE(void) switch_cdr_spool_destroy(switch_cdr_spool_t **spool);
+
 SWITCH_END_EXTERN_C
 #endif
 /* For Emacs:
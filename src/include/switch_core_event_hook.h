@@ -170,6 +170,12 @@ struct switch_io_event_hooks {
 };
 
 extern switch_io_event_hooks_t switch_core_session_get_event_hooks(switch_core_session_t *session);
+/*!
+  \brief Check for hooks that need to see the audio or dtmf of a session
+  \param session the session to check
+  \return SWITCH_TRUE if a read/write frame or send/recv dtmf hook is installed
+*/
+SWITCH_DECLARE(switch_bool_t) switch_core_event_hook_media_attached(switch_core_session_t *session);
 
 #define NEW_HOOK_DECL_ADD_P(_NAME) SWITCH_DECLARE(switch_status_t) switch_core_event_hook_add_##_NAME \
 															   (switch_core_session_t *session, switch_##_NAME##_hook_t _NAME)
@@ -387,6 +387,31 @@ SWITCH_DECLARE(void) switch_ivr_clear_speech_cache(switch_core_session_t *sessio
 SWITCH_DECLARE(switch_status_t) switch_ivr_speak_text(switch_core_session_t *session,
 													  const char *tts_name, const char *voice_name, char *text, switch_input_args_t *args);
 
+/*!
+  \brief Look up previously rendered speech in the shared TTS cache
+  \param tts_name the tts module
+  \param voice_name the voice
+  \param rate the rendering rate
+  \param text the text that was spoken
+  \param buf buffer to hold a playable tts_cache:// path on a hit
+  \param buflen the size of buf
+  \return SWITCH_STATUS_SUCCESS if the audio is cached
+*/
+SWITCH_DECLARE(switch_status_t) switch_ivr_tts_cache_lookup(const char *tts_name, const char *voice_name, uint32_t rate, const char *text,
+															char *buf, switch_size_t buflen);
+
+/*!
+  \brief Add rendered speech to the shared TTS cache
+  \param tts_name the tts module
+  \param voice_name the voice
+  \param rate the rendering rate
+  \param text the text that was spoken
+  \param audio buffer holding the complete rendering as signed linear samples
+  \return SWITCH_STATUS_SUCCESS if the audio was stored
+*/
+SWITCH_DECLARE(switch_status_t) switch_ivr_tts_cache_store(const char *tts_name, const char *voice_name, uint32_t rate, const char *text,
+														   switch_buffer_t *audio);
+
 /*!
   \brief Make an outgoing call
   \param session originating session
@@ -224,6 +224,13 @@ SWITCH_DECLARE(int) switch_loadable_module_get_codecs(const switch_codec_impleme
 */
 SWITCH_DECLARE(int) switch_loadable_module_get_codecs_sorted(const switch_codec_implementation_t **array, int arraylen, char **prefs, int preflen);
 
+/*!
+  \brief Report the hit rate of the resolved codec preference cache used by switch_loadable_module_get_codecs_sorted
+  \param stream the stream to write the counters to
+  \param flush drop every cached preference list first
+*/
+SWITCH_DECLARE(void) switch_loadable_module_codec_prefs_status(switch_stream_handle_t *stream, switch_bool_t flush);
+
 /*!
   \brief Execute a registered API command
   \param cmd the name of the API command to execute
@@ -59,6 +59,26 @@ SWITCH_DECLARE(switch_odbc_status_t) switch_odbc_handle_exec(switch_odbc_handle_
 SWITCH_DECLARE(switch_odbc_status_t) switch_odbc_handle_exec_string(switch_odbc_handle_t *handle, const char *sql, char *resbuf, size_t len, char **err);
 SWITCH_DECLARE(switch_bool_t) switch_odbc_available(void);
 SWITCH_DECLARE(switch_odbc_status_t) switch_odbc_statement_handle_free(switch_odbc_statement_handle_t *stmt);
+/*!
+  \brief Run the driver's probe query once, without the reconnect and retry loop the exec functions use
+  \param handle the ODBC handle
+  \return SWITCH_ODBC_SUCCESS if the server answered
+*/
+SWITCH_DECLARE(switch_odbc_status_t) switch_odbc_handle_ping(switch_odbc_handle_t *handle);
+/*!
+  \brief Turn autocommit on or off for the connection, off starts a transaction
+  \param handle the ODBC handle
+  \param on SWITCH_TRUE to go back to autocommit
+  \return SWITCH_ODBC_SUCCESS if the driver accepted it
+*/
+SWITCH_DECLARE(switch_odbc_status_t) switch_odbc_SQLSetAutoCommitAttr(switch_odbc_handle_t *handle, switch_bool_t on);
+/*!
+  \brief Commit or roll back the transaction open on the connection
+  \param handle the ODBC handle
+  \param commit SWITCH_TRUE to commit, SWITCH_FALSE to roll back
+  \return SWITCH_ODBC_SUCCESS if the driver accepted it
+*/
+SWITCH_DECLARE(switch_odbc_status_t) switch_odbc_SQLEndTran(switch_odbc_handle_t *handle, switch_bool_t commit);
 
 /*!
   \brief Execute the sql query and issue a callback for each row returned
@@ -49,6 +49,23 @@ SWITCH_DECLARE(int) switch_regex_copy_substring(const char *subject, int *ovecto
 
 SWITCH_DECLARE(void) switch_regex_free(void *data);
 
+/*!
+ \brief Compile an expression the same way switch_regex_perform does (handles /re/opts and _asterisk patterns)
+ \param expression The expression to compile
+ \return The compiled regex (free with switch_regex_safe_free) or NULL on error
+*/
+SWITCH_DECLARE(switch_regex_t *) switch_regex_compile_expression(const char *expression);
+
+/*!
+ \brief Run a precompiled regex against a string
+ \param re The regex from switch_regex_compile_expression
+ \param field The string to match
+ \param ovector vector of integers for substring information
+ \param olen number of elements in ovector
+ \return the match count (0 if there was no match)
+*/
+SWITCH_DECLARE(int) switch_regex_exec(switch_regex_t *re, const char *field, int *ovector, uint32_t olen);
+
 SWITCH_DECLARE(int) switch_regex_perform(const char *field, const char *expression, switch_regex_t **new_re, int *ovector, uint32_t olen);
 SWITCH_DECLARE(void) switch_perform_substitution(switch_regex_t *re, int match_count, const char *data, const char *field_data,
 												 char *substituted, switch_size_t len, int *ovector);
@@ -0,0 +1,163 @@
+/* 
+ * FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ * Copyright (C) 2005-2010, Anthony Minessale II <anthm@freeswitch.org>
+ *
+ * Version: MPL 1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ *
+ * The Initial Developer of the Original Code is
+ * Anthony Minessale II <anthm@freeswitch.org>
+ * Portions created by the Initial Developer are Copyright (C)
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ * 
+ * Anthony Minessale II <anthm@freeswitch.org>
+ *
+ *
+ * switch_ringbuffer.h -- Lock Free Single Producer/Single Consumer Ring Buffer
+ *
+ */
+/** 
+ * @file switch_ringbuffer.h
+ * @brief Lock Free Single Producer/Single Consumer Ring Buffer
+ * @see switch_ringbuffer
+ */
+
+#ifndef SWITCH_RINGBUFFER_H
+#define SWITCH_RINGBUFFER_H
+
+#include <switch.h>
+
+SWITCH_BEGIN_EXTERN_C
+/**
+ * @defgroup switch_ringbuffer Ring Buffer Routines
+ * @ingroup core1
+ * A fixed size byte ring for the case where exactly one thread writes and exactly one thread reads.
+ * The storage is rounded up to a power of two so the read and write positions can wrap with a mask,
+ * data is never moved once written and neither side takes a lock.
+ *
+ * Functions documented as producer side may only be called from the writing thread and functions
+ * documented as consumer side may only be called from the reading thread.  If more than one thread
+ * can write (or read) the callers must serialize that side themselves.
+ * @{
+ */
+	struct switch_ringbuffer;
+
+/*! \brief Allocate a new switch_ringbuffer
+ * \param pool Pool to allocate the ring from (NULL to use malloc, which requires switch_ringbuffer_destroy)
+ * \param ring returned pointer to the new ring
+ * \param min_len minimum number of bytes the ring must be able to hold (rounded up to a power of two)
+ * \return status
+ */
+SWITCH_DECLARE(switch_status_t) switch_ringbuffer_create(_In_opt_ switch_memory_pool_t *pool, _Out_ switch_ringbuffer_t **ring, _In_ switch_size_t min_len);
+
+/*! \brief Destroy the ring
+ * \param ring ring to destroy
+ * \note only neccessary on rings created without a pool (noop on pooled ones)
+ */
+SWITCH_DECLARE(void) switch_ringbuffer_destroy(switch_ringbuffer_t **ring);
+
+/*! \brief Get the capacity of a switch_ringbuffer_t
+ * \param ring any ring of type switch_ringbuffer_t
+ * \return the number of bytes the ring can hold
+ */
+SWITCH_DECLARE(switch_size_t) switch_ringbuffer_size(_In_ switch_ringbuffer_t *ring);
+
+/*! \brief Get the in use amount of a switch_ringbuffer_t
+ * \param ring any ring of type switch_ringbuffer_t
+ * \return ammount of data waiting to be read (exact from the consumer, a lower bound from the producer)
+ */
+SWITCH_DECLARE(switch_size_t) switch_ringbuffer_inuse(_In_ switch_ringbuffer_t *ring);
+
+/*! \brief Get the freespace of a switch_ringbuffer_t
+ * \param ring any ring of type switch_ringbuffer_t
+ * \return free space in the ring (exact from the producer, a lower bound from the consumer)
+ */
+SWITCH_DECLARE(switch_size_t) switch_ringbuffer_freespace(_In_ switch_ringbuffer_t *ring);
+
+/*! \brief Write data into a switch_ringbuffer_t (producer side)
+ * \param ring any ring of type switch_ringbuffer_t
+ * \param data pointer to the data to be written
+ * \param datalen amount of data to be written
+ * \return datalen, or 0 if there is not enough room for all of it (nothing is written in that case)
+ */
+SWITCH_DECLARE(switch_size_t) switch_ringbuffer_write(_In_ switch_ringbuffer_t *ring, _In_bytecount_(datalen)
+													  const void *data, _In_ switch_size_t datalen);
+
+/*! \brief Get the largest contiguous free region of a switch_ringbuffer_t for zero copy writing (producer side)
+ * \param ring any ring of type switch_ringbuffer_t
+ * \param data returned pointer to the start of the region
+ * \return length of the region, which may be less than the total freespace when the free space wraps
+ * \note nothing is visible to the consumer until switch_ringbuffer_write_commit is called
+ */
+SWITCH_DECLARE(switch_size_t) switch_ringbuffer_write_region(_In_ switch_ringbuffer_t *ring, _Out_ void **data);
+
+/*! \brief Publish data written into a region returned by switch_ringbuffer_write_region (producer side)
+ * \param ring any ring of type switch_ringbuffer_t
+ * \param datalen amount of data to publish
+ * \return datalen, or 0 if datalen is larger than the free space
+ */
+SWITCH_DECLARE(switch_size_t) switch_ringbuffer_write_commit(_In_ switch_ringbuffer_t *ring, _In_ switch_size_t datalen);
+
+/*! \brief Read data from a switch_ringbuffer_t up to the ammount of datalen if it is available.  Remove read data from the ring. (consumer side)
+ * \param ring any ring of type switch_ringbuffer_t
+ * \param data pointer to the read data to be returned
+ * \param datalen amount of data to be returned
+ * \return ammount of data actually read
+ */
+SWITCH_DECLARE(switch_size_t) switch_ringbuffer_read(_In_ switch_ringbuffer_t *ring, _In_ void *data, _In_ switch_size_t datalen);
+
+/*! \brief Read data from a switch_ringbuffer_t up to the ammount of datalen if it is available, without removing it. (consumer side)
+ * \param ring any ring of type switch_ringbuffer_t
+ * \param data pointer to the read data to be returned
+ * \param datalen amount of data to be returned
+ * \return ammount of data actually read
+ */
+SWITCH_DECLARE(switch_size_t) switch_ringbuffer_peek(_In_ switch_ringbuffer_t *ring, _In_ void *data, _In_ switch_size_t datalen);
+
+/*! \brief Get the largest contiguous readable region of a switch_ringbuffer_t for zero copy reading (consumer side)
+ * \param ring any ring of type switch_ringbuffer_t
+ * \param data returned pointer to the start of the region
+ * \return length of the region, which may be less than the total in use when the data wraps
+ * \note release the data with switch_ringbuffer_toss once it has been consumed
+ */
+SWITCH_DECLARE(switch_size_t) switch_ringbuffer_read_region(_In_ switch_ringbuffer_t *ring, _Out_ const void **data);
+
+/*! \brief Remove data from the ring (consumer side)
+ * \param ring any ring of type switch_ringbuffer_t
+ * \param datalen amount of data to be removed
+ * \return ammount of data actually removed
+ */
+SWITCH_DECLARE(switch_size_t) switch_ringbuffer_toss(_In_ switch_ringbuffer_t *ring, _In_ switch_size_t datalen);
+
+/*! \brief Remove all data from the ring (consumer side)
+ * \param ring any ring of type switch_ringbuffer_t
+ */
+SWITCH_DECLARE(void) switch_ringbuffer_zero(_In_ switch_ringbuffer_t *ring);
+
+/** @} */
+
+SWITCH_END_EXTERN_C
+#endif
+/* For Emacs:
+ * Local Variables:
+ * mode:c
+ * indent-tabs-mode:t
+ * tab-width:4
+ * c-basic-offset:4
+ * End:
+ * For VIM:
+ * vim:set softtabstop=4 shiftwidth=4 tabstop=4:
+ */
@@ -114,6 +114,20 @@ SWITCH_DECLARE(switch_port_t) switch_rtp_set_end_port(switch_port_t port);
 SWITCH_DECLARE(switch_port_t) switch_rtp_request_port(const char *ip);
 SWITCH_DECLARE(void) switch_rtp_release_port(const char *ip, switch_port_t port);
 
+/*! 
+  \brief Size the pool of pre-bound RTP/RTCP socket pairs (call before switch_rtp_init)
+  \param min pairs to keep bound per media ip even when idle
+  \param max most pairs to keep bound per media ip (0 disables the pool)
+  \param lead_ms how many ms of the recent call rate to keep bound ahead of time
+*/
+SWITCH_DECLARE(void) switch_rtp_set_socket_pool(uint32_t min, uint32_t max, uint32_t lead_ms);
+
+/*! 
+  \brief Write the socket pool sizing and hit/miss counters for each media ip to a stream
+  \param stream the stream to write to
+*/
+SWITCH_DECLARE(void) switch_rtp_socket_pool_status(switch_stream_handle_t *stream);
+
 SWITCH_DECLARE(switch_status_t) switch_rtp_set_interval(switch_rtp_t *rtp_session, uint32_t ms_per_packet, uint32_t samples_per_interval);
 
 SWITCH_DECLARE(switch_status_t) switch_rtp_change_interval(switch_rtp_t *rtp_session, uint32_t ms_per_packet, uint32_t samples_per_interval);
@@ -408,6 +422,15 @@ SWITCH_DECLARE(int) switch_rtp_write_frame(switch_rtp_t *rtp_session, switch_fra
 SWITCH_DECLARE(int) switch_rtp_write_manual(switch_rtp_t *rtp_session,
 											void *data, uint32_t datalen, uint8_t m, switch_payload_t payload, uint32_t ts, switch_frame_flag_t *flags);
 
+/*!
+  \brief Relay media received on one RTP session straight out another one without passing it up to the core
+  \param rtp_session the RTP session to read from
+  \param peer_rtp_session the RTP session to send on (NULL to stop relaying)
+  \return SWITCH_STATUS_SUCCESS if the relay was set
+  \note while relaying, reads return CNG frames flagged with SFF_RTP_RELAY; RFC2833 is passed through
+*/
+SWITCH_DECLARE(switch_status_t) switch_rtp_set_relay(switch_rtp_t *rtp_session, switch_rtp_t *peer_rtp_session);
+
 /*! 
   \brief Retrieve the SSRC from a given RTP session
   \param rtp_session the RTP session to retrieve from
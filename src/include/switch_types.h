@@ -150,6 +150,7 @@ SWITCH_BEGIN_EXTERN_C
 #define SWITCH_PLAYBACK_TERMINATOR_USED "playback_terminator_used"
 #define SWITCH_CACHE_SPEECH_HANDLES_VARIABLE "cache_speech_handles"
 #define SWITCH_CACHE_SPEECH_HANDLES_OBJ_NAME "__cache_speech_handles_obj__"
+#define SWITCH_TTS_CACHE_VARIABLE "tts_cache"
 #define SWITCH_BYPASS_MEDIA_VARIABLE "bypass_media"
 #define SWITCH_PROXY_MEDIA_VARIABLE "proxy_media"
 #define SWITCH_ENDPOINT_DISPOSITION_VARIABLE "endpoint_disposition"
@@ -471,6 +472,7 @@ typedef struct {
 	switch_size_t dtmf_packet_count;
 	switch_size_t cng_packet_count;
 	switch_size_t flush_packet_count;
+	switch_size_t relay_packet_count;
 } switch_rtp_numbers_t;
 
 typedef struct {
@@ -1058,6 +1060,7 @@ SFF_RTP_HEADER = (1 << 2)  - Get the rtp header from the frame header
 SFF_PLC        = (1 << 3)  - Frame has generated PLC data
 SFF_RFC2833    = (1 << 4)  - Frame has rfc2833 dtmf data
 SFF_DYNAMIC    = (1 << 5)  - Frame is dynamic and should be freed
+SFF_RTP_RELAY  = (1 << 9)  - The media was already relayed to the bridged rtp session and should not be written
 </pre>
  */
 typedef enum {
@@ -1070,7 +1073,8 @@ typedef enum {
 	SFF_PROXY_PACKET = (1 << 5),
 	SFF_DYNAMIC = (1 << 6),
 	SFF_ZRTP = (1 << 7),
-	SFF_UDPTL_PACKET = (1 << 8)
+	SFF_UDPTL_PACKET = (1 << 8),
+	SFF_RTP_RELAY = (1 << 9)
 } switch_frame_flag_enum_t;
 typedef uint32_t switch_frame_flag_t;
 
@@ -1568,6 +1572,7 @@ typedef struct switch_codec switch_codec_t;
 typedef struct switch_core_thread_session switch_core_thread_session_t;
 typedef struct switch_codec_implementation switch_codec_implementation_t;
 typedef struct switch_buffer switch_buffer_t;
+typedef struct switch_ringbuffer switch_ringbuffer_t;
 typedef struct switch_codec_settings switch_codec_settings_t;
 typedef struct switch_odbc_handle switch_odbc_handle_t;
 
@@ -1642,6 +1647,7 @@ typedef switch_bool_t (*switch_hash_delete_callback_t) (_In_ const void *key, _I
 #define SWITCH_HASH_DELETE_FUNC(name) static switch_bool_t name (const void *key, const void *val, void *pData)
 
 typedef struct switch_scheduler_task switch_scheduler_task_t;
+typedef struct switch_profile_counter switch_profile_counter_t;
 
 typedef void (*switch_scheduler_func_t) (switch_scheduler_task_t *task);
 
@@ -1693,6 +1699,15 @@ typedef struct HashElem switch_hash_index_t;
 struct switch_network_list;
 typedef struct switch_network_list switch_network_list_t;
 
+struct switch_channel_waiter;
+typedef struct switch_channel_waiter switch_channel_waiter_t;
+
+struct switch_cdr_spool;
+typedef struct switch_cdr_spool switch_cdr_spool_t;
+typedef switch_status_t (*switch_cdr_spool_send_func_t) (const char *uuid, char leg, const char *data, switch_size_t len,
+														 void **thread_data, void *user_data);
+typedef void (*switch_cdr_spool_cleanup_func_t) (void *thread_data, void *user_data);
+
 
 #define SWITCH_API_VERSION 4
 #define SWITCH_MODULE_LOAD_ARGS (switch_loadable_module_interface_t **module_interface, switch_memory_pool_t *pool)
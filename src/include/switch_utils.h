@@ -135,7 +135,20 @@ SWITCH_DECLARE(switch_size_t) switch_fd_read_line(int fd, char *buf, switch_size
 
 SWITCH_DECLARE(switch_status_t) switch_frame_alloc(switch_frame_t **frame, switch_size_t size);
 SWITCH_DECLARE(switch_status_t) switch_frame_dup(switch_frame_t *orig, switch_frame_t **clone);
+/*!
+  \brief Clone a frame sharing its payload instead of copying it
+  \param orig the frame to clone, frames not made by switch_frame_alloc/switch_frame_dup are copied
+  \param clone the new frame, free it with switch_frame_free
+  \note call switch_frame_writable on either frame before changing its samples
+*/
+SWITCH_DECLARE(switch_status_t) switch_frame_ref(switch_frame_t *orig, switch_frame_t **clone);
+/*!
+  \brief Give a dynamic frame a private copy of its payload if it is shared
+  \param frame the frame about to be modified, non dynamic frames are left alone
+*/
+SWITCH_DECLARE(switch_status_t) switch_frame_writable(switch_frame_t *frame);
 SWITCH_DECLARE(switch_status_t) switch_frame_free(switch_frame_t **frame);
+SWITCH_DECLARE(void) switch_frame_stats(switch_stream_handle_t *stream);
 
 /*!
   \brief Evaluate the truthfullness of a string expression
@@ -624,6 +637,7 @@ SWITCH_DECLARE(char *) switch_find_end_paren(const char *s, char open, char clos
 
 
 SWITCH_DECLARE(int) switch_parse_cidr(const char *string, uint32_t *ip, uint32_t *mask, uint32_t *bitp);
+SWITCH_DECLARE(int) switch_parse_cidr6(const char *string, uint8_t *ip6, uint32_t *bitp);
 SWITCH_DECLARE(switch_status_t) switch_network_list_create(switch_network_list_t **list, const char *name, switch_bool_t default_type,
 														   switch_memory_pool_t *pool);
 SWITCH_DECLARE(switch_status_t) switch_network_list_add_cidr_token(switch_network_list_t *list, const char *cidr_str, switch_bool_t ok, const char *token);
@@ -633,6 +647,12 @@ SWITCH_DECLARE(switch_status_t) switch_network_list_add_cidr_token(switch_networ
 SWITCH_DECLARE(switch_status_t) switch_network_list_add_host_mask(switch_network_list_t *list, const char *host, const char *mask_str, switch_bool_t ok);
 SWITCH_DECLARE(switch_bool_t) switch_network_list_validate_ip_token(switch_network_list_t *list, uint32_t ip, const char **token);
 #define switch_network_list_validate_ip(_list, _ip) switch_network_list_validate_ip_token(_list, _ip, NULL);
+/*!
+  \brief Longest prefix match of a 16 byte IPv6 address, IPv4 mapped addresses (::ffff:a.b.c.d) also match IPv4 entries
+*/
+SWITCH_DECLARE(switch_bool_t) switch_network_list_validate_ip6_token(switch_network_list_t *list, const uint8_t *ip6, const char **token);
+SWITCH_DECLARE(switch_bool_t) switch_test_subnet6(const uint8_t *ip6, const uint8_t *net6, uint32_t bits);
+SWITCH_DECLARE(void) switch_network_list_stats(switch_network_list_t *list, uint32_t *prefixes, uint32_t *trie_nodes, uint32_t *linear_nodes);
 
 #define switch_test_subnet(_ip, _net, _mask) (_mask ? ((_net & _mask) == (_ip & _mask)) : _net ? _net == _ip : 1)
 
@@ -355,6 +355,11 @@ SWITCH_DECLARE(switch_status_t) switch_xml_locate(_In_z_ const char *section,
 												  _Out_ switch_xml_t *root,
 												  _Out_ switch_xml_t *node, _In_opt_ switch_event_t *params, _In_ switch_bool_t clone);
 
+///\brief check if any external gateway is bound to a section
+///\param section the section to check
+///\return SWITCH_TRUE if switch_xml_locate would consult a binding before the core registry
+SWITCH_DECLARE(switch_bool_t) switch_xml_section_has_binding(_In_z_ const char *section);
+
 SWITCH_DECLARE(switch_status_t) switch_xml_locate_domain(_In_z_ const char *domain_name, _In_opt_ switch_event_t *params, _Out_ switch_xml_t *root,
 														 _Out_ switch_xml_t *domain);
 
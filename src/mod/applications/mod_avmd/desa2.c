@@ -55,5 +55,46 @@ extern double desa2(circ_buffer_t *b, size_t i)
 
 }
 
+/*! \brief Run desa2 over num consecutive positions, the results match desa2() position by position
+ * @param b A circular audio sample buffer
+ * @param i First position in the buffer
+ * @param num Number of positions
+ * @param x Scratch space for num + 4 samples
+ * @param ratio Scratch space for num values
+ * @param out Receives num frequency estimates
+ */
+extern void desa2_block(circ_buffer_t *b, size_t i, size_t num, double *x, double *ratio, double *out)
+{
+    size_t k;
+    double result;
+
+    /* unwrap the ring once so the arithmetic below runs over flat arrays */
+    for(k = 0; k < num + 4; k++){
+	x[k] = GET_SAMPLE((b), ((i) + k));
+    }
+
+    for(k = 0; k < num; k++){
+	double x2sq = x[k + 2] * x[k + 2];
+
+	out[k] = 2.0 * ((x2sq) - (x[k + 1] * x[k + 3]));
+	ratio[k] = ((x2sq) - (x[k] * x[k + 4])) - ((x[k + 1] * x[k + 1]) - (x[k] * x[k + 2])) - ((x[k + 3] * x[k + 3]) - (x[k + 2] * x[k + 4]));
+    }
+
+    for(k = 0; k < num; k++){
+	if(out[k] == 0.0){
+	    out[k] = 0.0;
+	    continue;
+	}
+
+#ifdef FASTMATH
+	result = 0.5 * (double)fast_acosf((float)ratio[k]/out[k]);
+#else
+	result = 0.5 * acos(ratio[k]/out[k]);
+#endif
+
+	out[k] = ISNAN(result) ? 0.0 : result;
+    }
+}
+
 #endif
 
@@ -4,5 +4,6 @@
 #include "buffer.h"
 
 extern double desa2(circ_buffer_t *b, size_t i);
+extern void desa2_block(circ_buffer_t *b, size_t i, size_t num, double *x, double *ratio, double *out);
 #endif
 
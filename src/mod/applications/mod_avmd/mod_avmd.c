@@ -75,7 +75,7 @@
 #endif
 
 /*! Syntax of the API call. */
-#define AVMD_SYNTAX "<uuid> <command>"
+#define AVMD_SYNTAX "<uuid> <command> | stats"
 
 /*! Number of expected parameters in api call. */
 #define AVMD_PARAMS 2
@@ -83,13 +83,20 @@
 /*! FreeSWITCH CUSTOM event type. */
 #define AVMD_EVENT_BEEP "avmd::beep"
 
+/*! Most frames a channel may have waiting for a DSP worker */
+#define AVMD_DSP_QUEUE_FRAMES (16)
+/*! Most samples a channel may have waiting for a DSP worker (160ms at 48kHz) */
+#define AVMD_DSP_QUEUE_SAMPLES (7680)
+/*! Upper bound for dsp-batch-size */
+#define AVMD_DSP_BATCH_MAX (1024)
+
 
 /* Prototypes */
 SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_avmd_shutdown);
 SWITCH_STANDARD_API(avmd_api_main);
 
 SWITCH_MODULE_LOAD_FUNCTION(mod_avmd_load);
-SWITCH_MODULE_DEFINITION(mod_avmd, mod_avmd_load, NULL, NULL);
+SWITCH_MODULE_DEFINITION(mod_avmd, mod_avmd_load, mod_avmd_shutdown, NULL);
 SWITCH_STANDARD_APP(avmd_start_function);
 
 /*! Status of the beep detection */
@@ -104,8 +111,18 @@ typedef struct {
     size_t last_beep;
 } avmd_state_t;
 
-/*! Type that holds session information pertinent to the avmd module. */
+/*! Frames waiting for (or being processed by) a DSP worker */
 typedef struct {
+    int16_t *samples;
+    uint32_t len[AVMD_DSP_QUEUE_FRAMES];
+    uint32_t frames;
+    uint32_t used;
+} avmd_dsp_frames_t;
+
+struct avmd_worker;
+
+/*! Type that holds session information pertinent to the avmd module. */
+typedef struct avmd_session {
     /*! Internal FreeSWITCH session. */
     switch_core_session_t *session;
     uint32_t rate;
@@ -114,9 +131,58 @@ typedef struct {
     size_t pos;
     /* freq_table_t ft; */
     avmd_state_t state;
+    /*! desa2 frequency and amplitude per buffer position, a position never changes once its samples are in */
+    double *f_cache;
+    double *a_cache;
+    /*! Positions below this one are in the cache */
+    size_t analyzed;
+    /*! Scratch space for desa2_block() */
+    double *dsp_x;
+    double *dsp_r;
+    double *dsp_f;
+    /*! DSP worker owning this channel or NULL to process on the channel thread */
+    struct avmd_worker *worker;
+    avmd_dsp_frames_t *pending;
+    avmd_dsp_frames_t *work;
+    avmd_dsp_frames_t frames[2];
+    int queued;
+    int busy;
+    int closing;
+    struct avmd_session *next;
 } avmd_session_t;
 
-static void avmd_process(avmd_session_t *session, switch_frame_t *frame);
+/*! A DSP worker thread and the channels it serves */
+typedef struct avmd_worker {
+    uint32_t id;
+    switch_thread_t *thread;
+    switch_mutex_t *mutex;
+    /*! Signalled when a channel is queued */
+    switch_thread_cond_t *cond;
+    /*! Signalled when a batch is finished */
+    switch_thread_cond_t *idle_cond;
+    avmd_session_t *head;
+    avmd_session_t *tail;
+    avmd_session_t **batch;
+    uint32_t depth;
+    uint32_t channels;
+    uint32_t max_depth;
+    uint32_t max_batch;
+    uint64_t frames;
+    uint64_t batches;
+    uint64_t dropped;
+    switch_time_t busy_us;
+} avmd_worker_t;
+
+static struct {
+    switch_memory_pool_t *pool;
+    avmd_worker_t *workers;
+    uint32_t worker_count;
+    uint32_t batch_size;
+    switch_time_t started;
+    int running;
+} globals;
+
+static void avmd_process(avmd_session_t *session, int16_t *data, uint32_t samples);
 static switch_bool_t avmd_callback(switch_media_bug_t * bug, void *user_data, switch_abc_type_t type);
 static void init_avmd_session_data(avmd_session_t *avmd_session,  switch_core_session_t *fs_session);
 
@@ -137,6 +203,13 @@ static void init_avmd_session_data(avmd_session_t *avmd_session,  switch_core_se
     avmd_session->state.last_beep = 0;
     avmd_session->state.beep_state = BEEP_NOTDETECTED;
 
+    avmd_session->f_cache = (double *)switch_core_session_alloc(fs_session, sizeof(double) * avmd_session->b.buf_len);
+    avmd_session->a_cache = (double *)switch_core_session_alloc(fs_session, sizeof(double) * avmd_session->b.buf_len);
+    avmd_session->dsp_x = (double *)switch_core_session_alloc(fs_session, sizeof(double) * (avmd_session->b.buf_len + P));
+    avmd_session->dsp_r = (double *)switch_core_session_alloc(fs_session, sizeof(double) * avmd_session->b.buf_len);
+    avmd_session->dsp_f = (double *)switch_core_session_alloc(fs_session, sizeof(double) * avmd_session->b.buf_len);
+    avmd_session->analyzed = 0;
+
     INIT_SMA_BUFFER(
         &avmd_session->sma_b,
         BEEP_LEN(avmd_session->rate) / SINE_LEN(avmd_session->rate),
@@ -145,6 +218,293 @@ static void init_avmd_session_data(avmd_session_t *avmd_session,  switch_core_se
 }
 
 
+/*! \brief Hand a channel to the least loaded DSP worker
+ * @param avmd_session A reference to a avmd session
+ */
+static void avmd_dsp_attach(avmd_session_t *avmd_session)
+{
+    avmd_worker_t *worker = NULL;
+    uint32_t i;
+
+    for (i = 0; i < globals.worker_count; i++) {
+        if (!worker || globals.workers[i].channels < worker->channels) {
+            worker = &globals.workers[i];
+        }
+    }
+
+    avmd_session->frames[0].samples = (int16_t *)switch_core_session_alloc(avmd_session->session, sizeof(int16_t) * AVMD_DSP_QUEUE_SAMPLES);
+    avmd_session->frames[1].samples = (int16_t *)switch_core_session_alloc(avmd_session->session, sizeof(int16_t) * AVMD_DSP_QUEUE_SAMPLES);
+    avmd_session->pending = &avmd_session->frames[0];
+    avmd_session->work = &avmd_session->frames[1];
+
+    switch_mutex_lock(worker->mutex);
+    worker->channels++;
+    avmd_session->worker = worker;
+    switch_mutex_unlock(worker->mutex);
+}
+
+/*! \brief Take a channel away from its DSP worker, waits for a batch that still holds it
+ * @param avmd_session A reference to a avmd session
+ */
+static void avmd_dsp_detach(avmd_session_t *avmd_session)
+{
+    avmd_worker_t *worker = avmd_session->worker;
+    avmd_session_t *s, *last = NULL;
+
+    switch_mutex_lock(worker->mutex);
+
+    avmd_session->closing = 1;
+
+    if (avmd_session->queued) {
+        for (s = worker->head; s; last = s, s = s->next) {
+            if (s == avmd_session) {
+                if (last) {
+                    last->next = s->next;
+                } else {
+                    worker->head = s->next;
+                }
+                if (worker->tail == s) {
+                    worker->tail = last;
+                }
+                worker->depth--;
+                break;
+            }
+        }
+        avmd_session->queued = 0;
+    }
+
+    while (avmd_session->busy) {
+        switch_thread_cond_wait(worker->idle_cond, worker->mutex);
+    }
+
+    worker->channels--;
+    avmd_session->worker = NULL;
+    switch_mutex_unlock(worker->mutex);
+}
+
+/*! \brief Queue a channel on its worker, worker mutex held */
+static void avmd_dsp_enqueue(avmd_worker_t *worker, avmd_session_t *avmd_session)
+{
+    avmd_session->next = NULL;
+    avmd_session->queued = 1;
+
+    if (worker->tail) {
+        worker->tail->next = avmd_session;
+    } else {
+        worker->head = avmd_session;
+    }
+    worker->tail = avmd_session;
+
+    if (++worker->depth > worker->max_depth) {
+        worker->max_depth = worker->depth;
+    }
+}
+
+/*! \brief Copy a frame for the DSP worker, drops it when the channel is too far behind
+ * @param avmd_session A reference to a avmd session
+ * @param frame A audio frame
+ */
+static void avmd_dsp_queue(avmd_session_t *avmd_session, switch_frame_t *frame)
+{
+    avmd_worker_t *worker = avmd_session->worker;
+    avmd_dsp_frames_t *pending;
+
+    switch_mutex_lock(worker->mutex);
+
+    pending = avmd_session->pending;
+
+    if (pending->frames == AVMD_DSP_QUEUE_FRAMES || frame->samples > AVMD_DSP_QUEUE_SAMPLES - pending->used) {
+        worker->dropped++;
+    } else {
+        memcpy(pending->samples + pending->used, frame->data, frame->samples * sizeof(int16_t));
+        pending->len[pending->frames++] = frame->samples;
+        pending->used += frame->samples;
+
+        /* a channel in the middle of a batch is queued again when the batch is done */
+        if (!avmd_session->queued && !avmd_session->busy) {
+            avmd_dsp_enqueue(worker, avmd_session);
+            switch_thread_cond_signal(worker->cond);
+        }
+    }
+
+    switch_mutex_unlock(worker->mutex);
+}
+
+/*! \brief DSP worker thread, runs queued channels in batches
+ *
+ * Each batch takes up to dsp-batch-size channels off the queue at once and runs them back to back
+ * without touching the worker mutex, the channel threads keep filling the other half of each
+ * channel's double buffer meanwhile.
+ */
+static void *SWITCH_THREAD_FUNC avmd_dsp_worker(switch_thread_t *thread, void *obj)
+{
+    avmd_worker_t *worker = (avmd_worker_t *) obj;
+    avmd_session_t *avmd_session;
+    avmd_dsp_frames_t *work;
+    switch_time_t start;
+    uint32_t count, frames, i, x, off;
+
+    switch_mutex_lock(worker->mutex);
+
+    while (globals.running) {
+        if (!worker->head) {
+            switch_thread_cond_timedwait(worker->cond, worker->mutex, 100000);
+            continue;
+        }
+
+        for (count = 0; worker->head && count < globals.batch_size; count++) {
+            avmd_session = worker->head;
+            if (!(worker->head = avmd_session->next)) {
+                worker->tail = NULL;
+            }
+            worker->depth--;
+            avmd_session->next = NULL;
+            avmd_session->queued = 0;
+            avmd_session->busy = 1;
+
+            work = avmd_session->work;
+            avmd_session->work = avmd_session->pending;
+            avmd_session->pending = work;
+
+            worker->batch[count] = avmd_session;
+        }
+
+        switch_mutex_unlock(worker->mutex);
+
+        start = switch_time_now();
+        frames = 0;
+
+        for (i = 0; i < count; i++) {
+            avmd_session = worker->batch[i];
+            work = avmd_session->work;
+
+            for (x = 0, off = 0; x < work->frames; off += work->len[x], x++) {
+                avmd_process(avmd_session, work->samples + off, work->len[x]);
+            }
+
+            frames += work->frames;
+            work->frames = work->used = 0;
+        }
+
+        switch_mutex_lock(worker->mutex);
+
+        worker->busy_us += switch_time_now() - start;
+        worker->frames += frames;
+        worker->batches++;
+        if (count > worker->max_batch) {
+            worker->max_batch = count;
+        }
+
+        for (i = 0; i < count; i++) {
+            avmd_session = worker->batch[i];
+            avmd_session->busy = 0;
+            if (avmd_session->pending->frames && !avmd_session->queued && !avmd_session->closing) {
+                avmd_dsp_enqueue(worker, avmd_session);
+            }
+        }
+
+        switch_thread_cond_broadcast(worker->idle_cond);
+    }
+
+    switch_mutex_unlock(worker->mutex);
+
+    return NULL;
+}
+
+/*! \brief Read avmd.conf and start the DSP workers when asked to
+ * @author Eric des Courtis
+ * @param pool The module memory pool
+ */
+static void avmd_load_config(switch_memory_pool_t *pool)
+{
+    switch_xml_t cfg, xml, settings, param;
+    switch_threadattr_t *thd_attr = NULL;
+    uint32_t threads = 0, i;
+
+    memset(&globals, 0, sizeof(globals));
+    globals.pool = pool;
+    globals.batch_size = 64;
+
+    if ((xml = switch_xml_open_cfg("avmd.conf", &cfg, NULL))) {
+        if ((settings = switch_xml_child(cfg, "settings"))) {
+            for (param = switch_xml_child(settings, "param"); param; param = param->next) {
+                char *var = (char *) switch_xml_attr_soft(param, "name");
+                char *val = (char *) switch_xml_attr_soft(param, "value");
+
+                if (!strcasecmp(var, "dsp-threads")) {
+                    int tmp = atoi(val);
+                    threads = tmp > 0 ? (uint32_t) tmp : 0;
+                } else if (!strcasecmp(var, "dsp-batch-size")) {
+                    int tmp = atoi(val);
+                    if (tmp > 0) {
+                        globals.batch_size = tmp > AVMD_DSP_BATCH_MAX ? AVMD_DSP_BATCH_MAX : (uint32_t) tmp;
+                    }
+                }
+            }
+        }
+        switch_xml_free(xml);
+    }
+
+    if (!threads) {
+        return;
+    }
+
+    globals.workers = (avmd_worker_t *)switch_core_alloc(pool, sizeof(avmd_worker_t) * threads);
+    globals.worker_count = threads;
+    globals.running = 1;
+    globals.started = switch_time_now();
+
+    switch_threadattr_create(&thd_attr, pool);
+    switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+
+    for (i = 0; i < threads; i++) {
+        avmd_worker_t *worker = &globals.workers[i];
+
+        worker->id = i;
+        worker->batch = (avmd_session_t **)switch_core_alloc(pool, sizeof(avmd_session_t *) * globals.batch_size);
+        switch_mutex_init(&worker->mutex, SWITCH_MUTEX_NESTED, pool);
+        switch_thread_cond_create(&worker->cond, pool);
+        switch_thread_cond_create(&worker->idle_cond, pool);
+        switch_thread_create(&worker->thread, thd_attr, avmd_dsp_worker, worker, pool);
+    }
+
+    switch_log_printf(
+        SWITCH_CHANNEL_LOG,
+        SWITCH_LOG_NOTICE,
+        "Advanced Voicemail detection: %u DSP worker(s), batches of up to %u channels\n",
+        threads, globals.batch_size
+    );
+}
+
+/*! \brief Print per worker load
+ * @param stream The API output stream
+ */
+static void avmd_dsp_stats(switch_stream_handle_t *stream)
+{
+    switch_time_t uptime = switch_time_now() - globals.started;
+    uint32_t i;
+
+    if (!globals.worker_count) {
+        stream->write_function(stream, "DSP workers disabled, frames are processed on the channel threads\n");
+        return;
+    }
+
+    stream->write_function(stream, "%-6s %8s %6s %9s %12s %10s %9s %9s %10s %6s\n",
+                           "worker", "channels", "queued", "max-queue", "frames", "batches", "avg-batch", "max-batch", "dropped", "load");
+
+    for (i = 0; i < globals.worker_count; i++) {
+        avmd_worker_t *worker = &globals.workers[i];
+
+        switch_mutex_lock(worker->mutex);
+        stream->write_function(stream, "%-6u %8u %6u %9u %12" SWITCH_UINT64_T_FMT " %10" SWITCH_UINT64_T_FMT " %9.1f %9u %10" SWITCH_UINT64_T_FMT " %5.1f%%\n",
+                               worker->id, worker->channels, worker->depth, worker->max_depth, worker->frames, worker->batches,
+                               worker->batches ? (double) worker->frames / worker->batches : 0.0, worker->max_batch, worker->dropped,
+                               uptime > 0 ? 100.0 * worker->busy_us / uptime : 0.0);
+        switch_mutex_unlock(worker->mutex);
+    }
+}
+
+
 /*! \brief The callback function that is called when new audio data becomes available
  *
  * @author Eric des Courtis
@@ -171,11 +531,18 @@ static switch_bool_t avmd_callback(switch_media_bug_t * bug, void *user_data, sw
         read_codec = switch_core_session_get_read_codec(avmd_session->session);
         avmd_session->rate = read_codec->implementation->samples_per_second;
         /* avmd_session->vmd_codec.channels = read_codec->implementation->number_of_channels; */
+        if (globals.running) {
+            avmd_dsp_attach(avmd_session);
+        }
         break;
 
     case SWITCH_ABC_TYPE_READ_PING:
         break;
     case SWITCH_ABC_TYPE_CLOSE:
+        if (avmd_session->worker) {
+            avmd_dsp_detach(avmd_session);
+        }
+        DESTROY_CIRC_BUFFER(&avmd_session->b);
         break;
     case SWITCH_ABC_TYPE_READ:
         break;
@@ -184,7 +551,14 @@ static switch_bool_t avmd_callback(switch_media_bug_t * bug, void *user_data, sw
 
     case SWITCH_ABC_TYPE_READ_REPLACE:
         frame = switch_core_media_bug_get_read_replace_frame(bug);
-        avmd_process(avmd_session, frame);
+        if (avmd_session->state.beep_state == BEEP_DETECTED) {
+            return SWITCH_TRUE;
+        }
+        if (avmd_session->worker) {
+            avmd_dsp_queue(avmd_session, frame);
+        } else {
+            avmd_process(avmd_session, (int16_t *)(frame->data), frame->samples);
+        }
         return SWITCH_TRUE;
 
     case SWITCH_ABC_TYPE_WRITE_REPLACE:
@@ -234,6 +608,8 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_avmd_load)
 
     SWITCH_ADD_API(api_interface, "avmd", "Voicemail beep detection", avmd_api_main, AVMD_SYNTAX);
 
+    avmd_load_config(pool);
+
     /* indicate that the module should continue to be loaded */
     return SWITCH_STATUS_SUCCESS;
 }
@@ -312,6 +688,20 @@ SWITCH_STANDARD_APP(avmd_start_function)
  */
 SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_avmd_shutdown)
 {
+    switch_status_t st;
+    uint32_t i;
+
+    if (globals.running) {
+        globals.running = 0;
+        for (i = 0; i < globals.worker_count; i++) {
+            switch_mutex_lock(globals.workers[i].mutex);
+            switch_thread_cond_broadcast(globals.workers[i].cond);
+            switch_mutex_unlock(globals.workers[i].mutex);
+        }
+        for (i = 0; i < globals.worker_count; i++) {
+            switch_thread_join(&st, globals.workers[i].thread);
+        }
+    }
 
 #ifdef FASTMATH
     destroy_fast_acosf();
@@ -357,6 +747,11 @@ SWITCH_STANDARD_API(avmd_api_main)
     /* Separate the arguments */
     argc = switch_separate_string(ccmd, ' ', argv, AVMD_PARAMS);
 
+    if (argc == 1 && strcasecmp(argv[0], "stats") == 0) {
+        avmd_dsp_stats(stream);
+        goto end;
+    }
+
     /* If we don't have the expected number of parameters
      * display usage */
     if (argc != AVMD_PARAMS) {
@@ -458,12 +853,38 @@ end:
     return SWITCH_STATUS_SUCCESS;
 }
 
+/*! \brief Fill the desa2 and amplitude cache for buffer positions [from, to)
+ * @param session An avmd session
+ * @param from First position
+ * @param to One past the last position
+ */
+static void avmd_analyze(avmd_session_t *session, size_t from, size_t to)
+{
+    circ_buffer_t *b = &session->b;
+    size_t num = to - from;
+    size_t k;
+    size_t pos;
+    double f;
+
+    desa2_block(b, from, num, session->dsp_x, session->dsp_r, session->dsp_f);
+
+    for(k = 0; k < num; k++){
+        pos = from + k;
+        f = TO_HZ(session->rate, session->dsp_f[k]);
+        session->f_cache[pos & b->mask] = f;
+        if(!(f < MIN_FREQUENCY || f > MAX_FREQUENCY)){
+            session->a_cache[pos & b->mask] = amplitude(b, pos, f);
+        }
+    }
+}
+
 /*! \brief Process one frame of data with avmd algorithm
  * @author Eric des Courtis
  * @param session An avmd session
- * @param frame A audio frame
+ * @param data 16 bit audio samples
+ * @param samples Number of samples in data
  */
-static void avmd_process(avmd_session_t *session, switch_frame_t *frame)
+static void avmd_process(avmd_session_t *session, int16_t *data, uint32_t samples)
 {
     switch_event_t *event;
     switch_status_t status;
@@ -472,6 +893,8 @@ static void avmd_process(avmd_session_t *session, switch_frame_t *frame)
 
     circ_buffer_t *b;
     size_t pos;
+    size_t end;
+    size_t from;
     double f;
     double a;
     double error = 0.0;
@@ -499,20 +922,32 @@ static void avmd_process(avmd_session_t *session, switch_frame_t *frame)
     channel = switch_core_session_get_channel(session->session);
 
 	/*! Insert frame of 16 bit samples into buffer */
-    INSERT_INT16_FRAME(b, (int16_t *)(frame->data), frame->samples);
+    INSERT_INT16_FRAME(b, data, samples);
+
+    /*! The whole backlog is evaluated on every frame but only the positions that are new since
+        the last frame need desa2 and amplitude, the rest come from the cache */
+    end = GET_CURRENT_POS(b) - P;
+    from = GET_BACKLOG_POS(b);
+    if(session->analyzed > from){
+        from = session->analyzed;
+    }
+    if(end > from){
+        avmd_analyze(session, from, end);
+        session->analyzed = end;
+    }
 
     /*! INNER LOOP -- OPTIMIZATION TARGET */
-    for(pos = GET_BACKLOG_POS(b); pos != (GET_CURRENT_POS(b) - P); pos++){
+    for(pos = GET_BACKLOG_POS(b); pos != end; pos++){
 
 		/*! Get a desa2 frequency estimate in Hertz */
-        f = TO_HZ(session->rate, desa2(b, pos));
+        f = session->f_cache[pos & b->mask];
 
         /*! Don't caculate amplitude if frequency is not within range */
         if(f < MIN_FREQUENCY || f > MAX_FREQUENCY) {
             a = 0.0;
             error += 1.0;
         } else {
-            a = amplitude(b, pos, f);
+            a = session->a_cache[pos & b->mask];
             success += 1.0;
             if(!ISNAN(a)){
                 amp += a;
@@ -247,6 +247,279 @@ SWITCH_STANDARD_API(time_test_function)
 	return SWITCH_STATUS_SUCCESS;
 }
 
+static void codec_bench_run(switch_stream_handle_t *stream, const switch_codec_implementation_t *imp, int frames)
+{
+	switch_codec_t codec = { 0 };
+	const switch_codec_implementation_t *cimp;
+	int16_t *decoded = NULL, *out = NULL;
+	uint8_t *encoded = NULL;
+	switch_size_t buflen;
+	uint32_t samples, enc_len = 0, dec_len, rate, i;
+	unsigned int flag;
+	switch_time_t start, enc_us = 0, dec_us = 0;
+	int x;
+
+	if (imp->codec_type != SWITCH_CODEC_TYPE_AUDIO) {
+		return;
+	}
+
+	if (switch_core_codec_init(&codec, imp->iananame, NULL, imp->samples_per_second, imp->microseconds_per_packet / 1000, imp->number_of_channels,
+							   SWITCH_CODEC_FLAG_ENCODE | SWITCH_CODEC_FLAG_DECODE, NULL, NULL) != SWITCH_STATUS_SUCCESS) {
+		stream->write_function(stream, "%-16s %6d %4d  init failed\n", imp->iananame, imp->samples_per_second, imp->microseconds_per_packet / 1000);
+		return;
+	}
+
+	cimp = codec.implementation;
+	buflen = cimp->decoded_bytes_per_packet * 2;
+	if (buflen < SWITCH_RECOMMENDED_BUFFER_SIZE) {
+		buflen = SWITCH_RECOMMENDED_BUFFER_SIZE;
+	}
+	switch_zmalloc(decoded, buflen);
+	switch_zmalloc(out, buflen);
+	switch_zmalloc(encoded, buflen);
+
+	/* a sweep across most of the sample range so companding codecs hit every segment */
+	samples = cimp->decoded_bytes_per_packet / sizeof(int16_t);
+	for (i = 0; i < samples; i++) {
+		decoded[i] = (int16_t) ((int32_t) ((i * 2731) % 60000) - 30000);
+	}
+
+	start = switch_time_now();
+	for (x = 0; x < frames; x++) {
+		enc_len = (uint32_t) buflen;
+		rate = cimp->samples_per_second;
+		flag = 0;
+		if (switch_core_codec_encode(&codec, NULL, decoded, cimp->decoded_bytes_per_packet, cimp->actual_samples_per_second,
+									 encoded, &enc_len, &rate, &flag) != SWITCH_STATUS_SUCCESS) {
+			break;
+		}
+	}
+	enc_us = switch_time_now() - start;
+
+	if (x < frames || !enc_len) {
+		stream->write_function(stream, "%-16s %6d %4d  encode not supported\n", cimp->iananame, cimp->samples_per_second,
+							   cimp->microseconds_per_packet / 1000);
+		goto end;
+	}
+
+	start = switch_time_now();
+	for (x = 0; x < frames; x++) {
+		dec_len = (uint32_t) buflen;
+		rate = cimp->samples_per_second;
+		flag = 0;
+		if (switch_core_codec_decode(&codec, NULL, encoded, enc_len, cimp->actual_samples_per_second, out, &dec_len, &rate, &flag) != SWITCH_STATUS_SUCCESS) {
+			break;
+		}
+	}
+	dec_us = switch_time_now() - start;
+
+	if (x < frames) {
+		stream->write_function(stream, "%-16s %6d %4d  decode not supported\n", cimp->iananame, cimp->samples_per_second,
+							   cimp->microseconds_per_packet / 1000);
+		goto end;
+	}
+
+	stream->write_function(stream, "%-16s %6d %4d %12.3f %12.3f %12.1f %12.1f\n",
+						   cimp->iananame, cimp->samples_per_second, cimp->microseconds_per_packet / 1000,
+						   (double) enc_us / frames, (double) dec_us / frames,
+						   enc_us ? (double) frames * samples / enc_us : 0.0,
+						   (enc_us + dec_us) ? (double) cimp->microseconds_per_packet * frames / (enc_us + dec_us) : 0.0);
+
+  end:
+	switch_core_codec_destroy(&codec);
+	switch_safe_free(decoded);
+	switch_safe_free(out);
+	switch_safe_free(encoded);
+}
+
+#define CODEC_BENCH_SYNTAX "[<codec>|all] [<frames>]"
+SWITCH_STANDARD_API(codec_bench_function)
+{
+	const switch_codec_implementation_t *codecs[SWITCH_MAX_CODECS] = { 0 };
+	const switch_codec_implementation_t *imp;
+	switch_codec_interface_t *codec_interface;
+	char *mydata = NULL, *argv[2] = { 0 };
+	const char *which = NULL;
+	int argc = 0, num, i, frames = 1000;
+
+	if (!zstr(cmd)) {
+		mydata = strdup(cmd);
+		switch_assert(mydata);
+		argc = switch_separate_string(mydata, ' ', argv, (sizeof(argv) / sizeof(argv[0])));
+	}
+
+	if (argc > 0 && strcasecmp(argv[0], "all")) {
+		which = argv[0];
+	}
+
+	if (argc > 1 && (frames = atoi(argv[1])) < 1) {
+		stream->write_function(stream, "-USAGE: %s\n", CODEC_BENCH_SYNTAX);
+		goto done;
+	}
+
+	stream->write_function(stream, "%-16s %6s %4s %12s %12s %12s %12s\n", "codec", "rate", "ms", "enc-us/frame", "dec-us/frame", "enc-Msamp/s",
+						   "channels");
+
+	num = switch_loadable_module_get_codecs(codecs, SWITCH_MAX_CODECS - 1);
+
+	for (i = 0; i < num; i++) {
+		if (which && strcasecmp(which, codecs[i]->iananame)) {
+			continue;
+		}
+
+		if (!(codec_interface = switch_loadable_module_get_codec_interface(codecs[i]->iananame))) {
+			continue;
+		}
+
+		for (imp = codec_interface->implementations; imp; imp = imp->next) {
+			codec_bench_run(stream, imp, frames);
+		}
+
+		UNPROTECT_INTERFACE(codec_interface);
+	}
+
+  done:
+	switch_safe_free(mydata);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+static int tone_bench_differs(const teletone_goertzel_state_t *a, const teletone_goertzel_state_t *b)
+{
+	return memcmp(&a->v2, &b->v2, sizeof(a->v2)) || memcmp(&a->v3, &b->v3, sizeof(a->v3));
+}
+
+/* feed a short block to fresh detectors and check that the filter bank left every filter bit for bit where
+   teletone_goertzel_update leaves it one filter at a time, the block stops one sample early so nothing resets */
+static uint32_t tone_bench_verify(int16_t *audio, uint32_t samples, uint32_t rate, uint32_t *blocks)
+{
+	teletone_dtmf_detect_state_t dtmf, dref;
+	teletone_multi_tone_t mt, mref;
+	teletone_tone_map_t map = { { 0 } };
+	uint32_t i, x, n, bad = 0;
+
+	map.freqs[0] = 350;
+	map.freqs[1] = 440;
+
+	for (i = 0; i + BLOCK_LEN <= samples; i += BLOCK_LEN) {
+		n = BLOCK_LEN - 1;
+
+		teletone_dtmf_detect_init(&dtmf, rate);
+		dref = dtmf;
+		teletone_dtmf_detect(&dtmf, audio + i, n);
+
+		for (x = 0; x < GRID_FACTOR; x++) {
+			teletone_goertzel_update(&dref.row_out[x], audio + i, n);
+			teletone_goertzel_update(&dref.col_out[x], audio + i, n);
+			teletone_goertzel_update(&dref.row_out2nd[x], audio + i, n);
+			teletone_goertzel_update(&dref.col_out2nd[x], audio + i, n);
+
+			bad += tone_bench_differs(&dref.row_out[x], &dtmf.row_out[x]) + tone_bench_differs(&dref.col_out[x], &dtmf.col_out[x]) +
+				tone_bench_differs(&dref.row_out2nd[x], &dtmf.row_out2nd[x]) + tone_bench_differs(&dref.col_out2nd[x], &dtmf.col_out2nd[x]);
+		}
+
+		memset(&mt, 0, sizeof(mt));
+		mt.sample_rate = rate;
+		teletone_multi_tone_init(&mt, &map);
+		mref = mt;
+
+		if ((n = mt.min_samples - 1) > BLOCK_LEN) {
+			n = BLOCK_LEN;
+		}
+
+		teletone_multi_tone_detect(&mt, audio + i, n);
+
+		for (x = 0; x < (uint32_t) mt.tone_count && x < TELETONE_MAX_TONES; x++) {
+			teletone_goertzel_update(&mref.gs[x], audio + i, n);
+			bad += tone_bench_differs(&mref.gs[x], &mt.gs[x]) + tone_bench_differs(&mref.gs[x], &mt.gs2[x]);
+		}
+
+		(*blocks)++;
+	}
+
+	return bad;
+}
+
+#define TONE_BENCH_SYNTAX "[<seconds>]"
+SWITCH_STANDARD_API(tone_bench_function)
+{
+	static const float rows[] = { 697.0f, 770.0f, 852.0f, 941.0f };
+	static const float cols[] = { 1209.0f, 1336.0f, 1477.0f, 1633.0f };
+	static const char digits[] = "123A456B789C*0#D";
+	teletone_dtmf_detect_state_t dtmf;
+	teletone_multi_tone_t mt;
+	teletone_tone_map_t map = { { 0 } };
+	int16_t *audio = NULL;
+	char got[TELETONE_MAX_DTMF_DIGITS + 1];
+	uint32_t rate = 8000, frame = 160, seconds = 10, samples, i, d, sent = 0, found = 0, mt_hits = 0, blocks = 0, bad;
+	uint32_t seed = 0x6C078965;
+	switch_time_t start, dtmf_us, mt_us;
+	double audio_us;
+
+	if (!zstr(cmd) && (int) (seconds = atoi(cmd)) < 1) {
+		stream->write_function(stream, "-USAGE: %s\n", TONE_BENCH_SYNTAX);
+		return SWITCH_STATUS_SUCCESS;
+	}
+
+	samples = seconds * rate;
+	switch_zmalloc(audio, samples * sizeof(*audio));
+
+	/* 50ms digits with 50ms gaps over a low noise floor, every third second is dial tone instead */
+	for (i = 0; i < samples; i++) {
+		double v;
+
+		seed = seed * 1103515245 + 12345;
+		v = (double) ((seed >> 16) % 1000) - 500;
+
+		if ((i / rate) % 3 == 2) {
+			v += 6000 * sin(2 * M_PI * 350 * i / rate) + 6000 * sin(2 * M_PI * 440 * i / rate);
+		} else if ((i % 800) < 400) {
+			d = (i / 800) % 16;
+			v += 8000 * sin(2 * M_PI * rows[d / 4] * i / rate) + 8000 * sin(2 * M_PI * cols[d % 4] * i / rate);
+			if ((i % 800) == 0) {
+				sent++;
+			}
+		}
+
+		audio[i] = (int16_t) v;
+	}
+
+	/* dtmf, dial tone and the bare noise floor between digits all go through the exactness check */
+	bad = tone_bench_verify(audio, samples, rate, &blocks);
+
+	teletone_dtmf_detect_init(&dtmf, rate);
+	start = switch_time_now();
+	for (i = 0; i + frame <= samples; i += frame) {
+		teletone_dtmf_detect(&dtmf, audio + i, frame);
+		found += teletone_dtmf_get(&dtmf, got, sizeof(got) - 1);
+	}
+	dtmf_us = switch_time_now() - start;
+
+	memset(&mt, 0, sizeof(mt));
+	mt.sample_rate = rate;
+	map.freqs[0] = 350;
+	map.freqs[1] = 440;
+	teletone_multi_tone_init(&mt, &map);
+	start = switch_time_now();
+	for (i = 0; i + frame <= samples; i += frame) {
+		mt_hits += teletone_multi_tone_detect(&mt, audio + i, frame);
+	}
+	mt_us = switch_time_now() - start;
+
+	audio_us = (double) seconds * 1000000;
+
+	stream->write_function(stream, "audio: %us at %uhz in %ums frames, %u digits sent (%s...)\n", seconds, rate, frame * 1000 / rate, sent, digits);
+	stream->write_function(stream, "dtmf:       %8.3f ms %10.0f channels/core, %u digits detected\n", (double) dtmf_us / 1000,
+						   dtmf_us ? audio_us / dtmf_us : 0.0, found);
+	stream->write_function(stream, "multi-tone: %8.3f ms %10.0f channels/core, %u hits\n", (double) mt_us / 1000,
+						   mt_us ? audio_us / mt_us : 0.0, mt_hits);
+	stream->write_function(stream, "%s filter bank vs scalar goertzel over %u block(s), %u filter(s) differ\n", bad ? "-ERR" : "+OK", blocks, bad);
+
+	switch_safe_free(audio);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
 #define TIMER_TEST_SYNTAX "<10|20|40|60|120> [<1..200>] [<timer_name>]"
 
 SWITCH_STANDARD_API(timer_test_function)
@@ -1160,6 +1433,127 @@ SWITCH_STANDARD_API(reload_acl_function)
 	return SWITCH_STATUS_SUCCESS;
 }
 
+#define ACL_BENCH_SYNTAX "[<prefixes>] [<lookups>]"
+SWITCH_STANDARD_API(acl_bench_function)
+{
+	switch_memory_pool_t *bench_pool = NULL;
+	switch_network_list_t *list = NULL;
+	char *mydata = NULL, *argv[2] = { 0 };
+	char host[16], mask[16];
+	uint32_t *nets = NULL, *masks = NULL, *ips = NULL;
+	switch_bool_t *oks = NULL;
+	uint32_t seed = 0x2545F491, prefixes = 100000, lookups = 1000000, sample, i, j, bits, best, hits = 0, mismatches = 0, trie_nodes = 0;
+	uint8_t ip6[16] = { 0 };
+	switch_time_t start, build_us, trie_us, trie6_us, linear_us;
+	switch_bool_t ok, linear_ok;
+	int argc = 0;
+
+	if (!zstr(cmd)) {
+		mydata = strdup(cmd);
+		switch_assert(mydata);
+		argc = switch_separate_string(mydata, ' ', argv, (sizeof(argv) / sizeof(argv[0])));
+	}
+
+	if ((argc > 0 && (int) (prefixes = atoi(argv[0])) < 1) || (argc > 1 && (int) (lookups = atoi(argv[1])) < 1)) {
+		stream->write_function(stream, "-USAGE: %s\n", ACL_BENCH_SYNTAX);
+		goto done;
+	}
+
+	switch_zmalloc(nets, prefixes * sizeof(*nets));
+	switch_zmalloc(masks, prefixes * sizeof(*masks));
+	switch_zmalloc(oks, prefixes * sizeof(*oks));
+	switch_zmalloc(ips, lookups * sizeof(*ips));
+
+#define acl_bench_rand() (seed = seed * 1103515245 + 12345, seed ^ (seed >> 16))
+
+	/* random /16 to /32 prefixes, the same mix a list of customer cidrs tends to have */
+	for (i = 0; i < prefixes; i++) {
+		bits = 16 + acl_bench_rand() % 17;
+		masks[i] = 0xFFFFFFFF << (32 - bits);
+		nets[i] = acl_bench_rand() & masks[i];
+		oks[i] = (i & 1) ? SWITCH_TRUE : SWITCH_FALSE;
+	}
+
+	/* half of the lookups land inside a listed prefix, the rest anywhere */
+	for (i = 0; i < lookups; i++) {
+		if ((i & 1)) {
+			j = acl_bench_rand() % prefixes;
+			ips[i] = nets[j] | (acl_bench_rand() & ~masks[j]);
+		} else {
+			ips[i] = acl_bench_rand();
+		}
+	}
+
+	switch_core_new_memory_pool(&bench_pool);
+	switch_network_list_create(&list, "acl_bench", SWITCH_FALSE, bench_pool);
+
+	start = switch_time_now();
+	for (i = 0; i < prefixes; i++) {
+		switch_snprintf(host, sizeof(host), "%u.%u.%u.%u", nets[i] >> 24, (nets[i] >> 16) & 0xFF, (nets[i] >> 8) & 0xFF, nets[i] & 0xFF);
+		switch_snprintf(mask, sizeof(mask), "%u.%u.%u.%u", masks[i] >> 24, (masks[i] >> 16) & 0xFF, (masks[i] >> 8) & 0xFF, masks[i] & 0xFF);
+		switch_network_list_add_host_mask(list, host, mask, oks[i]);
+	}
+	build_us = switch_time_now() - start;
+
+	switch_network_list_stats(list, NULL, &trie_nodes, NULL);
+
+	start = switch_time_now();
+	for (i = 0; i < lookups; i++) {
+		if (switch_network_list_validate_ip_token(list, ips[i], NULL)) {
+			hits++;
+		}
+	}
+	trie_us = switch_time_now() - start;
+
+	ip6[10] = ip6[11] = 0xFF;
+	start = switch_time_now();
+	for (i = 0; i < lookups; i++) {
+		ip6[12] = (uint8_t) (ips[i] >> 24);
+		ip6[13] = (uint8_t) (ips[i] >> 16);
+		ip6[14] = (uint8_t) (ips[i] >> 8);
+		ip6[15] = (uint8_t) ips[i];
+		switch_network_list_validate_ip6_token(list, ip6, NULL);
+	}
+	trie6_us = switch_time_now() - start;
+
+	/* the old linear scan on a sample of the lookups, also cross checks the trie answers */
+	sample = lookups < 1000 ? lookups : 1000;
+	start = switch_time_now();
+	for (i = 0; i < sample; i++) {
+		linear_ok = SWITCH_FALSE;
+		best = 0;
+		for (j = prefixes; j > 0; j--) {
+			/* contiguous masks order the same way as their prefix lengths */
+			if (masks[j - 1] > best && switch_test_subnet(ips[i], nets[j - 1], masks[j - 1])) {
+				linear_ok = oks[j - 1];
+				best = masks[j - 1];
+			}
+		}
+		ok = switch_network_list_validate_ip_token(list, ips[i], NULL);
+		if (ok != linear_ok) {
+			mismatches++;
+		}
+	}
+	linear_us = switch_time_now() - start;
+
+	stream->write_function(stream, "prefixes: %u trie nodes: %u build: %0.3f ms\n", prefixes, trie_nodes, (double) build_us / 1000);
+	stream->write_function(stream, "ipv4 trie: %u lookups %0.3f us/lookup (%u allowed)\n", lookups, (double) trie_us / lookups, hits);
+	stream->write_function(stream, "ipv6 trie: %u lookups %0.3f us/lookup (v4 mapped)\n", lookups, (double) trie6_us / lookups);
+	stream->write_function(stream, "linear: %u lookups %0.3f us/lookup, %u mismatches\n", sample, (double) linear_us / sample, mismatches);
+
+  done:
+	if (bench_pool) {
+		switch_core_destroy_memory_pool(&bench_pool);
+	}
+	switch_safe_free(nets);
+	switch_safe_free(masks);
+	switch_safe_free(oks);
+	switch_safe_free(ips);
+	switch_safe_free(mydata);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
 SWITCH_STANDARD_API(acl_function)
 {
 	int argc;
@@ -1460,7 +1854,7 @@ SWITCH_STANDARD_API(status_function)
 	return SWITCH_STATUS_SUCCESS;
 }
 
-#define CTL_SYNTAX "[send_sighup|hupall|pause|resume|shutdown [cancel|elegant|asap|now|restart]|sps|sync_clock|reclaim_mem|max_sessions|min_dtmf_duration [num]|max_dtmf_duration [num]|default_dtmf_duration [num]|min_idle_cpu|loglevel [level]|debug_level [level]]"
+#define CTL_SYNTAX "[send_sighup|hupall|pause|resume|shutdown [cancel|elegant|asap|now|restart]|sps|sync_clock|reclaim_mem|max_sessions|min_dtmf_duration [num]|max_dtmf_duration [num]|default_dtmf_duration [num]|min_idle_cpu|loglevel [level]|debug_level [level]|profile [on|off|reset|<subsystem>]]"
 SWITCH_STANDARD_API(ctl_function)
 {
 	int argc;
@@ -1623,6 +2017,19 @@ SWITCH_STANDARD_API(ctl_function)
 			arg = 0;
 			switch_core_session_ctl(SCSC_SYNC_CLOCK, &arg);
 			stream->write_function(stream, "+OK clock synchronized\n");
+		} else if (!strcasecmp(argv[0], "profile")) {
+			if (argc > 1 && !strcasecmp(argv[1], "on")) {
+				switch_core_profile_enable(SWITCH_TRUE);
+				stream->write_function(stream, "+OK profiling on\n");
+			} else if (argc > 1 && !strcasecmp(argv[1], "off")) {
+				switch_core_profile_enable(SWITCH_FALSE);
+				stream->write_function(stream, "+OK profiling off\n");
+			} else if (argc > 1 && !strcasecmp(argv[1], "reset")) {
+				switch_core_profile_reset();
+				stream->write_function(stream, "+OK profiling counters reset\n");
+			} else {
+				switch_core_profile_report(stream, argc > 1 ? argv[1] : NULL);
+			}
 		} else {
 			stream->write_function(stream, "-ERR INVALID COMMAND\nUSAGE: fsctl %s", CTL_SYNTAX);
 			goto end;
@@ -4172,6 +4579,98 @@ SWITCH_STANDARD_API(sql_escape)
 	return SWITCH_STATUS_SUCCESS;
 }
 
+#define CODEC_CACHE_SYNTAX "[flush]"
+SWITCH_STANDARD_API(codec_cache_function)
+{
+	switch_bool_t flush = SWITCH_FALSE;
+
+	if (!zstr(cmd)) {
+		if (strcasecmp(cmd, "flush")) {
+			stream->write_function(stream, "-USAGE: %s\n", CODEC_CACHE_SYNTAX);
+			return SWITCH_STATUS_SUCCESS;
+		}
+		flush = SWITCH_TRUE;
+	}
+
+	switch_core_codec_pool_status(stream);
+	switch_loadable_module_codec_prefs_status(stream, flush);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+SWITCH_STANDARD_API(transcode_status_function)
+{
+	switch_core_transcode_status(stream);
+	return SWITCH_STATUS_SUCCESS;
+}
+
+SWITCH_STANDARD_API(rtp_socket_pool_function)
+{
+	switch_rtp_socket_pool_status(stream);
+	return SWITCH_STATUS_SUCCESS;
+}
+
+SWITCH_STANDARD_API(frame_stats_function)
+{
+	switch_frame_stats(stream);
+	return SWITCH_STATUS_SUCCESS;
+}
+
+#define MEDIA_LATENCY_SYNTAX "[on|off|reset|<uuid>]"
+SWITCH_STANDARD_API(media_latency_function)
+{
+	if (zstr(cmd)) {
+		switch_core_latency_report(stream, NULL);
+	} else if (!strcasecmp(cmd, "on")) {
+		switch_core_latency_enable(SWITCH_TRUE);
+		stream->write_function(stream, "+OK media latency stats on\n");
+	} else if (!strcasecmp(cmd, "off")) {
+		switch_core_latency_enable(SWITCH_FALSE);
+		stream->write_function(stream, "+OK media latency stats off\n");
+	} else if (!strcasecmp(cmd, "reset")) {
+		switch_core_latency_reset();
+		stream->write_function(stream, "+OK media latency stats reset\n");
+	} else {
+		switch_core_latency_report(stream, cmd);
+	}
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+#define MEMORY_REPORT_SYNTAX "[start|stop|reset|status] [<top>]"
+SWITCH_STANDARD_API(memory_report_function)
+{
+	char *mydata = NULL, *argv[2] = { 0 };
+	uint32_t top = 25;
+	int argc = 0;
+
+	if (!zstr(cmd) && (mydata = strdup(cmd))) {
+		argc = switch_separate_string(mydata, ' ', argv, (sizeof(argv) / sizeof(argv[0])));
+	}
+
+	if (argc > 1 && atoi(argv[1]) >= 0) {
+		top = (uint32_t) atoi(argv[1]);
+	}
+
+	if (argc && !strcasecmp(argv[0], "start")) {
+		switch_core_memory_telemetry(SWITCH_TRUE);
+		stream->write_function(stream, "+OK memory telemetry started\n");
+	} else if (argc && !strcasecmp(argv[0], "stop")) {
+		switch_core_memory_telemetry(SWITCH_FALSE);
+		stream->write_function(stream, "+OK memory telemetry stopped\n");
+	} else if (argc && !strcasecmp(argv[0], "reset")) {
+		switch_core_memory_telemetry_reset();
+		stream->write_function(stream, "+OK memory telemetry reset\n");
+	} else if (!argc || !strcasecmp(argv[0], "status")) {
+		switch_core_memory_report(stream, top);
+	} else {
+		stream->write_function(stream, "-USAGE: %s\n", MEMORY_REPORT_SYNTAX);
+	}
+
+	switch_safe_free(mydata);
+	return SWITCH_STATUS_SUCCESS;
+}
+
 SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_commands_shutdown)
 {
 	int x;
@@ -4230,11 +4729,14 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_commands_load)
 	switch_thread_rwlock_create(&bgapi_rwlock, pool);
 
 	SWITCH_ADD_API(commands_api_interface, "acl", "compare an ip to an acl list", acl_function, "<ip> <list_name>");
+	SWITCH_ADD_API(commands_api_interface, "acl_bench", "Measure acl lookups against a list of random prefixes", acl_bench_function, ACL_BENCH_SYNTAX);
 	SWITCH_ADD_API(commands_api_interface, "alias", "Alias", alias_function, ALIAS_SYNTAX);
 	SWITCH_ADD_API(commands_api_interface, "banner", "Returns the system banner", banner_function, "");
 	SWITCH_ADD_API(commands_api_interface, "bgapi", "Execute an api command in a thread", bgapi_function, "<command>[ <arg>]");
 	SWITCH_ADD_API(commands_api_interface, "bg_system", "Execute a system command in the background", bg_system_function, SYSTEM_SYNTAX);
 	SWITCH_ADD_API(commands_api_interface, "break", "Break", break_function, BREAK_SYNTAX);
+	SWITCH_ADD_API(commands_api_interface, "codec_bench", "Measure encode/decode throughput of the loaded codecs", codec_bench_function, CODEC_BENCH_SYNTAX);
+	SWITCH_ADD_API(commands_api_interface, "codec_cache", "Show codec pool and preference cache counters", codec_cache_function, CODEC_CACHE_SYNTAX);
 	SWITCH_ADD_API(commands_api_interface, "complete", "Complete", complete_function, COMPLETE_SYNTAX);
 	SWITCH_ADD_API(commands_api_interface, "cond", "Eval a conditional", cond_function, "<expr> ? <true val> : <false val>");
 	SWITCH_ADD_API(commands_api_interface, "console_complete", "", console_complete_function, "<line>");
@@ -4251,6 +4753,7 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_commands_load)
 	SWITCH_ADD_API(commands_api_interface, "...", "shutdown", shutdown_function, "");
 	SWITCH_ADD_API(commands_api_interface, "shutdown", "shutdown", shutdown_function, "");
 	SWITCH_ADD_API(commands_api_interface, "version", "version", version_function, "");
+	SWITCH_ADD_API(commands_api_interface, "frame_stats", "Show dynamic frame allocation and copy counters", frame_stats_function, "");
 	SWITCH_ADD_API(commands_api_interface, "global_getvar", "global_getvar", global_getvar_function, GLOBAL_GETVAR_SYNTAX);
 	SWITCH_ADD_API(commands_api_interface, "global_setvar", "global_setvar", global_setvar_function, GLOBAL_SETVAR_SYNTAX);
 	SWITCH_ADD_API(commands_api_interface, "group_call", "Generate a dial string to call a group", group_call_function, "<group>[@<domain>]");
@@ -4263,6 +4766,8 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_commands_load)
 	SWITCH_ADD_API(commands_api_interface, "load", "Load Module", load_function, LOAD_SYNTAX);
 	SWITCH_ADD_API(commands_api_interface, "log", "Log", log_function, LOG_SYNTAX);
 	SWITCH_ADD_API(commands_api_interface, "md5", "md5", md5_function, "<data>");
+	SWITCH_ADD_API(commands_api_interface, "media_latency", "Show media path latency percentiles", media_latency_function, MEDIA_LATENCY_SYNTAX);
+	SWITCH_ADD_API(commands_api_interface, "memory_report", "Show memory arena and allocation statistics", memory_report_function, MEMORY_REPORT_SYNTAX);
 	SWITCH_ADD_API(commands_api_interface, "module_exists", "check if module exists", module_exists_function, "<module>");
 	SWITCH_ADD_API(commands_api_interface, "nat_map", "nat_map", nat_map_function, "[status|republish|reinit] | [add|del] <port> [tcp|udp] [static]");
 	SWITCH_ADD_API(commands_api_interface, "originate", "Originate a Call", originate_function, ORIGINATE_SYNTAX);
@@ -4271,6 +4776,7 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_commands_load)
 	SWITCH_ADD_API(commands_api_interface, "reloadacl", "Reload ACL", reload_acl_function, "[reloadxml]");
 	SWITCH_ADD_API(commands_api_interface, "reload", "Reload Module", reload_function, UNLOAD_SYNTAX);
 	SWITCH_ADD_API(commands_api_interface, "reloadxml", "Reload XML", reload_xml_function, "");
+	SWITCH_ADD_API(commands_api_interface, "rtp_socket_pool", "Show pre-bound rtp socket pool statistics", rtp_socket_pool_function, "");
 	SWITCH_ADD_API(commands_api_interface, "sched_api", "Schedule an api command", sched_api_function, SCHED_SYNTAX);
 	SWITCH_ADD_API(commands_api_interface, "sched_broadcast", "Schedule a broadcast event to a running call", sched_broadcast_function,
 				   SCHED_BROADCAST_SYNTAX);
@@ -4285,6 +4791,8 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_commands_load)
 	SWITCH_ADD_API(commands_api_interface, "system", "Execute a system command", system_function, SYSTEM_SYNTAX);
 	SWITCH_ADD_API(commands_api_interface, "time_test", "time_test", time_test_function, "<mss> [count]");
 	SWITCH_ADD_API(commands_api_interface, "timer_test", "timer_test", timer_test_function, TIMER_TEST_SYNTAX);
+	SWITCH_ADD_API(commands_api_interface, "transcode_status", "Show transcoding pool statistics", transcode_status_function, "");
+	SWITCH_ADD_API(commands_api_interface, "tone_bench", "Measure dtmf and multi-tone detector throughput", tone_bench_function, TONE_BENCH_SYNTAX);
 	SWITCH_ADD_API(commands_api_interface, "tone_detect", "Start Tone Detection on a channel", tone_detect_session_function, TONE_DETECT_SYNTAX);
 	SWITCH_ADD_API(commands_api_interface, "unload", "Unload Module", unload_function, UNLOAD_SYNTAX);
 	SWITCH_ADD_API(commands_api_interface, "unsched_api", "Unschedule an api command", unsched_api_function, UNSCHED_SYNTAX);
@@ -315,8 +315,8 @@ struct conference_member {
 	switch_core_session_t *session;
 	conference_obj_t *conference;
 	switch_memory_pool_t *pool;
-	switch_buffer_t *audio_buffer;
-	switch_buffer_t *mux_buffer;
+	switch_ringbuffer_t *audio_buffer;
+	switch_ringbuffer_t *mux_buffer;
 	switch_buffer_t *resample_buffer;
 	uint32_t flags;
 	uint32_t score;
@@ -1047,15 +1047,14 @@ static void *SWITCH_THREAD_FUNC conference_thread_run(switch_thread_t *thread, v
 			}
 
 			switch_clear_flag_locked(imember, MFLAG_HAS_AUDIO);
-			switch_mutex_lock(imember->audio_in_mutex);
 
-			if (switch_buffer_inuse(imember->audio_buffer) >= bytes
-				&& (buf_read = (uint32_t) switch_buffer_read(imember->audio_buffer, imember->frame, bytes))) {
+			/* the input thread is the only writer and we are the only reader so the ring needs no lock */
+			if (switch_ringbuffer_inuse(imember->audio_buffer) >= bytes
+				&& (buf_read = (uint32_t) switch_ringbuffer_read(imember->audio_buffer, imember->frame, bytes))) {
 				imember->read = buf_read;
 				switch_set_flag_locked(imember, MFLAG_HAS_AUDIO);
 				ready++;
 			}
-			switch_mutex_unlock(imember->audio_in_mutex);
 		}
 
 		/* Find if no one talked for more than x number of second */
@@ -1220,8 +1219,6 @@ static void *SWITCH_THREAD_FUNC conference_thread_run(switch_thread_t *thread, v
 			   cut it off at the min and max range if need be and write the frame to the output buffer.
 			 */
 			for (omember = conference->members; omember; omember = omember->next) {
-				switch_size_t ok = 1;
-
 				if (!switch_test_flag(omember, MFLAG_RUNNING)) {
 					continue;
 				}
@@ -1273,13 +1270,8 @@ static void *SWITCH_THREAD_FUNC conference_thread_run(switch_thread_t *thread, v
 					write_frame[x] = (int16_t) z;
 				}
 
-				switch_mutex_lock(omember->audio_out_mutex);
-				ok = switch_buffer_write(omember->mux_buffer, write_frame, bytes);
-				switch_mutex_unlock(omember->audio_out_mutex);
-
-				if (!ok) {
-					goto end;
-				}
+				/* a full ring means this member stopped draining it, drop the frame rather than the conference */
+				switch_ringbuffer_write(omember->mux_buffer, write_frame, bytes);
 			}
 		}
 
@@ -1310,7 +1302,6 @@ static void *SWITCH_THREAD_FUNC conference_thread_run(switch_thread_t *thread, v
 		switch_mutex_unlock(conference->mutex);
 	}
 	/* Rinse ... Repeat */
-  end:
 
 	if (switch_event_create(&event, SWITCH_EVENT_PRESENCE_IN) == SWITCH_STATUS_SUCCESS) {
 		switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "proto", CONF_CHAT_PROTO);
@@ -2046,16 +2037,8 @@ static void *SWITCH_THREAD_FUNC conference_loop_input(switch_thread_t *thread, v
 			}
 
 			if (datalen) {
-				switch_size_t ok = 1;
-
-				/* Write the audio into the input buffer */
-				switch_mutex_lock(member->audio_in_mutex);
-				ok = switch_buffer_write(member->audio_buffer, data, datalen);
-				switch_mutex_unlock(member->audio_in_mutex);
-				if (!ok) {
-					switch_mutex_unlock(member->read_mutex);
-					break;
-				}
+				/* Write the audio into the input buffer, if the conference thread has fallen that far behind the frame is dropped */
+				switch_ringbuffer_write(member->audio_buffer, data, datalen);
 			}
 		}
 
@@ -2317,7 +2300,7 @@ static void conference_loop_output(conference_member_t *member)
 		switch_event_t *event;
 		caller_control_action_t *caller_action = NULL;
 		int use_timer = 0;
-		switch_buffer_t *use_buffer = NULL;
+		switch_ringbuffer_t *use_buffer = NULL;
 		uint32_t mux_used = 0;
 
 		switch_mutex_lock(member->write_mutex);
@@ -2404,7 +2387,7 @@ static void conference_loop_output(conference_member_t *member)
 
 
 		use_buffer = NULL;
-		mux_used = (uint32_t) switch_buffer_inuse(member->mux_buffer);
+		mux_used = (uint32_t) switch_ringbuffer_inuse(member->mux_buffer);
 
 		if (mux_used) {
 			if (mux_used < bytes) {
@@ -2423,11 +2406,10 @@ static void conference_loop_output(conference_member_t *member)
 
 		if (mux_used) {
 			/* Flush the output buffer and write all the data (presumably muxed) back to the channel */
-			switch_mutex_lock(member->audio_out_mutex);
 			write_frame.data = data;
 			use_buffer = member->mux_buffer;
 			low_count = 0;
-			if ((write_frame.datalen = (uint32_t) switch_buffer_read(use_buffer, write_frame.data, bytes))) {
+			if ((write_frame.datalen = (uint32_t) switch_ringbuffer_read(use_buffer, write_frame.data, bytes))) {
 				if (write_frame.datalen) {
                write_frame.samples = write_frame.datalen / 2;
 				   
@@ -2447,8 +2429,6 @@ static void conference_loop_output(conference_member_t *member)
 					switch_core_session_write_frame(member->session, &write_frame, SWITCH_IO_FLAG_NONE, 0);
 				}
 			}
-
-			switch_mutex_unlock(member->audio_out_mutex);
 		} else if (member->fnode) {
 			write_frame.datalen = bytes;
 			write_frame.samples = samples;
@@ -2472,11 +2452,7 @@ static void conference_loop_output(conference_member_t *member)
 		}
 
 		if (switch_test_flag(member, MFLAG_FLUSH_BUFFER)) {
-			if (switch_buffer_inuse(member->mux_buffer)) {
-				switch_mutex_lock(member->audio_out_mutex);
-				switch_buffer_zero(member->mux_buffer);
-				switch_mutex_unlock(member->audio_out_mutex);
-			}
+			switch_ringbuffer_zero(member->mux_buffer);
 			switch_clear_flag_locked(member, MFLAG_FLUSH_BUFFER);
 		}
 
@@ -2575,13 +2551,13 @@ static void *SWITCH_THREAD_FUNC conference_record_thread_run(switch_thread_t *th
 	switch_mutex_init(&member->read_mutex, SWITCH_MUTEX_NESTED, rec->pool);
 
 	/* Setup an audio buffer for the incoming audio */
-	if (switch_buffer_create_dynamic(&member->audio_buffer, CONF_DBLOCK_SIZE, CONF_DBUFFER_SIZE, 0) != SWITCH_STATUS_SUCCESS) {
+	if (switch_ringbuffer_create(NULL, &member->audio_buffer, CONF_BUFFER_SIZE) != SWITCH_STATUS_SUCCESS) {
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "Memory Error Creating Audio Buffer!\n");
 		goto end;
 	}
 
 	/* Setup an audio buffer for the outgoing audio */
-	if (switch_buffer_create_dynamic(&member->mux_buffer, CONF_DBLOCK_SIZE, CONF_DBUFFER_SIZE, 0) != SWITCH_STATUS_SUCCESS) {
+	if (switch_ringbuffer_create(NULL, &member->mux_buffer, CONF_BUFFER_SIZE) != SWITCH_STATUS_SUCCESS) {
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "Memory Error Creating Audio Buffer!\n");
 		goto end;
 	}
@@ -2617,13 +2593,11 @@ static void *SWITCH_THREAD_FUNC conference_record_thread_run(switch_thread_t *th
 
 	while (switch_test_flag(member, MFLAG_RUNNING) && switch_test_flag(conference, CFLAG_RUNNING) && conference->count) {
 		switch_size_t len = 0;
-		mux_used = (uint32_t) switch_buffer_inuse(member->mux_buffer);
+		mux_used = (uint32_t) switch_ringbuffer_inuse(member->mux_buffer);
 
 		if (switch_test_flag(member, MFLAG_FLUSH_BUFFER)) {
 			if (mux_used) {
-				switch_mutex_lock(member->audio_out_mutex);
-				switch_buffer_zero(member->mux_buffer);
-				switch_mutex_unlock(member->audio_out_mutex);
+				switch_ringbuffer_zero(member->mux_buffer);
 				mux_used = 0;
 			}
 			switch_clear_flag_locked(member, MFLAG_FLUSH_BUFFER);
@@ -2634,13 +2608,11 @@ static void *SWITCH_THREAD_FUNC conference_record_thread_run(switch_thread_t *th
 		} else {
 			if (mux_used) {
 				/* Flush the output buffer and write all the data (presumably muxed) to the file */
-				switch_mutex_lock(member->audio_out_mutex);
 				low_count = 0;
 
-				if ((rlen = (uint32_t) switch_buffer_read(member->mux_buffer, data_buf, data_buf_len))) {
+				if ((rlen = (uint32_t) switch_ringbuffer_read(member->mux_buffer, data_buf, data_buf_len))) {
 					len = (switch_size_t) rlen / sizeof(int16_t);
 				}
-				switch_mutex_unlock(member->audio_out_mutex);
 			}
 
 			if (len < (switch_size_t) samples) {
@@ -2662,8 +2634,8 @@ static void *SWITCH_THREAD_FUNC conference_record_thread_run(switch_thread_t *th
 	switch_safe_free(data_buf);
 	switch_core_timer_destroy(&timer);
 	conference_del_member(conference, member);
-	switch_buffer_destroy(&member->audio_buffer);
-	switch_buffer_destroy(&member->mux_buffer);
+	switch_ringbuffer_destroy(&member->audio_buffer);
+	switch_ringbuffer_destroy(&member->mux_buffer);
 	switch_clear_flag_locked(member, MFLAG_RUNNING);
 	if (switch_test_flag((&fh), SWITCH_FILE_OPEN)) {
 		switch_core_file_close(&fh);
@@ -5085,14 +5057,16 @@ static int setup_media(conference_member_t *member, conference_obj_t *conference
 		goto codec_done2;
 	}
 
-	/* Setup an audio buffer for the incoming audio */
-	if (switch_buffer_create_dynamic(&member->audio_buffer, CONF_DBLOCK_SIZE, CONF_DBUFFER_SIZE, CONF_DBUFFER_MAX) != SWITCH_STATUS_SUCCESS) {
+	/* Setup an audio buffer for the incoming audio, a transfer keeps the ring the input thread is already writing to */
+	if (!member->audio_buffer && switch_ringbuffer_create(NULL, &member->audio_buffer, CONF_BUFFER_SIZE) != SWITCH_STATUS_SUCCESS) {
 		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(member->session), SWITCH_LOG_CRIT, "Memory Error Creating Audio Buffer!\n");
 		goto codec_done1;
 	}
 
-	/* Setup an audio buffer for the outgoing audio */
-	if (switch_buffer_create_dynamic(&member->mux_buffer, CONF_DBLOCK_SIZE, CONF_DBUFFER_SIZE, CONF_DBUFFER_MAX) != SWITCH_STATUS_SUCCESS) {
+	/* Setup an audio buffer for the outgoing audio, on a transfer have the output loop drop what was mixed at the old rate */
+	if (member->mux_buffer) {
+		switch_set_flag_locked(member, MFLAG_FLUSH_BUFFER);
+	} else if (switch_ringbuffer_create(NULL, &member->mux_buffer, CONF_BUFFER_SIZE) != SWITCH_STATUS_SUCCESS) {
 		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(member->session), SWITCH_LOG_CRIT, "Memory Error Creating Audio Buffer!\n");
 		goto codec_done1;
 	}
@@ -5550,8 +5524,8 @@ SWITCH_STANDARD_APP(conference_function)
 
 	switch_event_destroy(&params);
 	switch_buffer_destroy(&member.resample_buffer);
-	switch_buffer_destroy(&member.audio_buffer);
-	switch_buffer_destroy(&member.mux_buffer);
+	switch_ringbuffer_destroy(&member.audio_buffer);
+	switch_ringbuffer_destroy(&member.mux_buffer);
 	if (conference && member.dtmf_parser != conference->dtmf_parser) {
 		switch_ivr_digit_stream_parser_destroy(member.dtmf_parser);
 	}
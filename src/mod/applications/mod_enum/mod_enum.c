@@ -55,13 +55,23 @@ typedef struct enum_record enum_record_t;
 struct query {
 	const char *name;			/* original query string */
 	char *number;
+	char *key;
 	unsigned char dn[DNS_MAXDN];
 	enum dns_type qtyp;			/* type of the query */
 	enum_record_t *results;
 	int errs;
+	unsigned ttl;
+	int done;
+	int refs;
 };
 typedef struct query enum_query_t;
 
+struct cache_entry {
+	enum_record_t *results;
+	time_t expires;
+};
+typedef struct cache_entry enum_cache_entry_t;
+
 struct route {
 	char *service;
 	char *regex;
@@ -81,8 +91,29 @@ static struct {
 	switch_memory_pool_t *pool;
 	int auto_reload;
 	int timeout;
+	int cache;
+	int cache_max_ttl;
+	int cache_max_entries;
+	int negative_ttl;
+	int max_queries;
 } globals;
 
+/* one udns context shared by every lookup, driven by its own thread */
+static struct {
+	switch_mutex_t *mutex;
+	switch_thread_cond_t *cond;
+	struct dns_ctx *ctx;
+	switch_thread_t *thread;
+	int running;
+	switch_hash_t *pending;
+	switch_hash_t *cache;
+	int cache_count;
+	int active;
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t coalesced;
+} resolver;
+
 SWITCH_DECLARE_GLOBAL_STRING_FUNC(set_global_root, globals.root);
 SWITCH_DECLARE_GLOBAL_STRING_FUNC(set_global_isn_root, globals.isn_root);
 
@@ -129,6 +160,19 @@ static switch_status_t load_config(void)
 				globals.auto_reload = switch_true(val);
 			} else if (!strcasecmp(var, "query-timeout")) {
 				globals.timeout = atoi(val);
+			} else if (!strcasecmp(var, "cache")) {
+				globals.cache = switch_true(val);
+			} else if (!strcasecmp(var, "cache-max-ttl")) {
+				globals.cache_max_ttl = atoi(val);
+			} else if (!strcasecmp(var, "cache-max-entries")) {
+				globals.cache_max_entries = atoi(val);
+			} else if (!strcasecmp(var, "negative-cache-ttl")) {
+				globals.negative_ttl = atoi(val);
+			} else if (!strcasecmp(var, "max-concurrent-queries")) {
+				int tmp = atoi(val);
+				if (tmp > 0) {
+					globals.max_queries = tmp;
+				}
 			} else if (!strcasecmp(var, "default-isn-root")) {
 				set_global_isn_root(val);
 			} else if (!strcasecmp(var, "log-level-trace")) {
@@ -265,6 +309,80 @@ static void free_results(enum_record_t ** results)
 	*results = NULL;
 }
 
+static enum_record_t *dup_results(enum_record_t *results)
+{
+	enum_record_t *head = NULL, *tail = NULL, *rp, *np;
+
+	for (rp = results; rp; rp = rp->next) {
+		switch_zmalloc(np, sizeof(*np));
+		np->order = rp->order;
+		np->preference = rp->preference;
+		np->service = strdup(rp->service);
+		np->route = strdup(rp->route);
+		np->supported = rp->supported;
+
+		if (tail) {
+			tail->next = np;
+		} else {
+			head = np;
+		}
+		tail = np;
+	}
+
+	return head;
+}
+
+static void free_cache_entry(enum_cache_entry_t *entry)
+{
+	free_results(&entry->results);
+	free(entry);
+	resolver.cache_count--;
+}
+
+static void release_query(enum_query_t *q)
+{
+	if (--q->refs > 0) {
+		return;
+	}
+
+	free_results(&q->results);
+	switch_safe_free(q->key);
+	switch_safe_free(q->number);
+	free(q);
+}
+
+/* called with the resolver locked once udns is finished with a query */
+static void query_done(enum_query_t *q, int status)
+{
+	enum_cache_entry_t *entry;
+	int ttl = 0;
+
+	if (q->results) {
+		ttl = (int) q->ttl < globals.cache_max_ttl ? (int) q->ttl : globals.cache_max_ttl;
+	} else if (status == DNS_E_NXDOMAIN || status == DNS_E_NODATA || status == 0) {
+		/* a definite no is worth remembering, a timeout or server failure is not */
+		ttl = globals.negative_ttl;
+	}
+
+	if (globals.cache && ttl > 0 && resolver.cache_count < globals.cache_max_entries) {
+		if ((entry = switch_core_hash_find(resolver.cache, q->key))) {
+			switch_core_hash_delete(resolver.cache, q->key);
+			free_cache_entry(entry);
+		}
+		switch_zmalloc(entry, sizeof(*entry));
+		entry->results = dup_results(q->results);
+		entry->expires = switch_epoch_time_now(NULL) + ttl;
+		switch_core_hash_insert(resolver.cache, q->key, entry);
+		resolver.cache_count++;
+	}
+
+	switch_core_hash_delete(resolver.pending, q->key);
+	resolver.active--;
+	q->done = 1;
+	switch_thread_cond_broadcast(resolver.cond);
+	release_query(q);
+}
+
 static void parse_rr(const struct dns_parse *p, enum_query_t *q, struct dns_rr *rr)
 {
 	const unsigned char *pkt = p->dnsp_pkt;
@@ -404,6 +522,7 @@ static void dnscb(struct dns_ctx *ctx, void *result, void *data)
 	const unsigned char *pkt, *cur, *end, *qdn;
 	if (!result) {
 		dnserror(q, r);
+		query_done(q, r);
 		return;
 	}
 	pkt = result;
@@ -418,9 +537,11 @@ static void dnscb(struct dns_ctx *ctx, void *result, void *data)
 	while ((r = dns_nextrr(&p, &rr)) > 0) {
 		if (!dns_dnequal(qdn, rr.dnsrr_dn))
 			continue;
-		if ((qcls == DNS_C_ANY || qcls == rr.dnsrr_cls) && (q->qtyp == DNS_T_ANY || q->qtyp == rr.dnsrr_typ))
-			++nrr;
-		else if (rr.dnsrr_typ == DNS_T_CNAME && !nrr) {
+		if ((qcls == DNS_C_ANY || qcls == rr.dnsrr_cls) && (q->qtyp == DNS_T_ANY || q->qtyp == rr.dnsrr_typ)) {
+			if (!nrr++ || rr.dnsrr_ttl < q->ttl) {
+				q->ttl = rr.dnsrr_ttl;
+			}
+		} else if (rr.dnsrr_typ == DNS_T_CNAME && !nrr) {
 			if (dns_getdn(pkt, &rr.dnsrr_dptr, end, p.dnsp_dnbuf, sizeof(p.dnsp_dnbuf)) <= 0 || rr.dnsrr_dptr != rr.dnsrr_dend) {
 				r = DNS_E_PROTOCOL;
 				break;
@@ -434,6 +555,7 @@ static void dnscb(struct dns_ctx *ctx, void *result, void *data)
 	if (r < 0) {
 		dnserror(q, r);
 		free(result);
+		query_done(q, r);
 		return;
 	}
 
@@ -445,20 +567,161 @@ static void dnscb(struct dns_ctx *ctx, void *result, void *data)
 	}
 
 	free(result);
+	query_done(q, 0);
+}
+
+static void flush_cache(void)
+{
+	switch_hash_index_t *hi;
+	const void *var;
+	void *val;
+
+	switch_mutex_lock(resolver.mutex);
+	while ((hi = switch_hash_first(NULL, resolver.cache))) {
+		switch_hash_this(hi, &var, NULL, &val);
+		switch_core_hash_delete(resolver.cache, (const char *) var);
+		free_cache_entry((enum_cache_entry_t *) val);
+	}
+	resolver.cache_count = 0;
+	switch_mutex_unlock(resolver.mutex);
+}
+
+static void expire_cache(time_t now)
+{
+	switch_hash_index_t *hi;
+	const void *var;
+	void *val;
+	int found = 1;
+
+	/* deleting invalidates the iterator so start over after each one */
+	while (found) {
+		found = 0;
+		for (hi = switch_hash_first(NULL, resolver.cache); hi; hi = switch_hash_next(hi)) {
+			enum_cache_entry_t *entry;
+
+			switch_hash_this(hi, &var, NULL, &val);
+			entry = (enum_cache_entry_t *) val;
+			if (entry->expires <= now) {
+				switch_core_hash_delete(resolver.cache, (const char *) var);
+				free_cache_entry(entry);
+				found = 1;
+				break;
+			}
+		}
+	}
+}
+
+static void *SWITCH_THREAD_FUNC resolver_thread(switch_thread_t *thread, void *obj)
+{
+	time_t now, last_expire = switch_epoch_time_now(NULL);
+	dns_socket fd = dns_sock(resolver.ctx);
+
+	while (resolver.running) {
+		fd_set fds;
+		struct timeval tv = { 0, 100000 };
+		int r;
+
+		switch_mutex_lock(resolver.mutex);
+		now = switch_epoch_time_now(NULL);
+		dns_timeouts(resolver.ctx, -1, now);
+		if (now - last_expire >= 60) {
+			expire_cache(now);
+			last_expire = now;
+		}
+		switch_mutex_unlock(resolver.mutex);
+
+		FD_ZERO(&fds);
+#ifdef _MSC_VER
+#pragma warning(push)
+#pragma warning(disable: 4389 4127)
+#endif
+		FD_SET(fd, &fds);
+#ifdef _MSC_VER
+#pragma warning(pop)
+#endif
+
+		if ((r = select((int) (fd + 1), &fds, 0, 0, &tv)) > 0) {
+			switch_mutex_lock(resolver.mutex);
+			dns_ioevent(resolver.ctx, switch_epoch_time_now(NULL));
+			switch_mutex_unlock(resolver.mutex);
+		}
+	}
+
+	return NULL;
+}
+
+static switch_status_t resolver_start(switch_memory_pool_t *pool)
+{
+	switch_threadattr_t *thd_attr = NULL;
+
+	memset(&resolver, 0, sizeof(resolver));
+	switch_mutex_init(&resolver.mutex, SWITCH_MUTEX_NESTED, pool);
+	switch_thread_cond_create(&resolver.cond, pool);
+	switch_core_hash_init(&resolver.cache, pool);
+	switch_core_hash_init(&resolver.pending, pool);
+
+	if (!(resolver.ctx = dns_new(NULL))) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Memory Error!\n");
+		return SWITCH_STATUS_MEMERR;
+	}
+
+	if (dns_open(resolver.ctx) < 0) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "FD Error!\n");
+		dns_free(resolver.ctx);
+		resolver.ctx = NULL;
+		return SWITCH_STATUS_FALSE;
+	}
+
+	resolver.running = 1;
+	switch_threadattr_create(&thd_attr, pool);
+	switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+	switch_thread_create(&resolver.thread, thd_attr, resolver_thread, NULL, pool);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+static void resolver_stop(void)
+{
+	switch_status_t st;
+	switch_hash_index_t *hi;
+	void *val;
+
+	if (resolver.thread) {
+		resolver.running = 0;
+		switch_thread_join(&st, resolver.thread);
+		resolver.thread = NULL;
+	}
+
+	switch_mutex_lock(resolver.mutex);
+
+	if (resolver.ctx) {
+		/* drops the outstanding queries without calling back */
+		dns_free(resolver.ctx);
+		resolver.ctx = NULL;
+	}
+
+	for (hi = switch_hash_first(NULL, resolver.pending); hi; hi = switch_hash_next(hi)) {
+		switch_hash_this(hi, NULL, NULL, &val);
+		((enum_query_t *) val)->done = 1;
+		release_query((enum_query_t *) val);
+	}
+	switch_core_hash_destroy(&resolver.pending);
+	switch_thread_cond_broadcast(resolver.cond);
+
+	switch_mutex_unlock(resolver.mutex);
+
+	flush_cache();
+	switch_core_hash_destroy(&resolver.cache);
 }
 
 static switch_status_t enum_lookup(char *root, char *in, enum_record_t ** results)
 {
 	switch_status_t sstatus = SWITCH_STATUS_SUCCESS;
-	char *name = NULL;
-	enum_query_t query = { 0 };
-	enum dns_type l_qtyp = DNS_T_NAPTR;
-	int i = 0, abs = 0, j = 0;
-	dns_socket fd = (dns_socket) - 1;
-	fd_set fds;
-	struct timeval tv = { 0 };
-	time_t now = 0;
-	struct dns_ctx *nctx = NULL;
+	char *name = NULL, *key = NULL;
+	enum_query_t *query = NULL;
+	enum_cache_entry_t *entry;
+	int abs = 0;
+	switch_time_t deadline;
 	char *num, *mnum = NULL, *mroot = NULL, *p;
 
 	*results = NULL;
@@ -482,79 +745,101 @@ static switch_status_t enum_lookup(char *root, char *in, enum_record_t ** result
 		goto done;
 	}
 
-	if (!(nctx = dns_new(NULL))) {
-		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Memory Error!\n");
-		sstatus = SWITCH_STATUS_MEMERR;
+	if (!resolver.ctx) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Resolver not running!\n");
+		sstatus = SWITCH_STATUS_FALSE;
 		goto done;
 	}
 
-	fd = dns_open(nctx);
+	/* the answer depends on both the domain and the number the NAPTR regex is applied to */
+	key = switch_mprintf("%s|%s", num, name);
+	deadline = switch_micro_time_now() + (switch_time_t) globals.timeout * 1000000;
 
-	if (fd < 0) {
-		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "FD Error!\n");
-		sstatus = SWITCH_STATUS_FALSE;
-		goto done;
-	}
+	switch_mutex_lock(resolver.mutex);
 
-	dns_ptodn(name, (unsigned int) strlen(name), query.dn, sizeof(query.dn), &abs);
-	query.name = name;
-	query.number = num;
-	query.qtyp = l_qtyp;
+	while (!query) {
+		if (globals.cache && (entry = switch_core_hash_find(resolver.cache, key))) {
+			if (entry->expires > switch_epoch_time_now(NULL)) {
+				resolver.hits++;
+				*results = dup_results(entry->results);
+				switch_mutex_unlock(resolver.mutex);
+				sstatus = *results ? SWITCH_STATUS_SUCCESS : SWITCH_STATUS_FALSE;
+				goto done;
+			}
+			switch_core_hash_delete(resolver.cache, key);
+			free_cache_entry(entry);
+		}
 
-	if (abs) {
-		abs = DNS_NOSRCH;
-	}
+		if ((query = switch_core_hash_find(resolver.pending, key))) {
+			/* somebody already asked, wait for their answer */
+			resolver.coalesced++;
+			query->refs++;
+			break;
+		}
 
-	if (!dns_submit_dn(nctx, query.dn, qcls, l_qtyp, abs, 0, dnscb, &query)) {
-		dnserror(&query, dns_status(nctx));
-	}
+		if (resolver.active < globals.max_queries) {
+			switch_zmalloc(query, sizeof(*query));
+			query->key = strdup(key);
+			query->name = query->key + strlen(num) + 1;
+			query->number = strdup(num);
+			query->qtyp = DNS_T_NAPTR;
+			/* one for the resolver and one for us */
+			query->refs = 2;
 
-	FD_ZERO(&fds);
-	now = 0;
+			dns_ptodn(name, (unsigned int) strlen(name), query->dn, sizeof(query->dn), &abs);
 
-	while ((i = dns_timeouts(nctx, 1, now)) > 0) {
-#ifdef _MSC_VER
-#pragma warning(push)
-#pragma warning(disable: 4389 4127)
-#endif
-		FD_SET(fd, &fds);
-#ifdef _MSC_VER
-#pragma warning(pop)
-#endif
+			if (abs) {
+				abs = DNS_NOSRCH;
+			}
 
-		j += i;
+			resolver.misses++;
 
-		if (j > globals.timeout || query.results || query.errs) {
+			if (!dns_submit_dn(resolver.ctx, query->dn, qcls, query->qtyp, abs, 0, dnscb, query)) {
+				dnserror(query, dns_status(resolver.ctx));
+				query->done = 1;
+				query->refs--;
+				break;
+			}
+
+			switch_core_hash_insert(resolver.pending, key, query);
+			resolver.active++;
+
+			/* get it on the wire now instead of on the next pass of the resolver thread */
+			dns_timeouts(resolver.ctx, -1, switch_epoch_time_now(NULL));
 			break;
 		}
 
-		tv.tv_sec = i;
-		tv.tv_usec = 0;
-		i = select((int) (fd + 1), &fds, 0, 0, &tv);
-		now = switch_epoch_time_now(NULL);
-		if (i > 0) {
-			dns_ioevent(nctx, now);
+		/* too many queries in flight, wait for a slot */
+		if (switch_micro_time_now() >= deadline) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Too many ENUM queries in flight, giving up on %s\n", num);
+			switch_mutex_unlock(resolver.mutex);
+			sstatus = SWITCH_STATUS_FALSE;
+			goto done;
 		}
+		switch_thread_cond_timedwait(resolver.cond, resolver.mutex, deadline - switch_micro_time_now());
 	}
 
-	if (!query.results) {
-		sstatus = SWITCH_STATUS_FALSE;
+	while (!query->done && switch_micro_time_now() < deadline) {
+		switch_thread_cond_timedwait(resolver.cond, resolver.mutex, deadline - switch_micro_time_now());
 	}
 
-	*results = query.results;
-	query.results = NULL;
+	if (query->done) {
+		*results = dup_results(query->results);
+	} else {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "ENUM query for %s timed out\n", num);
+	}
 
-  done:
+	release_query(query);
 
-	if (fd > -1) {
-		closesocket(fd);
-		fd = (dns_socket) - 1;
-	}
+	switch_mutex_unlock(resolver.mutex);
 
-	if (nctx) {
-		dns_free(nctx);
+	if (!*results) {
+		sstatus = SWITCH_STATUS_FALSE;
 	}
 
+  done:
+
+	switch_safe_free(key);
 	switch_safe_free(name);
 	switch_safe_free(mnum);
 	switch_safe_free(mroot);
@@ -731,6 +1016,11 @@ static void do_load(void)
 	memset(&globals, 0, sizeof(globals));
 	switch_core_new_memory_pool(&globals.pool);
 	globals.timeout = 10;
+	globals.cache = 1;
+	globals.cache_max_ttl = 3600;
+	globals.cache_max_entries = 100000;
+	globals.negative_ttl = 60;
+	globals.max_queries = 64;
 	load_config();
 	switch_mutex_unlock(MUTEX);
 
@@ -750,7 +1040,7 @@ SWITCH_STANDARD_API(enum_function)
 	}
 
 	if (!cmd || !(mydata = strdup(cmd))) {
-		stream->write_function(stream, "Usage: enum [reload | <number> [<root>] ]\n");
+		stream->write_function(stream, "Usage: enum [reload | cache | flush | <number> [<root>] ]\n");
 		return SWITCH_STATUS_SUCCESS;
 	}
 
@@ -761,11 +1051,30 @@ SWITCH_STANDARD_API(enum_function)
 
 		if (!strcasecmp(dest, "reload")) {
 			do_load();
+			/* cached answers went through the old routes */
+			flush_cache();
 			stream->write_function(stream, "+OK ENUM Reloaded.\n");
 			return SWITCH_STATUS_SUCCESS;
 
 		}
 
+		if (!strcasecmp(dest, "flush")) {
+			flush_cache();
+			stream->write_function(stream, "+OK ENUM cache flushed.\n");
+			return SWITCH_STATUS_SUCCESS;
+		}
+
+		if (!strcasecmp(dest, "cache")) {
+			switch_mutex_lock(resolver.mutex);
+			stream->write_function(stream, "Cached answers:\t%d\n", resolver.cache_count);
+			stream->write_function(stream, "In flight:\t%d (max %d)\n", resolver.active, globals.max_queries);
+			stream->write_function(stream, "Hits:\t\t%" SWITCH_UINT64_T_FMT "\n", resolver.hits);
+			stream->write_function(stream, "Misses:\t\t%" SWITCH_UINT64_T_FMT "\n", resolver.misses);
+			stream->write_function(stream, "Coalesced:\t%" SWITCH_UINT64_T_FMT "\n", resolver.coalesced);
+			switch_mutex_unlock(resolver.mutex);
+			return SWITCH_STATUS_SUCCESS;
+		}
+
 		if (!enum_lookup(root, dest, &results) == SWITCH_STATUS_SUCCESS) {
 			stream->write_function(stream, "No Match!\n");
 			return SWITCH_STATUS_SUCCESS;
@@ -805,6 +1114,7 @@ static void event_handler(switch_event_t *event)
 		switch_mutex_lock(MUTEX);
 		do_load();
 		switch_mutex_unlock(MUTEX);
+		flush_cache();
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "ENUM Reloaded\n");
 	}
 }
@@ -830,6 +1140,10 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_enum_load)
 	memset(&globals, 0, sizeof(globals));
 	do_load();
 
+	if (resolver_start(pool) != SWITCH_STATUS_SUCCESS) {
+		return SWITCH_STATUS_FALSE;
+	}
+
 	/* connect my internal structure to the blank pointer passed to me */
 	*module_interface = switch_loadable_module_create_module_interface(pool, modname);
 	SWITCH_ADD_API(api_interface, "enum", "ENUM", enum_function, "");
@@ -847,6 +1161,8 @@ SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_enum_shutdown)
 {
 	switch_event_unbind(&NODE);
 
+	resolver_stop();
+
 	if (globals.pool) {
 		switch_core_destroy_memory_pool(&globals.pool);
 	}
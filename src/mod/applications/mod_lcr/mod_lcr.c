@@ -33,7 +33,7 @@
 #include <switch.h>
 
 #define LCR_SYNTAX "lcr <digits> [<lcr profile>] [caller_id] [intrastate] [as xml]"
-#define LCR_ADMIN_SYNTAX "lcr_admin show profiles"
+#define LCR_ADMIN_SYNTAX "lcr_admin show profiles|show cache|reload cache"
 
 /* SQL Query places */
 /* these now make up a map that describes the location of
@@ -54,6 +54,36 @@
 #define LCR_QUERY_COLS_REQUIRED 9
 #define LCR_QUERY_COLS 12
 
+/* columns of the query that loads the memory cache */
+#define LCR_CACHE_DIGITS_PLACE 0
+#define LCR_CACHE_CARRIER_PLACE 1
+#define LCR_CACHE_RATE_PLACE 2
+#define LCR_CACHE_GW_PREFIX_PLACE 3
+#define LCR_CACHE_GW_SUFFIX_PLACE 4
+#define LCR_CACHE_LSTRIP_PLACE 5
+#define LCR_CACHE_TSTRIP_PLACE 6
+#define LCR_CACHE_PREFIX_PLACE 7
+#define LCR_CACHE_SUFFIX_PLACE 8
+#define LCR_CACHE_CODEC_PLACE 9
+#define LCR_CACHE_CID_PLACE 10
+#define LCR_CACHE_PROFILE_PLACE 11
+#define LCR_CACHE_DATE_START_PLACE 12
+#define LCR_CACHE_DATE_END_PLACE 13
+#define LCR_CACHE_QUALITY_PLACE 14
+#define LCR_CACHE_RELIABILITY_PLACE 15
+#define LCR_CACHE_INTRASTATE_PLACE 16
+#define LCR_CACHE_INTRALATA_PLACE 17
+
+#define LCR_CACHE_COLS 18
+
+/* which of the rate columns a lookup is using */
+#define LCR_RATE_INTERSTATE 0
+#define LCR_RATE_INTRASTATE 1
+#define LCR_RATE_INTRALATA 2
+#define LCR_RATE_COUNT 3
+
+#define LCR_MAX_ORDER_KEYS 4
+
 #define LCR_HEADERS_COUNT 6
 
 #define LCR_HEADERS_DIGITS 0
@@ -112,6 +142,56 @@ typedef lcr_obj_t *lcr_route;
 typedef struct max_obj max_obj_t;
 typedef max_obj_t *max_len;
 
+typedef enum {
+	LCR_ORDER_RATE,
+	LCR_ORDER_QUALITY,
+	LCR_ORDER_RELIABILITY
+} lcr_order_key_t;
+
+/* one row of the lcr table as held by the memory cache, strings are interned */
+struct lcr_cache_route {
+	const char *carrier_name;
+	const char *gw_prefix;
+	const char *gw_suffix;
+	const char *prefix;
+	const char *suffix;
+	const char *lstrip;
+	const char *tstrip;
+	const char *codec;
+	const char *cid;
+	const char *rate_str[LCR_RATE_COUNT];
+	float rate[LCR_RATE_COUNT];
+	float quality;
+	float reliability;
+	int lcr_profile;
+	switch_time_t date_start;
+	switch_time_t date_end;
+	struct lcr_cache_route *next;
+};
+typedef struct lcr_cache_route lcr_cache_route_t;
+
+struct lcr_trie_node {
+	const char *digits;
+	lcr_cache_route_t *routes;
+	uint32_t route_count;
+	struct lcr_trie_node *child[10];
+};
+typedef struct lcr_trie_node lcr_trie_node_t;
+
+struct lcr_cache {
+	switch_memory_pool_t *pool;
+	switch_hash_t *strings;
+	lcr_trie_node_t root;
+	switch_bool_t has_codec;
+	switch_bool_t has_cid;
+	uint32_t routes;
+	uint32_t nodes;
+	uint32_t strings_count;
+	switch_time_t loaded;
+	switch_time_t load_time;
+};
+typedef struct lcr_cache lcr_cache_t;
+
 struct profile_obj {
 	char *name;
 	uint16_t id;
@@ -127,6 +207,11 @@ struct profile_obj {
 	switch_bool_t quote_in_list;
 	switch_bool_t info_in_headers;
 	switch_bool_t enable_sip_redir;
+
+	/* set when the profile uses the default sql and can be served from the memory cache */
+	switch_bool_t use_memory_cache;
+	lcr_order_key_t order_keys[LCR_MAX_ORDER_KEYS];
+	int order_key_count;
 };
 typedef struct profile_obj profile_t;
 
@@ -155,6 +240,15 @@ static struct {
 	switch_hash_t *profile_hash;
 	profile_t *default_profile;
 	void *filler1;
+	switch_bool_t memory_cache;
+	uint32_t memory_cache_refresh;
+	switch_thread_rwlock_t *cache_rwlock;
+	lcr_cache_t *cache;
+	switch_thread_t *cache_thread;
+	int cache_running;
+	int cache_reload;
+	uint64_t cache_lookups;
+	uint64_t sql_lookups;
 } globals;
 
 
@@ -673,6 +767,298 @@ static int route_add_callback(void *pArg, int argc, char **argv, char **columnNa
 	return SWITCH_STATUS_SUCCESS;
 }
 
+static const char *lcr_cache_intern(lcr_cache_t *cache, const char *str)
+{
+	char *val;
+
+	if (zstr(str)) {
+		return "";
+	}
+
+	if (!(val = switch_core_hash_find(cache->strings, str))) {
+		val = switch_core_strdup(cache->pool, str);
+		switch_core_hash_insert(cache->strings, val, val);
+		cache->strings_count++;
+	}
+
+	return val;
+}
+
+static int lcr_cache_load_callback(void *pArg, int argc, char **argv, char **columnNames)
+{
+	lcr_cache_t *cache = (lcr_cache_t *) pArg;
+	lcr_trie_node_t *node = &cache->root;
+	lcr_cache_route_t *route;
+	const char *p;
+	int x;
+
+	if (argc < LCR_CACHE_COLS) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "Unexpected number of columns returned loading the lcr cache: %d\n", argc);
+		return SWITCH_STATUS_GENERR;
+	}
+
+	if (zstr(argv[LCR_CACHE_DIGITS_PLACE]) || !switch_is_number(argv[LCR_CACHE_DIGITS_PLACE])) {
+		/* lookups only ever ask for digit prefixes so nothing else could match */
+		return SWITCH_STATUS_SUCCESS;
+	}
+
+	for (p = argv[LCR_CACHE_DIGITS_PLACE]; *p; p++) {
+		if (!switch_isdigit(*p)) {
+			return SWITCH_STATUS_SUCCESS;
+		}
+		x = *p - '0';
+		if (!node->child[x]) {
+			node->child[x] = switch_core_alloc(cache->pool, sizeof(lcr_trie_node_t));
+			cache->nodes++;
+		}
+		node = node->child[x];
+	}
+
+	if (!node->digits) {
+		node->digits = switch_core_strdup(cache->pool, argv[LCR_CACHE_DIGITS_PLACE]);
+	}
+
+	route = switch_core_alloc(cache->pool, sizeof(*route));
+	route->carrier_name = lcr_cache_intern(cache, argv[LCR_CACHE_CARRIER_PLACE]);
+	route->gw_prefix = lcr_cache_intern(cache, argv[LCR_CACHE_GW_PREFIX_PLACE]);
+	route->gw_suffix = lcr_cache_intern(cache, argv[LCR_CACHE_GW_SUFFIX_PLACE]);
+	route->prefix = lcr_cache_intern(cache, argv[LCR_CACHE_PREFIX_PLACE]);
+	route->suffix = lcr_cache_intern(cache, argv[LCR_CACHE_SUFFIX_PLACE]);
+	route->lstrip = lcr_cache_intern(cache, argv[LCR_CACHE_LSTRIP_PLACE]);
+	route->tstrip = lcr_cache_intern(cache, argv[LCR_CACHE_TSTRIP_PLACE]);
+	route->codec = lcr_cache_intern(cache, argv[LCR_CACHE_CODEC_PLACE]);
+	route->cid = lcr_cache_intern(cache, argv[LCR_CACHE_CID_PLACE]);
+	route->rate_str[LCR_RATE_INTERSTATE] = lcr_cache_intern(cache, argv[LCR_CACHE_RATE_PLACE]);
+	route->rate_str[LCR_RATE_INTRASTATE] = lcr_cache_intern(cache, argv[LCR_CACHE_INTRASTATE_PLACE]);
+	route->rate_str[LCR_RATE_INTRALATA] = lcr_cache_intern(cache, argv[LCR_CACHE_INTRALATA_PLACE]);
+	for (x = 0; x < LCR_RATE_COUNT; x++) {
+		route->rate[x] = (float) atof(route->rate_str[x]);
+	}
+	route->quality = (float) atof(switch_str_nil(argv[LCR_CACHE_QUALITY_PLACE]));
+	route->reliability = (float) atof(switch_str_nil(argv[LCR_CACHE_RELIABILITY_PLACE]));
+	route->lcr_profile = atoi(switch_str_nil(argv[LCR_CACHE_PROFILE_PLACE]));
+	route->date_start = zstr(argv[LCR_CACHE_DATE_START_PLACE]) ? 0 : switch_str_time(argv[LCR_CACHE_DATE_START_PLACE]);
+	route->date_end = zstr(argv[LCR_CACHE_DATE_END_PLACE]) ? 0 : switch_str_time(argv[LCR_CACHE_DATE_END_PLACE]);
+
+	route->next = node->routes;
+	node->routes = route;
+	node->route_count++;
+	cache->routes++;
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+static void lcr_cache_destroy(lcr_cache_t **cache)
+{
+	switch_memory_pool_t *pool;
+
+	if (!cache || !*cache) {
+		return;
+	}
+
+	pool = (*cache)->pool;
+	switch_core_hash_destroy(&(*cache)->strings);
+	*cache = NULL;
+	switch_core_destroy_memory_pool(&pool);
+}
+
+/* load every enabled, unexpired route into a fresh trie and swap it in */
+static switch_status_t lcr_cache_load(void)
+{
+	switch_stream_handle_t sql_stream = { 0 };
+	switch_memory_pool_t *pool = NULL;
+	lcr_cache_t *cache, *old;
+	switch_bool_t ok;
+	switch_time_t start = switch_micro_time_now();
+
+	if (!globals.odbc_dsn) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	switch_core_new_memory_pool(&pool);
+	cache = switch_core_alloc(pool, sizeof(*cache));
+	cache->pool = pool;
+	switch_core_hash_init(&cache->strings, pool);
+	cache->has_codec = db_check("SELECT codec from carrier_gateway limit 1");
+	cache->has_cid = db_check("SELECT cid from lcr limit 1");
+
+	SWITCH_STANDARD_STREAM(sql_stream);
+	sql_stream.write_function(&sql_stream,
+							  "SELECT l.digits, c.carrier_name, l.rate, cg.prefix AS gw_prefix, cg.suffix AS gw_suffix, l.lead_strip, l.trail_strip, l.prefix, l.suffix, ");
+	sql_stream.write_function(&sql_stream, "%s, %s, ", cache->has_codec ? "cg.codec" : "''", cache->has_cid ? "l.cid" : "''");
+	sql_stream.write_function(&sql_stream, "l.lcr_profile, l.date_start, l.date_end, l.quality, l.reliability, ");
+	sql_stream.write_function(&sql_stream, "%s, %s ", db_check("SELECT intrastate_rate FROM lcr LIMIT 1") ? "l.intrastate_rate" : "l.rate",
+							  db_check("SELECT intralata_rate FROM lcr LIMIT 1") ? "l.intralata_rate" : "l.rate");
+	sql_stream.write_function(&sql_stream,
+							  "FROM lcr l JOIN carriers c ON l.carrier_id=c.id JOIN carrier_gateway cg ON c.id=cg.carrier_id WHERE c.enabled = '1' AND cg.enabled = '1' AND l.enabled = '1' AND date_end >= CURRENT_TIMESTAMP;");
+
+	ok = lcr_execute_sql_callback((char *) sql_stream.data, lcr_cache_load_callback, cache);
+	switch_safe_free(sql_stream.data);
+
+	if (!ok) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Error loading the lcr memory cache, lookups stay on sql\n");
+		lcr_cache_destroy(&cache);
+		return SWITCH_STATUS_FALSE;
+	}
+
+	cache->loaded = switch_micro_time_now();
+	cache->load_time = cache->loaded - start;
+
+	switch_thread_rwlock_wrlock(globals.cache_rwlock);
+	old = globals.cache;
+	globals.cache = cache;
+	switch_thread_rwlock_unlock(globals.cache_rwlock);
+
+	lcr_cache_destroy(&old);
+
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "Loaded %u routes into the lcr memory cache in %" SWITCH_TIME_T_FMT "ms\n",
+					  cache->routes, cache->load_time / 1000);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+static void *SWITCH_THREAD_FUNC lcr_cache_thread(switch_thread_t *thread, void *obj)
+{
+	switch_time_t next = 0;
+
+	while (globals.cache_running) {
+		if (globals.cache_reload || switch_epoch_time_now(NULL) >= next) {
+			globals.cache_reload = 0;
+			lcr_cache_load();
+			next = switch_epoch_time_now(NULL) + globals.memory_cache_refresh;
+		}
+		switch_yield(1000000);
+	}
+
+	return NULL;
+}
+
+struct lcr_cache_match {
+	lcr_cache_route_t *route;
+	float keys[LCR_MAX_ORDER_KEYS];
+	int key_count;
+	int random;
+};
+typedef struct lcr_cache_match lcr_cache_match_t;
+
+static int lcr_cache_match_cmp(const void *a, const void *b)
+{
+	const lcr_cache_match_t *ma = (const lcr_cache_match_t *) a, *mb = (const lcr_cache_match_t *) b;
+	int x;
+
+	for (x = 0; x < ma->key_count; x++) {
+		if (ma->keys[x] < mb->keys[x]) {
+			return -1;
+		}
+		if (ma->keys[x] > mb->keys[x]) {
+			return 1;
+		}
+	}
+
+	return ma->random < mb->random ? -1 : (ma->random > mb->random ? 1 : 0);
+}
+
+/* 
+   walk the trie along the digits and hand the rows to route_add_callback longest match first,
+   in the same order the default sql would have returned them
+ */
+static switch_status_t lcr_cache_lookup(callback_t *cb_struct, const char *digits, int rate_idx)
+{
+	lcr_trie_node_t *path[256];
+	lcr_trie_node_t *node;
+	lcr_cache_match_t *matches = NULL;
+	profile_t *profile = cb_struct->profile;
+	switch_time_t now = switch_micro_time_now();
+	switch_status_t status = SWITCH_STATUS_SUCCESS;
+	const char *p;
+	int depth = 0, x, k;
+
+	switch_thread_rwlock_rdlock(globals.cache_rwlock);
+
+	if (!globals.cache) {
+		switch_thread_rwlock_unlock(globals.cache_rwlock);
+		return SWITCH_STATUS_NOTFOUND;
+	}
+
+	for (node = &globals.cache->root, p = digits; *p && depth < (int) (sizeof(path) / sizeof(path[0])); p++) {
+		if (!(node = node->child[*p - '0'])) {
+			break;
+		}
+		path[depth++] = node;
+	}
+
+	for (x = depth - 1; x >= 0 && status == SWITCH_STATUS_SUCCESS; x--) {
+		lcr_cache_route_t *route;
+		int count = 0, i;
+
+		if (!(node = path[x])->route_count) {
+			continue;
+		}
+
+		switch_safe_free(matches);
+		switch_zmalloc(matches, node->route_count * sizeof(*matches));
+
+		for (route = node->routes; route; route = route->next) {
+			if ((profile->id > 0 && route->lcr_profile != profile->id) || now < route->date_start || (route->date_end && now > route->date_end)) {
+				continue;
+			}
+
+			matches[count].route = route;
+			matches[count].key_count = profile->order_key_count;
+			matches[count].random = db_random ? rand() : 0;
+			for (k = 0; k < profile->order_key_count; k++) {
+				switch (profile->order_keys[k]) {
+				case LCR_ORDER_RATE:
+					matches[count].keys[k] = route->rate[rate_idx];
+					break;
+				case LCR_ORDER_QUALITY:
+					matches[count].keys[k] = -route->quality;
+					break;
+				case LCR_ORDER_RELIABILITY:
+					matches[count].keys[k] = -route->reliability;
+					break;
+				}
+			}
+			count++;
+		}
+
+		qsort(matches, count, sizeof(*matches), lcr_cache_match_cmp);
+
+		for (i = 0; i < count; i++) {
+			char *argv[LCR_QUERY_COLS] = { 0 };
+			int argc = LCR_QUERY_COLS_REQUIRED;
+
+			route = matches[i].route;
+			argv[LCR_DIGITS_PLACE] = (char *) node->digits;
+			argv[LCR_CARRIER_PLACE] = (char *) route->carrier_name;
+			argv[LCR_RATE_PLACE] = (char *) route->rate_str[rate_idx];
+			argv[LCR_GW_PREFIX_PLACE] = (char *) route->gw_prefix;
+			argv[LCR_GW_SUFFIX_PLACE] = (char *) route->gw_suffix;
+			argv[LCR_LSTRIP_PLACE] = (char *) route->lstrip;
+			argv[LCR_TSTRIP_PLACE] = (char *) route->tstrip;
+			argv[LCR_PREFIX_PLACE] = (char *) route->prefix;
+			argv[LCR_SUFFIX_PLACE] = (char *) route->suffix;
+			/* the default sql only selects these when the schema has them */
+			if (globals.cache->has_codec) {
+				argv[argc++] = (char *) route->codec;
+			}
+			if (globals.cache->has_cid) {
+				argv[argc++] = (char *) route->cid;
+			}
+
+			if (route_add_callback(cb_struct, argc, argv, NULL) != SWITCH_STATUS_SUCCESS) {
+				status = SWITCH_STATUS_GENERR;
+				break;
+			}
+		}
+	}
+
+	switch_thread_rwlock_unlock(globals.cache_rwlock);
+	switch_safe_free(matches);
+
+	return status;
+}
+
 static int intrastatelata_callback(void *pArg, int argc, char **argv, char **columnNames)
 {
 	int count = 0;
@@ -746,6 +1132,8 @@ static switch_status_t lcr_do_lookup(callback_t *cb_struct)
 	char *safe_sql = NULL;
 	char *rate_field = NULL;
 	char *user_rate_field = NULL;
+	int rate_idx = LCR_RATE_INTERSTATE;
+	switch_status_t cache_status;
 
 	switch_assert(cb_struct->lookup_number != NULL);
 
@@ -770,9 +1158,11 @@ static switch_status_t lcr_do_lookup(callback_t *cb_struct)
 	if (cb_struct->intralata == SWITCH_TRUE && profile->profile_has_intralata == SWITCH_TRUE) {
 		rate_field = switch_core_strdup(cb_struct->pool, "intralata_rate");
 		user_rate_field = switch_core_strdup(cb_struct->pool, "user_intralata_rate");
+		rate_idx = LCR_RATE_INTRALATA;
 	} else if (cb_struct->intrastate == SWITCH_TRUE && profile->profile_has_intrastate == SWITCH_TRUE) {
 		rate_field = switch_core_strdup(cb_struct->pool, "intrastate_rate");
 		user_rate_field = switch_core_strdup(cb_struct->pool, "user_intrastate_rate");
+		rate_idx = LCR_RATE_INTRASTATE;
 	} else {
 		rate_field = switch_core_strdup(cb_struct->pool, "rate");
 		user_rate_field = switch_core_strdup(cb_struct->pool, "user_rate");
@@ -802,6 +1192,21 @@ static switch_status_t lcr_do_lookup(callback_t *cb_struct)
 		switch_event_add_header_string(cb_struct->event, SWITCH_STACK_BOTTOM, "lcr_query_expanded_digits", digits_expanded);
 	}
 
+	/* the memory cache answers for the default query, sql stays the source of truth until it is loaded */
+	if (profile->use_memory_cache && (cache_status = lcr_cache_lookup(cb_struct, digits_copy, rate_idx)) != SWITCH_STATUS_NOTFOUND) {
+		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(cb_struct->session), SWITCH_LOG_DEBUG, "Routes for %s served from the memory cache\n", digits_copy);
+		switch_mutex_lock(globals.mutex);
+		globals.cache_lookups++;
+		switch_mutex_unlock(globals.mutex);
+		switch_event_safe_destroy(&cb_struct->event);
+		switch_core_hash_destroy(&cb_struct->dedup_hash);
+		return cache_status;
+	}
+
+	switch_mutex_lock(globals.mutex);
+	globals.sql_lookups++;
+	switch_mutex_unlock(globals.mutex);
+
 	/* set up the query to be executed */
 	/* format the custom_sql */
 	safe_sql = format_custom_sql(profile->custom_sql, cb_struct, digits_copy);
@@ -883,6 +1288,13 @@ static switch_status_t lcr_load_config()
 						*globals.odbc_pass++ = '\0';
 					}
 				}
+			} else if (!strcasecmp(var, "memory-cache") && !zstr(val)) {
+				globals.memory_cache = switch_true(val);
+			} else if (!strcasecmp(var, "memory-cache-refresh") && !zstr(val)) {
+				int tmp = atoi(val);
+				if (tmp > 0) {
+					globals.memory_cache_refresh = (uint32_t) tmp;
+				}
 			}
 		}
 	}
@@ -917,6 +1329,9 @@ static switch_status_t lcr_load_config()
 			char *custom_sql = NULL;
 			int argc, x = 0;
 			char *argv[4] = { 0 };
+			lcr_order_key_t order_keys[LCR_MAX_ORDER_KEYS];
+			int order_key_count = 0;
+			switch_bool_t order_cacheable = SWITCH_TRUE;
 
 			SWITCH_STANDARD_STREAM(order_by);
 
@@ -935,12 +1350,16 @@ static switch_status_t lcr_load_config()
 							if (!zstr(argv[x])) {
 								if (!strcasecmp(argv[x], "quality")) {
 									thisorder->write_function(thisorder, "%s quality DESC", comma);
+									order_keys[order_key_count++] = LCR_ORDER_QUALITY;
 								} else if (!strcasecmp(argv[x], "reliability")) {
 									thisorder->write_function(thisorder, "%s reliability DESC", comma);
+									order_keys[order_key_count++] = LCR_ORDER_RELIABILITY;
 								} else if (!strcasecmp(argv[x], "rate")) {
 									thisorder->write_function(thisorder, "%s ${lcr_rate_field}", comma);
+									order_keys[order_key_count++] = LCR_ORDER_RATE;
 								} else {
 									thisorder->write_function(thisorder, "%s %s", comma, argv[x]);
+									order_cacheable = SWITCH_FALSE;
 								}
 							} else {
 								switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "arg #%d is empty\n", x);
@@ -949,10 +1368,13 @@ static switch_status_t lcr_load_config()
 					} else {
 						if (!strcasecmp(val, "quality")) {
 							thisorder->write_function(thisorder, "%s quality DESC", comma);
+							order_keys[order_key_count++] = LCR_ORDER_QUALITY;
 						} else if (!strcasecmp(val, "reliability")) {
 							thisorder->write_function(thisorder, "%s reliability DESC", comma);
+							order_keys[order_key_count++] = LCR_ORDER_RELIABILITY;
 						} else {
 							thisorder->write_function(thisorder, "%s %s", comma, val);
+							order_cacheable = SWITCH_FALSE;
 						}
 					}
 				} else if (!strcasecmp(var, "id") && !zstr(val)) {
@@ -982,7 +1404,10 @@ static switch_status_t lcr_load_config()
 				} else {
 					/* default to rate */
 					profile->order_by = ", ${lcr_rate_field}";
+					order_keys[order_key_count++] = LCR_ORDER_RATE;
 				}
+				memcpy(profile->order_keys, order_keys, sizeof(order_keys));
+				profile->order_key_count = order_key_count;
 
 				if (!zstr(id_s)) {
 					profile->id = (uint16_t) atoi(id_s);
@@ -1021,6 +1446,9 @@ static switch_status_t lcr_load_config()
 					sql_stream.write_function(&sql_stream, ";");
 
 					custom_sql = sql_stream.data;
+
+					/* custom sql can select anything so only the default query is mirrored by the memory cache */
+					profile->use_memory_cache = globals.memory_cache && order_cacheable;
 				}
 
 
@@ -1521,8 +1949,37 @@ SWITCH_STANDARD_API(dialplan_lcr_admin_function)
 				stream->write_function(stream, " Info in headers:\t%s\n", profile->info_in_headers ? "enabled" : "disabled");
 				stream->write_function(stream, " Sip Redirection Mode:\t%s\n", profile->enable_sip_redir ? "enabled" : "disabled");
 				stream->write_function(stream, " Quote IN() List:\t%s\n", profile->quote_in_list ? "enabled" : "disabled");
+				stream->write_function(stream, " Memory cache:\t%s\n", profile->use_memory_cache ? "enabled" : "disabled");
 				stream->write_function(stream, "\n");
 			}
+		} else if (!strcasecmp(argv[0], "show") && !strcasecmp(argv[1], "cache")) {
+			if (!globals.memory_cache) {
+				stream->write_function(stream, "Memory cache:\tdisabled\n");
+			} else {
+				switch_thread_rwlock_rdlock(globals.cache_rwlock);
+				if (globals.cache) {
+					stream->write_function(stream, "Routes:\t\t%u\n", globals.cache->routes);
+					stream->write_function(stream, "Trie nodes:\t%u\n", globals.cache->nodes);
+					stream->write_function(stream, "Strings:\t%u\n", globals.cache->strings_count);
+					stream->write_function(stream, "Loaded:\t\t%" SWITCH_TIME_T_FMT "s ago in %" SWITCH_TIME_T_FMT "ms\n",
+										   (switch_micro_time_now() - globals.cache->loaded) / 1000000, globals.cache->load_time / 1000);
+				} else {
+					stream->write_function(stream, "Memory cache:\tnot loaded\n");
+				}
+				switch_thread_rwlock_unlock(globals.cache_rwlock);
+				stream->write_function(stream, "Refresh:\t%us\n", globals.memory_cache_refresh);
+			}
+			switch_mutex_lock(globals.mutex);
+			stream->write_function(stream, "Cache lookups:\t%" SWITCH_UINT64_T_FMT "\n", globals.cache_lookups);
+			stream->write_function(stream, "SQL lookups:\t%" SWITCH_UINT64_T_FMT "\n", globals.sql_lookups);
+			switch_mutex_unlock(globals.mutex);
+		} else if (!strcasecmp(argv[0], "reload") && !strcasecmp(argv[1], "cache")) {
+			if (globals.memory_cache) {
+				globals.cache_reload = 1;
+				stream->write_function(stream, "+OK cache reload scheduled\n");
+			} else {
+				stream->write_function(stream, "-ERR memory cache is disabled\n");
+			}
 		} else {
 			goto usage;
 		}
@@ -1556,11 +2013,24 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_lcr_load)
 	if (switch_mutex_init(&globals.mutex, SWITCH_MUTEX_NESTED, globals.pool) != SWITCH_STATUS_SUCCESS) {
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "failed to initialize mutex\n");
 	}
+	switch_thread_rwlock_create(&globals.cache_rwlock, globals.pool);
+	globals.memory_cache_refresh = 300;
+
 	if (lcr_load_config() != SWITCH_STATUS_SUCCESS) {
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Unable to load lcr config file\n");
 		return SWITCH_STATUS_FALSE;
 	}
 
+	if (globals.memory_cache && globals.odbc_dsn) {
+		switch_threadattr_t *thd_attr = NULL;
+
+		/* the first load happens in the background, lookups use sql until it is done */
+		globals.cache_running = 1;
+		switch_threadattr_create(&thd_attr, globals.pool);
+		switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+		switch_thread_create(&globals.cache_thread, thd_attr, lcr_cache_thread, NULL, globals.pool);
+	}
+
 	SWITCH_ADD_API(dialplan_lcr_api_interface, "lcr", "Least Cost Routing Module", dialplan_lcr_function, LCR_SYNTAX);
 	SWITCH_ADD_API(dialplan_lcr_api_admin_interface, "lcr_admin", "Least Cost Routing Module Admin", dialplan_lcr_admin_function, LCR_ADMIN_SYNTAX);
 	SWITCH_ADD_APP(app_interface, "lcr", "Perform an LCR lookup", "Perform an LCR lookup",
@@ -1573,6 +2043,13 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_lcr_load)
 
 SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_lcr_shutdown)
 {
+	switch_status_t st;
+
+	if (globals.cache_thread) {
+		globals.cache_running = 0;
+		switch_thread_join(&st, globals.cache_thread);
+	}
+	lcr_cache_destroy(&globals.cache);
 
 	switch_core_hash_destroy(&globals.profile_hash);
 
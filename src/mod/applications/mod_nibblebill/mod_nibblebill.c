@@ -45,7 +45,7 @@
  * TODO: Fix what happens when the DB queries fail (right now, all are acting like success)
  * TODO: Add buffering abilities
  * TODO: Make error handling for database, such that when the database is down (or not installed) we just log to a text file
- * FUTURE: Possibly make the hooks not tied per-channel, and instead just do this as a supervision style application with one thread that watches all calls
+ * Setting "supervisor" moves billing onto one thread that watches all calls and batches the database writes
  */
 
 #include <switch.h>
@@ -60,6 +60,27 @@ typedef struct {
 } nibble_data_t;
 
 
+/* An account with calls up, or debits not yet written to the database */
+typedef struct {
+	char *name;
+	float balance;				/* Balance as last read from the database */
+	float pending;				/* Debits not yet written */
+	float flushing;				/* Debits in the transaction being written */
+	switch_time_t loaded;		/* When balance was read */
+	int calls;					/* Supervised calls billing this account */
+	int low;					/* Low balance already signalled */
+} nibble_account_t;
+
+/* A supervised call, kept in a heap ordered by when it is next due for billing */
+typedef struct {
+	char uuid[SWITCH_UUID_FORMATTED_LENGTH + 1];
+	char *account;
+	switch_time_t due;
+	int removed;
+} nibble_call_t;
+
+#define NIBBLE_EVENT_LOW_BALANCE "nibblebill::low_balance"
+
 typedef struct nibblebill_results {
 	float balance;
 
@@ -90,6 +111,22 @@ static struct {
 	/* Other options */
 	int global_heartbeat;		/* Supervise and bill every X seconds, 0 means off */
 
+	/* Supervisor */
+	int supervisor;				/* Bill all calls from one thread instead of session heartbeats */
+	int supervisor_interval;	/* Bill each call every X seconds */
+	int flush_interval;			/* Write pending debits every X seconds */
+	int balance_ttl;			/* Re-read cached balances every X seconds */
+	switch_hash_t *accounts;
+	switch_hash_t *calls;
+	nibble_call_t **heap;
+	size_t heap_len;
+	size_t heap_size;
+	switch_thread_t *supervisor_thread;
+	int supervisor_running;
+	uint64_t debits;
+	uint64_t flushes;
+	uint64_t flush_failures;
+
 	/* Database settings */
 	char *db_username;
 	char *db_password;
@@ -100,9 +137,11 @@ static struct {
 	char *custom_sql_save;
 	char *custom_sql_lookup;
 	switch_odbc_handle_t *master_odbc;
+	switch_mutex_t *db_mutex;	/* one statement or transaction at a time on master_odbc */
 } globals;
 
 static void nibblebill_pause(switch_core_session_t *session);
+static switch_status_t do_billing(switch_core_session_t *session);
 
 /**************************
 * Setup FreeSWITCH Macros *
@@ -190,6 +229,14 @@ static switch_status_t load_config(void)
 				globals.nobal_amt = (float) atof(val);
 			} else if (!strcasecmp(var, "global_heartbeat")) {
 				globals.global_heartbeat = atoi(val);
+			} else if (!strcasecmp(var, "supervisor")) {
+				globals.supervisor = switch_true(val);
+			} else if (!strcasecmp(var, "supervisor_interval")) {
+				globals.supervisor_interval = atoi(val);
+			} else if (!strcasecmp(var, "flush_interval")) {
+				globals.flush_interval = atoi(val);
+			} else if (!strcasecmp(var, "balance_cache_ttl")) {
+				globals.balance_ttl = atoi(val);
 			}
 		}
 	}
@@ -205,6 +252,20 @@ static switch_status_t load_config(void)
 	if (zstr(globals.nobal_action)) {
 		set_global_nobal_action("hangup");
 	}
+	if (globals.supervisor_interval < 1) {
+		globals.supervisor_interval = globals.global_heartbeat > 0 ? globals.global_heartbeat : 60;
+	}
+	if (globals.flush_interval < 1) {
+		globals.flush_interval = 5;
+	}
+	if (globals.balance_ttl < 1) {
+		globals.balance_ttl = 60;
+	}
+	if (globals.supervisor && (globals.custom_sql_save || globals.custom_sql_lookup)) {
+		/* custom sql is expanded against each channel so it can't be summed per account */
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Billing supervisor can't be used with custom_sql_save or custom_sql_lookup, disabling it\n");
+		globals.supervisor = 0;
+	}
 
 	if (switch_odbc_available() && globals.db_dsn) {
 		if (!(globals.master_odbc = switch_odbc_handle_new(globals.db_dsn, globals.db_username, globals.db_password))) {
@@ -320,6 +381,7 @@ static switch_status_t bill_event(float billamount, const char *billaccount, swi
 
 	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Doing update query\n[%s]\n", sql);
 
+	switch_mutex_lock(globals.db_mutex);
 	if (switch_odbc_handle_exec(globals.master_odbc, sql, &stmt, NULL) != SWITCH_ODBC_SUCCESS) {
 		char *err_str;
 		err_str = switch_odbc_handle_get_error(globals.master_odbc, stmt);
@@ -332,6 +394,7 @@ static switch_status_t bill_event(float billamount, const char *billaccount, swi
 	if (stmt) {
 		switch_odbc_statement_handle_free(&stmt);
 	}
+	switch_mutex_unlock(globals.db_mutex);
 	
 	switch_safe_free(dsql);
 
@@ -344,6 +407,7 @@ static float get_balance(const char *billaccount, switch_channel_t *channel)
 	char *dsql = NULL, *sql = NULL;
 	nibblebill_results_t pdata;
 	float balance = 0.00f;
+	switch_odbc_status_t status;
 
 	if (!switch_odbc_available()) {
 		return -1.00f;
@@ -365,7 +429,11 @@ static float get_balance(const char *billaccount, switch_channel_t *channel)
 
 	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Doing lookup query\n[%s]\n", sql);
 	
-	if (switch_odbc_handle_callback_exec(globals.master_odbc, sql, nibblebill_callback, &pdata, NULL) != SWITCH_ODBC_SUCCESS) {
+	switch_mutex_lock(globals.db_mutex);
+	status = switch_odbc_handle_callback_exec(globals.master_odbc, sql, nibblebill_callback, &pdata, NULL);
+	switch_mutex_unlock(globals.db_mutex);
+
+	if (status != SWITCH_ODBC_SUCCESS) {
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Error running this query: [%s]\n", sql);
 		/* Return -1 for safety */
 
@@ -380,6 +448,418 @@ static float get_balance(const char *billaccount, switch_channel_t *channel)
 	return balance;
 }
 
+/*************************
+* Billing supervisor     *
+*************************/
+/* Debits are summed per account in memory and written out by one thread in a single transaction,
+   balances are read from the database once per balance_cache_ttl instead of on every heartbeat */
+
+static void heap_push(nibble_call_t *call)
+{
+	size_t i;
+
+	if (globals.heap_len == globals.heap_size) {
+		globals.heap_size = globals.heap_size ? globals.heap_size * 2 : 64;
+		globals.heap = realloc(globals.heap, globals.heap_size * sizeof(nibble_call_t *));
+		switch_assert(globals.heap);
+	}
+
+	for (i = globals.heap_len++; i > 0; i = (i - 1) / 2) {
+		nibble_call_t *parent = globals.heap[(i - 1) / 2];
+		if (parent->due <= call->due) {
+			break;
+		}
+		globals.heap[i] = parent;
+	}
+	globals.heap[i] = call;
+}
+
+static nibble_call_t *heap_pop(void)
+{
+	nibble_call_t *top, *last;
+	size_t i = 0, child;
+
+	if (!globals.heap_len) {
+		return NULL;
+	}
+
+	top = globals.heap[0];
+	last = globals.heap[--globals.heap_len];
+
+	while ((child = i * 2 + 1) < globals.heap_len) {
+		if (child + 1 < globals.heap_len && globals.heap[child + 1]->due < globals.heap[child]->due) {
+			child++;
+		}
+		if (last->due <= globals.heap[child]->due) {
+			break;
+		}
+		globals.heap[i] = globals.heap[child];
+		i = child;
+	}
+	globals.heap[i] = last;
+
+	return top;
+}
+
+/* Must be called with globals.mutex held */
+static nibble_account_t *account_find(const char *billaccount, switch_bool_t create)
+{
+	nibble_account_t *account;
+
+	if (!(account = switch_core_hash_find(globals.accounts, billaccount)) && create) {
+		switch_zmalloc(account, sizeof(*account));
+		account->name = strdup(billaccount);
+		switch_core_hash_insert(globals.accounts, account->name, account);
+	}
+
+	return account;
+}
+
+static void account_free(nibble_account_t *account)
+{
+	switch_safe_free(account->name);
+	free(account);
+}
+
+static void fire_low_balance(const char *billaccount, float balance)
+{
+	switch_event_t *event;
+
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "Account %s is down to %f\n", billaccount, balance);
+
+	if (switch_event_create_subclass(&event, SWITCH_EVENT_CUSTOM, NIBBLE_EVENT_LOW_BALANCE) == SWITCH_STATUS_SUCCESS) {
+		switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "nibble_account", billaccount);
+		switch_event_add_header(event, SWITCH_STACK_BOTTOM, "nibble_balance", "%f", balance);
+		switch_event_add_header(event, SWITCH_STACK_BOTTOM, "lowbal_amt", "%f", globals.lowbal_amt);
+		switch_event_fire(&event);
+	}
+}
+
+/* Must be called with globals.mutex held */
+static float account_available(nibble_account_t *account)
+{
+	return account->balance - account->pending - account->flushing;
+}
+
+static float account_balance(const char *billaccount, switch_channel_t *channel)
+{
+	nibble_account_t *account;
+	float balance;
+
+	switch_mutex_lock(globals.mutex);
+	if ((account = account_find(billaccount, SWITCH_FALSE)) && account->loaded) {
+		balance = account_available(account);
+		switch_mutex_unlock(globals.mutex);
+		return balance;
+	}
+	switch_mutex_unlock(globals.mutex);
+
+	/* first time we see this account, after that the supervisor keeps it fresh */
+	if ((balance = get_balance(billaccount, channel)) == -1.00f) {
+		return balance;
+	}
+
+	switch_mutex_lock(globals.mutex);
+	account = account_find(billaccount, SWITCH_TRUE);
+	if (!account->loaded) {
+		account->balance = balance;
+		account->loaded = switch_micro_time_now();
+	}
+	balance = account_available(account);
+	switch_mutex_unlock(globals.mutex);
+
+	return balance;
+}
+
+static void account_debit(float billamount, const char *billaccount)
+{
+	nibble_account_t *account;
+	float balance = 0;
+	int low = 0;
+
+	switch_mutex_lock(globals.mutex);
+	account = account_find(billaccount, SWITCH_TRUE);
+	account->pending += billamount;
+	globals.debits++;
+	if (account->loaded && (balance = account_available(account)) <= globals.lowbal_amt && !account->low) {
+		account->low = 1;
+		low = 1;
+	}
+	switch_mutex_unlock(globals.mutex);
+
+	if (low) {
+		fire_low_balance(billaccount, balance);
+	}
+}
+
+static switch_status_t nibble_debit(float billamount, const char *billaccount, switch_channel_t *channel)
+{
+	if (globals.supervisor) {
+		account_debit(billamount, billaccount);
+		return SWITCH_STATUS_SUCCESS;
+	}
+
+	return bill_event(billamount, billaccount, channel);
+}
+
+static float nibble_balance(const char *billaccount, switch_channel_t *channel)
+{
+	if (globals.supervisor) {
+		return account_balance(billaccount, channel);
+	}
+
+	return get_balance(billaccount, channel);
+}
+
+/* Write every account's pending debits in one transaction */
+static void flush_accounts(void)
+{
+	switch_hash_index_t *hi;
+	switch_odbc_statement_handle_t stmt = NULL;
+	void *val;
+	char **sqls = NULL;
+	int count = 0, size = 0, ok = 0, x;
+
+	switch_mutex_lock(globals.mutex);
+	for (hi = switch_hash_first(NULL, globals.accounts); hi; hi = switch_hash_next(hi)) {
+		nibble_account_t *account;
+
+		switch_hash_this(hi, NULL, NULL, &val);
+		account = (nibble_account_t *) val;
+
+		if (account->pending != 0) {
+			if (count == size) {
+				char **tmp;
+
+				size = size ? size * 2 : 64;
+				if (!(tmp = realloc(sqls, size * sizeof(*sqls)))) {
+					break;
+				}
+				sqls = tmp;
+			}
+			sqls[count++] = switch_mprintf("UPDATE %s SET %s=%s-%f WHERE %s='%q'", globals.db_table, globals.db_column_cash,
+										   globals.db_column_cash, account->pending, globals.db_column_account, account->name);
+			account->flushing = account->pending;
+			account->pending = 0;
+		}
+	}
+	switch_mutex_unlock(globals.mutex);
+
+	if (count) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Flushing debits for %d accounts\n", count);
+
+		/* one statement at a time inside a real transaction, multi statement strings are not portable across drivers
+		   and a failed statement must not leave the connection stuck in an aborted transaction */
+		switch_mutex_lock(globals.db_mutex);
+		if (switch_odbc_available() && switch_odbc_SQLSetAutoCommitAttr(globals.master_odbc, SWITCH_FALSE) == SWITCH_ODBC_SUCCESS) {
+			ok = 1;
+
+			for (x = 0; x < count; x++) {
+				if (switch_odbc_handle_exec(globals.master_odbc, sqls[x], &stmt, NULL) != SWITCH_ODBC_SUCCESS) {
+					ok = 0;
+				}
+
+				if (stmt) {
+					switch_odbc_statement_handle_free(&stmt);
+				}
+
+				if (!ok) {
+					break;
+				}
+			}
+
+			if (ok && switch_odbc_SQLEndTran(globals.master_odbc, SWITCH_TRUE) != SWITCH_ODBC_SUCCESS) {
+				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Commit of %d debits failed\n", count);
+				ok = 0;
+			}
+
+			if (!ok && switch_odbc_SQLEndTran(globals.master_odbc, SWITCH_FALSE) != SWITCH_ODBC_SUCCESS) {
+				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Rollback of %d debits failed\n", count);
+			}
+
+			switch_odbc_SQLSetAutoCommitAttr(globals.master_odbc, SWITCH_TRUE);
+		} else {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Cannot start a transaction to flush %d debits\n", count);
+		}
+		switch_mutex_unlock(globals.db_mutex);
+
+		switch_mutex_lock(globals.mutex);
+		for (hi = switch_hash_first(NULL, globals.accounts); hi; hi = switch_hash_next(hi)) {
+			nibble_account_t *account;
+
+			switch_hash_this(hi, NULL, NULL, &val);
+			account = (nibble_account_t *) val;
+
+			if (ok) {
+				/* the database has it now, keep the cached balance in step until the next read */
+				account->balance -= account->flushing;
+			} else {
+				/* try again next time */
+				account->pending += account->flushing;
+			}
+			account->flushing = 0;
+		}
+		if (ok) {
+			globals.flushes++;
+		} else {
+			globals.flush_failures++;
+		}
+		switch_mutex_unlock(globals.mutex);
+	}
+
+	for (x = 0; x < count; x++) {
+		switch_safe_free(sqls[x]);
+	}
+	switch_safe_free(sqls);
+}
+
+/* Re-read stale balances of accounts with calls up and forget idle ones */
+static void refresh_accounts(void)
+{
+	switch_hash_index_t *hi;
+	const void *var;
+	void *val;
+	switch_time_t now = switch_micro_time_now();
+	char *stale[64];
+	int count = 0, x;
+
+	switch_mutex_lock(globals.mutex);
+  top:
+	for (hi = switch_hash_first(NULL, globals.accounts); hi; hi = switch_hash_next(hi)) {
+		nibble_account_t *account;
+
+		switch_hash_this(hi, &var, NULL, &val);
+		account = (nibble_account_t *) val;
+
+		if (now - account->loaded < (switch_time_t) globals.balance_ttl * 1000000) {
+			continue;
+		}
+
+		if (!account->calls && account->pending == 0) {
+			switch_core_hash_delete(globals.accounts, (const char *) var);
+			account_free(account);
+			goto top;
+		}
+
+		if (count < (int) (sizeof(stale) / sizeof(stale[0]))) {
+			stale[count++] = strdup(account->name);
+		}
+	}
+	switch_mutex_unlock(globals.mutex);
+
+	for (x = 0; x < count; x++) {
+		float balance = get_balance(stale[x], NULL);
+		nibble_account_t *account;
+		int low = 0;
+
+		if (balance != -1.00f) {
+			switch_mutex_lock(globals.mutex);
+			if ((account = account_find(stale[x], SWITCH_FALSE))) {
+				account->balance = balance;
+				account->loaded = switch_micro_time_now();
+				balance = account_available(account);
+				if (balance > globals.lowbal_amt) {
+					account->low = 0;
+				} else if (!account->low) {
+					account->low = low = 1;
+				}
+			}
+			switch_mutex_unlock(globals.mutex);
+
+			if (low) {
+				fire_low_balance(stale[x], balance);
+			}
+		}
+		free(stale[x]);
+	}
+}
+
+static void nibblebill_supervise(switch_core_session_t *session, const char *billaccount)
+{
+	const char *uuid = switch_core_session_get_uuid(session);
+	nibble_call_t *call;
+
+	switch_mutex_lock(globals.mutex);
+	if (!switch_core_hash_find(globals.calls, uuid)) {
+		switch_zmalloc(call, sizeof(*call));
+		switch_copy_string(call->uuid, uuid, sizeof(call->uuid));
+		call->account = strdup(billaccount);
+		call->due = switch_micro_time_now() + (switch_time_t) globals.supervisor_interval * 1000000;
+		account_find(billaccount, SWITCH_TRUE)->calls++;
+		switch_core_hash_insert(globals.calls, call->uuid, call);
+		heap_push(call);
+	}
+	switch_mutex_unlock(globals.mutex);
+}
+
+static void nibblebill_unsupervise(switch_core_session_t *session)
+{
+	const char *uuid = switch_core_session_get_uuid(session);
+	nibble_call_t *call;
+	nibble_account_t *account;
+
+	switch_mutex_lock(globals.mutex);
+	if ((call = switch_core_hash_find(globals.calls, uuid))) {
+		switch_core_hash_delete(globals.calls, uuid);
+		if ((account = account_find(call->account, SWITCH_FALSE)) && account->calls) {
+			account->calls--;
+		}
+		/* the heap entry is dropped when it comes up */
+		call->removed = 1;
+	}
+	switch_mutex_unlock(globals.mutex);
+}
+
+static void *SWITCH_THREAD_FUNC supervisor_thread(switch_thread_t *thread, void *obj)
+{
+	switch_time_t next_flush = switch_micro_time_now() + (switch_time_t) globals.flush_interval * 1000000;
+
+	while (globals.supervisor_running) {
+		char uuids[64][SWITCH_UUID_FORMATTED_LENGTH + 1];
+		int count = 0, x;
+		switch_time_t now = switch_micro_time_now();
+		nibble_call_t *call;
+
+		switch_mutex_lock(globals.mutex);
+		while (count < 64 && globals.heap_len && globals.heap[0]->due <= now) {
+			call = heap_pop();
+			if (call->removed) {
+				switch_safe_free(call->account);
+				free(call);
+				continue;
+			}
+			switch_copy_string(uuids[count++], call->uuid, sizeof(uuids[0]));
+			call->due = now + (switch_time_t) globals.supervisor_interval * 1000000;
+			heap_push(call);
+		}
+		switch_mutex_unlock(globals.mutex);
+
+		for (x = 0; x < count; x++) {
+			switch_core_session_t *session;
+
+			if ((session = switch_core_session_locate(uuids[x]))) {
+				do_billing(session);
+				switch_core_session_rwunlock(session);
+			}
+		}
+
+		if (count == 64) {
+			/* more are due, skip the nap */
+			continue;
+		}
+
+		if (now >= next_flush) {
+			flush_accounts();
+			refresh_accounts();
+			next_flush = now + (switch_time_t) globals.flush_interval * 1000000;
+		}
+
+		switch_yield(100000);
+	}
+
+	return NULL;
+}
+
 /* This is where we actually charge the guy 
   This can be called anytime a call is in progress or at the end of a call before the session is destroyed */
 static switch_status_t do_billing(switch_core_session_t *session)
@@ -445,7 +925,7 @@ static switch_status_t do_billing(switch_core_session_t *session)
 		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_DEBUG, "Not billing %s - call is not in answered state\n", billaccount);
 
 		/* See if this person has enough money left to continue the call */
-		balance = get_balance(billaccount, channel);
+		balance = nibble_balance(billaccount, channel);
 		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_DEBUG, "Comparing %f to hangup balance of %f\n", balance, nobal_amt);
 		if (balance <= nobal_amt) {
 			/* Not enough money - reroute call to nobal location */
@@ -501,7 +981,7 @@ static switch_status_t do_billing(switch_core_session_t *session)
 						  uuid, nibble_data->total);
 
 		/* DO ODBC BILLING HERE and reset counters if it's successful! */
-		if (bill_event(billamount, billaccount, channel) == SWITCH_STATUS_SUCCESS) {
+		if (nibble_debit(billamount, billaccount, channel) == SWITCH_STATUS_SUCCESS) {
 			/* Increment total cost */
 			nibble_data->total += billamount;
 
@@ -528,7 +1008,7 @@ static switch_status_t do_billing(switch_core_session_t *session)
 		/* don't verify balance and transfer to nobal if we're done with call */
 		if (switch_channel_get_state(channel) != CS_REPORTING && switch_channel_get_state(channel) != CS_HANGUP) {
 			/* See if this person has enough money left to continue the call */
-			balance = get_balance(billaccount, channel);
+			balance = nibble_balance(billaccount, channel);
 			if (balance <= nobal_amt) {
 				/* Not enough money - reroute call to nobal location */
 				switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_CRIT, "Balance of %f fell below allowed amount of %f! (Account %s)\n",
@@ -756,7 +1236,7 @@ static void nibblebill_adjust(switch_core_session_t *session, float amount)
 	}
 
 	/* Add or remove amount from adjusted billing here. Note, we bill the OPPOSITE */
-	if (bill_event(-amount, billaccount, channel) == SWITCH_STATUS_SUCCESS) {
+	if (nibble_debit(-amount, billaccount, channel) == SWITCH_STATUS_SUCCESS) {
 		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_INFO, "Recorded adjustment to %s for $%f\n", billaccount, amount);
 	} else {
 		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_ERROR, "Failed to record adjustment to %s for $%f\n", billaccount, amount);
@@ -792,7 +1272,7 @@ SWITCH_STANDARD_APP(nibblebill_app_function)
 }
 
 /* We get here from the API only (theoretically) */
-#define API_SYNTAX "<uuid> [pause | resume | reset | adjust <amount> | heartbeat <seconds> | check]"
+#define API_SYNTAX "<uuid> [pause | resume | reset | adjust <amount> | heartbeat <seconds> | check] | status"
 SWITCH_STANDARD_API(nibblebill_api_function)
 {
 	switch_core_session_t *psession = NULL;
@@ -801,7 +1281,28 @@ SWITCH_STANDARD_API(nibblebill_api_function)
 
 	if (!zstr(cmd) && (mycmd = strdup(cmd))) {
 		argc = switch_separate_string(mycmd, ' ', argv, (sizeof(argv) / sizeof(argv[0])));
-		if ((argc == 2 || argc == 3) && !zstr(argv[0])) {
+		if (argc == 1 && !strcasecmp(argv[0], "status")) {
+			switch_hash_index_t *hi;
+			void *val;
+			float pending = 0;
+			int accounts = 0;
+
+			switch_mutex_lock(globals.mutex);
+			if (globals.accounts) {
+				for (hi = switch_hash_first(NULL, globals.accounts); hi; hi = switch_hash_next(hi)) {
+					switch_hash_this(hi, NULL, NULL, &val);
+					pending += ((nibble_account_t *) val)->pending;
+					accounts++;
+				}
+			}
+			stream->write_function(stream, "Supervisor:\t%s\n", globals.supervisor ? "enabled" : "disabled");
+			stream->write_function(stream, "Calls:\t\t%d\n", (int) globals.heap_len);
+			stream->write_function(stream, "Accounts:\t%d\n", accounts);
+			stream->write_function(stream, "Pending:\t%f\n", pending);
+			stream->write_function(stream, "Debits:\t\t%" SWITCH_UINT64_T_FMT "\n", globals.debits);
+			stream->write_function(stream, "Flushes:\t%" SWITCH_UINT64_T_FMT " (%" SWITCH_UINT64_T_FMT " failed)\n", globals.flushes, globals.flush_failures);
+			switch_mutex_unlock(globals.mutex);
+		} else if ((argc == 2 || argc == 3) && !zstr(argv[0])) {
 			char *uuid = argv[0];
 			if ((psession = switch_core_session_locate(uuid))) {
 				switch_channel_t *channel;
@@ -859,7 +1360,9 @@ static switch_status_t sched_billing(switch_core_session_t *session)
 		return SWITCH_STATUS_SUCCESS;
 	}
 
-	if (globals.global_heartbeat > 0) {
+	if (globals.supervisor) {
+		nibblebill_supervise(session, billaccount);
+	} else if (globals.global_heartbeat > 0) {
 		switch_core_session_enable_heartbeat(session, globals.global_heartbeat);
 	}
 
@@ -883,12 +1386,21 @@ static switch_status_t process_hangup(switch_core_session_t *session)
 
 	billaccount = switch_channel_get_variable(channel, "nibble_account");
 	if (billaccount) {
-		switch_channel_set_variable_printf(channel, "nibble_current_balance", "%f", get_balance(billaccount, channel));
+		switch_channel_set_variable_printf(channel, "nibble_current_balance", "%f", nibble_balance(billaccount, channel));
 	}			
 	
 	return SWITCH_STATUS_SUCCESS;
 }
 
+static switch_status_t process_destroy(switch_core_session_t *session)
+{
+	if (globals.supervisor) {
+		nibblebill_unsupervise(session);
+	}
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
 static switch_status_t process_and_sched(switch_core_session_t *session) {
 	process_hangup(session);
 	sched_billing(session);
@@ -907,7 +1419,7 @@ switch_state_handler_table_t nibble_state_handler = {
 	/* on_reset */ NULL,
 	/* on_park */ NULL,
 	/* on_reporting */ process_hangup, /* force billing event on b-leg if we can */
-	/* on_destroy */ NULL
+	/* on_destroy */ process_destroy
 };
 
 SWITCH_MODULE_LOAD_FUNCTION(mod_nibblebill_load)
@@ -919,9 +1431,26 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_nibblebill_load)
 	memset(&globals, 0, sizeof(globals));
 	globals.pool = pool;
 	switch_mutex_init(&globals.mutex, SWITCH_MUTEX_NESTED, globals.pool);
+	switch_mutex_init(&globals.db_mutex, SWITCH_MUTEX_NESTED, globals.pool);
 
 	load_config();
 
+	if (globals.supervisor) {
+		switch_threadattr_t *thd_attr = NULL;
+
+		if (switch_event_reserve_subclass(NIBBLE_EVENT_LOW_BALANCE) != SWITCH_STATUS_SUCCESS) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Couldn't register subclass %s!\n", NIBBLE_EVENT_LOW_BALANCE);
+		}
+
+		switch_core_hash_init(&globals.accounts, globals.pool);
+		switch_core_hash_init(&globals.calls, globals.pool);
+
+		globals.supervisor_running = 1;
+		switch_threadattr_create(&thd_attr, globals.pool);
+		switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+		switch_thread_create(&globals.supervisor_thread, thd_attr, supervisor_thread, NULL, globals.pool);
+	}
+
 	/* connect my internal structure to the blank pointer passed to me */
 	*module_interface = switch_loadable_module_create_module_interface(pool, modname);
 
@@ -951,6 +1480,38 @@ SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_nibblebill_shutdown)
 {
 	switch_event_unbind(&globals.node);
 	switch_core_remove_state_handler(&nibble_state_handler);
+
+	if (globals.supervisor_thread) {
+		switch_status_t st;
+		switch_hash_index_t *hi;
+		void *val;
+		size_t x;
+
+		globals.supervisor_running = 0;
+		switch_thread_join(&st, globals.supervisor_thread);
+
+		/* don't lose what was billed since the last flush */
+		flush_accounts();
+
+		for (x = 0; x < globals.heap_len; x++) {
+			switch_safe_free(globals.heap[x]->account);
+			free(globals.heap[x]);
+		}
+		switch_safe_free(globals.heap);
+
+		while ((hi = switch_hash_first(NULL, globals.accounts))) {
+			nibble_account_t *account;
+
+			switch_hash_this(hi, NULL, NULL, &val);
+			account = (nibble_account_t *) val;
+			switch_core_hash_delete(globals.accounts, account->name);
+			account_free(account);
+		}
+		switch_core_hash_destroy(&globals.accounts);
+		switch_core_hash_destroy(&globals.calls);
+		switch_event_free_subclass(NIBBLE_EVENT_LOW_BALANCE);
+	}
+
 	switch_odbc_handle_disconnect(globals.master_odbc);
 
 	switch_safe_free(globals.db_username);
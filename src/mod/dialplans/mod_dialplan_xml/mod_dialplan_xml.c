@@ -35,7 +35,8 @@
 #include <fcntl.h>
 
 SWITCH_MODULE_LOAD_FUNCTION(mod_dialplan_xml_load);
-SWITCH_MODULE_DEFINITION(mod_dialplan_xml, mod_dialplan_xml_load, NULL, NULL);
+SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_dialplan_xml_shutdown);
+SWITCH_MODULE_DEFINITION(mod_dialplan_xml, mod_dialplan_xml_load, mod_dialplan_xml_shutdown, NULL);
 
 typedef enum {
 	BREAK_ON_TRUE,
@@ -79,11 +80,443 @@ static switch_status_t exec_app(switch_core_session_t *session, const char *app,
 	return status;
 }
 
-static int parse_exten(switch_core_session_t *session, switch_caller_profile_t *caller_profile, switch_xml_t xexten, switch_caller_extension_t **extension)
+/* compiled form of the dialplan, rebuilt from the core registry on every reloadxml */
+
+typedef struct dp_action {
+	const char *application;
+	const char *data;
+	int xinline;
+	int loop_count;
+	struct dp_action *next;
+} dp_action_t;
+
+typedef struct dp_condition {
+	switch_xml_t xcond;
+	const char *field;
+	int field_dynamic;
+	const char *expression;
+	int expression_dynamic;
+	/* precompiled when the expression has no variables */
+	switch_regex_t *re;
+	const char *do_break_a;
+	break_t do_break_i;
+	int has_time;
+	int nested;
+	dp_action_t *actions;
+	dp_action_t *anti_actions;
+	struct dp_condition *next;
+} dp_condition_t;
+
+typedef struct dp_extension {
+	const char *name;
+	const char *cont;
+	uint32_t index;
+	uint64_t hits;
+	/* literal destination_number prefix the first condition requires, NULL when it may match anything */
+	const char *prefix;
+	dp_condition_t *conditions;
+	struct dp_extension *next;
+} dp_extension_t;
+
+typedef struct dp_index_list {
+	uint32_t *index;
+	uint32_t count;
+	uint32_t size;
+} dp_index_list_t;
+
+typedef struct dp_context {
+	const char *name;
+	dp_extension_t **extensions;
+	uint32_t count;
+	switch_hash_t *names;
+	switch_hash_t *prefixes;
+	dp_index_list_t always;
+	switch_size_t max_prefix_len;
+	struct dp_context *next;
+} dp_context_t;
+
+typedef struct dp_program {
+	switch_memory_pool_t *pool;
+	switch_xml_t xml;
+	switch_hash_t *contexts;
+	dp_context_t *context_list;
+	uint32_t extension_count;
+	uint32_t indexed_count;
+	uint32_t refs;
+	switch_time_t created;
+} dp_program_t;
+
+/* upper bounds in microseconds, the last bucket takes everything above */
+static const switch_time_t hunt_buckets[] = { 10, 50, 100, 500, 1000, 5000, 10000, 50000 };
+#define HUNT_BUCKETS (sizeof(hunt_buckets) / sizeof(hunt_buckets[0]) + 1)
+
+static struct {
+	switch_mutex_t *mutex;
+	dp_program_t *program;
+	switch_event_node_t *node;
+	uint64_t hunts;
+	uint64_t compiled_hunts;
+	uint64_t skipped;
+	uint64_t histogram[HUNT_BUCKETS];
+} globals;
+
+static dp_action_t *dp_compile_actions(switch_memory_pool_t *pool, switch_xml_t xcond, const char *name)
+{
+	switch_xml_t xaction;
+	dp_action_t *head = NULL, *tail = NULL, *action;
+
+	for (xaction = switch_xml_child(xcond, name); xaction; xaction = xaction->next) {
+		const char *loop = switch_xml_attr(xaction, "loop");
+
+		action = switch_core_alloc(pool, sizeof(*action));
+		action->application = switch_xml_attr_soft(xaction, "application");
+
+		if (!zstr(xaction->txt)) {
+			action->data = xaction->txt;
+		} else {
+			action->data = switch_xml_attr_soft(xaction, "data");
+		}
+
+		action->xinline = switch_true(switch_xml_attr_soft(xaction, "inline"));
+		action->loop_count = loop ? atoi(loop) : 1;
+
+		if (tail) {
+			tail->next = action;
+		} else {
+			head = action;
+		}
+		tail = action;
+	}
+
+	return head;
+}
+
+/* literal characters an anchored expression requires at the start of the field, NULL when that can't be told */
+static const char *dp_literal_prefix(switch_memory_pool_t *pool, const char *expression)
+{
+	char buf[128] = "";
+	const char *p;
+	switch_size_t n = 0;
+
+	if (!expression || *expression != '^' || strchr(expression, '|')) {
+		return NULL;
+	}
+
+	for (p = expression + 1; *p && n < sizeof(buf) - 1;) {
+		char lit;
+		int adv = 1;
+
+		if (*p == '\\') {
+			if (*(p + 1) && strchr("+*#.?$^()[]{}|\\/-", *(p + 1))) {
+				lit = *(p + 1);
+				adv = 2;
+			} else {
+				break;
+			}
+		} else if (switch_isalnum(*p) || strchr("#@-_=:%,", *p)) {
+			lit = *p;
+		} else {
+			break;
+		}
+
+		/* an optional character ends the literal run, one-or-more still needs it once */
+		if (*(p + adv) == '?' || *(p + adv) == '*' || *(p + adv) == '{') {
+			break;
+		}
+
+		buf[n++] = lit;
+
+		if (*(p + adv) == '+') {
+			break;
+		}
+
+		p += adv;
+	}
+
+	buf[n] = '\0';
+
+	return switch_core_strdup(pool, buf);
+}
+
+static dp_extension_t *dp_compile_extension(switch_memory_pool_t *pool, switch_xml_t xexten, uint32_t index)
 {
-	switch_xml_t xcond, xaction, xexpression;
+	dp_extension_t *exten;
+	dp_condition_t *tail = NULL, *cond;
+	switch_xml_t xcond, xexpression;
+
+	exten = switch_core_alloc(pool, sizeof(*exten));
+	exten->name = switch_xml_attr(xexten, "name");
+	exten->cont = switch_xml_attr(xexten, "continue");
+	exten->index = index;
+
+	for (xcond = switch_xml_child(xexten, "condition"); xcond; xcond = xcond->next) {
+		cond = switch_core_alloc(pool, sizeof(*cond));
+		cond->xcond = xcond;
+		cond->has_time = switch_xml_std_datetime_check(xcond) != -1;
+		cond->nested = switch_xml_child(xcond, "condition") ? 1 : 0;
+
+		if ((cond->field = switch_xml_attr(xcond, "field"))) {
+			cond->field_dynamic = strchr(cond->field, '$') ? 1 : 0;
+		}
+
+		if ((xexpression = switch_xml_child(xcond, "expression"))) {
+			cond->expression = switch_str_nil(xexpression->txt);
+		} else {
+			cond->expression = switch_xml_attr_soft(xcond, "expression");
+		}
+
+		cond->expression_dynamic = switch_string_var_check_const(cond->expression) || switch_string_has_escaped_data(cond->expression);
+
+		if (cond->field && !cond->expression_dynamic) {
+			cond->re = switch_regex_compile_expression(cond->expression);
+		}
+
+		cond->do_break_i = BREAK_ON_FALSE;
+		if ((cond->do_break_a = switch_xml_attr(xcond, "break"))) {
+			if (!strcasecmp(cond->do_break_a, "on-true")) {
+				cond->do_break_i = BREAK_ON_TRUE;
+			} else if (!strcasecmp(cond->do_break_a, "on-false")) {
+				cond->do_break_i = BREAK_ON_FALSE;
+			} else if (!strcasecmp(cond->do_break_a, "always")) {
+				cond->do_break_i = BREAK_ALWAYS;
+			} else if (!strcasecmp(cond->do_break_a, "never")) {
+				cond->do_break_i = BREAK_NEVER;
+			} else {
+				cond->do_break_a = NULL;
+			}
+		}
+
+		cond->actions = dp_compile_actions(pool, xcond, "action");
+		cond->anti_actions = dp_compile_actions(pool, xcond, "anti-action");
+
+		if (tail) {
+			tail->next = cond;
+		} else {
+			exten->conditions = cond;
+		}
+		tail = cond;
+	}
+
+	/* an extension whose first condition fails on destination_number without anti-actions has no effect at all */
+	if ((cond = exten->conditions) && !cond->nested && !cond->has_time && !cond->anti_actions &&
+		cond->field && !cond->field_dynamic && !strcasecmp(cond->field, "destination_number") && !cond->expression_dynamic &&
+		(cond->do_break_i == BREAK_ON_FALSE || cond->do_break_i == BREAK_ALWAYS)) {
+		exten->prefix = dp_literal_prefix(pool, cond->expression);
+		if (exten->prefix && !*exten->prefix) {
+			exten->prefix = NULL;
+		}
+	}
+
+	return exten;
+}
+
+static void dp_free_extension(dp_extension_t *exten)
+{
+	dp_condition_t *cond;
+
+	for (cond = exten->conditions; cond; cond = cond->next) {
+		switch_regex_safe_free(cond->re);
+	}
+}
+
+static void dp_index_add(switch_memory_pool_t *pool, dp_index_list_t *list, uint32_t index)
+{
+	if (list->count == list->size) {
+		uint32_t *tmp;
+
+		list->size = list->size ? list->size * 2 : 8;
+		tmp = switch_core_alloc(pool, list->size * sizeof(*tmp));
+		if (list->count) {
+			memcpy(tmp, list->index, list->count * sizeof(*tmp));
+		}
+		list->index = tmp;
+	}
+
+	list->index[list->count++] = index;
+}
+
+static dp_context_t *dp_compile_context(dp_program_t *program, switch_xml_t xcontext)
+{
+	switch_memory_pool_t *pool = program->pool;
+	dp_context_t *context;
+	switch_xml_t xexten;
+	uint32_t count = 0, x = 0;
+
+	context = switch_core_alloc(pool, sizeof(*context));
+	context->name = switch_xml_attr_soft(xcontext, "name");
+	switch_core_hash_init(&context->names, pool);
+	switch_core_hash_init(&context->prefixes, pool);
+
+	for (xexten = switch_xml_child(xcontext, "extension"); xexten; xexten = xexten->next) {
+		count++;
+	}
+
+	context->extensions = switch_core_alloc(pool, (count + 1) * sizeof(dp_extension_t *));
+
+	for (xexten = switch_xml_child(xcontext, "extension"); xexten; xexten = xexten->next) {
+		dp_extension_t *exten = dp_compile_extension(pool, xexten, x);
+
+		context->extensions[x++] = exten;
+
+		if (exten->name && !switch_core_hash_find(context->names, exten->name)) {
+			switch_core_hash_insert(context->names, exten->name, exten);
+		}
+
+		if (exten->prefix) {
+			dp_index_list_t *list;
+			switch_size_t len = strlen(exten->prefix);
+
+			if (!(list = switch_core_hash_find(context->prefixes, exten->prefix))) {
+				list = switch_core_alloc(pool, sizeof(*list));
+				switch_core_hash_insert(context->prefixes, exten->prefix, list);
+			}
+			dp_index_add(pool, list, exten->index);
+
+			if (len > context->max_prefix_len) {
+				context->max_prefix_len = len;
+			}
+			program->indexed_count++;
+		} else {
+			dp_index_add(pool, &context->always, exten->index);
+		}
+	}
+
+	context->count = count;
+	program->extension_count += count;
+
+	return context;
+}
+
+static void dp_program_destroy(dp_program_t *program)
+{
+	dp_context_t *context;
+	uint32_t x;
+
+	for (context = program->context_list; context; context = context->next) {
+		for (x = 0; x < context->count; x++) {
+			dp_free_extension(context->extensions[x]);
+		}
+		switch_core_hash_destroy(&context->names);
+		switch_core_hash_destroy(&context->prefixes);
+	}
+
+	switch_core_hash_destroy(&program->contexts);
+	switch_xml_free(program->xml);
+	switch_core_destroy_memory_pool(&program->pool);
+}
+
+static dp_program_t *dp_program_compile(void)
+{
+	switch_xml_t root, section, cfg, xcontext;
+	switch_memory_pool_t *pool;
+	dp_program_t *program;
+	dp_context_t *tail = NULL;
+	char *x = NULL;
+	switch_time_t start = switch_micro_time_now();
+
+	if (!(root = switch_xml_root())) {
+		return NULL;
+	}
+
+	if ((section = switch_xml_find_child(root, "section", "name", "dialplan")) && (cfg = switch_xml_find_child(section, "dialplan", NULL, NULL))) {
+		x = switch_xml_toxml(cfg, SWITCH_FALSE);
+	}
+	switch_xml_free(root);
+
+	if (!x) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "No dialplan section to compile\n");
+		return NULL;
+	}
+
+	switch_core_new_memory_pool(&pool);
+	program = switch_core_alloc(pool, sizeof(*program));
+	program->pool = pool;
+	program->created = start;
+	switch_core_hash_init(&program->contexts, pool);
+
+	/* a private copy keeps the condition nodes valid for the time checks no matter what reloadxml does */
+	if (!(program->xml = switch_xml_parse_str_dynamic(x, SWITCH_FALSE))) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Failed to copy dialplan\n");
+		free(x);
+		switch_core_hash_destroy(&program->contexts);
+		switch_core_destroy_memory_pool(&pool);
+		return NULL;
+	}
+
+	for (xcontext = switch_xml_child(program->xml, "context"); xcontext; xcontext = xcontext->next) {
+		dp_context_t *context = dp_compile_context(program, xcontext);
+
+		if (tail) {
+			tail->next = context;
+		} else {
+			program->context_list = context;
+		}
+		tail = context;
+
+		if (!switch_core_hash_find(program->contexts, context->name)) {
+			switch_core_hash_insert(program->contexts, context->name, context);
+		}
+	}
+
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Compiled dialplan, %u extensions (%u indexed) in %" SWITCH_TIME_T_FMT "us\n",
+					  program->extension_count, program->indexed_count, switch_micro_time_now() - start);
+
+	return program;
+}
+
+static void dp_program_swap(dp_program_t *program)
+{
+	dp_program_t *old;
+
+	switch_mutex_lock(globals.mutex);
+	old = globals.program;
+	globals.program = program;
+	if (old && old->refs) {
+		/* the last hunt still using it cleans up */
+		old = NULL;
+	}
+	switch_mutex_unlock(globals.mutex);
+
+	if (old) {
+		dp_program_destroy(old);
+	}
+}
+
+static dp_program_t *dp_program_acquire(void)
+{
+	dp_program_t *program;
+
+	switch_mutex_lock(globals.mutex);
+	if ((program = globals.program)) {
+		program->refs++;
+	}
+	switch_mutex_unlock(globals.mutex);
+
+	return program;
+}
+
+static void dp_program_release(dp_program_t *program)
+{
+	int destroy = 0;
+
+	switch_mutex_lock(globals.mutex);
+	if (!--program->refs && program != globals.program) {
+		destroy = 1;
+	}
+	switch_mutex_unlock(globals.mutex);
+
+	if (destroy) {
+		dp_program_destroy(program);
+	}
+}
+
+static int parse_exten(switch_core_session_t *session, switch_caller_profile_t *caller_profile, dp_extension_t *exten,
+					   switch_caller_extension_t **extension)
+{
+	dp_condition_t *cond;
+	dp_action_t *action;
 	switch_channel_t *channel = switch_core_session_get_channel(session);
-	char *exten_name = (char *) switch_xml_attr(xexten, "name");
+	const char *exten_name = exten->name;
 	int proceed = 0;
 	char *expression_expanded = NULL, *field_expanded = NULL;
 	switch_regex_t *re = NULL;
@@ -92,51 +525,32 @@ static int parse_exten(switch_core_session_t *session, switch_caller_profile_t *
 		exten_name = "_anon_";
 	}
 
-	for (xcond = switch_xml_child(xexten, "condition"); xcond; xcond = xcond->next) {
-		char *field = NULL;
-		char *do_break_a = NULL;
-		char *expression = NULL;
+	for (cond = exten->conditions; cond; cond = cond->next) {
+		const char *field = cond->field;
+		const char *do_break_a = cond->do_break_a;
+		const char *expression = cond->expression;
 		const char *field_data = NULL;
+		switch_regex_t *match_re = NULL;
 		int ovector[30];
 		switch_bool_t anti_action = SWITCH_TRUE;
-		break_t do_break_i = BREAK_ON_FALSE;
+		break_t do_break_i = cond->do_break_i;
 
-		int time_match = switch_xml_std_datetime_check(xcond);
+		int time_match = cond->has_time ? switch_xml_std_datetime_check(cond->xcond) : -1;
 
 		switch_safe_free(field_expanded);
 		switch_safe_free(expression_expanded);
 
-		if (switch_xml_child(xcond, "condition")) {
+		if (cond->nested) {
 			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_ERROR, "Nested conditions are not allowed!\n");
 			proceed = 1;
 			goto done;
 		}
 
-		field = (char *) switch_xml_attr(xcond, "field");
-
-		if ((xexpression = switch_xml_child(xcond, "expression"))) {
-			expression = switch_str_nil(xexpression->txt);
-		} else {
-			expression = (char *) switch_xml_attr_soft(xcond, "expression");
-		}
-
-		if ((expression_expanded = switch_channel_expand_variables(channel, expression)) == expression) {
-			expression_expanded = NULL;
-		} else {
-			expression = expression_expanded;
-		}
-
-		if ((do_break_a = (char *) switch_xml_attr(xcond, "break"))) {
-			if (!strcasecmp(do_break_a, "on-true")) {
-				do_break_i = BREAK_ON_TRUE;
-			} else if (!strcasecmp(do_break_a, "on-false")) {
-				do_break_i = BREAK_ON_FALSE;
-			} else if (!strcasecmp(do_break_a, "always")) {
-				do_break_i = BREAK_ALWAYS;
-			} else if (!strcasecmp(do_break_a, "never")) {
-				do_break_i = BREAK_NEVER;
+		if (cond->expression_dynamic) {
+			if ((expression_expanded = switch_channel_expand_variables(channel, expression)) == expression) {
+				expression_expanded = NULL;
 			} else {
-				do_break_a = NULL;
+				expression = expression_expanded;
 			}
 		}
 
@@ -152,7 +566,7 @@ static int parse_exten(switch_core_session_t *session, switch_caller_profile_t *
 		}
 
 		if (field) {
-			if (strchr(field, '$')) {
+			if (cond->field_dynamic) {
 				if ((field_expanded = switch_channel_expand_variables(channel, field)) == field) {
 					field_expanded = NULL;
 					field_data = field;
@@ -166,7 +580,15 @@ static int parse_exten(switch_core_session_t *session, switch_caller_profile_t *
 				field_data = "";
 			}
 
-			if ((proceed = switch_regex_perform(field_data, expression, &re, ovector, sizeof(ovector) / sizeof(ovector[0])))) {
+			if (cond->expression_dynamic) {
+				proceed = switch_regex_perform(field_data, expression, &re, ovector, sizeof(ovector) / sizeof(ovector[0]));
+				match_re = re;
+			} else {
+				proceed = switch_regex_exec(cond->re, field_data, ovector, sizeof(ovector) / sizeof(ovector[0]));
+				match_re = cond->re;
+			}
+
+			if (proceed) {
 				switch_log_printf(SWITCH_CHANNEL_SESSION_LOG_CLEAN(session), SWITCH_LOG_DEBUG,
 								  "Dialplan: %s Regex (PASS) [%s] %s(%s) =~ /%s/ break=%s\n",
 								  switch_channel_get_name(channel), exten_name, field, field_data, expression, do_break_a ? do_break_a : "on-false");
@@ -183,19 +605,8 @@ static int parse_exten(switch_core_session_t *session, switch_caller_profile_t *
 		}
 
 		if (anti_action) {
-			for (xaction = switch_xml_child(xcond, "anti-action"); xaction; xaction = xaction->next) {
-				const char *application = switch_xml_attr_soft(xaction, "application");
-				const char *loop = switch_xml_attr(xaction, "loop");
-				const char *data;
-				const char *inline_ = switch_xml_attr_soft(xaction, "inline");
-				int xinline = switch_true(inline_);
-				int loop_count = 1;
-
-				if (!zstr(xaction->txt)) {
-					data = xaction->txt;
-				} else {
-					data = (char *) switch_xml_attr_soft(xaction, "data");
-				}
+			for (action = cond->anti_actions; action; action = action->next) {
+				int loop_count = action->loop_count;
 
 				if (!*extension) {
 					if ((*extension = switch_caller_extension_new(session, exten_name, caller_profile->destination_number)) == 0) {
@@ -205,39 +616,26 @@ static int parse_exten(switch_core_session_t *session, switch_caller_profile_t *
 					}
 				}
 
-				if (loop) {
-					loop_count = atoi(loop);
-				}
-
 				for (;loop_count > 0; loop_count--) {
 					switch_log_printf(SWITCH_CHANNEL_SESSION_LOG_CLEAN(session), SWITCH_LOG_DEBUG,
-							"Dialplan: %s ANTI-Action %s(%s) %s\n", switch_channel_get_name(channel), application, data, xinline ? "INLINE" : "");
+							"Dialplan: %s ANTI-Action %s(%s) %s\n", switch_channel_get_name(channel), action->application, action->data,
+							action->xinline ? "INLINE" : "");
 
-					if (xinline) {
-						exec_app(session, application, data);
+					if (action->xinline) {
+						exec_app(session, action->application, action->data);
 					} else {
-						switch_caller_extension_add_application(session, *extension, application, data);
+						switch_caller_extension_add_application(session, *extension, action->application, action->data);
 					}
 				}
 				proceed = 1;
 			}
 		} else {
-			for (xaction = switch_xml_child(xcond, "action"); xaction; xaction = xaction->next) {
-				char *application = (char *) switch_xml_attr_soft(xaction, "application");
-				const char *loop = switch_xml_attr(xaction, "loop");
-				char *data = NULL;
+			for (action = cond->actions; action; action = action->next) {
+				const char *data = action->data;
 				char *substituted = NULL;
 				uint32_t len = 0;
-				char *app_data = NULL;
-				const char *inline_ = switch_xml_attr_soft(xaction, "inline");
-				int xinline = switch_true(inline_);
-				int loop_count = 1;
-
-				if (!zstr(xaction->txt)) {
-					data = xaction->txt;
-				} else {
-					data = (char *) switch_xml_attr_soft(xaction, "data");
-				}
+				const char *app_data = NULL;
+				int loop_count = action->loop_count;
 
 				if (field && strchr(expression, '(')) {
 					len = (uint32_t) (strlen(data) + strlen(field_data) + 10) * proceed;
@@ -247,7 +645,7 @@ static int parse_exten(switch_core_session_t *session, switch_caller_profile_t *
 						goto done;
 					}
 					memset(substituted, 0, len);
-					switch_perform_substitution(re, proceed, data, field_data, substituted, len, ovector);
+					switch_perform_substitution(match_re, proceed, data, field_data, substituted, len, ovector);
 					app_data = substituted;
 				} else {
 					app_data = data;
@@ -256,22 +654,21 @@ static int parse_exten(switch_core_session_t *session, switch_caller_profile_t *
 				if (!*extension) {
 					if ((*extension = switch_caller_extension_new(session, exten_name, caller_profile->destination_number)) == 0) {
 						switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_CRIT, "Memory Error!\n");
+						switch_safe_free(substituted);
 						proceed = 0;
 						goto done;
 					}
 				}
 
-				if (loop) {
-					loop_count = atoi(loop);
-				}
 				for (;loop_count > 0; loop_count--) {
 					switch_log_printf(SWITCH_CHANNEL_SESSION_LOG_CLEAN(session), SWITCH_LOG_DEBUG,
-							"Dialplan: %s Action %s(%s) %s\n", switch_channel_get_name(channel), application, app_data, xinline ? "INLINE" : "");
+							"Dialplan: %s Action %s(%s) %s\n", switch_channel_get_name(channel), action->application, app_data,
+							action->xinline ? "INLINE" : "");
 
-					if (xinline) {
-						exec_app(session, application, app_data);
+					if (action->xinline) {
+						exec_app(session, action->application, app_data);
 					} else {
-						switch_caller_extension_add_application(session, *extension, application, app_data);
+						switch_caller_extension_add_application(session, *extension, action->application, app_data);
 					}
 				}
 				switch_safe_free(substituted);
@@ -309,6 +706,142 @@ static switch_status_t dialplan_xml_locate(switch_core_session_t *session, switc
 	return status;
 }
 
+static int dp_index_cmp(const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t *) a, y = *(const uint32_t *) b;
+
+	return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+/* the extensions that can match a destination, in dialplan order, starting at first */
+static uint32_t dp_candidates(dp_context_t *context, const char *dest, uint32_t first, uint32_t *out)
+{
+	char buf[128];
+	switch_size_t len = 0, x;
+	uint32_t count = 0, i;
+	dp_index_list_t *list;
+
+	for (i = 0; i < context->always.count; i++) {
+		if (context->always.index[i] >= first) {
+			out[count++] = context->always.index[i];
+		}
+	}
+
+	if (dest) {
+		len = strlen(dest);
+	}
+	if (len > context->max_prefix_len) {
+		len = context->max_prefix_len;
+	}
+	if (len > sizeof(buf) - 1) {
+		len = sizeof(buf) - 1;
+	}
+
+	for (x = 1; x <= len; x++) {
+		memcpy(buf, dest, x);
+		buf[x] = '\0';
+
+		if ((list = switch_core_hash_find(context->prefixes, buf))) {
+			for (i = 0; i < list->count; i++) {
+				if (list->index[i] >= first) {
+					out[count++] = list->index[i];
+				}
+			}
+		}
+	}
+
+	qsort(out, count, sizeof(*out), dp_index_cmp);
+
+	return count;
+}
+
+static void dp_hunt_done(switch_time_t start, dp_extension_t **hits, uint32_t hit_count, int compiled, uint32_t skipped)
+{
+	switch_time_t elapsed = switch_micro_time_now() - start;
+	uint32_t x;
+
+	for (x = 0; x < HUNT_BUCKETS - 1; x++) {
+		if (elapsed < hunt_buckets[x]) {
+			break;
+		}
+	}
+
+	switch_mutex_lock(globals.mutex);
+	globals.histogram[x]++;
+	globals.hunts++;
+	globals.skipped += skipped;
+	if (compiled) {
+		globals.compiled_hunts++;
+	}
+	for (x = 0; x < hit_count; x++) {
+		hits[x]->hits++;
+	}
+	switch_mutex_unlock(globals.mutex);
+}
+
+static switch_caller_extension_t *dp_hunt_compiled(switch_core_session_t *session, switch_caller_profile_t *caller_profile, dp_program_t *program,
+												   switch_time_t start)
+{
+	switch_caller_extension_t *extension = NULL;
+	switch_channel_t *channel = switch_core_session_get_channel(session);
+	dp_context_t *context;
+	dp_extension_t *exten = NULL, **hits = NULL;
+	uint32_t *candidates = NULL, count = 0, first = 0, x, hit_count = 0;
+	const char *hunt = NULL;
+
+	if (!(context = switch_core_hash_find(program->contexts, caller_profile->context))) {
+		if (!(context = switch_core_hash_find(program->contexts, "global"))) {
+			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_WARNING, "Context %s not found\n", caller_profile->context);
+			goto done;
+		}
+	}
+
+	if (!context->count) {
+		goto done;
+	}
+
+	if ((hunt = switch_channel_get_variable(channel, "auto_hunt")) && switch_true(hunt) && caller_profile->destination_number) {
+		if ((exten = switch_core_hash_find(context->names, caller_profile->destination_number))) {
+			first = exten->index;
+		}
+	}
+
+	switch_zmalloc(candidates, context->count * sizeof(*candidates));
+	switch_zmalloc(hits, context->count * sizeof(*hits));
+	count = dp_candidates(context, caller_profile->destination_number, first, candidates);
+
+	for (x = 0; x < count; x++) {
+		int proceed = 0;
+		const char *exten_name;
+
+		exten = context->extensions[candidates[x]];
+
+		if (!(exten_name = exten->name)) {
+			exten_name = "UNKNOWN";
+		}
+
+		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG_CLEAN(session), SWITCH_LOG_DEBUG,
+						  "Dialplan: %s parsing [%s->%s] continue=%s\n",
+						  switch_channel_get_name(channel), caller_profile->context, exten_name, exten->cont ? exten->cont : "false");
+
+		proceed = parse_exten(session, caller_profile, exten, &extension);
+
+		if (proceed) {
+			hits[hit_count++] = exten;
+		}
+
+		if (proceed && !switch_true(exten->cont)) {
+			break;
+		}
+	}
+
+  done:
+	dp_hunt_done(start, hits, hit_count, 1, context ? context->count - first - count : 0);
+	switch_safe_free(candidates);
+	switch_safe_free(hits);
+	return extension;
+}
+
 SWITCH_STANDARD_DIALPLAN(dialplan_hunt)
 {
 	switch_caller_extension_t *extension = NULL;
@@ -316,6 +849,8 @@ SWITCH_STANDARD_DIALPLAN(dialplan_hunt)
 	switch_xml_t alt_root = NULL, cfg, xml = NULL, xcontext, xexten = NULL;
 	char *alt_path = (char *) arg;
 	const char *hunt = NULL;
+	dp_program_t *program = NULL;
+	switch_time_t start = switch_micro_time_now();
 
 	if (!caller_profile) {
 		if (!(caller_profile = switch_channel_get_caller_profile(channel))) {
@@ -331,6 +866,13 @@ SWITCH_STANDARD_DIALPLAN(dialplan_hunt)
 	switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_INFO, "Processing %s->%s in context %s\n",
 					  caller_profile->caller_id_name, caller_profile->destination_number, caller_profile->context);
 
+	/* the compiled program mirrors the core registry so it is only good when nothing else serves the dialplan section */
+	if (zstr(alt_path) && !switch_xml_section_has_binding("dialplan") && (program = dp_program_acquire())) {
+		extension = dp_hunt_compiled(session, caller_profile, program, start);
+		dp_program_release(program);
+		return extension;
+	}
+
 	/* get our handle to the "dialplan" section of the config */
 
 	if (!zstr(alt_path)) {
@@ -371,10 +913,12 @@ SWITCH_STANDARD_DIALPLAN(dialplan_hunt)
 		xexten = switch_xml_child(xcontext, "extension");
 	}
 
+	/* dynamic dialplans are compiled one extension at a time as they are visited, into the session pool */
 	while (xexten) {
 		int proceed = 0;
 		const char *cont = switch_xml_attr(xexten, "continue");
 		const char *exten_name = switch_xml_attr(xexten, "name");
+		dp_extension_t *exten;
 
 		if (!exten_name) {
 			exten_name = "UNKNOWN";
@@ -384,7 +928,9 @@ SWITCH_STANDARD_DIALPLAN(dialplan_hunt)
 						  "Dialplan: %s parsing [%s->%s] continue=%s\n",
 						  switch_channel_get_name(channel), caller_profile->context, exten_name, cont ? cont : "false");
 
-		proceed = parse_exten(session, caller_profile, xexten, &extension);
+		exten = dp_compile_extension(switch_core_session_get_pool(session), xexten, 0);
+		proceed = parse_exten(session, caller_profile, exten, &extension);
+		dp_free_extension(exten);
 
 		if (proceed && !switch_true(cont)) {
 			break;
@@ -397,22 +943,124 @@ SWITCH_STANDARD_DIALPLAN(dialplan_hunt)
 	xml = NULL;
 
   done:
+	dp_hunt_done(start, NULL, 0, 0, 0);
 	switch_xml_free(xml);
 	return extension;
 }
 
+static void event_handler(switch_event_t *event)
+{
+	dp_program_t *program;
+
+	if ((program = dp_program_compile())) {
+		dp_program_swap(program);
+	}
+}
+
+#define DIALPLAN_XML_SYNTAX "stats [<context>]|compile"
+SWITCH_STANDARD_API(dialplan_xml_function)
+{
+	char *mydata = NULL, *argv[2] = { 0 };
+	int argc = 0;
+	uint32_t x;
+	dp_program_t *program;
+
+	if (!zstr(cmd) && (mydata = strdup(cmd))) {
+		argc = switch_separate_string(mydata, ' ', argv, (sizeof(argv) / sizeof(argv[0])));
+	}
+
+	if (argc && !strcasecmp(argv[0], "compile")) {
+		if ((program = dp_program_compile())) {
+			/* once swapped in the program belongs to whoever swaps it out */
+			x = program->extension_count;
+			dp_program_swap(program);
+			stream->write_function(stream, "+OK %u extensions\n", x);
+		} else {
+			stream->write_function(stream, "-ERR compile failed\n");
+		}
+		goto done;
+	}
+
+	if (argc && strcasecmp(argv[0], "stats")) {
+		stream->write_function(stream, "-USAGE: %s\n", DIALPLAN_XML_SYNTAX);
+		goto done;
+	}
+
+	if ((program = dp_program_acquire())) {
+		dp_context_t *context;
+
+		stream->write_function(stream, "compiled: %u extensions, %u indexed\n", program->extension_count, program->indexed_count);
+
+		switch_mutex_lock(globals.mutex);
+		for (context = program->context_list; context; context = context->next) {
+			if (argv[1] && strcasecmp(argv[1], context->name)) {
+				continue;
+			}
+			stream->write_function(stream, "context %s: %u extensions\n", context->name, context->count);
+			for (x = 0; x < context->count; x++) {
+				dp_extension_t *exten = context->extensions[x];
+				if (exten->hits) {
+					stream->write_function(stream, "  %s: %" SWITCH_UINT64_T_FMT " hits\n", exten->name ? exten->name : "_anon_", exten->hits);
+				}
+			}
+		}
+		switch_mutex_unlock(globals.mutex);
+
+		dp_program_release(program);
+	} else {
+		stream->write_function(stream, "compiled: none\n");
+	}
+
+	switch_mutex_lock(globals.mutex);
+	stream->write_function(stream, "hunts: %" SWITCH_UINT64_T_FMT " (%" SWITCH_UINT64_T_FMT " compiled, %" SWITCH_UINT64_T_FMT
+						   " extensions skipped by index)\n", globals.hunts, globals.compiled_hunts, globals.skipped);
+	for (x = 0; x < HUNT_BUCKETS; x++) {
+		if (x < HUNT_BUCKETS - 1) {
+			stream->write_function(stream, "  < %6" SWITCH_TIME_T_FMT "us: %" SWITCH_UINT64_T_FMT "\n", hunt_buckets[x], globals.histogram[x]);
+		} else {
+			stream->write_function(stream, "  >=%6" SWITCH_TIME_T_FMT "us: %" SWITCH_UINT64_T_FMT "\n", hunt_buckets[x - 1], globals.histogram[x]);
+		}
+	}
+	switch_mutex_unlock(globals.mutex);
+
+  done:
+	switch_safe_free(mydata);
+	return SWITCH_STATUS_SUCCESS;
+}
+
 SWITCH_MODULE_LOAD_FUNCTION(mod_dialplan_xml_load)
 {
 	switch_dialplan_interface_t *dp_interface;
+	switch_api_interface_t *api_interface;
+
+	memset(&globals, 0, sizeof(globals));
+	switch_mutex_init(&globals.mutex, SWITCH_MUTEX_NESTED, pool);
+
+	if ((switch_event_bind_removable(modname, SWITCH_EVENT_RELOADXML, NULL, event_handler, NULL, &globals.node) != SWITCH_STATUS_SUCCESS)) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Couldn't bind!\n");
+	}
+
+	globals.program = dp_program_compile();
 
 	/* connect my internal structure to the blank pointer passed to me */
 	*module_interface = switch_loadable_module_create_module_interface(pool, modname);
 	SWITCH_ADD_DIALPLAN(dp_interface, "XML", dialplan_hunt);
+	SWITCH_ADD_API(api_interface, "dialplan_xml", "XML dialplan stats", dialplan_xml_function, DIALPLAN_XML_SYNTAX);
+	switch_console_set_complete("add dialplan_xml stats");
+	switch_console_set_complete("add dialplan_xml compile");
 
 	/* indicate that the module should continue to be loaded */
 	return SWITCH_STATUS_SUCCESS;
 }
 
+SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_dialplan_xml_shutdown)
+{
+	switch_event_unbind(&globals.node);
+	dp_program_swap(NULL);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
 /* For Emacs:
  * Local Variables:
  * mode:c
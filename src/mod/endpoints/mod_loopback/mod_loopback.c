@@ -684,7 +684,7 @@ static switch_status_t channel_write_frame(switch_core_session_t *session, switc
 		}
 
 		if (switch_queue_size(tech_pvt->other_tech_pvt->frame_queue) < FRAME_QUEUE_LEN) {
-			if (switch_frame_dup(frame, &clone) != SWITCH_STATUS_SUCCESS) {
+			if (switch_frame_ref(frame, &clone) != SWITCH_STATUS_SUCCESS) {
 				abort();
 			}
 
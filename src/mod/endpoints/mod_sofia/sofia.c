@@ -1177,6 +1177,8 @@ void *SWITCH_THREAD_FUNC sofia_profile_worker_thread_run(switch_thread_t *thread
 	int loop_count = 0;
 	switch_size_t sql_len = SQLLEN;
 	char *tmp, *sqlbuf = NULL;
+	switch_profile_counter_t *prof = switch_core_profile_counter("sofia", profile->name);
+	switch_time_t prof_start;
 
 	if (sofia_test_pflag(profile, PFLAG_SQL_IN_TRANS)) {
 		sqlbuf = (char *) malloc(sql_len);
@@ -1192,12 +1194,15 @@ void *SWITCH_THREAD_FUNC sofia_profile_worker_thread_run(switch_thread_t *thread
 	qsize = switch_queue_size(profile->sql_queue);
 
 	while ((mod_sofia_globals.running == 1 && sofia_test_pflag(profile, PFLAG_RUNNING)) || qsize) {
+		switch_core_profile_depth(prof, qsize);
+
 		if (sofia_test_pflag(profile, PFLAG_SQL_IN_TRANS)) {
 			if (qsize > 0 && (qsize >= 1024 || ++loop_count >= profile->trans_timeout)) {
 				switch_size_t newlen;
 				uint32_t itterations = 0;
 				switch_size_t len = 0;
 
+				switch_core_profile_start(prof_start);
 				switch_mutex_lock(profile->ireg_mutex);
 				
 				//sofia_glue_actually_execute_sql(profile, "begin;\n", NULL);
@@ -1228,16 +1233,19 @@ void *SWITCH_THREAD_FUNC sofia_profile_worker_thread_run(switch_thread_t *thread
 				sofia_glue_actually_execute_sql_trans(profile, sqlbuf, NULL);
 				//sofia_glue_actually_execute_sql(profile, "commit;\n", NULL);
 				switch_mutex_unlock(profile->ireg_mutex);
+				switch_core_profile_stop(prof, prof_start);
 				loop_count = 0;
 			}
 		} else {
 			if (qsize) {
+				switch_core_profile_start(prof_start);
 				//switch_mutex_lock(profile->ireg_mutex);
 				while (switch_queue_trypop(profile->sql_queue, &pop) == SWITCH_STATUS_SUCCESS && pop) {
 					sofia_glue_actually_execute_sql(profile, (char *) pop, profile->ireg_mutex);
 					free(pop);
 				}
 				//switch_mutex_unlock(profile->ireg_mutex);
+				switch_core_profile_stop(prof, prof_start);
 			}
 		}
 
@@ -28,17 +28,57 @@
  */
 #include <sys/stat.h>
 #include <switch.h>
+#ifndef WIN32
+#include <sys/uio.h>
+#include <limits.h>
+#endif
+
+#ifndef IOV_MAX
+#define IOV_MAX 64
+#endif
 
 typedef enum {
 	CDR_LEG_A = (1 << 0),
 	CDR_LEG_B = (1 << 1)
 } cdr_leg_t;
 
+typedef enum {
+	CDR_SYNC_NONE,
+	CDR_SYNC_FLUSH
+} cdr_sync_t;
+
+struct cdr_line {
+	char *data;
+	switch_size_t len;
+};
+typedef struct cdr_line cdr_line_t;
+
+struct cdr_lines {
+	cdr_line_t *line;
+	uint32_t count;
+	uint32_t alloc;
+	switch_size_t bytes;
+};
+typedef struct cdr_lines cdr_lines_t;
+
 struct cdr_fd {
 	int fd;
 	char *path;
 	int64_t bytes;
+	switch_time_t opened;
+	/* held by the hangup threads only long enough to queue a line */
 	switch_mutex_t *mutex;
+	/* lines waiting for the writer thread and the set it is writing out */
+	cdr_lines_t pending;
+	cdr_lines_t writing;
+	int rotate_pending;
+	uint64_t lines;
+	uint64_t flushes;
+	uint64_t errors;
+	switch_time_t flush_time;
+	switch_time_t flush_max;
+	switch_time_t flush_last;
+	struct cdr_fd *next;
 };
 typedef struct cdr_fd cdr_fd_t;
 
@@ -57,6 +97,18 @@ static struct {
 	int rotate;
 	int debug;
 	cdr_leg_t legs;
+	switch_mutex_t *mutex;
+	cdr_fd_t *fd_list;
+	int buffered;
+	uint32_t flush_interval;
+	switch_size_t flush_size;
+	cdr_sync_t sync;
+	int64_t rotate_size;
+	uint32_t rotate_interval;
+	int writer_running;
+	switch_thread_t *writer_thread;
+	switch_mutex_t *writer_mutex;
+	switch_thread_cond_t *writer_cond;
 } globals;
 
 SWITCH_MODULE_LOAD_FUNCTION(mod_cdr_csv_load);
@@ -82,13 +134,14 @@ static void do_reopen(cdr_fd_t *fd)
 	for (x = 0; x < 10; x++) {
 		if ((fd->fd = open(fd->path, O_WRONLY | O_CREAT | O_APPEND, S_IRUSR | S_IWUSR)) > -1) {
 			fd->bytes = fd_size(fd->fd);
+			fd->opened = switch_epoch_time_now(NULL);
 			break;
 		}
 		switch_yield(100000);
 	}
 }
 
-static void do_rotate(cdr_fd_t *fd)
+static void do_rotate(cdr_fd_t *fd, switch_bool_t rename)
 {
 	switch_time_exp_t tm;
 	char date[80] = "";
@@ -96,10 +149,12 @@ static void do_rotate(cdr_fd_t *fd)
 	char *p;
 	size_t len;
 
-	close(fd->fd);
-	fd->fd = -1;
+	if (fd->fd > -1) {
+		close(fd->fd);
+		fd->fd = -1;
+	}
 
-	if (globals.rotate) {
+	if (rename) {
 		switch_time_exp_lt(&tm, switch_micro_time_now());
 		switch_strftime_nocheck(date, &retsize, sizeof(date), "%Y-%m-%d-%H-%M-%S", &tm);
 
@@ -120,17 +175,16 @@ static void do_rotate(cdr_fd_t *fd)
 			switch_event_fire(&event);
 		}
 	} else {
-		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "%s CDR logfile %s\n", globals.rotate ? "Rotated" : "Re-opened", fd->path);
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "%s CDR logfile %s\n", rename ? "Rotated" : "Re-opened", fd->path);
 	}
 
 }
 
-static void write_cdr(const char *path, const char *log_line)
+static cdr_fd_t *get_cdr_fd(const char *path)
 {
 	cdr_fd_t *fd = NULL;
-	unsigned int bytes_in, bytes_out;
-	int loops = 0;
 
+	switch_mutex_lock(globals.mutex);
 	if (!(fd = switch_core_hash_find(globals.fd_hash, path))) {
 		fd = switch_core_alloc(globals.pool, sizeof(*fd));
 		switch_assert(fd);
@@ -139,31 +193,62 @@ static void write_cdr(const char *path, const char *log_line)
 		switch_mutex_init(&fd->mutex, SWITCH_MUTEX_NESTED, globals.pool);
 		fd->path = switch_core_strdup(globals.pool, path);
 		switch_core_hash_insert(globals.fd_hash, path, fd);
+		/* the writer thread walks this list without the lock, entries are only ever prepended */
+		fd->next = globals.fd_list;
+		globals.fd_list = fd;
+	}
+	switch_mutex_unlock(globals.mutex);
+
+	return fd;
+}
+
+static switch_bool_t rotate_due(cdr_fd_t *fd, switch_size_t bytes_out)
+{
+	if (fd->bytes + bytes_out > UINT_MAX) {
+		return SWITCH_TRUE;
 	}
 
+	if (globals.rotate_size && fd->bytes && fd->bytes + (int64_t) bytes_out > globals.rotate_size) {
+		return SWITCH_TRUE;
+	}
+
+	if (globals.rotate_interval && fd->bytes && switch_epoch_time_now(NULL) - fd->opened >= (switch_time_t) globals.rotate_interval) {
+		return SWITCH_TRUE;
+	}
+
+	return SWITCH_FALSE;
+}
+
+static void write_cdr_sync(cdr_fd_t *fd, const char *log_line)
+{
+	unsigned int bytes_in, bytes_out;
+	int loops = 0;
+
 	switch_mutex_lock(fd->mutex);
 	bytes_out = (unsigned) strlen(log_line);
 
 	if (fd->fd < 0) {
 		do_reopen(fd);
 		if (fd->fd < 0) {
-			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Error opening %s\n", path);
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Error opening %s\n", fd->path);
 			goto end;
 		}
 	}
 
-	if (fd->bytes + bytes_out > UINT_MAX) {
-		do_rotate(fd);
+	if (rotate_due(fd, bytes_out)) {
+		do_rotate(fd, fd->bytes + bytes_out > UINT_MAX ? globals.rotate : SWITCH_TRUE);
 	}
 
 	while ((bytes_in = write(fd->fd, log_line, bytes_out)) != bytes_out && ++loops < 10) {
-		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "Write error to file %s %d/%d\n", path, (int) bytes_in, (int) bytes_out);
-		do_rotate(fd);
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "Write error to file %s %d/%d\n", fd->path, (int) bytes_in, (int) bytes_out);
+		fd->errors++;
+		do_rotate(fd, globals.rotate);
 		switch_yield(250000);
 	}
 
 	if (bytes_in > 0) {
 		fd->bytes += bytes_in;
+		fd->lines++;
 	}
 
   end:
@@ -171,6 +256,253 @@ static void write_cdr(const char *path, const char *log_line)
 	switch_mutex_unlock(fd->mutex);
 }
 
+static void free_lines(cdr_lines_t *lines)
+{
+	uint32_t i;
+
+	for (i = 0; i < lines->count; i++) {
+		free(lines->line[i].data);
+	}
+
+	lines->count = 0;
+	lines->bytes = 0;
+}
+
+/* byte offset of the start of the line that holds offset, and how many lines come before it */
+static switch_size_t line_start(cdr_lines_t *lines, switch_size_t offset, uint32_t *index)
+{
+	switch_size_t start = 0;
+	uint32_t i = 0;
+
+	while (i < lines->count && start + lines->line[i].len <= offset) {
+		start += lines->line[i].len;
+		i++;
+	}
+
+	if (index) {
+		*index = i;
+	}
+
+	return start;
+}
+
+/* write out a set of lines from offset on with as few syscalls as possible, returns the number of bytes written */
+static switch_size_t write_lines(cdr_fd_t *fd, cdr_lines_t *lines, switch_size_t offset)
+{
+	switch_size_t total = 0;
+	uint32_t i = 0;
+	switch_size_t skip = offset - line_start(lines, offset, &i);
+
+	while (i < lines->count) {
+#ifndef WIN32
+		struct iovec iov[IOV_MAX];
+		int n = 0;
+		ssize_t wrote;
+
+		while (n < IOV_MAX && i + n < lines->count) {
+			iov[n].iov_base = lines->line[i + n].data + (n ? 0 : skip);
+			iov[n].iov_len = lines->line[i + n].len - (n ? 0 : skip);
+			n++;
+		}
+
+		if ((wrote = writev(fd->fd, iov, n)) <= 0) {
+			break;
+		}
+
+		total += wrote;
+
+		/* find where a short write stopped */
+		wrote += skip;
+		while (i < lines->count && (switch_size_t) wrote >= lines->line[i].len) {
+			wrote -= lines->line[i].len;
+			i++;
+		}
+		skip = wrote;
+#else
+		int wrote;
+
+		if ((wrote = write(fd->fd, lines->line[i].data + skip, (unsigned) (lines->line[i].len - skip))) <= 0) {
+			break;
+		}
+
+		total += wrote;
+		skip += wrote;
+
+		if (skip == lines->line[i].len) {
+			skip = 0;
+			i++;
+		}
+#endif
+	}
+
+	return total;
+}
+
+static void flush_cdr_fd(cdr_fd_t *fd)
+{
+	cdr_lines_t tmp;
+	switch_time_t start;
+	switch_size_t wrote, done = 0, partial;
+	int loops = 0;
+	int rotate;
+	uint32_t written;
+
+	switch_mutex_lock(fd->mutex);
+	rotate = fd->rotate_pending;
+	fd->rotate_pending = 0;
+	/* swap the queues so the hangup threads can keep appending while we write */
+	tmp = fd->writing;
+	fd->writing = fd->pending;
+	fd->pending = tmp;
+	switch_mutex_unlock(fd->mutex);
+
+	if (rotate) {
+		do_rotate(fd, globals.rotate);
+	}
+
+	if (!fd->writing.count) {
+		return;
+	}
+
+	start = switch_time_now();
+
+	if (fd->fd < 0) {
+		do_reopen(fd);
+	}
+
+	if (fd->fd > -1 && rotate_due(fd, fd->writing.bytes)) {
+		do_rotate(fd, fd->bytes + (int64_t) fd->writing.bytes > UINT_MAX ? globals.rotate : SWITCH_TRUE);
+	}
+
+	while (fd->fd > -1 && done < fd->writing.bytes) {
+		wrote = write_lines(fd, &fd->writing, done);
+		fd->bytes += wrote;
+		done += wrote;
+
+		if (done == fd->writing.bytes) {
+			break;
+		}
+
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "Write error to file %s %d/%d\n", fd->path, (int) done, (int) fd->writing.bytes);
+		fd->errors++;
+
+		/* cut off a line that only made it part way so the retry starts on a line boundary */
+		if ((partial = done - line_start(&fd->writing, done, NULL))) {
+#ifdef WIN32
+			if (_chsize(fd->fd, (long) (fd->bytes - partial))) {
+#else
+			if (ftruncate(fd->fd, (off_t) (fd->bytes - partial))) {
+#endif
+				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Truncated cdr left at the end of %s\n", fd->path);
+			} else {
+				fd->bytes -= partial;
+			}
+			done -= partial;
+		}
+
+		if (++loops >= 10) {
+			break;
+		}
+
+		do_rotate(fd, globals.rotate);
+		switch_yield(250000);
+	}
+
+	line_start(&fd->writing, done, &written);
+	fd->lines += written;
+
+	if (done != fd->writing.bytes) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "%s %s, %u of %u cdr(s) lost\n", fd->fd < 0 ? "Error opening" : "Error writing",
+						  fd->path, fd->writing.count - written, fd->writing.count);
+		fd->errors++;
+	} else {
+
+		if (globals.sync == CDR_SYNC_FLUSH) {
+#if defined(__linux__)
+			fdatasync(fd->fd);
+#elif !defined(WIN32)
+			fsync(fd->fd);
+#endif
+		}
+	}
+
+	free_lines(&fd->writing);
+
+	fd->flush_last = switch_time_now() - start;
+	fd->flush_time += fd->flush_last;
+	if (fd->flush_last > fd->flush_max) {
+		fd->flush_max = fd->flush_last;
+	}
+	fd->flushes++;
+}
+
+static void flush_all(void)
+{
+	cdr_fd_t *fd;
+
+	switch_mutex_lock(globals.mutex);
+	fd = globals.fd_list;
+	switch_mutex_unlock(globals.mutex);
+
+	for (; fd; fd = fd->next) {
+		flush_cdr_fd(fd);
+	}
+}
+
+static void *SWITCH_THREAD_FUNC cdr_writer_thread(switch_thread_t *thread, void *obj)
+{
+	switch_mutex_lock(globals.writer_mutex);
+	while (globals.writer_running) {
+		switch_thread_cond_timedwait(globals.writer_cond, globals.writer_mutex, (switch_interval_time_t) globals.flush_interval * 1000);
+		switch_mutex_unlock(globals.writer_mutex);
+
+		flush_all();
+
+		switch_mutex_lock(globals.writer_mutex);
+	}
+	switch_mutex_unlock(globals.writer_mutex);
+
+	/* whatever came in while stopping */
+	flush_all();
+
+	return NULL;
+}
+
+static void write_cdr(const char *path, const char *log_line)
+{
+	cdr_fd_t *fd = get_cdr_fd(path);
+	cdr_lines_t *lines;
+	switch_size_t len;
+	int wake = 0;
+
+	if (!globals.writer_running) {
+		write_cdr_sync(fd, log_line);
+		return;
+	}
+
+	len = strlen(log_line);
+
+	switch_mutex_lock(fd->mutex);
+	lines = &fd->pending;
+	if (lines->count == lines->alloc) {
+		lines->alloc = lines->alloc ? lines->alloc * 2 : 64;
+		lines->line = realloc(lines->line, lines->alloc * sizeof(cdr_line_t));
+		switch_assert(lines->line);
+	}
+	lines->line[lines->count].data = strdup(log_line);
+	lines->line[lines->count].len = len;
+	lines->count++;
+	lines->bytes += len;
+	wake = globals.flush_size && lines->bytes >= globals.flush_size;
+	switch_mutex_unlock(fd->mutex);
+
+	if (wake) {
+		switch_mutex_lock(globals.writer_mutex);
+		switch_thread_cond_signal(globals.writer_cond);
+		switch_mutex_unlock(globals.writer_mutex);
+	}
+}
+
 static switch_status_t my_on_reporting(switch_core_session_t *session)
 {
 	switch_channel_t *channel = switch_core_session_get_channel(session);
@@ -278,17 +610,61 @@ static void event_handler(switch_event_t *event)
 	}
 
 	if (sig && !strcmp(sig, "HUP")) {
+		switch_mutex_lock(globals.mutex);
 		for (hi = switch_hash_first(NULL, globals.fd_hash); hi; hi = switch_hash_next(hi)) {
 			switch_hash_this(hi, NULL, NULL, &val);
 			fd = (cdr_fd_t *) val;
 			switch_mutex_lock(fd->mutex);
-			do_rotate(fd);
+			if (globals.writer_running) {
+				/* the writer thread rotates it on its next pass */
+				fd->rotate_pending = 1;
+			} else {
+				do_rotate(fd, globals.rotate);
+			}
 			switch_mutex_unlock(fd->mutex);
 		}
+		switch_mutex_unlock(globals.mutex);
+
+		if (globals.writer_running) {
+			switch_mutex_lock(globals.writer_mutex);
+			switch_thread_cond_signal(globals.writer_cond);
+			switch_mutex_unlock(globals.writer_mutex);
+		}
 	}
 }
 
 
+SWITCH_STANDARD_API(cdr_csv_function)
+{
+	cdr_fd_t *fd;
+
+	stream->write_function(stream, "writer: %s, flush-interval %ums, flush-size %" SWITCH_SIZE_T_FMT ", sync %s\n",
+						   globals.writer_running ? "buffered" : "direct", globals.flush_interval, globals.flush_size,
+						   globals.sync == CDR_SYNC_FLUSH ? "flush" : "none");
+
+	switch_mutex_lock(globals.mutex);
+	fd = globals.fd_list;
+	switch_mutex_unlock(globals.mutex);
+
+	for (; fd; fd = fd->next) {
+		uint32_t backlog;
+		switch_size_t backlog_bytes;
+
+		switch_mutex_lock(fd->mutex);
+		backlog = fd->pending.count;
+		backlog_bytes = fd->pending.bytes;
+		switch_mutex_unlock(fd->mutex);
+
+		stream->write_function(stream, "%s: size %" SWITCH_INT64_T_FMT ", cdrs %" SWITCH_UINT64_T_FMT ", backlog %u (%" SWITCH_SIZE_T_FMT
+							   " bytes), flushes %" SWITCH_UINT64_T_FMT ", flush usec last/avg/max %" SWITCH_TIME_T_FMT "/%" SWITCH_TIME_T_FMT
+							   "/%" SWITCH_TIME_T_FMT ", errors %" SWITCH_UINT64_T_FMT "\n",
+							   fd->path, fd->bytes, fd->lines, backlog, backlog_bytes, fd->flushes, fd->flush_last,
+							   fd->flushes ? fd->flush_time / (switch_time_t) fd->flushes : 0, fd->flush_max, fd->errors);
+	}
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
 static switch_state_handler_table_t state_handlers = {
 	/*.on_init */ NULL,
 	/*.on_routing */ NULL,
@@ -316,6 +692,10 @@ static switch_status_t load_config(switch_memory_pool_t *pool)
 	switch_core_hash_init(&globals.template_hash, pool);
 
 	globals.pool = pool;
+	switch_mutex_init(&globals.mutex, SWITCH_MUTEX_NESTED, pool);
+	globals.buffered = 1;
+	globals.flush_interval = 1000;
+	globals.flush_size = 65536;
 
 	switch_core_hash_insert(globals.template_hash, "default", default_template);
 	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Adding default template.\n");
@@ -347,7 +727,31 @@ static switch_status_t load_config(switch_memory_pool_t *pool)
 					globals.default_template = switch_core_strdup(pool, val);
 				} else if (!strcasecmp(var, "master-file-only")) {
 					globals.masterfileonly = switch_true(val);
-				}
+				} else if (!strcasecmp(var, "buffered")) {
+					globals.buffered = switch_true(val);
+				} else if (!strcasecmp(var, "flush-interval")) {
+					int tmp = atoi(val);
+					if (tmp > 0) {
+						globals.flush_interval = (uint32_t) tmp;
+					}
+				} else if (!strcasecmp(var, "flush-size")) {
+					int tmp = atoi(val);
+					if (tmp >= 0) {
+						globals.flush_size = (switch_size_t) tmp;
+					}
+				} else if (!strcasecmp(var, "sync")) {
+					globals.sync = !strcasecmp(val, "flush") ? CDR_SYNC_FLUSH : CDR_SYNC_NONE;
+				} else if (!strcasecmp(var, "rotate-size")) {
+					int64_t tmp = atoll(val);
+					if (tmp >= 0) {
+						globals.rotate_size = tmp;
+					}
+				} else if (!strcasecmp(var, "rotate-interval")) {
+					int tmp = atoi(val);
+					if (tmp >= 0) {
+						globals.rotate_interval = (uint32_t) tmp;
+					}
+				}
 			}
 		}
 
@@ -387,6 +791,7 @@ static switch_status_t load_config(switch_memory_pool_t *pool)
 
 SWITCH_MODULE_LOAD_FUNCTION(mod_cdr_csv_load)
 {
+	switch_api_interface_t *api_interface;
 	switch_status_t status = SWITCH_STATUS_SUCCESS;
 
 	load_config(pool);
@@ -401,11 +806,22 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_cdr_csv_load)
 		return status;
 	}
 
-	switch_core_add_state_handler(&state_handlers);
-	*module_interface = switch_loadable_module_create_module_interface(pool, modname);
+	if (globals.buffered) {
+		switch_threadattr_t *thd_attr = NULL;
 
+		switch_mutex_init(&globals.writer_mutex, SWITCH_MUTEX_NESTED, pool);
+		switch_thread_cond_create(&globals.writer_cond, pool);
+		globals.writer_running = 1;
+
+		switch_threadattr_create(&thd_attr, pool);
+		switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+		switch_thread_create(&globals.writer_thread, thd_attr, cdr_writer_thread, NULL, pool);
+	}
 
+	switch_core_add_state_handler(&state_handlers);
+	*module_interface = switch_loadable_module_create_module_interface(pool, modname);
 
+	SWITCH_ADD_API(api_interface, "cdr_csv", "Show cdr_csv writer status", cdr_csv_function, "");
 
 	return status;
 }
@@ -418,6 +834,17 @@ SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_cdr_csv_shutdown)
 	switch_event_unbind_callback(event_handler);
 	switch_core_remove_state_handler(&state_handlers);
 
+	if (globals.writer_thread) {
+		switch_status_t st;
+
+		switch_mutex_lock(globals.writer_mutex);
+		globals.writer_running = 0;
+		switch_thread_cond_signal(globals.writer_cond);
+		switch_mutex_unlock(globals.writer_mutex);
+
+		switch_thread_join(&st, globals.writer_thread);
+		globals.writer_thread = NULL;
+	}
 
 	return SWITCH_STATUS_SUCCESS;
 }
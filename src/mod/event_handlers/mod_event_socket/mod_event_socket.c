@@ -64,6 +64,29 @@ typedef enum {
 	EVENT_FORMAT_XML
 } event_format_t;
 
+typedef struct {
+	const char *name;
+	unsigned long hash;
+	const char *value;
+	int pos;
+	int is_regex;
+	switch_regex_t *re;
+} event_filter_rule_t;
+
+/* a listener's filter headers compiled into rules, shared by every listener with the same filter list */
+struct event_filter {
+	char *key;
+	switch_memory_pool_t *pool;
+	event_filter_rule_t *rules;
+	uint32_t rule_count;
+	uint32_t refs;
+	uint64_t eval_seq;
+	int eval_result;
+	struct event_filter *next;
+};
+
+typedef struct event_filter event_filter_t;
+
 struct listener {
 	switch_socket_t *sock;
 	switch_queue_t *event_queue;
@@ -92,6 +115,7 @@ struct listener {
 	char remote_ip[50];
 	switch_port_t remote_port;
 	switch_event_t *filters;
+	event_filter_t *compiled_filter;
 	struct listener *next;
 };
 
@@ -99,6 +123,9 @@ typedef struct listener listener_t;
 
 static struct {
 	switch_mutex_t *listener_mutex;
+	switch_mutex_t *filter_mutex;
+	event_filter_t *filters;
+	uint64_t event_seq;
 	switch_event_node_t *node;
 	int debug;
 } globals;
@@ -198,6 +225,168 @@ static void flush_listener(listener_t *listener, switch_bool_t flush_log, switch
 	}
 }
 
+static event_filter_t *event_filter_acquire(switch_event_t *filters)
+{
+	switch_stream_handle_t stream = { 0 };
+	switch_event_header_t *hp;
+	switch_memory_pool_t *pool = NULL;
+	event_filter_t *filter = NULL;
+	uint32_t x = 0;
+
+	SWITCH_STANDARD_STREAM(stream);
+	for (hp = filters->headers; hp; hp = hp->next) {
+		stream.write_function(&stream, "%s\n%s\n", hp->name, hp->value);
+		x++;
+	}
+
+	switch_mutex_lock(globals.filter_mutex);
+	for (filter = globals.filters; filter; filter = filter->next) {
+		if (!strcmp(filter->key, (char *) stream.data)) {
+			filter->refs++;
+			goto end;
+		}
+	}
+
+	switch_core_new_memory_pool(&pool);
+	filter = switch_core_alloc(pool, sizeof(*filter));
+	filter->pool = pool;
+	filter->key = switch_core_strdup(pool, (char *) stream.data);
+	filter->rules = switch_core_alloc(pool, sizeof(event_filter_rule_t) * x);
+	filter->refs = 1;
+
+	for (hp = filters->headers; hp; hp = hp->next) {
+		event_filter_rule_t *rule = &filter->rules[filter->rule_count++];
+		switch_ssize_t hlen = -1;
+		const char *comp_to = hp->value;
+
+		rule->name = switch_core_strdup(pool, hp->name);
+		rule->hash = switch_ci_hashfunc_default(rule->name, &hlen);
+		rule->pos = 1;
+
+		while (comp_to && *comp_to) {
+			if (*comp_to == '+') {
+				rule->pos = 1;
+			} else if (*comp_to == '-') {
+				rule->pos = 0;
+			} else if (*comp_to != ' ') {
+				break;
+			}
+			comp_to++;
+		}
+
+		rule->value = switch_core_strdup(pool, switch_str_nil(comp_to));
+
+		if (*hp->value == '/') {
+			rule->is_regex = 1;
+			rule->re = switch_regex_compile_expression(rule->value);
+		}
+	}
+
+	filter->next = globals.filters;
+	globals.filters = filter;
+
+  end:
+	switch_mutex_unlock(globals.filter_mutex);
+	switch_safe_free(stream.data);
+
+	return filter;
+}
+
+static void event_filter_release(event_filter_t **filterp)
+{
+	event_filter_t *filter = *filterp, *fp, *last = NULL;
+	switch_memory_pool_t *pool;
+	uint32_t x;
+
+	*filterp = NULL;
+
+	switch_mutex_lock(globals.filter_mutex);
+	if (--filter->refs) {
+		switch_mutex_unlock(globals.filter_mutex);
+		return;
+	}
+
+	for (fp = globals.filters; fp; fp = fp->next) {
+		if (fp == filter) {
+			if (last) {
+				last->next = fp->next;
+			} else {
+				globals.filters = fp->next;
+			}
+			break;
+		}
+		last = fp;
+	}
+	switch_mutex_unlock(globals.filter_mutex);
+
+	for (x = 0; x < filter->rule_count; x++) {
+		switch_regex_safe_free(filter->rules[x].re);
+	}
+
+	pool = filter->pool;
+	switch_core_destroy_memory_pool(&pool);
+}
+
+/* must be called with the listener's filter_mutex held whenever listener->filters changes */
+static void rebuild_listener_filter(listener_t *listener)
+{
+	event_filter_t *old = listener->compiled_filter;
+
+	if (listener->filters && listener->filters->headers) {
+		listener->compiled_filter = event_filter_acquire(listener->filters);
+	} else {
+		listener->compiled_filter = NULL;
+	}
+
+	if (old) {
+		event_filter_release(&old);
+	}
+}
+
+static int event_filter_match(event_filter_t *filter, switch_event_t *event)
+{
+	int send = 0;
+	uint32_t x;
+
+	for (x = 0; x < filter->rule_count; x++) {
+		event_filter_rule_t *rule = &filter->rules[x];
+		switch_event_header_t *hp;
+		int cmp = 0;
+
+		for (hp = event->headers; hp; hp = hp->next) {
+			if ((!hp->hash || rule->hash == hp->hash) && !strcasecmp(hp->name, rule->name)) {
+				break;
+			}
+		}
+
+		if (!hp) {
+			continue;
+		}
+
+		if (send && rule->pos) {
+			continue;
+		}
+
+		if (rule->is_regex) {
+			int ovector[30];
+			cmp = !!switch_regex_exec(rule->re, hp->value, ovector, sizeof(ovector) / sizeof(ovector[0]));
+		} else {
+			cmp = !strcasecmp(hp->value, rule->value);
+		}
+
+		if (cmp) {
+			if (rule->pos) {
+				send = 1;
+			} else {
+				send = 0;
+				break;
+			}
+		}
+	}
+
+	return send;
+}
+
 static switch_status_t expire_listener(listener_t ** listener)
 {
 	listener_t *l;
@@ -232,7 +421,7 @@ static switch_status_t expire_listener(listener_t ** listener)
 	if (l->filters) {
 		switch_event_destroy(&l->filters);
 	}
-
+	rebuild_listener_filter(l);
 	switch_mutex_unlock(l->filter_mutex);
 	switch_thread_rwlock_unlock(l->rwlock);
 	switch_core_destroy_memory_pool(&l->pool);
@@ -246,6 +435,7 @@ static void event_handler(switch_event_t *event)
 	switch_event_t *clone = NULL;
 	listener_t *l, *lp, *last = NULL;
 	time_t now = switch_epoch_time_now(NULL);
+	uint64_t seq;
 
 	switch_assert(event != NULL);
 
@@ -256,6 +446,7 @@ static void event_handler(switch_event_t *event)
 	lp = listen_list.listeners;
 
 	switch_mutex_lock(globals.listener_mutex);
+	seq = ++globals.event_seq;
 	while (lp) {
 		int send = 0;
 
@@ -286,54 +477,17 @@ static void event_handler(switch_event_t *event)
 			}
 		}
 
-		if (send && l->filters && l->filters->headers) {
-			switch_event_header_t *hp;
-			const char *hval;
+		if (send && l->compiled_filter) {
+			event_filter_t *filter;
 
-			send = 0;
 			switch_mutex_lock(l->filter_mutex);
-			for (hp = l->filters->headers; hp; hp = hp->next) {
-				if ((hval = switch_event_get_header(event, hp->name))) {
-					const char *comp_to = hp->value;
-					int pos = 1, cmp = 0;
-
-					while (comp_to && *comp_to) {
-						if (*comp_to == '+') {
-							pos = 1;
-						} else if (*comp_to == '-') {
-							pos = 0;
-						} else if (*comp_to != ' ') {
-							break;
-						}
-						comp_to++;
-					}
-
-					if (send && pos) {
-						continue;
-					}
-
-					if (!comp_to) {
-						continue;
-					}
-
-					if (*hp->value == '/') {
-						switch_regex_t *re = NULL;
-						int ovector[30];
-						cmp = !!switch_regex_perform(hval, comp_to, &re, ovector, sizeof(ovector) / sizeof(ovector[0]));
-						switch_regex_safe_free(re);
-					} else {
-						cmp = !strcasecmp(hval, comp_to);
-					}
-
-					if (cmp) {
-						if (pos) {
-							send = 1;
-						} else {
-							send = 0;
-							break;
-						}
-					}
+			if ((filter = l->compiled_filter)) {
+				/* listeners sharing this filter reuse the result for the same event */
+				if (filter->eval_seq != seq) {
+					filter->eval_result = event_filter_match(filter, event);
+					filter->eval_seq = seq;
 				}
+				send = filter->eval_result;
 			}
 			switch_mutex_unlock(l->filter_mutex);
 		}
@@ -692,6 +846,8 @@ SWITCH_STANDARD_API(event_sink_function)
 			stream->write_function(stream, "<data><reply type=\"error\">Invalid Syntax</reply></data>\n");
 		}
 
+		rebuild_listener_filter(listener);
+
 	  filter_end:
 
 		switch_mutex_unlock(listener->filter_mutex);
@@ -1003,6 +1159,7 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_event_socket_load)
 	memset(&globals, 0, sizeof(globals));
 
 	switch_mutex_init(&globals.listener_mutex, SWITCH_MUTEX_NESTED, pool);
+	switch_mutex_init(&globals.filter_mutex, SWITCH_MUTEX_NESTED, pool);
 
 	memset(&listen_list, 0, sizeof(listen_list));
 	switch_mutex_init(&listen_list.sock_mutex, SWITCH_MUTEX_NESTED, pool);
@@ -1735,6 +1892,7 @@ static switch_status_t parse_command(listener_t *listener, switch_event_t **even
 		} else {
 			switch_snprintf(reply, reply_len, "-ERR invalid syntax");
 		}
+		rebuild_listener_filter(listener);
 		switch_mutex_unlock(listener->filter_mutex);
 
 		goto done;
@@ -2472,6 +2630,7 @@ static void *SWITCH_THREAD_FUNC listener_run(switch_thread_t *thread, void *obj)
 	if (listener->filters) {
 		switch_event_destroy(&listener->filters);
 	}
+	rebuild_listener_filter(listener);
 	switch_mutex_unlock(listener->filter_mutex);
 
 	if (listener->session) {
@@ -68,6 +68,12 @@ static struct {
 	int disable100continue;
 	int rotate;
 	int auth_scheme;
+	int spool;
+	char *spool_dir;
+	uint32_t spool_threads;
+	uint32_t spool_batch;
+	uint32_t spool_backoff_max;
+	switch_cdr_spool_t *cdr_spool;
 	switch_memory_pool_t *pool;
 	switch_event_node_t *node;
 } globals;
@@ -595,20 +601,165 @@ static switch_status_t generate_json_cdr(switch_core_session_t *session, struct
 }
 
 
+/* post one cdr to the current url, rotating to the next url on failure.
+ * the spool threads hand in the same handle for every post so the connection is kept alive
+ */
+static switch_status_t post_cdr(CURL *curl_handle, const char *uuid, const char *json_text)
+{
+	char *json_text_escaped = NULL;
+	char *curl_json_text = NULL;
+	char *destUrl = NULL;
+	struct curl_slist *headers = NULL;
+	struct curl_slist *slist = NULL;
+	long httpRes = 0;
+	switch_status_t status = SWITCH_STATUS_FALSE;
+
+	if (globals.encode) {
+		switch_size_t need_bytes = strlen(json_text) * 3;
+
+		json_text_escaped = malloc(need_bytes);
+		switch_assert(json_text_escaped);
+		memset(json_text_escaped, 0, need_bytes);
+		if (globals.encode == ENCODING_DEFAULT) {
+			headers = curl_slist_append(headers, "Content-Type: application/x-www-form-urlencoded");
+			switch_url_encode(json_text, json_text_escaped, need_bytes);
+		} else {
+			headers = curl_slist_append(headers, "Content-Type: application/x-www-form-base64-encoded");
+			switch_b64_encode((unsigned char *) json_text, need_bytes / 3, (unsigned char *) json_text_escaped, need_bytes);
+		}
+
+		if (!(curl_json_text = switch_mprintf("cdr=%s", json_text_escaped))) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "Memory Error!\n");
+			goto end;
+		}
+
+	} else {
+		headers = curl_slist_append(headers, "Content-Type: application/x-www-form-plaintext");
+		curl_json_text = (char *) json_text;
+	}
+
+	if (!zstr(globals.cred)) {
+		curl_easy_setopt(curl_handle, CURLOPT_HTTPAUTH, globals.auth_scheme);
+		curl_easy_setopt(curl_handle, CURLOPT_USERPWD, globals.cred);
+	}
+
+	curl_easy_setopt(curl_handle, CURLOPT_HTTPHEADER, headers);
+	curl_easy_setopt(curl_handle, CURLOPT_POST, 1);
+	curl_easy_setopt(curl_handle, CURLOPT_POSTFIELDS, curl_json_text);
+	curl_easy_setopt(curl_handle, CURLOPT_USERAGENT, "freeswitch-json/1.0");
+	curl_easy_setopt(curl_handle, CURLOPT_WRITEFUNCTION, httpCallBack);
+
+	if (globals.disable100continue) {
+		slist = curl_slist_append(slist, "Expect:");
+		curl_easy_setopt(curl_handle, CURLOPT_HTTPHEADER, slist);
+	}
+
+	if (globals.ssl_cert_file) {
+		curl_easy_setopt(curl_handle, CURLOPT_SSLCERT, globals.ssl_cert_file);
+	}
+
+	if (globals.ssl_key_file) {
+		curl_easy_setopt(curl_handle, CURLOPT_SSLKEY, globals.ssl_key_file);
+	}
+
+	if (globals.ssl_key_password) {
+		curl_easy_setopt(curl_handle, CURLOPT_SSLKEYPASSWD, globals.ssl_key_password);
+	}
+
+	if (globals.ssl_version) {
+		if (!strcasecmp(globals.ssl_version, "SSLv3")) {
+			curl_easy_setopt(curl_handle, CURLOPT_SSLVERSION, CURL_SSLVERSION_SSLv3);
+		} else if (!strcasecmp(globals.ssl_version, "TLSv1")) {
+			curl_easy_setopt(curl_handle, CURLOPT_SSLVERSION, CURL_SSLVERSION_TLSv1);
+		}
+	}
+
+	if (globals.ssl_cacert_file) {
+		curl_easy_setopt(curl_handle, CURLOPT_CAINFO, globals.ssl_cacert_file);
+	}
+
+	/* these were used for testing, optionally they may be enabled if someone desires
+	   curl_easy_setopt(curl_handle, CURLOPT_TIMEOUT, 120); // tcp timeout
+	   curl_easy_setopt(curl_handle, CURLOPT_FOLLOWLOCATION, 1); // 302 recursion level
+	 */
+
+	destUrl = switch_mprintf("%s?uuid=%s", globals.urls[globals.url_index], uuid);
+	curl_easy_setopt(curl_handle, CURLOPT_URL, destUrl);
+
+	if (!strncasecmp(destUrl, "https", 5)) {
+		curl_easy_setopt(curl_handle, CURLOPT_SSL_VERIFYPEER, 0);
+		curl_easy_setopt(curl_handle, CURLOPT_SSL_VERIFYHOST, 0);
+	}
+
+	if (globals.enable_cacert_check) {
+		curl_easy_setopt(curl_handle, CURLOPT_SSL_VERIFYPEER, TRUE);
+	}
+
+	if (globals.enable_ssl_verifyhost) {
+		curl_easy_setopt(curl_handle, CURLOPT_SSL_VERIFYHOST, 2);
+	}
+
+	curl_easy_perform(curl_handle);
+	curl_easy_getinfo(curl_handle, CURLINFO_RESPONSE_CODE, &httpRes);
+	switch_safe_free(destUrl);
+
+	if (httpRes == 200) {
+		status = SWITCH_STATUS_SUCCESS;
+	} else {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Got error [%ld] posting to web server [%s]\n",
+						  httpRes, globals.urls[globals.url_index]);
+		globals.url_index++;
+		switch_assert(globals.url_count <= MAX_URLS);
+		if (globals.url_index >= globals.url_count) {
+			globals.url_index = 0;
+		}
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Retry will be with url [%s]\n", globals.urls[globals.url_index]);
+	}
+
+  end:
+	/* the lists are gone after this so don't leave them set on a handle that gets reused */
+	curl_easy_setopt(curl_handle, CURLOPT_HTTPHEADER, NULL);
+	curl_easy_setopt(curl_handle, CURLOPT_POSTFIELDS, NULL);
+
+	if (headers) {
+		curl_slist_free_all(headers);
+	}
+	if (slist) {
+		curl_slist_free_all(slist);
+	}
+	if (curl_json_text != json_text) {
+		switch_safe_free(curl_json_text);
+	}
+	switch_safe_free(json_text_escaped);
+
+	return status;
+}
+
+static switch_status_t spool_send(const char *uuid, char leg, const char *data, switch_size_t len, void **thread_data, void *user_data)
+{
+	if (!*thread_data) {
+		if (!(*thread_data = curl_easy_init())) {
+			return SWITCH_STATUS_FALSE;
+		}
+	}
+
+	return post_cdr((CURL *) *thread_data, uuid, data);
+}
+
+static void spool_cleanup(void *thread_data, void *user_data)
+{
+	curl_easy_cleanup((CURL *) thread_data);
+}
+
 static switch_status_t my_on_reporting(switch_core_session_t *session)
 {
 	struct json_object *json_cdr = NULL;
 	const char *json_text = NULL;
 	char *path = NULL;
-	char *curl_json_text = NULL;
 	const char *logdir = NULL;
-	char *json_text_escaped = NULL;
 	int fd = -1;
 	uint32_t cur_try;
-	long httpRes;
 	CURL *curl_handle = NULL;
-	struct curl_slist *headers = NULL;
-	struct curl_slist *slist = NULL;
 	switch_channel_t *channel = switch_core_session_get_channel(session);
 	switch_status_t status = SWITCH_STATUS_FALSE;
 	int is_b;
@@ -675,125 +826,29 @@ static switch_status_t my_on_reporting(switch_core_session_t *session)
 		switch_thread_rwlock_unlock(globals.log_path_lock);
 	}
 
+	/* hand it to the spool, the sender threads take care of posting it */
+	if (globals.url_count && globals.cdr_spool) {
+		if (switch_cdr_spool_write(globals.cdr_spool, switch_core_session_get_uuid(session), is_b ? 'b' : 'a',
+								   json_text, strlen(json_text)) == SWITCH_STATUS_SUCCESS) {
+			goto success;
+		}
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Unable to spool cdr, posting it directly\n");
+	}
+
 	/* try to post it to the web server */
 	if (globals.url_count) {
-		char *destUrl = NULL;
 		curl_handle = curl_easy_init();
 
-		if (globals.encode) {
-			switch_size_t need_bytes = strlen(json_text) * 3;
-
-			json_text_escaped = malloc(need_bytes);
-			switch_assert(json_text_escaped);
-			memset(json_text_escaped, 0, need_bytes);
-			if (globals.encode == ENCODING_DEFAULT) {
-				headers = curl_slist_append(headers, "Content-Type: application/x-www-form-urlencoded");
-				switch_url_encode(json_text, json_text_escaped, need_bytes);
-			} else {
-				headers = curl_slist_append(headers, "Content-Type: application/x-www-form-base64-encoded");
-				switch_b64_encode((unsigned char *) json_text, need_bytes / 3, (unsigned char *) json_text_escaped, need_bytes);
-			}
-
-			json_text = json_text_escaped;
-
-			if (!(curl_json_text = switch_mprintf("cdr=%s", json_text))) {
-				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "Memory Error!\n");
-				goto error;
-			}
-
-		} else {
-			headers = curl_slist_append(headers, "Content-Type: application/x-www-form-plaintext");
-			curl_json_text = (char *)json_text;
-		}
-
-
-		if (!zstr(globals.cred)) {
-			curl_easy_setopt(curl_handle, CURLOPT_HTTPAUTH, globals.auth_scheme);
-			curl_easy_setopt(curl_handle, CURLOPT_USERPWD, globals.cred);
-		}
-
-		curl_easy_setopt(curl_handle, CURLOPT_HTTPHEADER, headers);
-		curl_easy_setopt(curl_handle, CURLOPT_POST, 1);
-		curl_easy_setopt(curl_handle, CURLOPT_POSTFIELDS, curl_json_text);
-		curl_easy_setopt(curl_handle, CURLOPT_USERAGENT, "freeswitch-json/1.0");
-		curl_easy_setopt(curl_handle, CURLOPT_WRITEFUNCTION, httpCallBack);
-
-		if (globals.disable100continue) {
-			slist = curl_slist_append(slist, "Expect:");
-			curl_easy_setopt(curl_handle, CURLOPT_HTTPHEADER, slist);
-		}
-
-		if (globals.ssl_cert_file) {
-			curl_easy_setopt(curl_handle, CURLOPT_SSLCERT, globals.ssl_cert_file);
-		}
-
-		if (globals.ssl_key_file) {
-			curl_easy_setopt(curl_handle, CURLOPT_SSLKEY, globals.ssl_key_file);
-		}
-
-		if (globals.ssl_key_password) {
-			curl_easy_setopt(curl_handle, CURLOPT_SSLKEYPASSWD, globals.ssl_key_password);
-		}
-
-		if (globals.ssl_version) {
-			if (!strcasecmp(globals.ssl_version, "SSLv3")) {
-				curl_easy_setopt(curl_handle, CURLOPT_SSLVERSION, CURL_SSLVERSION_SSLv3);
-			} else if (!strcasecmp(globals.ssl_version, "TLSv1")) {
-				curl_easy_setopt(curl_handle, CURLOPT_SSLVERSION, CURL_SSLVERSION_TLSv1);
-			}
-		}
-
-		if (globals.ssl_cacert_file) {
-			curl_easy_setopt(curl_handle, CURLOPT_CAINFO, globals.ssl_cacert_file);
-		}
-
-		/* these were used for testing, optionally they may be enabled if someone desires
-		   curl_easy_setopt(curl_handle, CURLOPT_TIMEOUT, 120); // tcp timeout
-		   curl_easy_setopt(curl_handle, CURLOPT_FOLLOWLOCATION, 1); // 302 recursion level
-		 */
-
 		for (cur_try = 0; cur_try < globals.retries; cur_try++) {
 			if (cur_try > 0) {
 				switch_yield(globals.delay * 1000000);
 			}
 
-			destUrl = switch_mprintf("%s?uuid=%s", globals.urls[globals.url_index], switch_core_session_get_uuid(session));
-			curl_easy_setopt(curl_handle, CURLOPT_URL, destUrl);
-
-			if (!strncasecmp(destUrl, "https", 5)) {
-				curl_easy_setopt(curl_handle, CURLOPT_SSL_VERIFYPEER, 0);
-				curl_easy_setopt(curl_handle, CURLOPT_SSL_VERIFYHOST, 0);
-			}
-
-			if (globals.enable_cacert_check) {
-				curl_easy_setopt(curl_handle, CURLOPT_SSL_VERIFYPEER, TRUE);
-			}
-
-			if (globals.enable_ssl_verifyhost) {
-				curl_easy_setopt(curl_handle, CURLOPT_SSL_VERIFYHOST, 2);
-			}
-
-			curl_easy_perform(curl_handle);
-			curl_easy_getinfo(curl_handle, CURLINFO_RESPONSE_CODE, &httpRes);
-			switch_safe_free(destUrl);
-			if (httpRes == 200) {
+			if (post_cdr(curl_handle, switch_core_session_get_uuid(session), json_text) == SWITCH_STATUS_SUCCESS) {
 				goto success;
-			} else {
-				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Got error [%ld] posting to web server [%s]\n",
-								  httpRes, globals.urls[globals.url_index]);
-				globals.url_index++;
-				switch_assert(globals.url_count <= MAX_URLS);
-				if (globals.url_index >= globals.url_count) {
-					globals.url_index = 0;
-				}
-				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Retry will be with url [%s]\n", globals.urls[globals.url_index]);
 			}
 		}
 		curl_easy_cleanup(curl_handle);
-		curl_slist_free_all(headers);
-		curl_slist_free_all(slist);
-		slist = NULL;
-		headers = NULL;
 		curl_handle = NULL;
 
 		/* if we are here the web post failed for some reason */
@@ -831,18 +886,8 @@ static switch_status_t my_on_reporting(switch_core_session_t *session)
 	if (curl_handle) {
 		curl_easy_cleanup(curl_handle);
 	}
-	if (headers) {
-		curl_slist_free_all(headers);
-	}
-	if (slist) {
-		curl_slist_free_all(slist);
-	}
-	if (curl_json_text != json_text) {
-		switch_safe_free(curl_json_text);
-	}
-	
+
 	json_object_put(json_cdr);
-	switch_safe_free(json_text_escaped);
 
 	switch_safe_free(path);
 
@@ -860,6 +905,18 @@ static void event_handler(switch_event_t *event)
 	}
 }
 
+SWITCH_STANDARD_API(json_cdr_spool_function)
+{
+	if (!globals.cdr_spool) {
+		stream->write_function(stream, "-ERR spool is not enabled\n");
+		return SWITCH_STATUS_SUCCESS;
+	}
+
+	switch_cdr_spool_status(globals.cdr_spool, stream);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
 static switch_state_handler_table_t state_handlers = {
 	/*.on_init */ NULL,
 	/*.on_routing */ NULL,
@@ -878,6 +935,7 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_json_cdr_load)
 {
 	char *cf = "json_cdr.conf";
 	switch_xml_t cfg, xml, settings, param;
+	switch_api_interface_t *api_interface;
 	switch_status_t status = SWITCH_STATUS_SUCCESS;
 
 	/* test global state handlers */
@@ -897,6 +955,9 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_json_cdr_load)
 	globals.disable100continue = 0;
 	globals.pool = pool;
 	globals.auth_scheme = CURLAUTH_BASIC;
+	globals.spool_threads = 2;
+	globals.spool_batch = 10;
+	globals.spool_backoff_max = 60000;
 
 	switch_thread_rwlock_create(&globals.log_path_lock, pool);
 
@@ -939,6 +1000,25 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_json_cdr_load)
 				globals.retries = (uint32_t) atoi(val);
 			} else if (!strcasecmp(var, "rotate") && !zstr(val)) {
 				globals.rotate = switch_true(val);
+			} else if (!strcasecmp(var, "spool")) {
+				globals.spool = switch_true(val);
+			} else if (!strcasecmp(var, "spool-dir") && !zstr(val)) {
+				globals.spool_dir = switch_core_strdup(globals.pool, val);
+			} else if (!strcasecmp(var, "spool-threads") && !zstr(val)) {
+				int tmp = atoi(val);
+				if (tmp > 0) {
+					globals.spool_threads = (uint32_t) tmp;
+				}
+			} else if (!strcasecmp(var, "spool-batch") && !zstr(val)) {
+				int tmp = atoi(val);
+				if (tmp > 0) {
+					globals.spool_batch = (uint32_t) tmp;
+				}
+			} else if (!strcasecmp(var, "spool-max-backoff") && !zstr(val)) {
+				int tmp = atoi(val);
+				if (tmp > 0) {
+					globals.spool_backoff_max = (uint32_t) tmp * 1000;
+				}
 			} else if (!strcasecmp(var, "log-dir")) {
 				if (zstr(val)) {
 					globals.base_log_dir = switch_core_sprintf(globals.pool, "%s%sjson_cdr", SWITCH_GLOBAL_dirs.log_dir, SWITCH_PATH_SEPARATOR);
@@ -1017,6 +1097,20 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_json_cdr_load)
 
 	set_json_cdr_log_dirs();
 
+	if (globals.spool && globals.url_count) {
+		if (zstr(globals.spool_dir)) {
+			globals.spool_dir = switch_core_sprintf(globals.pool, "%s%sjson_cdr", SWITCH_GLOBAL_dirs.storage_dir, SWITCH_PATH_SEPARATOR);
+		}
+
+		if (switch_cdr_spool_create(&globals.cdr_spool, "json_cdr", globals.spool_dir, globals.spool_threads, globals.spool_batch,
+									1000, globals.spool_backoff_max, spool_send, spool_cleanup, NULL) != SWITCH_STATUS_SUCCESS) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Unable to start spool in %s, posting from the hangup path\n",
+							  globals.spool_dir);
+		}
+	}
+
+	SWITCH_ADD_API(api_interface, "json_cdr_spool", "Show the json_cdr delivery spool", json_cdr_spool_function, "");
+
 	switch_xml_free(xml);
 	return status;
 }
@@ -1032,6 +1126,9 @@ SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_json_cdr_shutdown)
 	switch_event_unbind(&globals.node);
 	switch_core_remove_state_handler(&state_handlers);
 
+	/* anything still queued stays in the journal for the next start */
+	switch_cdr_spool_destroy(&globals.cdr_spool);
+
 	switch_thread_rwlock_destroy(globals.log_path_lock);
 
 	return SWITCH_STATUS_SUCCESS;
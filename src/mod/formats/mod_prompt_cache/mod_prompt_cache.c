@@ -0,0 +1,607 @@
+/*
+ * FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ * Copyright (C) 2005-2010, Anthony Minessale II <anthm@freeswitch.org>
+ *
+ * Version: MPL 1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ *
+ * The Initial Developer of the Original Code is
+ * Anthony Minessale II <anthm@freeswitch.org>
+ * Portions created by the Initial Developer are Copyright (C)
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ * Anthony Minessale II <anthm@freeswitch.org>
+ *
+ *
+ * mod_prompt_cache.c -- Decoded prompt cache
+ *
+ * prompt_cache://<path> opens <path> through the regular file interfaces once, keeps the
+ * decoded signed linear audio at the requested rate in memory and serves every later
+ * playback of the same path, rate and mtime from there.  Files larger than the per file
+ * limit and native (pass-through codec) files are streamed from the real handle.
+ *
+ */
+#include <switch.h>
+#include <sys/stat.h>
+
+SWITCH_MODULE_LOAD_FUNCTION(mod_prompt_cache_load);
+SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_prompt_cache_shutdown);
+SWITCH_MODULE_DEFINITION(mod_prompt_cache, mod_prompt_cache_load, mod_prompt_cache_shutdown, NULL);
+
+static const char *global_cf = "prompt_cache.conf";
+
+struct prompt_entry {
+	char *key;
+	char *path;
+	uint32_t rate;
+	time_t mtime;
+	int16_t *data;
+	switch_size_t samples;
+	uint32_t refs;
+	uint32_t hits;
+	/* removed from the hash because the file changed, freed on the last close */
+	int stale;
+	struct prompt_entry *prev;
+	struct prompt_entry *next;
+};
+typedef struct prompt_entry prompt_entry_t;
+
+struct prompt_context {
+	prompt_entry_t *entry;
+	switch_size_t pos;
+	/* used instead of an entry for files that are not cached */
+	switch_file_handle_t fh;
+};
+typedef struct prompt_context prompt_context_t;
+
+static struct {
+	switch_memory_pool_t *pool;
+	switch_mutex_t *mutex;
+	switch_hash_t *hash;
+	/* most recently used first */
+	prompt_entry_t *head;
+	prompt_entry_t *tail;
+	switch_size_t mem_max;
+	switch_size_t file_max;
+	switch_size_t mem_used;
+	uint32_t entries;
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t bypassed;
+	uint64_t reloads;
+	uint64_t evictions;
+} globals;
+
+static void entry_unlink(prompt_entry_t *ep)
+{
+	if (ep->prev) {
+		ep->prev->next = ep->next;
+	} else {
+		globals.head = ep->next;
+	}
+
+	if (ep->next) {
+		ep->next->prev = ep->prev;
+	} else {
+		globals.tail = ep->prev;
+	}
+
+	ep->prev = ep->next = NULL;
+}
+
+static void entry_push(prompt_entry_t *ep)
+{
+	ep->prev = NULL;
+	ep->next = globals.head;
+
+	if (globals.head) {
+		globals.head->prev = ep;
+	}
+	globals.head = ep;
+
+	if (!globals.tail) {
+		globals.tail = ep;
+	}
+}
+
+static void entry_free(prompt_entry_t *ep)
+{
+	switch_safe_free(ep->data);
+	switch_safe_free(ep->key);
+	switch_safe_free(ep->path);
+	free(ep);
+}
+
+/* must be called with globals.mutex locked, takes the entry out of the cache and frees it unless it is in use */
+static void entry_remove(prompt_entry_t *ep)
+{
+	entry_unlink(ep);
+	switch_core_hash_delete(globals.hash, ep->key);
+	globals.mem_used -= ep->samples * 2;
+	globals.entries--;
+
+	if (ep->refs) {
+		ep->stale = 1;
+	} else {
+		entry_free(ep);
+	}
+}
+
+/* must be called with globals.mutex locked */
+static void cache_trim(void)
+{
+	prompt_entry_t *ep, *prev;
+
+	for (ep = globals.tail; ep && globals.mem_used > globals.mem_max; ep = prev) {
+		prev = ep->prev;
+		if (!ep->refs) {
+			entry_remove(ep);
+			globals.evictions++;
+		}
+	}
+}
+
+static void cache_flush(void)
+{
+	prompt_entry_t *ep, *next;
+
+	switch_mutex_lock(globals.mutex);
+	for (ep = globals.head; ep; ep = next) {
+		next = ep->next;
+		entry_remove(ep);
+	}
+	switch_mutex_unlock(globals.mutex);
+}
+
+/* read the whole file through the real file interface, resampled to the rate of the handle */
+static prompt_entry_t *entry_load(switch_file_handle_t *fh, const char *path, uint32_t rate, time_t mtime)
+{
+	prompt_entry_t *ep;
+	switch_buffer_t *buffer = NULL;
+	int16_t data[SWITCH_RECOMMENDED_BUFFER_SIZE / 2];
+	switch_size_t len, bytes;
+
+	switch_buffer_create_dynamic(&buffer, sizeof(data), sizeof(data), globals.file_max);
+	switch_assert(buffer);
+
+	for (;;) {
+		len = sizeof(data) / 2;
+		if (switch_core_file_read(fh, data, &len) != SWITCH_STATUS_SUCCESS || !len) {
+			break;
+		}
+		if (!switch_buffer_write(buffer, data, len * 2)) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "%s decodes to more than %" SWITCH_SIZE_T_FMT " bytes, not caching\n",
+							  path, globals.file_max);
+			switch_buffer_destroy(&buffer);
+			return NULL;
+		}
+	}
+
+	if (!(bytes = switch_buffer_inuse(buffer))) {
+		switch_buffer_destroy(&buffer);
+		return NULL;
+	}
+
+	switch_zmalloc(ep, sizeof(*ep));
+	ep->key = switch_mprintf("%u:%s", rate, path);
+	ep->path = strdup(path);
+	ep->rate = rate;
+	ep->mtime = mtime;
+	ep->samples = bytes / 2;
+	ep->data = malloc(bytes);
+	switch_assert(ep->key && ep->path && ep->data);
+	switch_buffer_read(buffer, ep->data, bytes);
+	switch_buffer_destroy(&buffer);
+
+	return ep;
+}
+
+/* find the file the way mod_sndfile does: <dir>/<rate>/<file> at the requested rate,
+   then at the highest rate on disk, then the path as given */
+static char *prompt_resolve_path(switch_memory_pool_t *pool, const char *path, uint32_t rate, struct stat *st)
+{
+	static const uint32_t rates[] = { 8000, 16000, 32000, 48000 };
+	const char *last;
+	char *alt_path;
+	int i;
+
+	last = strrchr(path, *SWITCH_PATH_SEPARATOR);
+#ifdef WIN32
+	if (!last || strrchr(path, '/') > last) {
+		last = strrchr(path, '/');	/* do not swallow a forward slash if they are intermixed under windows */
+	}
+#endif
+
+	if (last) {
+		int dir_len = (int) (last - path + 1);
+
+		alt_path = switch_core_sprintf(pool, "%.*s%u%s%s", dir_len, path, rate, SWITCH_PATH_SEPARATOR, last + 1);
+		if (!stat(alt_path, st)) {
+			return alt_path;
+		}
+
+		for (i = 3; i >= 0; i--) {
+			alt_path = switch_core_sprintf(pool, "%.*s%u%s%s", dir_len, path, rates[i], SWITCH_PATH_SEPARATOR, last + 1);
+			if (!stat(alt_path, st)) {
+				return alt_path;
+			}
+		}
+	}
+
+	if (!stat(path, st)) {
+		return switch_core_strdup(pool, path);
+	}
+
+	return NULL;
+}
+
+/* hand the file to the real file interface and stream it from there */
+static switch_status_t prompt_cache_passthru(switch_file_handle_t *handle, prompt_context_t *context, const char *path)
+{
+	switch_status_t status;
+
+	if (!switch_test_flag((&context->fh), SWITCH_FILE_OPEN) &&
+		(status = switch_core_file_open(&context->fh, path, handle->channels, handle->samplerate,
+										SWITCH_FILE_FLAG_READ | SWITCH_FILE_DATA_SHORT, handle->memory_pool)) != SWITCH_STATUS_SUCCESS) {
+		return status;
+	}
+
+	switch_mutex_lock(globals.mutex);
+	globals.bypassed++;
+	switch_mutex_unlock(globals.mutex);
+
+	handle->samples = context->fh.samples;
+	handle->samplerate = context->fh.samplerate;
+	handle->channels = context->fh.channels;
+	handle->format = context->fh.format;
+	handle->sections = context->fh.sections;
+	handle->seekable = context->fh.seekable;
+	handle->speed = context->fh.speed;
+	handle->interval = context->fh.interval;
+	if (switch_test_flag((&context->fh), SWITCH_FILE_NATIVE)) {
+		switch_set_flag(handle, SWITCH_FILE_NATIVE);
+	}
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+static switch_status_t prompt_cache_file_open(switch_file_handle_t *handle, const char *path)
+{
+	prompt_context_t *context;
+	prompt_entry_t *ep = NULL, *new_ep;
+	struct stat st;
+	char *key, *real_path;
+	switch_status_t status;
+
+	if (switch_test_flag(handle, SWITCH_FILE_FLAG_WRITE)) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "This format does not support writing!\n");
+		return SWITCH_STATUS_FALSE;
+	}
+
+	if (!(context = switch_core_alloc(handle->memory_pool, sizeof(*context)))) {
+		return SWITCH_STATUS_MEMERR;
+	}
+
+	handle->private_info = context;
+
+	if (!(real_path = prompt_resolve_path(handle->memory_pool, path, handle->samplerate, &st))) {
+		/* not a plain file, let whichever module owns it open it */
+		return prompt_cache_passthru(handle, context, path);
+	}
+
+	key = switch_mprintf("%u:%s", handle->samplerate, real_path);
+	switch_assert(key);
+
+	switch_mutex_lock(globals.mutex);
+	if ((ep = switch_core_hash_find(globals.hash, key))) {
+		if (ep->mtime != st.st_mtime) {
+			entry_remove(ep);
+			globals.reloads++;
+			ep = NULL;
+		} else {
+			ep->refs++;
+			ep->hits++;
+			entry_unlink(ep);
+			entry_push(ep);
+			globals.hits++;
+		}
+	}
+	switch_mutex_unlock(globals.mutex);
+	free(key);
+
+	if (ep) {
+		context->entry = ep;
+		goto done;
+	}
+
+	if ((status = switch_core_file_open(&context->fh, real_path, handle->channels, handle->samplerate,
+										SWITCH_FILE_FLAG_READ | SWITCH_FILE_DATA_SHORT, handle->memory_pool)) != SWITCH_STATUS_SUCCESS) {
+		return status;
+	}
+
+	if (switch_test_flag((&context->fh), SWITCH_FILE_NATIVE) || (switch_size_t) st.st_size > globals.file_max) {
+		return prompt_cache_passthru(handle, context, real_path);
+	}
+
+	new_ep = entry_load(&context->fh, real_path, handle->samplerate, st.st_mtime);
+	switch_core_file_close(&context->fh);
+	memset(&context->fh, 0, sizeof(context->fh));
+
+	if (!new_ep) {
+		/* too big or unreadable as a whole, stream it like a regular file */
+		return prompt_cache_passthru(handle, context, real_path);
+	}
+
+	switch_mutex_lock(globals.mutex);
+	globals.misses++;
+	if ((ep = switch_core_hash_find(globals.hash, new_ep->key)) && ep->mtime == new_ep->mtime) {
+		/* someone else decoded it first */
+		entry_free(new_ep);
+	} else {
+		if (ep) {
+			entry_remove(ep);
+		}
+		ep = new_ep;
+		switch_core_hash_insert(globals.hash, ep->key, ep);
+		entry_push(ep);
+		globals.mem_used += ep->samples * 2;
+		globals.entries++;
+	}
+	ep->refs++;
+	cache_trim();
+	switch_mutex_unlock(globals.mutex);
+
+	context->entry = ep;
+
+  done:
+
+	handle->samples = (unsigned int) ep->samples;
+	handle->samplerate = ep->rate;
+	handle->channels = 1;
+	handle->format = 0;
+	handle->sections = 0;
+	handle->seekable = 1;
+	handle->speed = 0;
+	handle->pos = 0;
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+static switch_status_t prompt_cache_file_close(switch_file_handle_t *handle)
+{
+	prompt_context_t *context = handle->private_info;
+	prompt_entry_t *ep;
+
+	if (!context) {
+		return SWITCH_STATUS_SUCCESS;
+	}
+
+	if (!(ep = context->entry)) {
+		if (switch_test_flag((&context->fh), SWITCH_FILE_OPEN)) {
+			switch_core_file_close(&context->fh);
+		}
+		return SWITCH_STATUS_SUCCESS;
+	}
+
+	switch_mutex_lock(globals.mutex);
+	if (!--ep->refs) {
+		if (ep->stale) {
+			entry_free(ep);
+		} else {
+			cache_trim();
+		}
+	}
+	switch_mutex_unlock(globals.mutex);
+	context->entry = NULL;
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+static switch_status_t prompt_cache_file_read(switch_file_handle_t *handle, void *data, size_t *len)
+{
+	prompt_context_t *context = handle->private_info;
+	prompt_entry_t *ep = context->entry;
+	switch_size_t want = *len;
+
+	if (!ep) {
+		return switch_core_file_read(&context->fh, data, len);
+	}
+
+	if (context->pos >= ep->samples) {
+		*len = 0;
+		return SWITCH_STATUS_FALSE;
+	}
+
+	if (want > ep->samples - context->pos) {
+		want = ep->samples - context->pos;
+	}
+
+	memcpy(data, ep->data + context->pos, want * 2);
+	context->pos += want;
+	handle->pos += want;
+	*len = want;
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+static switch_status_t prompt_cache_file_seek(switch_file_handle_t *handle, unsigned int *cur_sample, int64_t samples, int whence)
+{
+	prompt_context_t *context = handle->private_info;
+	prompt_entry_t *ep = context->entry;
+	int64_t target;
+
+	if (!ep) {
+		return switch_core_file_seek(&context->fh, cur_sample, samples, whence);
+	}
+
+	switch (whence) {
+	case SEEK_CUR:
+		target = (int64_t) context->pos + samples;
+		break;
+	case SEEK_END:
+		target = (int64_t) ep->samples + samples;
+		break;
+	default:
+		target = samples;
+		break;
+	}
+
+	if (target < 0) {
+		target = 0;
+	} else if (target > (int64_t) ep->samples) {
+		target = ep->samples;
+	}
+
+	context->pos = (switch_size_t) target;
+	handle->pos = target;
+	*cur_sample = (unsigned int) target;
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+static switch_status_t prompt_cache_file_get_string(switch_file_handle_t *handle, switch_audio_col_t col, const char **string)
+{
+	prompt_context_t *context = handle->private_info;
+
+	if (!context->entry && switch_test_flag((&context->fh), SWITCH_FILE_OPEN)) {
+		return switch_core_file_get_string(&context->fh, col, string);
+	}
+
+	return SWITCH_STATUS_FALSE;
+}
+
+#define PROMPT_CACHE_SYNTAX "stats|list|flush"
+SWITCH_STANDARD_API(prompt_cache_function)
+{
+	if (zstr(cmd) || !strcasecmp(cmd, "stats")) {
+		uint64_t total;
+
+		switch_mutex_lock(globals.mutex);
+		total = globals.hits + globals.misses;
+		stream->write_function(stream, "entries: %u\n", globals.entries);
+		stream->write_function(stream, "memory: %" SWITCH_SIZE_T_FMT "/%" SWITCH_SIZE_T_FMT " bytes\n", globals.mem_used, globals.mem_max);
+		stream->write_function(stream, "hits: %" SWITCH_UINT64_T_FMT "\n", globals.hits);
+		stream->write_function(stream, "misses: %" SWITCH_UINT64_T_FMT "\n", globals.misses);
+		stream->write_function(stream, "hit-rate: %.2f%%\n", total ? 100.0 * (double) globals.hits / (double) total : 0.0);
+		stream->write_function(stream, "bypassed: %" SWITCH_UINT64_T_FMT "\n", globals.bypassed);
+		stream->write_function(stream, "reloads: %" SWITCH_UINT64_T_FMT "\n", globals.reloads);
+		stream->write_function(stream, "evictions: %" SWITCH_UINT64_T_FMT "\n", globals.evictions);
+		switch_mutex_unlock(globals.mutex);
+	} else if (!strcasecmp(cmd, "list")) {
+		prompt_entry_t *ep;
+
+		switch_mutex_lock(globals.mutex);
+		for (ep = globals.head; ep; ep = ep->next) {
+			stream->write_function(stream, "%s %uhz %" SWITCH_SIZE_T_FMT " bytes %u hits %u refs\n",
+								   ep->path, ep->rate, ep->samples * 2, ep->hits, ep->refs);
+		}
+		switch_mutex_unlock(globals.mutex);
+	} else if (!strcasecmp(cmd, "flush")) {
+		cache_flush();
+		stream->write_function(stream, "+OK\n");
+	} else {
+		stream->write_function(stream, "-USAGE: %s\n", PROMPT_CACHE_SYNTAX);
+	}
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+static switch_status_t load_config(void)
+{
+	switch_xml_t cfg, xml, settings, param;
+
+	globals.mem_max = 32 * 1024 * 1024;
+	globals.file_max = 1024 * 1024;
+
+	if (!(xml = switch_xml_open_cfg(global_cf, &cfg, NULL))) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Open of %s failed, using defaults\n", global_cf);
+		return SWITCH_STATUS_SUCCESS;
+	}
+
+	if ((settings = switch_xml_child(cfg, "settings"))) {
+		for (param = switch_xml_child(settings, "param"); param; param = param->next) {
+			char *var = (char *) switch_xml_attr_soft(param, "name");
+			char *val = (char *) switch_xml_attr_soft(param, "value");
+			int tmp = atoi(val);
+
+			if (!strcasecmp(var, "max-memory") && tmp > 0) {
+				globals.mem_max = (switch_size_t) tmp * 1024;
+			} else if (!strcasecmp(var, "max-file-size") && tmp > 0) {
+				globals.file_max = (switch_size_t) tmp * 1024;
+			}
+		}
+	}
+
+	switch_xml_free(xml);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+/* Registration */
+
+static char *supported_formats[SWITCH_MAX_CODECS] = { 0 };
+
+SWITCH_MODULE_LOAD_FUNCTION(mod_prompt_cache_load)
+{
+	switch_file_interface_t *file_interface;
+	switch_api_interface_t *api_interface;
+
+	memset(&globals, 0, sizeof(globals));
+	globals.pool = pool;
+	switch_mutex_init(&globals.mutex, SWITCH_MUTEX_NESTED, pool);
+	switch_core_hash_init(&globals.hash, pool);
+
+	load_config();
+
+	supported_formats[0] = "prompt_cache";
+
+	*module_interface = switch_loadable_module_create_module_interface(pool, modname);
+	file_interface = switch_loadable_module_create_interface(*module_interface, SWITCH_FILE_INTERFACE);
+	file_interface->interface_name = modname;
+	file_interface->extens = supported_formats;
+	file_interface->file_open = prompt_cache_file_open;
+	file_interface->file_close = prompt_cache_file_close;
+	file_interface->file_read = prompt_cache_file_read;
+	file_interface->file_seek = prompt_cache_file_seek;
+	file_interface->file_get_string = prompt_cache_file_get_string;
+
+	SWITCH_ADD_API(api_interface, "prompt_cache", "Decoded prompt cache", prompt_cache_function, PROMPT_CACHE_SYNTAX);
+	switch_console_set_complete("add prompt_cache stats");
+	switch_console_set_complete("add prompt_cache list");
+	switch_console_set_complete("add prompt_cache flush");
+
+	/* indicate that the module should continue to be loaded */
+	return SWITCH_STATUS_SUCCESS;
+}
+
+SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_prompt_cache_shutdown)
+{
+	cache_flush();
+	switch_core_hash_destroy(&globals.hash);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+/* For Emacs:
+ * Local Variables:
+ * mode:c
+ * indent-tabs-mode:t
+ * tab-width:4
+ * c-basic-offset:4
+ * End:
+ * For VIM:
+ * vim:set softtabstop=4 shiftwidth=4 tabstop=4:
+ */
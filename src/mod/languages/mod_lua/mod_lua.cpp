@@ -44,8 +44,27 @@ SWITCH_MODULE_DEFINITION_EX(mod_lua, mod_lua_load, mod_lua_shutdown, NULL, SMODF
 static struct {
 	switch_memory_pool_t *pool;
 	char *xml_handler;
+	switch_mutex_t *mutex;
+	switch_hash_t *chunk_hash;
+	switch_bool_t cache_chunks;
+	switch_queue_t *state_queue;
+	uint32_t state_pool_size;
+	switch_event_node_t *node;
+	uint32_t chunk_hits;
+	uint32_t chunk_misses;
+	switch_time_t compile_time;
+	uint32_t state_hits;
+	uint32_t state_misses;
 } globals;
 
+/* a compiled script kept as lua bytecode, keyed on the full path */
+typedef struct {
+	time_t mtime;
+	char *data;
+	size_t len;
+	size_t size;
+} lua_chunk_t;
+
 int luaopen_freeswitch(lua_State * L);
 int lua_thread(const char *text);
 
@@ -116,6 +135,263 @@ static lua_State *lua_init(void)
 	return L;
 }
 
+/* copy the table at idx and every table reachable from it, keyed on the table itself, along with its metatable */
+static void lua_snapshot_table(lua_State * L, int snaps, int metas, int idx)
+{
+	lua_pushvalue(L, idx);
+	lua_rawget(L, snaps);
+	if (!lua_isnil(L, -1)) {
+		lua_pop(L, 1);
+		return;
+	}
+	lua_pop(L, 1);
+
+	lua_checkstack(L, 8);
+
+	lua_pushvalue(L, idx);
+	if (!lua_getmetatable(L, idx)) {
+		lua_pushboolean(L, 0);
+	}
+	lua_rawset(L, metas);
+
+	/* register the copy before walking so cycles like _G._G stop here */
+	lua_newtable(L);
+	lua_pushvalue(L, idx);
+	lua_pushvalue(L, -2);
+	lua_rawset(L, snaps);
+
+	lua_pushnil(L);
+	while (lua_next(L, idx) != 0) {
+		lua_pushvalue(L, -2);
+		lua_pushvalue(L, -2);
+		lua_rawset(L, -5);
+		if (lua_type(L, -1) == LUA_TTABLE) {
+			lua_snapshot_table(L, snaps, metas, lua_gettop(L));
+		}
+		lua_pop(L, 1);
+	}
+
+	lua_pop(L, 1);
+}
+
+/* remember the initial globals, down through string, table, package.loaded and the rest,
+   so a pooled state can be put back the way we found it */
+static void lua_snapshot_globals(lua_State * L)
+{
+	lua_settop(L, 0);
+	lua_newtable(L);
+	lua_newtable(L);
+	lua_pushvalue(L, LUA_GLOBALSINDEX);
+	lua_snapshot_table(L, 1, 2, 3);
+	lua_pop(L, 1);
+	lua_setfield(L, LUA_REGISTRYINDEX, "mod_lua_pristine_meta");
+	lua_setfield(L, LUA_REGISTRYINDEX, "mod_lua_pristine");
+}
+
+static void lua_restore_globals(lua_State * L)
+{
+	lua_settop(L, 0);
+	lua_getfield(L, LUA_REGISTRYINDEX, "mod_lua_pristine");
+	lua_getfield(L, LUA_REGISTRYINDEX, "mod_lua_pristine_meta");
+
+	if (!lua_istable(L, 1) || !lua_istable(L, 2)) {
+		lua_settop(L, 0);
+		return;
+	}
+
+	lua_pushnil(L);
+	while (lua_next(L, 1) != 0) {
+		/* 3 = live table, 4 = its pristine copy */
+
+		/* drop anything the script added, the table is not grown while we walk it */
+		lua_pushnil(L);
+		while (lua_next(L, 3) != 0) {
+			lua_pop(L, 1);
+			lua_pushvalue(L, -1);
+			lua_rawget(L, 4);
+			if (lua_isnil(L, -1)) {
+				lua_pushvalue(L, -2);
+				lua_pushnil(L);
+				lua_rawset(L, 3);
+			}
+			lua_pop(L, 1);
+		}
+
+		/* and put back anything it replaced or removed */
+		lua_pushnil(L);
+		while (lua_next(L, 4) != 0) {
+			lua_pushvalue(L, -2);
+			lua_insert(L, -2);
+			lua_rawset(L, 3);
+		}
+
+		lua_pushvalue(L, 3);
+		lua_rawget(L, 2);
+		if (lua_istable(L, -1)) {
+			lua_setmetatable(L, 3);
+		} else {
+			lua_pop(L, 1);
+			lua_pushnil(L);
+			lua_setmetatable(L, 3);
+		}
+
+		lua_pop(L, 1);
+	}
+
+	lua_settop(L, 0);
+	lua_gc(L, LUA_GCCOLLECT, 0);
+}
+
+static lua_State *lua_get_state(void)
+{
+	lua_State *L;
+	void *pop = NULL;
+
+	if (globals.state_queue && switch_queue_trypop(globals.state_queue, &pop) == SWITCH_STATUS_SUCCESS && pop) {
+		switch_mutex_lock(globals.mutex);
+		globals.state_hits++;
+		switch_mutex_unlock(globals.mutex);
+		return (lua_State *) pop;
+	}
+
+	switch_mutex_lock(globals.mutex);
+	globals.state_misses++;
+	switch_mutex_unlock(globals.mutex);
+
+	if ((L = lua_init()) && globals.state_queue) {
+		lua_snapshot_globals(L);
+	}
+
+	return L;
+}
+
+static void lua_release_state(lua_State * L)
+{
+	if (globals.state_queue) {
+		lua_restore_globals(L);
+		if (switch_queue_trypush(globals.state_queue, L) == SWITCH_STATUS_SUCCESS) {
+			return;
+		}
+	}
+
+	lua_uninit(L);
+}
+
+static void lua_fill_state_pool(void)
+{
+	uint32_t x;
+
+	if (!globals.state_pool_size) {
+		return;
+	}
+
+	switch_queue_create(&globals.state_queue, globals.state_pool_size, globals.pool);
+
+	for (x = 0; x < globals.state_pool_size; x++) {
+		lua_State *L = lua_init();
+
+		if (!L) {
+			break;
+		}
+
+		lua_snapshot_globals(L);
+		if (switch_queue_trypush(globals.state_queue, L) != SWITCH_STATUS_SUCCESS) {
+			lua_uninit(L);
+			break;
+		}
+	}
+}
+
+static int chunk_writer(lua_State * L, const void *p, size_t sz, void *ud)
+{
+	lua_chunk_t *chunk = (lua_chunk_t *) ud;
+
+	if (chunk->len + sz > chunk->size) {
+		size_t size = (chunk->len + sz) * 2;
+		char *data = (char *) realloc(chunk->data, size);
+
+		if (!data) {
+			return 1;
+		}
+		chunk->data = data;
+		chunk->size = size;
+	}
+
+	memcpy(chunk->data + chunk->len, p, sz);
+	chunk->len += sz;
+
+	return 0;
+}
+
+static void lua_flush_chunks(void)
+{
+	switch_hash_index_t *hi;
+	void *val;
+
+	switch_mutex_lock(globals.mutex);
+	for (hi = switch_hash_first(NULL, globals.chunk_hash); hi; hi = switch_hash_next(hi)) {
+		lua_chunk_t *chunk;
+
+		switch_hash_this(hi, NULL, NULL, &val);
+		chunk = (lua_chunk_t *) val;
+		switch_safe_free(chunk->data);
+		free(chunk);
+	}
+	switch_core_hash_destroy(&globals.chunk_hash);
+	switch_core_hash_init(&globals.chunk_hash, NULL);
+	switch_mutex_unlock(globals.mutex);
+}
+
+/* luaL_loadfile() that keeps the compiled chunk around until the file changes */
+static int lua_load_file(lua_State * L, const char *file)
+{
+	lua_chunk_t *chunk, *new_chunk;
+	switch_time_t start;
+	struct stat st;
+	int error;
+
+	if (!globals.cache_chunks || stat(file, &st) < 0) {
+		return luaL_loadfile(L, file);
+	}
+
+	switch_mutex_lock(globals.mutex);
+	if ((chunk = (lua_chunk_t *) switch_core_hash_find(globals.chunk_hash, file)) && chunk->mtime == st.st_mtime) {
+		globals.chunk_hits++;
+		error = luaL_loadbuffer(L, chunk->data, chunk->len, file);
+		switch_mutex_unlock(globals.mutex);
+		return error;
+	}
+	globals.chunk_misses++;
+	switch_mutex_unlock(globals.mutex);
+
+	start = switch_micro_time_now();
+
+	if ((error = luaL_loadfile(L, file))) {
+		return error;
+	}
+
+	new_chunk = (lua_chunk_t *) calloc(1, sizeof(*new_chunk));
+	switch_assert(new_chunk);
+	new_chunk->mtime = st.st_mtime;
+
+	if (lua_dump(L, chunk_writer, new_chunk)) {
+		switch_safe_free(new_chunk->data);
+		free(new_chunk);
+		return 0;
+	}
+
+	switch_mutex_lock(globals.mutex);
+	globals.compile_time += switch_micro_time_now() - start;
+	if ((chunk = (lua_chunk_t *) switch_core_hash_find(globals.chunk_hash, file))) {
+		switch_safe_free(chunk->data);
+		free(chunk);
+	}
+	switch_core_hash_insert(globals.chunk_hash, file, new_chunk);
+	switch_mutex_unlock(globals.mutex);
+
+	return 0;
+}
+
 
 static int lua_parse_and_execute(lua_State * L, char *input_code)
 {
@@ -171,7 +447,7 @@ static int lua_parse_and_execute(lua_State * L, char *input_code)
 				switch_assert(fdup);
 				file = fdup;
 			}
-			error = luaL_loadfile(L, file) || docall(L, 0, 1);
+			error = lua_load_file(L, file) || docall(L, 0, 1);
 			switch_safe_free(fdup);
 		}
 	}
@@ -217,7 +493,7 @@ static switch_xml_t lua_fetch(const char *section,
 	switch_xml_t xml = NULL;
 
 	if (!zstr(globals.xml_handler)) {
-		lua_State *L = lua_init();
+		lua_State *L = lua_get_state();
 		char *mycmd = strdup(globals.xml_handler);
 		const char *str;
 		int error;
@@ -246,6 +522,8 @@ static switch_xml_t lua_fetch(const char *section,
 
 		if( error = lua_parse_and_execute(L, mycmd) ){
 		    switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "LUA script parse/execute error!\n");
+		    lua_release_state(L);
+		    free(mycmd);
 		    return NULL;
 		}
 
@@ -263,7 +541,7 @@ static switch_xml_t lua_fetch(const char *section,
 			}
 		}
 
-		lua_uninit(L);
+		lua_release_state(L);
 		free(mycmd);
 	}
 
@@ -290,7 +568,12 @@ static switch_status_t do_config(void)
 			char *var = (char *) switch_xml_attr_soft(param, "name");
 			char *val = (char *) switch_xml_attr_soft(param, "value");
 
-			if (!strcmp(var, "xml-handler-script")) {
+			if (!strcmp(var, "cache-compiled-scripts")) {
+				globals.cache_chunks = switch_true(val) ? SWITCH_TRUE : SWITCH_FALSE;
+			} else if (!strcmp(var, "state-pool-size")) {
+				int tmp = atoi(val);
+				globals.state_pool_size = tmp > 0 ? (uint32_t) tmp : 0;
+			} else if (!strcmp(var, "xml-handler-script")) {
 				globals.xml_handler = switch_core_strdup(globals.pool, val);
 			} else if (!strcmp(var, "xml-handler-bindings")) {
 				if (!zstr(globals.xml_handler)) {
@@ -389,7 +672,7 @@ int lua_thread(const char *text)
 
 SWITCH_STANDARD_APP(lua_function)
 {
-	lua_State *L = lua_init();
+	lua_State *L;
 	char *mycmd;
 
 	if (zstr(data)) {
@@ -397,13 +680,15 @@ SWITCH_STANDARD_APP(lua_function)
 		return;
 	}
 
+	L = lua_get_state();
+
 	mod_lua_conjure_session(L, session, "session", 1);
 
 	mycmd = strdup((char *) data);
 	switch_assert(mycmd);
 
 	lua_parse_and_execute(L, mycmd);
-	lua_uninit(L);
+	lua_release_state(L);
 	free(mycmd);
 
 }
@@ -425,13 +710,14 @@ SWITCH_STANDARD_API(luarun_api_function)
 SWITCH_STANDARD_API(lua_api_function)
 {
 
-	lua_State *L = lua_init();
+	lua_State *L;
 	char *mycmd;
 	int error;
 
 	if (zstr(cmd)) {
 		stream->write_function(stream, "");
 	} else {
+		L = lua_get_state();
 
 		mycmd = strdup(cmd);
 		switch_assert(mycmd);
@@ -453,7 +739,7 @@ SWITCH_STANDARD_API(lua_api_function)
 				stream->write_function(stream, "-ERR encounterd\n");
 			}
 		}
-		lua_uninit(L);
+		lua_release_state(L);
 		free(mycmd);
 	}
 	return SWITCH_STATUS_SUCCESS;
@@ -461,7 +747,7 @@ SWITCH_STANDARD_API(lua_api_function)
 
 SWITCH_STANDARD_DIALPLAN(lua_dialplan_hunt)
 {
-	lua_State *L = lua_init();
+	lua_State *L = lua_get_state();
 	switch_caller_extension_t *extension = NULL;
 	switch_channel_t *channel = switch_core_session_get_channel(session);
 	char *cmd = NULL;
@@ -573,10 +859,47 @@ SWITCH_STANDARD_DIALPLAN(lua_dialplan_hunt)
 
  done:
 	switch_safe_free(cmd);
-	lua_uninit(L);
+	lua_release_state(L);
 	return extension;
 }
 
+SWITCH_STANDARD_API(lua_cache_api_function)
+{
+	if (!zstr(cmd) && !strcasecmp(cmd, "flush")) {
+		lua_flush_chunks();
+		stream->write_function(stream, "+OK\n");
+	} else if (zstr(cmd) || !strcasecmp(cmd, "stats")) {
+		uint32_t count = 0;
+		switch_hash_index_t *hi;
+
+		switch_mutex_lock(globals.mutex);
+		for (hi = switch_hash_first(NULL, globals.chunk_hash); hi; hi = switch_hash_next(hi)) {
+			count++;
+		}
+		stream->write_function(stream, "compiled-cache: %s\n", globals.cache_chunks ? "enabled" : "disabled");
+		stream->write_function(stream, "cached-scripts: %u\n", count);
+		stream->write_function(stream, "cache-hits: %u\n", globals.chunk_hits);
+		stream->write_function(stream, "cache-misses: %u\n", globals.chunk_misses);
+		stream->write_function(stream, "compile-time-ms: %" SWITCH_INT64_T_FMT "\n", (int64_t) (globals.compile_time / 1000));
+		stream->write_function(stream, "state-pool-size: %u\n", globals.state_pool_size);
+		stream->write_function(stream, "state-pool-idle: %u\n", globals.state_queue ? switch_queue_size(globals.state_queue) : 0);
+		stream->write_function(stream, "state-pool-hits: %u\n", globals.state_hits);
+		stream->write_function(stream, "state-pool-misses: %u\n", globals.state_misses);
+		switch_mutex_unlock(globals.mutex);
+	} else {
+		stream->write_function(stream, "-USAGE: [stats|flush]\n");
+	}
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+static void event_handler(switch_event_t *event)
+{
+	if (event->event_id == SWITCH_EVENT_RELOADXML) {
+		lua_flush_chunks();
+	}
+}
+
 SWITCH_MODULE_LOAD_FUNCTION(mod_lua_load)
 {
 	switch_api_interface_t *api_interface;
@@ -588,13 +911,22 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_lua_load)
 
 	SWITCH_ADD_API(api_interface, "luarun", "run a script", luarun_api_function, "<script>");
 	SWITCH_ADD_API(api_interface, "lua", "run a script as an api function", lua_api_function, "<script>");
+	SWITCH_ADD_API(api_interface, "lua_cache", "show or flush the compiled lua script cache", lua_cache_api_function, "[stats|flush]");
 	SWITCH_ADD_APP(app_interface, "lua", "Launch LUA ivr", "Run a lua ivr on a channel", lua_function, "<script>", SAF_SUPPORT_NOMEDIA);
 	SWITCH_ADD_DIALPLAN(dp_interface, "LUA", lua_dialplan_hunt);
 
 
 
 	globals.pool = pool;
+	globals.cache_chunks = SWITCH_FALSE;
+	switch_mutex_init(&globals.mutex, SWITCH_MUTEX_NESTED, globals.pool);
+	switch_core_hash_init(&globals.chunk_hash, NULL);
 	do_config();
+	lua_fill_state_pool();
+
+	if ((switch_event_bind_removable(modname, SWITCH_EVENT_RELOADXML, NULL, event_handler, NULL, &globals.node) != SWITCH_STATUS_SUCCESS)) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Couldn't bind our reloadxml handler!\n");
+	}
 
 	/* indicate that the module should continue to be loaded */
 	return SWITCH_STATUS_NOUNLOAD;
@@ -602,6 +934,16 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_lua_load)
 
 SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_lua_shutdown)
 {
+	void *pop;
+
+	switch_event_unbind(&globals.node);
+
+	if (globals.state_queue) {
+		while (switch_queue_trypop(globals.state_queue, &pop) == SWITCH_STATUS_SUCCESS) {
+			lua_uninit((lua_State *) pop);
+		}
+	}
+
 	return SWITCH_STATUS_SUCCESS;
 }
 
@@ -0,0 +1,849 @@
+/*
+ * FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ * Copyright (C) 2005-2010, Anthony Minessale II <anthm@freeswitch.org>
+ *
+ * Version: MPL 1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ *
+ * The Initial Developer of the Original Code is
+ * Anthony Minessale II <anthm@freeswitch.org>
+ * Portions created by the Initial Developer are Copyright (C)
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ * Anthony Minessale II <anthm@freeswitch.org>
+ *
+ *
+ * switch_cdr_spool.c -- Durable spool for delivering CDR records
+ *
+ * Records are appended to journal segments named <name>.<seq>.journal in the spool
+ * directory, each record being a "<uuid> <leg> <len>\n" header followed by the data and
+ * a newline.  Delivered records are acknowledged by appending their header offset to the
+ * matching <name>.<seq>.done file, and a segment is removed once it has been rotated out
+ * and every record in it has been acknowledged.  Whatever is left in the directory when
+ * the spool is created is queued again so nothing is lost across a restart.
+ *
+ */
+
+#include <switch.h>
+
+#define SPOOL_SEGMENT_SIZE (4 * 1024 * 1024)
+#define SPOOL_HEADER_SIZE 256
+
+typedef struct spool_segment {
+	uint32_t seq;
+	char *path;
+	char *done_path;
+	switch_file_t *rfd;
+	switch_file_t *dfd;
+	/* records still waiting for delivery when the segment was opened or replayed */
+	uint32_t records;
+	uint32_t acked;
+	int sealed;
+	switch_memory_pool_t *pool;
+	struct spool_segment *next;
+} spool_segment_t;
+
+typedef struct spool_record {
+	spool_segment_t *seg;
+	switch_size_t offset;
+	switch_size_t data_offset;
+	switch_size_t len;
+	char leg;
+	char *uuid;
+	struct spool_record *next;
+} spool_record_t;
+
+struct switch_cdr_spool {
+	char *name;
+	char *dir;
+	switch_memory_pool_t *pool;
+	switch_mutex_t *mutex;
+	switch_thread_cond_t *cond;
+	/* oldest first, the last one is the segment currently written to */
+	spool_segment_t *segments;
+	spool_segment_t *current;
+	switch_file_t *wfd;
+	switch_size_t wpos;
+	uint32_t next_seq;
+	spool_record_t *head;
+	spool_record_t *tail;
+	uint32_t queued;
+	uint32_t batch;
+	uint32_t backoff_min;
+	uint32_t backoff_max;
+	uint32_t thread_count;
+	switch_thread_t **threads;
+	switch_cdr_spool_send_func_t send_func;
+	switch_cdr_spool_cleanup_func_t cleanup_func;
+	void *user_data;
+	int running;
+	uint64_t written;
+	uint64_t sent;
+	uint64_t failed;
+	uint64_t replayed;
+};
+
+static void spool_free_record(spool_record_t *rec)
+{
+	switch_safe_free(rec->uuid);
+	free(rec);
+}
+
+static spool_segment_t *spool_segment_open(switch_cdr_spool_t *spool, uint32_t seq)
+{
+	switch_memory_pool_t *pool = NULL;
+	spool_segment_t *seg;
+
+	if (switch_core_new_memory_pool(&pool) != SWITCH_STATUS_SUCCESS) {
+		return NULL;
+	}
+
+	seg = switch_core_alloc(pool, sizeof(*seg));
+	seg->pool = pool;
+	seg->seq = seq;
+	seg->path = switch_core_sprintf(pool, "%s%s%s.%u.journal", spool->dir, SWITCH_PATH_SEPARATOR, spool->name, seq);
+	seg->done_path = switch_core_sprintf(pool, "%s%s%s.%u.done", spool->dir, SWITCH_PATH_SEPARATOR, spool->name, seq);
+
+	if (switch_file_open(&seg->rfd, seg->path, SWITCH_FOPEN_READ | SWITCH_FOPEN_CREATE | SWITCH_FOPEN_BINARY,
+						 SWITCH_FPROT_UREAD | SWITCH_FPROT_UWRITE, pool) != SWITCH_STATUS_SUCCESS ||
+		switch_file_open(&seg->dfd, seg->done_path, SWITCH_FOPEN_WRITE | SWITCH_FOPEN_CREATE | SWITCH_FOPEN_APPEND | SWITCH_FOPEN_BINARY,
+						 SWITCH_FPROT_UREAD | SWITCH_FPROT_UWRITE, pool) != SWITCH_STATUS_SUCCESS) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Cannot open spool segment %s\n", seg->path);
+		if (seg->rfd) {
+			switch_file_close(seg->rfd);
+		}
+		switch_core_destroy_memory_pool(&pool);
+		return NULL;
+	}
+
+	return seg;
+}
+
+static void spool_segment_close(spool_segment_t *seg, switch_bool_t remove)
+{
+	switch_memory_pool_t *pool = seg->pool;
+
+	switch_file_close(seg->rfd);
+	switch_file_close(seg->dfd);
+
+	if (remove) {
+		switch_file_remove(seg->path, pool);
+		switch_file_remove(seg->done_path, pool);
+	}
+
+	switch_core_destroy_memory_pool(&pool);
+}
+
+static void spool_segment_append(switch_cdr_spool_t *spool, spool_segment_t *seg)
+{
+	spool_segment_t *sp;
+
+	if (!spool->segments) {
+		spool->segments = seg;
+		return;
+	}
+
+	for (sp = spool->segments; sp->next; sp = sp->next);
+	sp->next = seg;
+}
+
+/* must be called with the spool mutex held */
+static void spool_segment_reap(switch_cdr_spool_t *spool, spool_segment_t *seg)
+{
+	spool_segment_t *sp, *last = NULL;
+
+	if (!seg->sealed || seg->acked < seg->records) {
+		return;
+	}
+
+	for (sp = spool->segments; sp; sp = sp->next) {
+		if (sp == seg) {
+			if (last) {
+				last->next = sp->next;
+			} else {
+				spool->segments = sp->next;
+			}
+			break;
+		}
+		last = sp;
+	}
+
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Spool %s segment %u fully delivered, removing\n", spool->name, seg->seq);
+	spool_segment_close(seg, SWITCH_TRUE);
+}
+
+/* must be called with the spool mutex held */
+static switch_status_t spool_rotate(switch_cdr_spool_t *spool)
+{
+	spool_segment_t *seg, *old = spool->current;
+	switch_file_t *wfd = NULL;
+
+	if (!(seg = spool_segment_open(spool, spool->next_seq))) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	if (switch_file_open(&wfd, seg->path, SWITCH_FOPEN_WRITE | SWITCH_FOPEN_CREATE | SWITCH_FOPEN_APPEND | SWITCH_FOPEN_BINARY,
+						 SWITCH_FPROT_UREAD | SWITCH_FPROT_UWRITE, seg->pool) != SWITCH_STATUS_SUCCESS) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Cannot open spool segment %s for writing\n", seg->path);
+		spool_segment_close(seg, SWITCH_TRUE);
+		return SWITCH_STATUS_FALSE;
+	}
+
+	if (spool->wfd) {
+		switch_file_close(spool->wfd);
+	}
+
+	spool->next_seq++;
+	spool_segment_append(spool, seg);
+	spool->current = seg;
+	spool->wfd = wfd;
+	spool->wpos = 0;
+
+	if (old) {
+		old->sealed = 1;
+		spool_segment_reap(spool, old);
+	}
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+/* must be called with the spool mutex held */
+static void spool_enqueue(switch_cdr_spool_t *spool, spool_record_t *rec)
+{
+	rec->next = NULL;
+
+	if (spool->tail) {
+		spool->tail->next = rec;
+	} else {
+		spool->head = rec;
+	}
+
+	spool->tail = rec;
+	spool->queued++;
+}
+
+static int spool_cmp_offset(const void *a, const void *b)
+{
+	switch_size_t x = *(const switch_size_t *) a, y = *(const switch_size_t *) b;
+
+	return x < y ? -1 : x > y;
+}
+
+static char *spool_read_file(const char *path, switch_size_t *lenp, switch_memory_pool_t *pool)
+{
+	switch_file_t *fd = NULL;
+	switch_size_t len = 0, alloc = 0, bytes;
+	char *buf = NULL;
+
+	if (switch_file_open(&fd, path, SWITCH_FOPEN_READ | SWITCH_FOPEN_BINARY, SWITCH_FPROT_UREAD, pool) != SWITCH_STATUS_SUCCESS) {
+		return NULL;
+	}
+
+	for (;;) {
+		if (alloc - len < 4096) {
+			alloc = alloc ? alloc * 2 : 65536;
+			buf = realloc(buf, alloc + 1);
+			switch_assert(buf);
+		}
+
+		bytes = alloc - len;
+		if (switch_file_read(fd, buf + len, &bytes) != SWITCH_STATUS_SUCCESS || !bytes) {
+			break;
+		}
+		len += bytes;
+	}
+
+	switch_file_close(fd);
+
+	if (buf) {
+		buf[len] = '\0';
+	}
+
+	*lenp = len;
+	return buf;
+}
+
+static int spool_parse_header(const char *p, const char *end, char *uuid, switch_size_t uuid_len, char *leg, switch_size_t *len)
+{
+	const char *nl, *sp;
+	char num[32];
+
+	if (!(nl = memchr(p, '\n', end - p)) || nl - p >= SPOOL_HEADER_SIZE) {
+		return -1;
+	}
+
+	if (!(sp = memchr(p, ' ', nl - p)) || (switch_size_t) (sp - p) >= uuid_len || sp + 3 >= nl || sp[2] != ' ') {
+		return -1;
+	}
+
+	memcpy(uuid, p, sp - p);
+	uuid[sp - p] = '\0';
+	*leg = sp[1];
+
+	if ((switch_size_t) (nl - (sp + 3)) >= sizeof(num)) {
+		return -1;
+	}
+
+	memcpy(num, sp + 3, nl - (sp + 3));
+	num[nl - (sp + 3)] = '\0';
+	*len = (switch_size_t) strtoul(num, NULL, 10);
+
+	return (int) (nl - p) + 1;
+}
+
+/* queue every unacknowledged record of an existing segment, returns the number of records queued */
+static uint32_t spool_replay_segment(switch_cdr_spool_t *spool, spool_segment_t *seg)
+{
+	switch_size_t jlen = 0, dlen = 0, *done = NULL, done_count = 0, done_alloc = 0;
+	char *jbuf, *dbuf, *p, *end;
+	uint32_t count = 0;
+
+	if (!(jbuf = spool_read_file(seg->path, &jlen, seg->pool))) {
+		return 0;
+	}
+
+	if ((dbuf = spool_read_file(seg->done_path, &dlen, seg->pool))) {
+		for (p = dbuf; p && *p; p = strchr(p, '\n') ? strchr(p, '\n') + 1 : NULL) {
+			if (done_count == done_alloc) {
+				done_alloc = done_alloc ? done_alloc * 2 : 1024;
+				done = realloc(done, done_alloc * sizeof(*done));
+				switch_assert(done);
+			}
+			done[done_count++] = (switch_size_t) strtoul(p, NULL, 10);
+		}
+		free(dbuf);
+		qsort(done, done_count, sizeof(*done), spool_cmp_offset);
+	}
+
+	p = jbuf;
+	end = jbuf + jlen;
+
+	while (p < end) {
+		char uuid[SPOOL_HEADER_SIZE];
+		char leg;
+		switch_size_t len, offset = p - jbuf;
+		int hlen;
+
+		if ((hlen = spool_parse_header(p, end, uuid, sizeof(uuid), &leg, &len)) < 0 || p + hlen + len + 1 > end) {
+			/* a partial write from a crash, whatever follows cannot be trusted */
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Spool segment %s truncated at offset %" SWITCH_SIZE_T_FMT "\n",
+							  seg->path, offset);
+			break;
+		}
+
+		if (!done_count || !bsearch(&offset, done, done_count, sizeof(*done), spool_cmp_offset)) {
+			spool_record_t *rec = malloc(sizeof(*rec));
+
+			switch_assert(rec);
+			memset(rec, 0, sizeof(*rec));
+			rec->seg = seg;
+			rec->offset = offset;
+			rec->data_offset = offset + hlen;
+			rec->len = len;
+			rec->leg = leg;
+			rec->uuid = strdup(uuid);
+			spool_enqueue(spool, rec);
+			count++;
+		}
+
+		p += hlen + len + 1;
+	}
+
+	switch_safe_free(done);
+	free(jbuf);
+
+	return count;
+}
+
+static void spool_replay(switch_cdr_spool_t *spool)
+{
+	switch_dir_t *dir = NULL;
+	char buf[1024] = "";
+	const char *fname;
+	switch_size_t nlen = strlen(spool->name);
+	uint32_t *seqs = NULL, seq_count = 0, seq_alloc = 0, i, j;
+
+	if (switch_dir_open(&dir, spool->dir, spool->pool) != SWITCH_STATUS_SUCCESS) {
+		return;
+	}
+
+	while ((fname = switch_dir_next_file(dir, buf, sizeof(buf)))) {
+		const char *p;
+		char *e = NULL;
+		unsigned long seq;
+
+		if (strncmp(fname, spool->name, nlen) || fname[nlen] != '.') {
+			continue;
+		}
+
+		p = fname + nlen + 1;
+		seq = strtoul(p, &e, 10);
+
+		if (e == p || !e || strcmp(e, ".journal")) {
+			continue;
+		}
+
+		if (seq_count == seq_alloc) {
+			seq_alloc = seq_alloc ? seq_alloc * 2 : 16;
+			seqs = realloc(seqs, seq_alloc * sizeof(*seqs));
+			switch_assert(seqs);
+		}
+		seqs[seq_count++] = (uint32_t) seq;
+	}
+
+	switch_dir_close(dir);
+
+	/* replay in the order the records were written */
+	for (i = 1; i < seq_count; i++) {
+		uint32_t v = seqs[i];
+		for (j = i; j > 0 && seqs[j - 1] > v; j--) {
+			seqs[j] = seqs[j - 1];
+		}
+		seqs[j] = v;
+	}
+
+	for (i = 0; i < seq_count; i++) {
+		spool_segment_t *seg;
+
+		if (seqs[i] >= spool->next_seq) {
+			spool->next_seq = seqs[i] + 1;
+		}
+
+		if (!(seg = spool_segment_open(spool, seqs[i]))) {
+			continue;
+		}
+
+		seg->sealed = 1;
+
+		if (!(seg->records = spool_replay_segment(spool, seg))) {
+			spool_segment_close(seg, SWITCH_TRUE);
+			continue;
+		}
+
+		spool->replayed += seg->records;
+		spool_segment_append(spool, seg);
+	}
+
+	switch_safe_free(seqs);
+
+	if (spool->replayed) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "Spool %s replaying %" SWITCH_UINT64_T_FMT " undelivered record(s)\n",
+						  spool->name, spool->replayed);
+	}
+}
+
+static switch_status_t spool_read_record(switch_cdr_spool_t *spool, spool_record_t *rec, char **data)
+{
+	switch_status_t status = SWITCH_STATUS_FALSE;
+	int64_t offset = (int64_t) rec->data_offset;
+	switch_size_t bytes = rec->len, got = 0;
+	char *buf;
+
+	if (!(buf = malloc(rec->len + 1))) {
+		return SWITCH_STATUS_MEMERR;
+	}
+
+	switch_mutex_lock(spool->mutex);
+	if (switch_file_seek(rec->seg->rfd, SWITCH_SEEK_SET, &offset) == SWITCH_STATUS_SUCCESS) {
+		while (got < rec->len) {
+			bytes = rec->len - got;
+			if (switch_file_read(rec->seg->rfd, buf + got, &bytes) != SWITCH_STATUS_SUCCESS || !bytes) {
+				break;
+			}
+			got += bytes;
+		}
+		if (got == rec->len) {
+			status = SWITCH_STATUS_SUCCESS;
+		}
+	}
+	switch_mutex_unlock(spool->mutex);
+
+	if (status != SWITCH_STATUS_SUCCESS) {
+		free(buf);
+		return status;
+	}
+
+	buf[rec->len] = '\0';
+	*data = buf;
+
+	return status;
+}
+
+static void spool_ack(switch_cdr_spool_t *spool, spool_record_t *rec)
+{
+	char line[32];
+	switch_size_t len;
+	spool_segment_t *seg = rec->seg;
+
+	switch_snprintf(line, sizeof(line), "%" SWITCH_SIZE_T_FMT "\n", rec->offset);
+	len = strlen(line);
+
+	switch_mutex_lock(spool->mutex);
+	switch_file_write(seg->dfd, line, &len);
+	seg->acked++;
+	spool->sent++;
+	spool_segment_reap(spool, seg);
+	switch_mutex_unlock(spool->mutex);
+
+	spool_free_record(rec);
+}
+
+static void spool_sleep(switch_cdr_spool_t *spool, uint32_t ms)
+{
+	while (spool->running && ms) {
+		uint32_t step = ms > 100 ? 100 : ms;
+		switch_yield(step * 1000);
+		ms -= step;
+	}
+}
+
+static void *SWITCH_THREAD_FUNC spool_thread_run(switch_thread_t *thread, void *obj)
+{
+	switch_cdr_spool_t *spool = (switch_cdr_spool_t *) obj;
+	void *thread_data = NULL;
+	uint32_t backoff = 0;
+
+	while (spool->running) {
+		spool_record_t *batch = NULL, *last = NULL, *rec;
+		uint32_t n = 0;
+
+		switch_mutex_lock(spool->mutex);
+		if (!spool->head && spool->running) {
+			switch_thread_cond_timedwait(spool->cond, spool->mutex, 1000000);
+		}
+
+		while (spool->head && n < spool->batch) {
+			rec = spool->head;
+			spool->head = rec->next;
+			rec->next = NULL;
+			if (last) {
+				last->next = rec;
+			} else {
+				batch = rec;
+			}
+			last = rec;
+			spool->queued--;
+			n++;
+		}
+		if (!spool->head) {
+			spool->tail = NULL;
+		}
+		switch_mutex_unlock(spool->mutex);
+
+		while ((rec = batch)) {
+			char *data = NULL;
+			switch_status_t status;
+
+			if ((status = spool_read_record(spool, rec, &data)) != SWITCH_STATUS_SUCCESS) {
+				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Spool %s cannot read record %s from %s, dropping it\n",
+								  spool->name, rec->uuid, rec->seg->path);
+				batch = rec->next;
+				spool_ack(spool, rec);
+				continue;
+			}
+
+			status = spool->send_func(rec->uuid, rec->leg, data, rec->len, &thread_data, spool->user_data);
+			free(data);
+
+			if (status != SWITCH_STATUS_SUCCESS) {
+				break;
+			}
+
+			batch = rec->next;
+			spool_ack(spool, rec);
+			backoff = 0;
+		}
+
+		if (batch) {
+			/* put whatever was not delivered back in front of the queue and back off */
+			switch_mutex_lock(spool->mutex);
+			for (last = batch, n = 1; last->next; last = last->next, n++);
+			last->next = spool->head;
+			spool->head = batch;
+			if (!spool->tail) {
+				spool->tail = last;
+			}
+			spool->queued += n;
+			spool->failed++;
+			switch_mutex_unlock(spool->mutex);
+
+			backoff = backoff ? backoff * 2 : spool->backoff_min;
+			if (backoff > spool->backoff_max) {
+				backoff = spool->backoff_max;
+			}
+
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Spool %s delivery failed, %u record(s) pending, retrying in %ums\n",
+							  spool->name, spool->queued, backoff);
+			spool_sleep(spool, backoff);
+		}
+	}
+
+	if (thread_data && spool->cleanup_func) {
+		spool->cleanup_func(thread_data, spool->user_data);
+	}
+
+	return NULL;
+}
+
+SWITCH_DECLARE(switch_status_t) switch_cdr_spool_create(switch_cdr_spool_t **spoolp, const char *name, const char *dir,
+														uint32_t threads, uint32_t batch, uint32_t backoff_min, uint32_t backoff_max,
+														switch_cdr_spool_send_func_t send_func, switch_cdr_spool_cleanup_func_t cleanup_func,
+														void *user_data)
+{
+	switch_memory_pool_t *pool = NULL;
+	switch_cdr_spool_t *spool;
+	switch_threadattr_t *thd_attr = NULL;
+	uint32_t i;
+
+	switch_assert(spoolp);
+	switch_assert(send_func);
+
+	*spoolp = NULL;
+
+	if (zstr(name) || zstr(dir)) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	if (switch_core_new_memory_pool(&pool) != SWITCH_STATUS_SUCCESS) {
+		return SWITCH_STATUS_MEMERR;
+	}
+
+	spool = switch_core_alloc(pool, sizeof(*spool));
+	spool->pool = pool;
+	spool->name = switch_core_strdup(pool, name);
+	spool->dir = switch_core_strdup(pool, dir);
+	spool->thread_count = threads ? threads : 1;
+	spool->batch = batch ? batch : 1;
+	spool->backoff_min = backoff_min ? backoff_min : 1000;
+	spool->backoff_max = backoff_max > spool->backoff_min ? backoff_max : spool->backoff_min;
+	spool->send_func = send_func;
+	spool->cleanup_func = cleanup_func;
+	spool->user_data = user_data;
+	spool->next_seq = 1;
+
+	switch_mutex_init(&spool->mutex, SWITCH_MUTEX_NESTED, pool);
+	switch_thread_cond_create(&spool->cond, pool);
+
+	if (switch_directory_exists(spool->dir, pool) != SWITCH_STATUS_SUCCESS &&
+		switch_dir_make_recursive(spool->dir, SWITCH_DEFAULT_DIR_PERMS, pool) != SWITCH_STATUS_SUCCESS) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Cannot create spool dir %s\n", spool->dir);
+		switch_core_destroy_memory_pool(&pool);
+		return SWITCH_STATUS_FALSE;
+	}
+
+	spool_replay(spool);
+
+	if (spool_rotate(spool) != SWITCH_STATUS_SUCCESS) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Cannot start spool %s in %s\n", spool->name, spool->dir);
+		switch_cdr_spool_destroy(&spool);
+		return SWITCH_STATUS_FALSE;
+	}
+
+	spool->running = 1;
+	spool->threads = switch_core_alloc(pool, sizeof(switch_thread_t *) * spool->thread_count);
+
+	switch_threadattr_create(&thd_attr, pool);
+	switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+
+	for (i = 0; i < spool->thread_count; i++) {
+		switch_thread_create(&spool->threads[i], thd_attr, spool_thread_run, spool, pool);
+	}
+
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "Spool %s started in %s with %u sender thread(s)\n",
+					  spool->name, spool->dir, spool->thread_count);
+
+	*spoolp = spool;
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+SWITCH_DECLARE(switch_status_t) switch_cdr_spool_write(switch_cdr_spool_t *spool, const char *uuid, char leg, const char *data, switch_size_t len)
+{
+	char header[SPOOL_HEADER_SIZE];
+	switch_size_t hlen, bytes;
+	spool_record_t *rec;
+	switch_status_t status = SWITCH_STATUS_FALSE;
+
+	if (!spool || zstr(uuid) || !data) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	if (strchr(uuid, ' ') || strchr(uuid, '\n')) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	switch_snprintf(header, sizeof(header), "%s %c %" SWITCH_SIZE_T_FMT "\n", uuid, leg ? leg : '-', len);
+	hlen = strlen(header);
+
+	if (hlen >= sizeof(header) - 1) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	rec = malloc(sizeof(*rec));
+	switch_assert(rec);
+	memset(rec, 0, sizeof(*rec));
+	rec->uuid = strdup(uuid);
+	rec->leg = leg ? leg : '-';
+	rec->len = len;
+
+	switch_mutex_lock(spool->mutex);
+
+	if (!spool->running) {
+		goto end;
+	}
+
+	if (spool->wpos >= SPOOL_SEGMENT_SIZE && spool_rotate(spool) != SWITCH_STATUS_SUCCESS) {
+		goto end;
+	}
+
+	rec->seg = spool->current;
+	rec->offset = spool->wpos;
+	rec->data_offset = spool->wpos + hlen;
+
+	bytes = hlen;
+	if (switch_file_write(spool->wfd, header, &bytes) != SWITCH_STATUS_SUCCESS || bytes != hlen) {
+		goto fail;
+	}
+	spool->wpos += bytes;
+
+	bytes = len;
+	if (len && (switch_file_write(spool->wfd, data, &bytes) != SWITCH_STATUS_SUCCESS || bytes != len)) {
+		goto fail;
+	}
+	spool->wpos += bytes;
+
+	bytes = 1;
+	if (switch_file_write(spool->wfd, "\n", &bytes) != SWITCH_STATUS_SUCCESS || bytes != 1) {
+		goto fail;
+	}
+	spool->wpos += bytes;
+
+	spool->current->records++;
+	spool->written++;
+	spool_enqueue(spool, rec);
+	rec = NULL;
+	switch_thread_cond_signal(spool->cond);
+	status = SWITCH_STATUS_SUCCESS;
+	goto end;
+
+  fail:
+	/* the segment now ends with a partial record, start a new one so the next write is readable */
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Error writing to spool segment %s\n", spool->current->path);
+	spool_rotate(spool);
+
+  end:
+	switch_mutex_unlock(spool->mutex);
+
+	if (rec) {
+		spool_free_record(rec);
+	}
+
+	return status;
+}
+
+SWITCH_DECLARE(void) switch_cdr_spool_status(switch_cdr_spool_t *spool, switch_stream_handle_t *stream)
+{
+	spool_segment_t *seg;
+	uint32_t segments = 0;
+
+	if (!spool) {
+		return;
+	}
+
+	switch_mutex_lock(spool->mutex);
+	for (seg = spool->segments; seg; seg = seg->next) {
+		segments++;
+	}
+
+	stream->write_function(stream, "spool:      %s\n", spool->name);
+	stream->write_function(stream, "directory:  %s\n", spool->dir);
+	stream->write_function(stream, "threads:    %u\n", spool->thread_count);
+	stream->write_function(stream, "segments:   %u\n", segments);
+	stream->write_function(stream, "queued:     %u\n", spool->queued);
+	stream->write_function(stream, "written:    %" SWITCH_UINT64_T_FMT "\n", spool->written);
+	stream->write_function(stream, "replayed:   %" SWITCH_UINT64_T_FMT "\n", spool->replayed);
+	stream->write_function(stream, "delivered:  %" SWITCH_UINT64_T_FMT "\n", spool->sent);
+	stream->write_function(stream, "failures:   %" SWITCH_UINT64_T_FMT "\n", spool->failed);
+	switch_mutex_unlock(spool->mutex);
+}
+
+SWITCH_DECLARE(void) switch_cdr_spool_destroy(switch_cdr_spool_t **spoolp)
+{
+	switch_cdr_spool_t *spool;
+	switch_memory_pool_t *pool;
+	spool_record_t *rec;
+	spool_segment_t *seg;
+	switch_status_t st;
+	uint32_t i;
+
+	if (!spoolp || !(spool = *spoolp)) {
+		return;
+	}
+
+	*spoolp = NULL;
+
+	switch_mutex_lock(spool->mutex);
+	spool->running = 0;
+	switch_thread_cond_broadcast(spool->cond);
+	switch_mutex_unlock(spool->mutex);
+
+	if (spool->threads) {
+		for (i = 0; i < spool->thread_count; i++) {
+			if (spool->threads[i]) {
+				switch_thread_join(&st, spool->threads[i]);
+			}
+		}
+	}
+
+	if (spool->queued) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "Spool %s stopped with %u undelivered record(s) kept in %s\n",
+						  spool->name, spool->queued, spool->dir);
+	}
+
+	if (spool->wfd) {
+		switch_file_close(spool->wfd);
+		spool->wfd = NULL;
+	}
+
+	if (spool->current) {
+		spool->current->sealed = 1;
+	}
+
+	/* undelivered records stay in the journal and are replayed by the next spool */
+	while ((rec = spool->head)) {
+		spool->head = rec->next;
+		spool_free_record(rec);
+	}
+
+	while ((seg = spool->segments)) {
+		spool->segments = seg->next;
+		spool_segment_close(seg, seg->acked >= seg->records ? SWITCH_TRUE : SWITCH_FALSE);
+	}
+
+	pool = spool->pool;
+	switch_core_destroy_memory_pool(&pool);
+}
+
+/* For Emacs:
+ * Local Variables:
+ * mode:c
+ * indent-tabs-mode:t
+ * tab-width:4
+ * c-basic-offset:4
+ * End:
+ * For VIM:
+ * vim:set softtabstop=4 shiftwidth=4 tabstop=4:
+ */
@@ -110,6 +110,17 @@ typedef enum {
 	OCF_HANGUP = (1 << 0)
 } opaque_channel_flag_t;
 
+#define CHANNEL_MAX_WAITERS 8
+
+struct switch_channel_waiter {
+	switch_memory_pool_t *pool;
+	switch_mutex_t *mutex;
+	switch_thread_cond_t *cond;
+	uint32_t refs;
+	uint32_t seq;
+	uint32_t seen;
+};
+
 struct switch_channel {
 	char *name;
 	switch_call_direction_t direction;
@@ -138,6 +149,9 @@ struct switch_channel {
 	int event_count;
 	int profile_index;
 	opaque_channel_flag_t opaque_flags;
+	/* signalled on every state or flag change, guarded by flag_mutex */
+	switch_channel_waiter_t *waiters[CHANNEL_MAX_WAITERS];
+	int waiter_count;
 };
 
 
@@ -539,6 +553,12 @@ SWITCH_DECLARE(void) switch_channel_uninit(switch_channel_t *channel)
 	switch_mutex_lock(channel->profile_mutex);
 	switch_event_destroy(&channel->variables);
 	switch_mutex_unlock(channel->profile_mutex);
+
+	switch_mutex_lock(channel->flag_mutex);
+	while (channel->waiter_count > 0) {
+		switch_channel_waiter_release(&channel->waiters[--channel->waiter_count]);
+	}
+	switch_mutex_unlock(channel->flag_mutex);
 }
 
 SWITCH_DECLARE(switch_status_t) switch_channel_init(switch_channel_t *channel, switch_core_session_t *session, switch_channel_state_t state,
@@ -1066,6 +1086,165 @@ SWITCH_DECLARE(switch_bool_t) switch_channel_clear_flag_partner(switch_channel_t
 	return SWITCH_FALSE;
 }
 
+SWITCH_DECLARE(switch_status_t) switch_channel_waiter_create(switch_channel_waiter_t **waiter)
+{
+	switch_memory_pool_t *pool = NULL;
+	switch_channel_waiter_t *wp;
+
+	switch_assert(waiter);
+
+	if (switch_core_new_memory_pool(&pool) != SWITCH_STATUS_SUCCESS) {
+		*waiter = NULL;
+		return SWITCH_STATUS_MEMERR;
+	}
+
+	wp = switch_core_alloc(pool, sizeof(*wp));
+	wp->pool = pool;
+	wp->refs = 1;
+	switch_mutex_init(&wp->mutex, SWITCH_MUTEX_NESTED, pool);
+	switch_thread_cond_create(&wp->cond, pool);
+
+	*waiter = wp;
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+static void channel_waiter_ref(switch_channel_waiter_t *waiter)
+{
+	switch_mutex_lock(waiter->mutex);
+	waiter->refs++;
+	switch_mutex_unlock(waiter->mutex);
+}
+
+SWITCH_DECLARE(void) switch_channel_waiter_release(switch_channel_waiter_t **waiter)
+{
+	switch_channel_waiter_t *wp;
+	switch_memory_pool_t *pool;
+	uint32_t refs;
+
+	if (!waiter || !(wp = *waiter)) {
+		return;
+	}
+
+	*waiter = NULL;
+
+	switch_mutex_lock(wp->mutex);
+	refs = --wp->refs;
+	switch_mutex_unlock(wp->mutex);
+
+	if (!refs) {
+		pool = wp->pool;
+		switch_core_destroy_memory_pool(&pool);
+	}
+}
+
+SWITCH_DECLARE(void) switch_channel_waiter_signal(switch_channel_waiter_t *waiter)
+{
+	switch_mutex_lock(waiter->mutex);
+	waiter->seq++;
+	switch_thread_cond_signal(waiter->cond);
+	switch_mutex_unlock(waiter->mutex);
+}
+
+SWITCH_DECLARE(switch_status_t) switch_channel_waiter_wait(switch_channel_waiter_t *waiter, uint32_t ms)
+{
+	switch_status_t status = SWITCH_STATUS_SUCCESS;
+
+	if (!waiter) {
+		switch_cond_next();
+		return SWITCH_STATUS_TIMEOUT;
+	}
+
+	switch_mutex_lock(waiter->mutex);
+	if (waiter->seen == waiter->seq) {
+		switch_thread_cond_timedwait(waiter->cond, waiter->mutex, (switch_interval_time_t) ms * 1000);
+	}
+	if (waiter->seen == waiter->seq) {
+		status = SWITCH_STATUS_TIMEOUT;
+	}
+	waiter->seen = waiter->seq;
+	switch_mutex_unlock(waiter->mutex);
+
+	return status;
+}
+
+SWITCH_DECLARE(switch_status_t) switch_channel_attach_waiter(switch_channel_t *channel, switch_channel_waiter_t *waiter)
+{
+	switch_status_t status = SWITCH_STATUS_FALSE;
+	int i;
+
+	switch_assert(channel);
+
+	if (!waiter) {
+		return status;
+	}
+
+	switch_mutex_lock(channel->flag_mutex);
+	for (i = 0; i < channel->waiter_count; i++) {
+		if (channel->waiters[i] == waiter) {
+			status = SWITCH_STATUS_SUCCESS;
+			goto end;
+		}
+	}
+
+	if (channel->waiter_count < CHANNEL_MAX_WAITERS) {
+		channel_waiter_ref(waiter);
+		channel->waiters[channel->waiter_count++] = waiter;
+		status = SWITCH_STATUS_SUCCESS;
+	}
+
+  end:
+	switch_mutex_unlock(channel->flag_mutex);
+
+	return status;
+}
+
+SWITCH_DECLARE(void) switch_channel_detach_waiter(switch_channel_t *channel, switch_channel_waiter_t *waiter)
+{
+	switch_channel_waiter_t *wp = NULL;
+	int i;
+
+	switch_assert(channel);
+
+	if (!waiter) {
+		return;
+	}
+
+	switch_mutex_lock(channel->flag_mutex);
+	for (i = 0; i < channel->waiter_count; i++) {
+		if (channel->waiters[i] == waiter) {
+			wp = waiter;
+			channel->waiters[i] = channel->waiters[--channel->waiter_count];
+			channel->waiters[channel->waiter_count] = NULL;
+			break;
+		}
+	}
+	switch_mutex_unlock(channel->flag_mutex);
+
+	switch_channel_waiter_release(&wp);
+}
+
+/* must be called with flag_mutex held */
+static void channel_signal_waiters(switch_channel_t *channel)
+{
+	int i;
+
+	for (i = 0; i < channel->waiter_count; i++) {
+		switch_channel_waiter_signal(channel->waiters[i]);
+	}
+}
+
+static void channel_notify_waiters(switch_channel_t *channel)
+{
+	if (!channel->waiter_count) {
+		return;
+	}
+
+	switch_mutex_lock(channel->flag_mutex);
+	channel_signal_waiters(channel);
+	switch_mutex_unlock(channel->flag_mutex);
+}
+
 SWITCH_DECLARE(void) switch_channel_wait_for_state(switch_channel_t *channel, switch_channel_t *other_channel, switch_channel_state_t want_state)
 {
 	switch_channel_state_t state, mystate, ostate;
@@ -1226,6 +1405,7 @@ SWITCH_DECLARE(void) switch_channel_set_flag_value(switch_channel_t *channel, sw
 
 	switch_mutex_lock(channel->flag_mutex);
 	channel->flags[flag] = value;
+	channel_signal_waiters(channel);
 	switch_mutex_unlock(channel->flag_mutex);
 
 	if (flag == CF_OUTBOUND) {
@@ -1246,6 +1426,7 @@ SWITCH_DECLARE(void) switch_channel_set_flag_recursive(switch_channel_t *channel
 
 	switch_mutex_lock(channel->flag_mutex);
 	channel->flags[flag]++;
+	channel_signal_waiters(channel);
 	switch_mutex_unlock(channel->flag_mutex);
 
 	if (flag == CF_OUTBOUND) {
@@ -1319,6 +1500,7 @@ SWITCH_DECLARE(void) switch_channel_clear_flag(switch_channel_t *channel, switch
 
 	switch_mutex_lock(channel->flag_mutex);
 	channel->flags[flag] = 0;
+	channel_signal_waiters(channel);
 	switch_mutex_unlock(channel->flag_mutex);
 
 	if (flag == CF_OUTBOUND) {
@@ -1340,6 +1522,7 @@ SWITCH_DECLARE(void) switch_channel_clear_flag_recursive(switch_channel_t *chann
 	if (channel->flags[flag]) {
 		channel->flags[flag]--;
 	}
+	channel_signal_waiters(channel);
 	switch_mutex_unlock(channel->flag_mutex);
 
 	if (flag == CF_OUTBOUND) {
@@ -1502,6 +1685,8 @@ SWITCH_DECLARE(switch_channel_state_t) switch_channel_perform_set_running_state(
 
 	switch_mutex_unlock(channel->state_mutex);
 
+	channel_notify_waiters(channel);
+
 	return SWITCH_STATUS_SUCCESS;
 }
 
@@ -1723,6 +1908,11 @@ SWITCH_DECLARE(switch_channel_state_t) switch_channel_perform_set_state(switch_c
   done:
 
 	switch_mutex_unlock(channel->state_mutex);
+
+	if (ok) {
+		channel_notify_waiters(channel);
+	}
+
 	return channel->state;
 }
 
@@ -2249,6 +2439,8 @@ SWITCH_DECLARE(switch_channel_state_t) switch_channel_perform_hangup(switch_chan
 		channel->state = CS_HANGUP;
 		switch_mutex_unlock(channel->state_mutex);
 
+		channel_notify_waiters(channel);
+
 
 		if (hangup_cause == SWITCH_CAUSE_LOSE_RACE) {
 			switch_channel_set_variable(channel, "presence_call_info", NULL);
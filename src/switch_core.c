@@ -896,21 +896,52 @@ typedef struct {
 	switch_hash_t *hash;
 } switch_ip_list_t;
 
+/* readers only hold IP_LIST_RWLOCK long enough to look up and match, a reload builds the
+   replacement lists off to the side and swaps them in under the write lock */
 static switch_ip_list_t IP_LIST = { 0 };
+static switch_thread_rwlock_t *IP_LIST_RWLOCK = NULL;
+
+static switch_bool_t check_cidr_ip(const char *cidr, switch_bool_t v6, uint32_t ip, const uint8_t *ip6)
+{
+	uint32_t net = 0, mask = 0, bits = 0;
+	uint8_t net6[16];
+
+	if (strchr(cidr, ':')) {
+		return v6 && !switch_parse_cidr6(cidr, net6, &bits) && switch_test_subnet6(ip6, net6, bits);
+	}
+
+	if (v6) {
+		return SWITCH_FALSE;
+	}
+
+	switch_parse_cidr(cidr, &net, &mask, &bits);
+
+	return switch_test_subnet(ip, net, mask);
+}
 
 SWITCH_DECLARE(switch_bool_t) switch_check_network_list_ip_token(const char *ip_str, const char *list_name, const char **token)
 {
 	switch_network_list_t *list;
-	uint32_t ip, net, mask, bits;
-	switch_bool_t ok = SWITCH_FALSE;
+	uint32_t ip = 0;
+	uint8_t ip6[16] = { 0 };
+	switch_bool_t ok = SWITCH_FALSE, v6 = SWITCH_FALSE;
 
-	switch_mutex_lock(runtime.global_mutex);
-	switch_inet_pton(AF_INET, ip_str, &ip);
+	if (strchr(ip_str, ':')) {
+		v6 = SWITCH_TRUE;
+		switch_inet_pton(AF_INET6, ip_str, ip6);
+	} else {
+		switch_inet_pton(AF_INET, ip_str, &ip);
+		ip = htonl(ip);
+	}
 
-	ip = htonl(ip);
+	switch_thread_rwlock_rdlock(IP_LIST_RWLOCK);
 
-	if ((list = switch_core_hash_find(IP_LIST.hash, list_name))) {
-		ok = switch_network_list_validate_ip_token(list, ip, token);
+	if (IP_LIST.hash && (list = switch_core_hash_find(IP_LIST.hash, list_name))) {
+		if (v6) {
+			ok = switch_network_list_validate_ip6_token(list, ip6, token);
+		} else {
+			ok = switch_network_list_validate_ip_token(list, ip, token);
+		}
 	} else if (strchr(list_name, '/')) {
 		if (strchr(list_name, ',')) {
 			char *list_name_dup = strdup(list_name);
@@ -922,19 +953,18 @@ SWITCH_DECLARE(switch_bool_t) switch_check_network_list_ip_token(const char *ip_
 			if ((argc = switch_separate_string(list_name_dup, ',', argv, (sizeof(argv) / sizeof(argv[0]))))) {
 				int i;
 				for (i = 0; i < argc; i++) {
-					switch_parse_cidr(argv[i], &net, &mask, &bits);
-					if ((ok = switch_test_subnet(ip, net, mask))) {
+					if ((ok = check_cidr_ip(argv[i], v6, ip, ip6))) {
 						break;
 					}
 				}
 			}
 			free(list_name_dup);
 		} else {
-			switch_parse_cidr(list_name, &net, &mask, &bits);
-			ok = switch_test_subnet(ip, net, mask);
+			ok = check_cidr_ip(list_name, v6, ip, ip6);
 		}
 	}
-	switch_mutex_unlock(runtime.global_mutex);
+
+	switch_thread_rwlock_unlock(IP_LIST_RWLOCK);
 
 	return ok;
 }
@@ -944,6 +974,7 @@ SWITCH_DECLARE(void) switch_load_network_lists(switch_bool_t reload)
 {
 	switch_xml_t xml = NULL, x_lists = NULL, x_list = NULL, x_node = NULL, cfg = NULL;
 	switch_network_list_t *rfc_list, *list;
+	switch_ip_list_t new_list = { 0 }, old_list;
 	char guess_ip[16] = "";
 	int mask = 0;
 	char guess_mask[16] = "";
@@ -954,39 +985,31 @@ SWITCH_DECLARE(void) switch_load_network_lists(switch_bool_t reload)
 	in.s_addr = mask;
 	switch_set_string(guess_mask, inet_ntoa(in));
 
+	/* serializes reloads only, lookups keep running against the current lists until the swap */
 	switch_mutex_lock(runtime.global_mutex);
 
-	if (IP_LIST.hash) {
-		switch_core_hash_destroy(&IP_LIST.hash);
-	}
-
-	if (IP_LIST.pool) {
-		switch_core_destroy_memory_pool(&IP_LIST.pool);
-	}
-
-	memset(&IP_LIST, 0, sizeof(IP_LIST));
-	switch_core_new_memory_pool(&IP_LIST.pool);
-	switch_core_hash_init(&IP_LIST.hash, IP_LIST.pool);
+	switch_core_new_memory_pool(&new_list.pool);
+	switch_core_hash_init(&new_list.hash, new_list.pool);
 
 
 	tmp_name = "rfc1918.auto";
-	switch_network_list_create(&rfc_list, tmp_name, SWITCH_FALSE, IP_LIST.pool);
+	switch_network_list_create(&rfc_list, tmp_name, SWITCH_FALSE, new_list.pool);
 	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "Created ip list %s default (deny)\n", tmp_name);
 	switch_network_list_add_cidr(rfc_list, "10.0.0.0/8", SWITCH_TRUE);
 	switch_network_list_add_cidr(rfc_list, "172.16.0.0/12", SWITCH_TRUE);
 	switch_network_list_add_cidr(rfc_list, "192.168.0.0/16", SWITCH_TRUE);
-	switch_core_hash_insert(IP_LIST.hash, tmp_name, rfc_list);
+	switch_core_hash_insert(new_list.hash, tmp_name, rfc_list);
 
 	tmp_name = "wan.auto";
-	switch_network_list_create(&rfc_list, tmp_name, SWITCH_TRUE, IP_LIST.pool);
+	switch_network_list_create(&rfc_list, tmp_name, SWITCH_TRUE, new_list.pool);
 	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "Created ip list %s default (allow)\n", tmp_name);
 	switch_network_list_add_cidr(rfc_list, "10.0.0.0/8", SWITCH_FALSE);
 	switch_network_list_add_cidr(rfc_list, "172.16.0.0/12", SWITCH_FALSE);
 	switch_network_list_add_cidr(rfc_list, "192.168.0.0/16", SWITCH_FALSE);
-	switch_core_hash_insert(IP_LIST.hash, tmp_name, rfc_list);
+	switch_core_hash_insert(new_list.hash, tmp_name, rfc_list);
 
 	tmp_name = "nat.auto";
-	switch_network_list_create(&rfc_list, tmp_name, SWITCH_FALSE, IP_LIST.pool);
+	switch_network_list_create(&rfc_list, tmp_name, SWITCH_FALSE, new_list.pool);
 	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "Created ip list %s default (deny)\n", tmp_name);
 	if (switch_network_list_add_host_mask(rfc_list, guess_ip, guess_mask, SWITCH_FALSE) == SWITCH_STATUS_SUCCESS) {
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "Adding %s/%s (deny) to list %s\n", guess_ip, guess_mask, tmp_name);
@@ -994,22 +1017,23 @@ SWITCH_DECLARE(void) switch_load_network_lists(switch_bool_t reload)
 	switch_network_list_add_cidr(rfc_list, "10.0.0.0/8", SWITCH_TRUE);
 	switch_network_list_add_cidr(rfc_list, "172.16.0.0/12", SWITCH_TRUE);
 	switch_network_list_add_cidr(rfc_list, "192.168.0.0/16", SWITCH_TRUE);
-	switch_core_hash_insert(IP_LIST.hash, tmp_name, rfc_list);
+	switch_core_hash_insert(new_list.hash, tmp_name, rfc_list);
 
 	tmp_name = "loopback.auto";
-	switch_network_list_create(&rfc_list, tmp_name, SWITCH_FALSE, IP_LIST.pool);
+	switch_network_list_create(&rfc_list, tmp_name, SWITCH_FALSE, new_list.pool);
 	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "Created ip list %s default (deny)\n", tmp_name);
 	switch_network_list_add_cidr(rfc_list, "127.0.0.0/8", SWITCH_TRUE);
-	switch_core_hash_insert(IP_LIST.hash, tmp_name, rfc_list);
+	switch_network_list_add_cidr(rfc_list, "::1/128", SWITCH_TRUE);
+	switch_core_hash_insert(new_list.hash, tmp_name, rfc_list);
 
 	tmp_name = "localnet.auto";
-	switch_network_list_create(&list, tmp_name, SWITCH_FALSE, IP_LIST.pool);
+	switch_network_list_create(&list, tmp_name, SWITCH_FALSE, new_list.pool);
 	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "Created ip list %s default (deny)\n", tmp_name);
 
 	if (switch_network_list_add_host_mask(list, guess_ip, guess_mask, SWITCH_TRUE) == SWITCH_STATUS_SUCCESS) {
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "Adding %s/%s (allow) to list %s\n", guess_ip, guess_mask, tmp_name);
 	}
-	switch_core_hash_insert(IP_LIST.hash, tmp_name, list);
+	switch_core_hash_insert(new_list.hash, tmp_name, list);
 
 
 	if ((xml = switch_xml_open_cfg("acl.conf", &cfg, NULL))) {
@@ -1027,7 +1051,7 @@ SWITCH_DECLARE(void) switch_load_network_lists(switch_bool_t reload)
 					default_type = switch_true(dft);
 				}
 
-				if (switch_network_list_create(&list, name, default_type, IP_LIST.pool) != SWITCH_STATUS_SUCCESS) {
+				if (switch_network_list_create(&list, name, default_type, new_list.pool) != SWITCH_STATUS_SUCCESS) {
 					abort();
 				}
 
@@ -1115,7 +1139,7 @@ SWITCH_DECLARE(void) switch_load_network_lists(switch_bool_t reload)
 						}
 					}
 
-					switch_core_hash_insert(IP_LIST.hash, name, list);
+					switch_core_hash_insert(new_list.hash, name, list);
 				}
 			}
 		}
@@ -1123,6 +1147,19 @@ SWITCH_DECLARE(void) switch_load_network_lists(switch_bool_t reload)
 		switch_xml_free(xml);
 	}
 
+	switch_thread_rwlock_wrlock(IP_LIST_RWLOCK);
+	old_list = IP_LIST;
+	IP_LIST = new_list;
+	switch_thread_rwlock_unlock(IP_LIST_RWLOCK);
+
+	if (old_list.hash) {
+		switch_core_hash_destroy(&old_list.hash);
+	}
+
+	if (old_list.pool) {
+		switch_core_destroy_memory_pool(&old_list.pool);
+	}
+
 	switch_mutex_unlock(runtime.global_mutex);
 }
 
@@ -1267,8 +1304,11 @@ SWITCH_DECLARE(switch_status_t) switch_core_init(switch_core_flag_t flags, switc
 	switch_mutex_init(&runtime.session_hash_mutex, SWITCH_MUTEX_NESTED, runtime.memory_pool);
 	switch_mutex_init(&runtime.global_mutex, SWITCH_MUTEX_NESTED, runtime.memory_pool);
 	switch_mutex_init(&runtime.global_var_mutex, SWITCH_MUTEX_NESTED, runtime.memory_pool);
+	switch_thread_rwlock_create(&IP_LIST_RWLOCK, runtime.memory_pool);
 	switch_core_set_globals();
 	switch_core_session_init(runtime.memory_pool);
+	switch_core_codec_pool_init(runtime.memory_pool);
+	switch_core_frame_init(runtime.memory_pool);
 	switch_event_create_plain(&runtime.global_vars, SWITCH_EVENT_CHANNEL_DATA);
 	switch_core_hash_init(&runtime.mime_types, runtime.memory_pool);
 	load_mime_types();
@@ -1298,6 +1338,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_init(switch_core_flag_t flags, switc
 	switch_core_set_variable("sounds_dir", SWITCH_GLOBAL_dirs.sounds_dir);
 	switch_core_set_serial();
 
+	switch_core_profile_init(runtime.memory_pool);
 	switch_console_init(runtime.memory_pool);
 	switch_event_init(runtime.memory_pool);
 
@@ -1314,8 +1355,21 @@ SWITCH_DECLARE(switch_status_t) switch_core_init(switch_core_flag_t flags, switc
 
 	runtime.tipping_point = 5000;
 	runtime.timer_affinity = -1;
+	runtime.transcode_affinity = -1;
+	runtime.db_pool_max = 64;
+	runtime.db_pool_wait = 5000;
+	runtime.db_pool_health_interval = 30;
+	runtime.rtp_pool_min = 2;
+	runtime.rtp_pool_max = 64;
+	runtime.rtp_pool_lead = 500;
+	runtime.memory_arenas = 16;
+	runtime.memory_arena_max_free = 2048;
+	runtime.latency_event_interval = 60;
 	switch_load_core_config("switch.conf");
 
+	switch_core_memory_arena_init();
+
+	switch_core_transcode_init(runtime.memory_pool);
 
 	switch_core_state_machine_init(runtime.memory_pool);
 
@@ -1325,12 +1379,14 @@ SWITCH_DECLARE(switch_status_t) switch_core_init(switch_core_flag_t flags, switc
 
 	switch_scheduler_task_thread_start();
 
+	switch_rtp_set_socket_pool(runtime.rtp_pool_min, runtime.rtp_pool_max, runtime.rtp_pool_lead);
 	switch_rtp_init(runtime.memory_pool);
 
 	runtime.running = 1;
 	runtime.initiated = switch_time_now();
 	
 	switch_scheduler_add_task(switch_epoch_time_now(NULL), heartbeat_callback, "heartbeat", "core", 0, NULL, SSHF_NONE | SSHF_NO_DEL);
+	switch_core_latency_init(runtime.memory_pool);
 
 	switch_uuid_get(&uuid);
 	switch_uuid_format(runtime.uuid_str, &uuid);
@@ -1485,10 +1541,60 @@ static void switch_load_core_config(const char *file)
 					} else {
 						runtime.timer_affinity = atoi(val);
 					}
+				} else if (!strcasecmp(var, "transcode-threads") && !zstr(val)) {
+					int tmp = atoi(val);
+					runtime.transcode_threads = tmp > 0 ? (uint32_t) tmp : 0;
+				} else if (!strcasecmp(var, "transcode-batch-size") && !zstr(val)) {
+					int tmp = atoi(val);
+					runtime.transcode_batch = tmp > 0 ? (uint32_t) tmp : 0;
+				} else if (!strcasecmp(var, "transcode-latency-budget") && !zstr(val)) {
+					int tmp = atoi(val);
+					runtime.transcode_budget = tmp > 0 ? (uint32_t) tmp : 0;
+				} else if (!strcasecmp(var, "transcode-codecs") && !zstr(val)) {
+					runtime.transcode_codecs = switch_core_strdup(runtime.memory_pool, val);
+				} else if (!strcasecmp(var, "transcode-cpu-affinity") && !zstr(val)) {
+					if (!strcasecmp(val, "disabled")) {
+						runtime.transcode_affinity = -1;
+					} else {
+						runtime.transcode_affinity = atoi(val);
+					}
+				} else if (!strcasecmp(var, "db-pool-max") && !zstr(val)) {
+					int tmp = atoi(val);
+					runtime.db_pool_max = tmp > 0 ? (uint32_t) tmp : 0;
+				} else if (!strcasecmp(var, "db-pool-wait-timeout") && !zstr(val)) {
+					int tmp = atoi(val);
+					runtime.db_pool_wait = tmp > 0 ? (uint32_t) tmp : 0;
+				} else if (!strcasecmp(var, "db-pool-health-interval") && !zstr(val)) {
+					int tmp = atoi(val);
+					runtime.db_pool_health_interval = tmp > 0 ? (uint32_t) tmp : 0;
 				} else if (!strcasecmp(var, "rtp-start-port") && !zstr(val)) {
 					switch_rtp_set_start_port((switch_port_t) atoi(val));
 				} else if (!strcasecmp(var, "rtp-end-port") && !zstr(val)) {
 					switch_rtp_set_end_port((switch_port_t) atoi(val));
+				} else if (!strcasecmp(var, "rtp-socket-pool-min") && !zstr(val)) {
+					int tmp = atoi(val);
+					runtime.rtp_pool_min = tmp > 0 ? (uint32_t) tmp : 0;
+				} else if (!strcasecmp(var, "rtp-socket-pool-max") && !zstr(val)) {
+					int tmp = atoi(val);
+					runtime.rtp_pool_max = tmp > 0 ? (uint32_t) tmp : 0;
+				} else if (!strcasecmp(var, "rtp-socket-pool-lead-ms") && !zstr(val)) {
+					int tmp = atoi(val);
+					runtime.rtp_pool_lead = tmp > 0 ? (uint32_t) tmp : 0;
+				} else if (!strcasecmp(var, "memory-arenas") && !zstr(val)) {
+					int tmp = atoi(val);
+					runtime.memory_arenas = tmp > 0 ? (uint32_t) tmp : 0;
+				} else if (!strcasecmp(var, "memory-arena-max-free-kb") && !zstr(val)) {
+					int tmp = atoi(val);
+					runtime.memory_arena_max_free = tmp > 0 ? (uint32_t) tmp : 0;
+				} else if (!strcasecmp(var, "memory-telemetry") && !zstr(val)) {
+					runtime.memory_telemetry = switch_true(val);
+				} else if (!strcasecmp(var, "media-latency-stats") && !zstr(val)) {
+					runtime.latency_enabled = switch_true(val);
+				} else if (!strcasecmp(var, "media-latency-event-interval") && !zstr(val)) {
+					int tmp = atoi(val);
+					runtime.latency_event_interval = tmp > 0 ? (uint32_t) tmp : 0;
+				} else if (!strcasecmp(var, "core-profiling") && !zstr(val)) {
+					switch_core_profile_enable(switch_true(val));
 				} else if (!strcasecmp(var, "core-db-dsn") && !zstr(val)) {
 					if (switch_odbc_available()) {
 						runtime.odbc_dsn = switch_core_strdup(runtime.memory_pool, val);
@@ -1881,7 +1987,10 @@ SWITCH_DECLARE(switch_status_t) switch_core_destroy(void)
 	switch_core_session_hupall(SWITCH_CAUSE_SYSTEM_SHUTDOWN);
 	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CONSOLE, "Clean up modules.\n");
 
+	switch_core_transcode_shutdown();
 	switch_loadable_module_shutdown();
+	switch_core_codec_pool_uninit();
+	switch_core_frame_uninit();
 
 	if (switch_test_flag((&runtime), SCF_USE_SQL)) {
 		switch_core_sqldb_stop();
@@ -1902,6 +2011,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_destroy(void)
 	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CONSOLE, "Finalizing Shutdown.\n");
 	switch_log_shutdown();
 
+	switch_core_profile_shutdown();
 	switch_core_unset_variables();
 	switch_core_memory_stop();
 
@@ -1927,6 +2037,8 @@ SWITCH_DECLARE(switch_status_t) switch_core_destroy(void)
 	switch_event_destroy(&runtime.global_vars);
 	switch_core_hash_destroy(&runtime.mime_types);
 
+	switch_thread_rwlock_wrlock(IP_LIST_RWLOCK);
+
 	if (IP_LIST.hash) {
 		switch_core_hash_destroy(&IP_LIST.hash);
 	}
@@ -1935,6 +2047,8 @@ SWITCH_DECLARE(switch_status_t) switch_core_destroy(void)
 		switch_core_destroy_memory_pool(&IP_LIST.pool);
 	}
 
+	switch_thread_rwlock_unlock(IP_LIST_RWLOCK);
+
 	if (runtime.memory_pool) {
 		apr_pool_destroy(runtime.memory_pool);
 		apr_terminate();
@@ -37,11 +37,197 @@
 
 static uint32_t CODEC_ID = 1;
 
+/* parked pools per implementation, the codec gets a clearable pool under a holder that keeps
+   the entry and the codec mutex, so a pool is emptied when it is parked and starts clean on reuse */
+#define CODEC_POOL_MAX_PER_IMPL 32
+#define CODEC_POOL_KEY "_codec_pool_entry"
+
+typedef struct codec_pool_entry_s {
+	switch_memory_pool_t *holder;
+	switch_memory_pool_t *pool;
+	switch_mutex_t *mutex;
+	struct codec_pool_entry_s *next;
+} codec_pool_entry_t;
+
+typedef struct {
+	uint32_t count;
+	codec_pool_entry_t *head;
+} codec_pool_bucket_t;
+
+static struct {
+	switch_memory_pool_t *pool;
+	switch_mutex_t *mutex;
+	switch_hash_t *hash;
+	int running;
+	uint64_t hits;
+	uint64_t allocs;
+	uint64_t parked;
+	uint64_t retired;
+} codec_pool;
+
 SWITCH_DECLARE(uint32_t) switch_core_codec_next_id(void)
 {
 	return CODEC_ID++;
 }
 
+void switch_core_codec_pool_init(switch_memory_pool_t *pool)
+{
+	memset(&codec_pool, 0, sizeof(codec_pool));
+	codec_pool.pool = pool;
+	switch_mutex_init(&codec_pool.mutex, SWITCH_MUTEX_NESTED, pool);
+	switch_core_hash_init(&codec_pool.hash, pool);
+	codec_pool.running = 1;
+}
+
+void switch_core_codec_pool_uninit(void)
+{
+	switch_hash_index_t *hi;
+	void *val;
+	codec_pool_bucket_t *bucket;
+	codec_pool_entry_t *entry;
+	switch_memory_pool_t *pool;
+
+	if (!codec_pool.running) {
+		return;
+	}
+
+	switch_mutex_lock(codec_pool.mutex);
+	codec_pool.running = 0;
+	for (hi = switch_hash_first(NULL, codec_pool.hash); hi; hi = switch_hash_next(hi)) {
+		switch_hash_this(hi, NULL, NULL, &val);
+		bucket = (codec_pool_bucket_t *) val;
+		while ((entry = bucket->head)) {
+			bucket->head = entry->next;
+			pool = entry->holder;
+			switch_core_destroy_memory_pool(&pool);
+		}
+		bucket->count = 0;
+	}
+	switch_mutex_unlock(codec_pool.mutex);
+}
+
+static codec_pool_bucket_t *codec_pool_bucket(uint32_t impl_id, switch_bool_t create)
+{
+	codec_pool_bucket_t *bucket;
+	char key[32];
+
+	switch_snprintf(key, sizeof(key), "%u", impl_id);
+
+	if (!(bucket = switch_core_hash_find(codec_pool.hash, key)) && create) {
+		bucket = switch_core_alloc(codec_pool.pool, sizeof(*bucket));
+		switch_core_hash_insert(codec_pool.hash, key, bucket);
+	}
+
+	return bucket;
+}
+
+/* hand out a pool for a codec that owns its memory, preferring one parked by the same implementation */
+static switch_status_t codec_pool_get(const switch_codec_implementation_t *implementation, switch_memory_pool_t **poolp, switch_mutex_t **mutexp)
+{
+	codec_pool_bucket_t *bucket;
+	codec_pool_entry_t *entry = NULL;
+	switch_memory_pool_t *pool = NULL;
+	switch_status_t status;
+
+	if (codec_pool.running) {
+		switch_mutex_lock(codec_pool.mutex);
+		if (codec_pool.running && (bucket = codec_pool_bucket(implementation->impl_id, SWITCH_FALSE)) && (entry = bucket->head)) {
+			bucket->head = entry->next;
+			bucket->count--;
+			codec_pool.hits++;
+		} else {
+			codec_pool.allocs++;
+		}
+		switch_mutex_unlock(codec_pool.mutex);
+	}
+
+	if (entry) {
+		entry->next = NULL;
+		*poolp = entry->pool;
+		*mutexp = entry->mutex;
+		return SWITCH_STATUS_SUCCESS;
+	}
+
+	if ((status = switch_core_new_memory_pool(&pool)) != SWITCH_STATUS_SUCCESS) {
+		return status;
+	}
+
+	entry = switch_core_alloc(pool, sizeof(*entry));
+	entry->holder = pool;
+	switch_mutex_init(&entry->mutex, SWITCH_MUTEX_NESTED, pool);
+
+	if ((status = switch_core_new_clearable_memory_pool(&entry->pool, pool)) != SWITCH_STATUS_SUCCESS) {
+		switch_core_destroy_memory_pool(&pool);
+		return status;
+	}
+
+	switch_core_memory_pool_set_data(entry->pool, CODEC_POOL_KEY, entry);
+
+	*poolp = entry->pool;
+	*mutexp = entry->mutex;
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+/* called once the implementation has released its state, clears and parks the pool or destroys it */
+static void codec_pool_put(uint32_t impl_id, switch_memory_pool_t *pool)
+{
+	codec_pool_bucket_t *bucket;
+	codec_pool_entry_t *entry = switch_core_memory_pool_get_data(pool, CODEC_POOL_KEY);
+	int parked = 0;
+
+	if (!entry) {
+		switch_core_destroy_memory_pool(&pool);
+		return;
+	}
+
+	if (codec_pool.running) {
+		/* runs the cleanups the last init registered and drops the pool data, so put the entry back */
+		switch_core_memory_pool_clear(entry->pool);
+		switch_core_memory_pool_set_data(entry->pool, CODEC_POOL_KEY, entry);
+
+		switch_mutex_lock(codec_pool.mutex);
+		if (codec_pool.running && (bucket = codec_pool_bucket(impl_id, SWITCH_TRUE)) && bucket->count < CODEC_POOL_MAX_PER_IMPL) {
+			entry->next = bucket->head;
+			bucket->head = entry;
+			bucket->count++;
+			codec_pool.parked++;
+			parked = 1;
+		} else {
+			codec_pool.retired++;
+		}
+		switch_mutex_unlock(codec_pool.mutex);
+	}
+
+	if (!parked) {
+		pool = entry->holder;
+		switch_core_destroy_memory_pool(&pool);
+	}
+}
+
+SWITCH_DECLARE(void) switch_core_codec_pool_status(switch_stream_handle_t *stream)
+{
+	switch_hash_index_t *hi;
+	void *val;
+	uint32_t idle = 0, impls = 0;
+
+	switch_mutex_lock(codec_pool.mutex);
+	for (hi = switch_hash_first(NULL, codec_pool.hash); hi; hi = switch_hash_next(hi)) {
+		switch_hash_this(hi, NULL, NULL, &val);
+		if (((codec_pool_bucket_t *) val)->count) {
+			idle += ((codec_pool_bucket_t *) val)->count;
+			impls++;
+		}
+	}
+
+	stream->write_function(stream, "codec-pool-hits: %" SWITCH_UINT64_T_FMT "\n", codec_pool.hits);
+	stream->write_function(stream, "codec-pool-allocs: %" SWITCH_UINT64_T_FMT "\n", codec_pool.allocs);
+	stream->write_function(stream, "codec-pool-parked: %" SWITCH_UINT64_T_FMT "\n", codec_pool.parked);
+	stream->write_function(stream, "codec-pool-retired: %" SWITCH_UINT64_T_FMT "\n", codec_pool.retired);
+	stream->write_function(stream, "codec-pool-idle: %u pool(s) across %u implementation(s)\n", idle, impls);
+	switch_mutex_unlock(codec_pool.mutex);
+}
+
 SWITCH_DECLARE(void) switch_core_session_unset_read_codec(switch_core_session_t *session)
 {
 	switch_mutex_t *mutex = NULL;
@@ -476,7 +662,9 @@ SWITCH_DECLARE(switch_status_t) switch_core_codec_copy(switch_codec_t *codec, sw
 	if (pool) {
 		new_codec->memory_pool = pool;
 	} else {
-		if ((status = switch_core_new_memory_pool(&new_codec->memory_pool)) != SWITCH_STATUS_SUCCESS) {
+		switch_mutex_t *mutex;
+
+		if ((status = codec_pool_get(codec->implementation, &new_codec->memory_pool, &mutex)) != SWITCH_STATUS_SUCCESS) {
 			return status;
 		}
 	}
@@ -551,7 +739,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_codec_init(switch_codec_t *codec, co
 		if (pool) {
 			codec->memory_pool = pool;
 		} else {
-			if ((status = switch_core_new_memory_pool(&codec->memory_pool)) != SWITCH_STATUS_SUCCESS) {
+			if ((status = codec_pool_get(implementation, &codec->memory_pool, &codec->mutex)) != SWITCH_STATUS_SUCCESS) {
 				return status;
 			}
 			switch_set_flag(codec, SWITCH_CODEC_FLAG_FREE_POOL);
@@ -562,7 +750,9 @@ SWITCH_DECLARE(switch_status_t) switch_core_codec_init(switch_codec_t *codec, co
 		}
 
 		implementation->init(codec, flags, codec_settings);
-		switch_mutex_init(&codec->mutex, SWITCH_MUTEX_NESTED, codec->memory_pool);
+		if (!codec->mutex) {
+			switch_mutex_init(&codec->mutex, SWITCH_MUTEX_NESTED, codec->memory_pool);
+		}
 		switch_set_flag(codec, SWITCH_CODEC_FLAG_READY);
 		return SWITCH_STATUS_SUCCESS;
 	} else {
@@ -600,8 +790,13 @@ SWITCH_DECLARE(switch_status_t) switch_core_codec_encode(switch_codec_t *codec,
 
 	if (codec->mutex)
 		switch_mutex_lock(codec->mutex);
-	status = codec->implementation->encode(codec, other_codec, decoded_data, decoded_data_len,
-										   decoded_rate, encoded_data, encoded_data_len, encoded_rate, flag);
+	if (switch_core_transcode_wanted(codec)) {
+		status = switch_core_transcode_frame(1, codec, other_codec, decoded_data, decoded_data_len,
+											 decoded_rate, encoded_data, encoded_data_len, encoded_rate, flag);
+	} else {
+		status = codec->implementation->encode(codec, other_codec, decoded_data, decoded_data_len,
+											   decoded_rate, encoded_data, encoded_data_len, encoded_rate, flag);
+	}
 	if (codec->mutex)
 		switch_mutex_unlock(codec->mutex);
 
@@ -643,8 +838,13 @@ SWITCH_DECLARE(switch_status_t) switch_core_codec_decode(switch_codec_t *codec,
 	
 	if (codec->mutex)
 		switch_mutex_lock(codec->mutex);
-	status = codec->implementation->decode(codec, other_codec, encoded_data, encoded_data_len, encoded_rate,
-										   decoded_data, decoded_data_len, decoded_rate, flag);
+	if (switch_core_transcode_wanted(codec)) {
+		status = switch_core_transcode_frame(0, codec, other_codec, encoded_data, encoded_data_len, encoded_rate,
+											 decoded_data, decoded_data_len, decoded_rate, flag);
+	} else {
+		status = codec->implementation->decode(codec, other_codec, encoded_data, encoded_data_len, encoded_rate,
+											   decoded_data, decoded_data_len, decoded_rate, flag);
+	}
 	if (codec->mutex)
 		switch_mutex_unlock(codec->mutex);
 
@@ -656,6 +856,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_codec_destroy(switch_codec_t *codec)
 	switch_mutex_t *mutex;
 	switch_memory_pool_t *pool;
 	int free_pool = 0;
+	uint32_t impl_id;
 
 	switch_assert(codec != NULL);
 
@@ -670,6 +871,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_codec_destroy(switch_codec_t *codec)
 
 	pool = codec->memory_pool;
 	mutex = codec->mutex;
+	impl_id = codec->implementation->impl_id;
 
 	if (mutex)
 		switch_mutex_lock(mutex);
@@ -683,7 +885,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_codec_destroy(switch_codec_t *codec)
 		switch_mutex_unlock(mutex);
 
 	if (free_pool) {
-		switch_core_destroy_memory_pool(&pool);
+		codec_pool_put(impl_id, pool);
 	}
 
 	return SWITCH_STATUS_SUCCESS;
@@ -44,6 +44,12 @@ NEW_HOOK_DECL(outgoing_channel)
 	NEW_HOOK_DECL(recv_dtmf)
 	NEW_HOOK_DECL(resurrect_session)
 
+SWITCH_DECLARE(switch_bool_t) switch_core_event_hook_media_attached(switch_core_session_t *session)
+{
+	return (session->event_hooks.read_frame || session->event_hooks.write_frame ||
+			session->event_hooks.recv_dtmf || session->event_hooks.send_dtmf) ? SWITCH_TRUE : SWITCH_FALSE;
+}
+
 /* For Emacs:
  * Local Variables:
  * mode:c
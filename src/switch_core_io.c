@@ -107,6 +107,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_read_frame(switch_core_sessi
 	int need_codec, perfect, do_bugs = 0, do_resample = 0, is_cng = 0;
 	unsigned int flag = 0;
 	switch_codec_implementation_t codec_impl;
+	switch_time_t lat_read = 0, lat_stage = 0;
 
 	switch_assert(session != NULL);
 
@@ -179,6 +180,9 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_read_frame(switch_core_sessi
 		switch_mutex_lock(session->read_codec->mutex);
 	}
 
+	/* the time spent waiting on the endpoint is not ours, start the clock once it hands over a frame */
+	switch_latency_start(lat_read);
+
 	if (status != SWITCH_STATUS_SUCCESS) {
 		goto done;
 	}
@@ -279,12 +283,14 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_read_frame(switch_core_sessi
 					use_codec = &session->bug_codec;
 				}
 
+				switch_latency_start(lat_stage);
 				status = switch_core_codec_decode(use_codec,
 												  session->read_codec,
 												  read_frame->data,
 												  read_frame->datalen,
 												  session->read_impl.actual_samples_per_second,
 												  session->raw_read_frame.data, &session->raw_read_frame.datalen, &session->raw_read_frame.rate, &flag);
+				switch_latency_stop(session, SWITCH_LATENCY_SIDE_READ, SWITCH_LATENCY_DECODE, lat_stage);
 			}
 
 			if (do_resample && ((status == SWITCH_STATUS_SUCCESS) || is_cng)) {
@@ -359,6 +365,8 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_read_frame(switch_core_sessi
 			switch_media_bug_t *bp;
 			switch_bool_t ok = SWITCH_TRUE;
 			int prune = 0;
+
+			switch_latency_start(lat_stage);
 			switch_thread_rwlock_rdlock(session->bug_rwlock);
 
 			for (bp = session->bugs; bp; bp = bp->next) {
@@ -371,8 +379,8 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_read_frame(switch_core_sessi
 				}
 
 				if (bp->ready && switch_test_flag(bp, SMBF_READ_STREAM)) {
+					switch_ringbuffer_write(bp->raw_read_buffer, read_frame->data, read_frame->datalen);
 					switch_mutex_lock(bp->read_mutex);
-					switch_buffer_write(bp->raw_read_buffer, read_frame->data, read_frame->datalen);
 					if (bp->callback) {
 						ok = bp->callback(bp, bp->user_data, SWITCH_ABC_TYPE_READ);
 					}
@@ -382,6 +390,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_read_frame(switch_core_sessi
 				if (ok && switch_test_flag(bp, SMBF_READ_REPLACE)) {
 					do_bugs = 0;
 					if (bp->callback) {
+						switch_frame_writable(read_frame);
 						bp->read_replace_frame_in = read_frame;
 						bp->read_replace_frame_out = read_frame;
 						if ((ok = bp->callback(bp, bp->user_data, SWITCH_ABC_TYPE_READ_REPLACE)) == SWITCH_TRUE) {
@@ -401,6 +410,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_read_frame(switch_core_sessi
 			if (prune) {
 				switch_core_media_bug_prune(session);
 			}
+			switch_latency_stop(session, SWITCH_LATENCY_SIDE_READ, SWITCH_LATENCY_BUGS, lat_stage);
 		}
 
 		if (do_bugs) {
@@ -409,7 +419,10 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_read_frame(switch_core_sessi
 
 		if (session->read_codec) {
 			if (session->read_resampler) {
-				short *data = read_frame->data;
+				short *data;
+				switch_frame_writable(read_frame);
+				data = read_frame->data;
+				switch_latency_start(lat_stage);
 				switch_mutex_lock(session->resample_mutex);
 				switch_resample_process(session->read_resampler, data, (int) read_frame->datalen / 2);
 				memcpy(data, session->read_resampler->to, session->read_resampler->to_len * 2);
@@ -417,7 +430,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_read_frame(switch_core_sessi
 				read_frame->datalen = session->read_resampler->to_len * 2;
 				read_frame->rate = session->read_resampler->to_rate;
 				switch_mutex_unlock(session->resample_mutex);
-
+				switch_latency_stop(session, SWITCH_LATENCY_SIDE_READ, SWITCH_LATENCY_RESAMPLE, lat_stage);
 			}
 
 			if (read_frame->datalen == session->read_impl.decoded_bytes_per_packet) {
@@ -455,12 +468,14 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_read_frame(switch_core_sessi
 				switch_assert(enc_frame != NULL);
 				switch_assert(enc_frame->data != NULL);
 
+				switch_latency_start(lat_stage);
 				status = switch_core_codec_encode(session->read_codec,
 												  enc_frame->codec,
 												  enc_frame->data,
 												  enc_frame->datalen,
 												  session->read_impl.actual_samples_per_second,
 												  session->enc_read_frame.data, &session->enc_read_frame.datalen, &session->enc_read_frame.rate, &flag);
+				switch_latency_stop(session, SWITCH_LATENCY_SIDE_READ, SWITCH_LATENCY_ENCODE, lat_stage);
 
 				switch (status) {
 				case SWITCH_STATUS_RESAMPLE:
@@ -560,6 +575,8 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_read_frame(switch_core_sessi
 		*frame = &runtime.dummy_cng_frame;
 	}
 
+	switch_latency_stop(session, SWITCH_LATENCY_SIDE_READ, SWITCH_LATENCY_READ, lat_read);
+
 	switch_mutex_unlock(session->read_codec->mutex);
 	switch_mutex_unlock(session->codec_read_mutex);
 
@@ -593,6 +610,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_write_frame(switch_core_sess
 	switch_frame_t *enc_frame = NULL, *write_frame = frame;
 	unsigned int flag = 0, need_codec = 0, perfect = 0, do_bugs = 0, do_write = 0, do_resample = 0, ptime_mismatch = 0, pass_cng = 0, resample = 0;
 	int did_write_resample = 0;
+	switch_time_t lat_write = 0, lat_stage = 0;
 
 	switch_assert(session != NULL);
 	switch_assert(frame != NULL);
@@ -628,6 +646,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_write_frame(switch_core_sess
 	switch_assert(frame->codec != NULL);
 	switch_assert(frame->codec->implementation != NULL);
 
+	switch_latency_start(lat_write);
 	switch_mutex_lock(session->codec_write_mutex);
 
 	if (!(session->write_codec && session->write_codec->mutex && frame->codec) ||
@@ -703,12 +722,14 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_write_frame(switch_core_sess
 
 	if (frame->codec) {
 		session->raw_write_frame.datalen = session->raw_write_frame.buflen;
+		switch_latency_start(lat_stage);
 		status = switch_core_codec_decode(frame->codec,
 										  session->write_codec,
 										  frame->data,
 										  frame->datalen,
 										  session->write_impl.actual_samples_per_second,
 										  session->raw_write_frame.data, &session->raw_write_frame.datalen, &session->raw_write_frame.rate, &flag);
+		switch_latency_stop(session, SWITCH_LATENCY_SIDE_WRITE, SWITCH_LATENCY_DECODE, lat_stage);
 
 
 
@@ -779,8 +800,12 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_write_frame(switch_core_sess
 
 
 	if (session->write_resampler) {
-		short *data = write_frame->data;
+		short *data;
+
+		switch_frame_writable(write_frame);
+		data = write_frame->data;
 
+		switch_latency_start(lat_stage);
 		switch_mutex_lock(session->resample_mutex);
 		if (session->write_resampler) {
 
@@ -797,6 +822,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_write_frame(switch_core_sess
 			did_write_resample = 1;
 		}
 		switch_mutex_unlock(session->resample_mutex);
+		switch_latency_stop(session, SWITCH_LATENCY_SIDE_WRITE, SWITCH_LATENCY_RESAMPLE, lat_stage);
 	}
 
 
@@ -805,6 +831,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_write_frame(switch_core_sess
 		switch_media_bug_t *bp;
 		int prune = 0;
 
+		switch_latency_start(lat_stage);
 		switch_thread_rwlock_rdlock(session->bug_rwlock);
 		for (bp = session->bugs; bp; bp = bp->next) {
 			switch_bool_t ok = SWITCH_TRUE;
@@ -823,9 +850,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_write_frame(switch_core_sess
 
 			if (switch_test_flag(bp, SMBF_WRITE_STREAM)) {
 
-				switch_mutex_lock(bp->write_mutex);
-				switch_buffer_write(bp->raw_write_buffer, write_frame->data, write_frame->datalen);
-				switch_mutex_unlock(bp->write_mutex);
+				switch_ringbuffer_write(bp->raw_write_buffer, write_frame->data, write_frame->datalen);
 				if (bp->callback) {
 					ok = bp->callback(bp, bp->user_data, SWITCH_ABC_TYPE_WRITE);
 				}
@@ -834,6 +859,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_write_frame(switch_core_sess
 			if (switch_test_flag(bp, SMBF_WRITE_REPLACE)) {
 				do_bugs = 0;
 				if (bp->callback) {
+					switch_frame_writable(write_frame);
 					bp->write_replace_frame_in = write_frame;
 					bp->write_replace_frame_out = write_frame;
 					if ((ok = bp->callback(bp, bp->user_data, SWITCH_ABC_TYPE_WRITE_REPLACE)) == SWITCH_TRUE) {
@@ -856,6 +882,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_write_frame(switch_core_sess
 		if (prune) {
 			switch_core_media_bug_prune(session);
 		}
+		switch_latency_stop(session, SWITCH_LATENCY_SIDE_WRITE, SWITCH_LATENCY_BUGS, lat_stage);
 	}
 
 	if (do_bugs) {
@@ -875,6 +902,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_write_frame(switch_core_sess
 		if (perfect) {
 
 			if (write_frame->datalen < session->write_impl.decoded_bytes_per_packet) {
+				switch_frame_writable(write_frame);
 				memset(write_frame->data, 255, session->write_impl.decoded_bytes_per_packet - write_frame->datalen);
 				write_frame->datalen = session->write_impl.decoded_bytes_per_packet;
 			}
@@ -882,12 +910,14 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_write_frame(switch_core_sess
 			enc_frame = write_frame;
 			session->enc_write_frame.datalen = session->enc_write_frame.buflen;
 
+			switch_latency_start(lat_stage);
 			status = switch_core_codec_encode(session->write_codec,
 											  frame->codec,
 											  enc_frame->data,
 											  enc_frame->datalen,
 											  session->write_impl.actual_samples_per_second,
 											  session->enc_write_frame.data, &session->enc_write_frame.datalen, &session->enc_write_frame.rate, &flag);
+			switch_latency_stop(session, SWITCH_LATENCY_SIDE_WRITE, SWITCH_LATENCY_ENCODE, lat_stage);
 
 
 
@@ -982,12 +1012,14 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_write_frame(switch_core_sess
 					rate = session->write_impl.actual_samples_per_second;
 				}
 
+				switch_latency_start(lat_stage);
 				status = switch_core_codec_encode(session->write_codec,
 												  frame->codec,
 												  enc_frame->data,
 												  enc_frame->datalen,
 												  rate,
 												  session->enc_write_frame.data, &session->enc_write_frame.datalen, &session->enc_write_frame.rate, &flag);
+				switch_latency_stop(session, SWITCH_LATENCY_SIDE_WRITE, SWITCH_LATENCY_ENCODE, lat_stage);
 
 
 				switch (status) {
@@ -1053,7 +1085,9 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_write_frame(switch_core_sess
 				}
 
 				if (!did_write_resample && session->read_resampler) {
-					short *data = write_frame->data;
+					short *data;
+					switch_frame_writable(write_frame);
+					data = write_frame->data;
 					switch_mutex_lock(session->resample_mutex);
 					if (session->read_resampler) {
 						switch_resample_process(session->read_resampler, data, write_frame->datalen / 2);
@@ -1104,6 +1138,8 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_write_frame(switch_core_sess
 	switch_mutex_unlock(frame->codec->mutex);
 	switch_mutex_unlock(session->codec_write_mutex);
 
+	switch_latency_stop(session, SWITCH_LATENCY_SIDE_WRITE, SWITCH_LATENCY_WRITE, lat_write);
+
 	return status;
 }
 
@@ -0,0 +1,421 @@
+/*
+ * FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ * Copyright (C) 2005-2010, Anthony Minessale II <anthm@freeswitch.org>
+ *
+ * Version: MPL 1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ *
+ * The Initial Developer of the Original Code is
+ * Anthony Minessale II <anthm@freeswitch.org>
+ * Portions created by the Initial Developer are Copyright (C)
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ * Anthony Minessale II <anthm@freeswitch.org>
+ *
+ *
+ * switch_core_latency.c -- Media path latency histograms
+ *
+ * When media-latency-stats is on, the read and write paths time their decode, encode,
+ * resample and media bug stages and the softtimer records how late each tick fired.
+ * Samples land in log-linear histograms (16 exact buckets then 8 per power of two, so
+ * any value is within 12.5%) kept on the session, one set for the read side and one for the
+ * write side since a bridged peer writes from its own thread while the session reads.  Each
+ * side has its own lock so the two media threads never meet and a report never sees a
+ * half written 64 bit count.  A session folds its histograms into the global ones when it
+ * is destroyed, the timer row is added under the global lock.
+ *
+ */
+
+#include <switch.h>
+#include "private/switch_core_pvt.h"
+
+#define LATENCY_SUB (1 << SWITCH_LATENCY_SUB_BITS)
+
+struct switch_latency_hist {
+	uint32_t bucket[SWITCH_LATENCY_STAGE_MAX][SWITCH_LATENCY_BUCKETS];
+	uint64_t count[SWITCH_LATENCY_STAGE_MAX];
+	uint64_t sum[SWITCH_LATENCY_STAGE_MAX];
+	uint32_t max[SWITCH_LATENCY_STAGE_MAX];
+};
+
+typedef struct {
+	switch_mutex_t *mutex;
+	switch_latency_hist_t hist;
+} latency_side_t;
+
+struct switch_latency_session {
+	latency_side_t side[SWITCH_LATENCY_SIDES];
+};
+
+static const char *latency_stage_names[SWITCH_LATENCY_STAGE_MAX] = { "Read", "Decode", "Encode", "Resample", "Bugs", "Write", "Timer" };
+
+static struct {
+	switch_mutex_t *mutex;
+	switch_latency_hist_t *global;
+	switch_time_t started;
+} latency;
+
+uint32_t switch_core_latency_bucket(switch_time_t usec)
+{
+	uint32_t v, e = 0;
+
+	if (usec < SWITCH_LATENCY_EXACT) {
+		return usec < 0 ? 0 : (uint32_t) usec;
+	}
+
+	if (usec >= ((switch_time_t) 1 << SWITCH_LATENCY_MAX_EXP)) {
+		return SWITCH_LATENCY_BUCKETS - 1;
+	}
+
+	v = (uint32_t) usec;
+	while ((v >> e) > 1) {
+		e++;
+	}
+
+	return SWITCH_LATENCY_EXACT + (e - 4) * LATENCY_SUB + ((v >> (e - SWITCH_LATENCY_SUB_BITS)) & (LATENCY_SUB - 1));
+}
+
+/* highest value that lands in the bucket */
+uint32_t switch_core_latency_bucket_value(uint32_t idx)
+{
+	uint32_t e, sub;
+
+	if (idx < SWITCH_LATENCY_EXACT) {
+		return idx;
+	}
+
+	e = (idx - SWITCH_LATENCY_EXACT) / LATENCY_SUB + 4;
+	sub = (idx - SWITCH_LATENCY_EXACT) % LATENCY_SUB;
+
+	return ((LATENCY_SUB + sub + 1) << (e - SWITCH_LATENCY_SUB_BITS)) - 1;
+}
+
+static void latency_hist_add(switch_latency_hist_t *hist, switch_latency_stage_t stage, switch_time_t usec)
+{
+	if (usec < 0) {
+		usec = 0;
+	}
+
+	hist->bucket[stage][switch_core_latency_bucket(usec)]++;
+	hist->count[stage]++;
+	hist->sum[stage] += usec;
+	if (usec > hist->max[stage]) {
+		hist->max[stage] = usec > UINT32_MAX ? UINT32_MAX : (uint32_t) usec;
+	}
+}
+
+static void latency_hist_merge(switch_latency_hist_t *to, switch_latency_hist_t *from)
+{
+	int s, i;
+
+	for (s = 0; s < SWITCH_LATENCY_STAGE_MAX; s++) {
+		if (!from->count[s]) {
+			continue;
+		}
+
+		for (i = 0; i < SWITCH_LATENCY_BUCKETS; i++) {
+			to->bucket[s][i] += from->bucket[s][i];
+		}
+
+		to->count[s] += from->count[s];
+		to->sum[s] += from->sum[s];
+		if (from->max[s] > to->max[s]) {
+			to->max[s] = from->max[s];
+		}
+	}
+}
+
+static uint32_t latency_hist_percentile(switch_latency_hist_t *hist, switch_latency_stage_t stage, double pct)
+{
+	uint64_t want, seen = 0;
+	uint32_t i;
+
+	if (!hist->count[stage]) {
+		return 0;
+	}
+
+	want = (uint64_t) (hist->count[stage] * pct / 100);
+	if (want < 1) {
+		want = 1;
+	}
+
+	for (i = 0; i < SWITCH_LATENCY_BUCKETS; i++) {
+		if ((seen += hist->bucket[stage][i]) >= want) {
+			uint32_t val = switch_core_latency_bucket_value(i);
+			return val < hist->max[stage] ? val : hist->max[stage];
+		}
+	}
+
+	return hist->max[stage];
+}
+
+void switch_core_latency_add(switch_core_session_t *session, switch_latency_side_t side, switch_latency_stage_t stage, switch_time_t usec)
+{
+	latency_side_t *ls;
+
+	if (!latency.mutex) {
+		return;
+	}
+
+	if (!session) {
+		/* only the timer thread records without a session */
+		if (stage == SWITCH_LATENCY_TIMER) {
+			switch_mutex_lock(latency.mutex);
+			latency_hist_add(latency.global, stage, usec);
+			switch_mutex_unlock(latency.mutex);
+		}
+		return;
+	}
+
+	if (!session->latency) {
+		switch_mutex_lock(latency.mutex);
+		if (!session->latency) {
+			switch_latency_session_t *sl = switch_core_session_alloc(session, sizeof(*sl));
+			int i;
+
+			for (i = 0; i < SWITCH_LATENCY_SIDES; i++) {
+				switch_mutex_init(&sl->side[i].mutex, SWITCH_MUTEX_NESTED, switch_core_session_get_pool(session));
+			}
+			session->latency = sl;
+		}
+		switch_mutex_unlock(latency.mutex);
+	}
+
+	ls = &session->latency->side[side];
+
+	switch_mutex_lock(ls->mutex);
+	latency_hist_add(&ls->hist, stage, usec);
+	switch_mutex_unlock(ls->mutex);
+}
+
+/* both sides of a session folded into one set of rows */
+static void latency_session_merge(switch_latency_hist_t *to, switch_latency_session_t *sl)
+{
+	int i;
+
+	for (i = 0; i < SWITCH_LATENCY_SIDES; i++) {
+		switch_mutex_lock(sl->side[i].mutex);
+		latency_hist_merge(to, &sl->side[i].hist);
+		switch_mutex_unlock(sl->side[i].mutex);
+	}
+}
+
+static void latency_event_add(switch_event_t *event, switch_latency_hist_t *hist)
+{
+	char name[64];
+	int s;
+
+	for (s = 0; s < SWITCH_LATENCY_STAGE_MAX; s++) {
+		if (!hist->count[s]) {
+			continue;
+		}
+
+		switch_snprintf(name, sizeof(name), "Latency-%s-Count", latency_stage_names[s]);
+		switch_event_add_header(event, SWITCH_STACK_BOTTOM, name, "%" SWITCH_UINT64_T_FMT, hist->count[s]);
+		switch_snprintf(name, sizeof(name), "Latency-%s-Mean-us", latency_stage_names[s]);
+		switch_event_add_header(event, SWITCH_STACK_BOTTOM, name, "%" SWITCH_UINT64_T_FMT, hist->sum[s] / hist->count[s]);
+		switch_snprintf(name, sizeof(name), "Latency-%s-P50-us", latency_stage_names[s]);
+		switch_event_add_header(event, SWITCH_STACK_BOTTOM, name, "%u", latency_hist_percentile(hist, s, 50));
+		switch_snprintf(name, sizeof(name), "Latency-%s-P99-us", latency_stage_names[s]);
+		switch_event_add_header(event, SWITCH_STACK_BOTTOM, name, "%u", latency_hist_percentile(hist, s, 99));
+		switch_snprintf(name, sizeof(name), "Latency-%s-Max-us", latency_stage_names[s]);
+		switch_event_add_header(event, SWITCH_STACK_BOTTOM, name, "%u", hist->max[s]);
+	}
+}
+
+void switch_core_latency_session_end(switch_core_session_t *session)
+{
+	switch_latency_hist_t *hist;
+	switch_event_t *event;
+
+	if (!session->latency || !latency.mutex) {
+		return;
+	}
+
+	switch_zmalloc(hist, sizeof(*hist));
+	latency_session_merge(hist, session->latency);
+
+	switch_mutex_lock(latency.mutex);
+	latency_hist_merge(latency.global, hist);
+	switch_mutex_unlock(latency.mutex);
+
+	if (switch_event_create_subclass(&event, SWITCH_EVENT_CUSTOM, SWITCH_LATENCY_EVENT) == SWITCH_STATUS_SUCCESS) {
+		switch_channel_event_set_data(session->channel, event);
+		switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "Latency-Scope", "session");
+		latency_event_add(event, hist);
+		switch_event_fire(&event);
+	}
+
+	free(hist);
+	session->latency = NULL;
+}
+
+/* global rows plus whatever the live sessions have not folded in yet, caller frees */
+static switch_latency_hist_t *latency_snapshot(void)
+{
+	switch_latency_hist_t *hist;
+	switch_hash_index_t *hi;
+	void *val;
+
+	switch_zmalloc(hist, sizeof(*hist));
+
+	switch_mutex_lock(latency.mutex);
+	latency_hist_merge(hist, latency.global);
+	switch_mutex_unlock(latency.mutex);
+
+	switch_mutex_lock(runtime.session_hash_mutex);
+	for (hi = switch_hash_first(NULL, session_manager.session_table); hi; hi = switch_hash_next(hi)) {
+		switch_core_session_t *session;
+
+		switch_hash_this(hi, NULL, NULL, &val);
+		if ((session = (switch_core_session_t *) val) && session->latency) {
+			latency_session_merge(hist, session->latency);
+		}
+	}
+	switch_mutex_unlock(runtime.session_hash_mutex);
+
+	return hist;
+}
+
+static void latency_report(switch_stream_handle_t *stream, switch_latency_hist_t *hist)
+{
+	int s;
+
+	stream->write_function(stream, "%-10s %12s %10s %10s %10s %10s %10s %10s\n", "stage", "count", "mean-us", "p50-us", "p90-us", "p99-us", "p99.9-us",
+						   "max-us");
+
+	for (s = 0; s < SWITCH_LATENCY_STAGE_MAX; s++) {
+		stream->write_function(stream, "%-10s %12" SWITCH_UINT64_T_FMT " %10" SWITCH_UINT64_T_FMT " %10u %10u %10u %10u %10u\n",
+							   latency_stage_names[s], hist->count[s], hist->count[s] ? hist->sum[s] / hist->count[s] : 0,
+							   latency_hist_percentile(hist, s, 50), latency_hist_percentile(hist, s, 90), latency_hist_percentile(hist, s, 99),
+							   latency_hist_percentile(hist, s, 99.9), hist->max[s]);
+	}
+}
+
+SWITCH_DECLARE(switch_status_t) switch_core_latency_report(switch_stream_handle_t *stream, const char *uuid)
+{
+	switch_latency_hist_t *hist;
+	switch_core_session_t *session;
+
+	if (!latency.mutex) {
+		stream->write_function(stream, "-ERR media latency stats not initialized\n");
+		return SWITCH_STATUS_FALSE;
+	}
+
+	if (!zstr(uuid)) {
+		if (!(session = switch_core_session_locate(uuid))) {
+			stream->write_function(stream, "-ERR no such session %s\n", uuid);
+			return SWITCH_STATUS_FALSE;
+		}
+
+		if (session->latency) {
+			switch_zmalloc(hist, sizeof(*hist));
+			latency_session_merge(hist, session->latency);
+			latency_report(stream, hist);
+			free(hist);
+		} else {
+			stream->write_function(stream, "no samples for %s\n", uuid);
+		}
+
+		switch_core_session_rwunlock(session);
+		return SWITCH_STATUS_SUCCESS;
+	}
+
+	stream->write_function(stream, "media latency stats: %s for %" SWITCH_INT64_T_FMT "s\n", runtime.latency_enabled ? "on" : "off",
+						   latency.started ? (int64_t) ((switch_micro_time_now() - latency.started) / 1000000) : (int64_t) 0);
+
+	hist = latency_snapshot();
+	latency_report(stream, hist);
+	free(hist);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+SWITCH_DECLARE(void) switch_core_latency_enable(switch_bool_t on)
+{
+	if (!latency.mutex) {
+		return;
+	}
+
+	switch_mutex_lock(latency.mutex);
+	if (on && !runtime.latency_enabled) {
+		latency.started = switch_micro_time_now();
+	}
+	runtime.latency_enabled = on ? 1 : 0;
+	switch_mutex_unlock(latency.mutex);
+}
+
+SWITCH_DECLARE(void) switch_core_latency_reset(void)
+{
+	if (!latency.mutex) {
+		return;
+	}
+
+	/* live sessions keep what they have, only the folded totals start over */
+	switch_mutex_lock(latency.mutex);
+	memset(latency.global, 0, sizeof(*latency.global));
+	latency.started = switch_micro_time_now();
+	switch_mutex_unlock(latency.mutex);
+}
+
+SWITCH_STANDARD_SCHED_FUNC(latency_event_callback)
+{
+	switch_latency_hist_t *hist;
+	switch_event_t *event;
+
+	task->runtime = switch_epoch_time_now(NULL) + runtime.latency_event_interval;
+
+	if (!runtime.latency_enabled) {
+		return;
+	}
+
+	hist = latency_snapshot();
+
+	if (switch_event_create_subclass(&event, SWITCH_EVENT_CUSTOM, SWITCH_LATENCY_EVENT) == SWITCH_STATUS_SUCCESS) {
+		switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "Latency-Scope", "global");
+		switch_event_add_header(event, SWITCH_STACK_BOTTOM, "Session-Count", "%u", switch_core_session_count());
+		latency_event_add(event, hist);
+		switch_event_fire(&event);
+	}
+
+	free(hist);
+}
+
+void switch_core_latency_init(switch_memory_pool_t *pool)
+{
+	latency.global = switch_core_alloc(pool, sizeof(*latency.global));
+	switch_mutex_init(&latency.mutex, SWITCH_MUTEX_NESTED, pool);
+
+	if (runtime.latency_enabled) {
+		latency.started = switch_micro_time_now();
+	}
+
+	if (runtime.latency_event_interval) {
+		switch_scheduler_add_task(switch_epoch_time_now(NULL) + runtime.latency_event_interval, latency_event_callback, "media_latency", "core", 0,
+								  NULL, SSHF_NONE | SSHF_NO_DEL);
+	}
+}
+
+/* For Emacs:
+ * Local Variables:
+ * mode:c
+ * indent-tabs-mode:t
+ * tab-width:4
+ * c-basic-offset:4
+ * End:
+ * For VIM:
+ * vim:set softtabstop=4 shiftwidth=4 tabstop=4:
+ */
@@ -40,11 +40,11 @@ static void switch_core_media_bug_destroy(switch_media_bug_t *bug)
 	switch_event_t *event = NULL;
 
 	if (bug->raw_read_buffer) {
-		switch_buffer_destroy(&bug->raw_read_buffer);
+		switch_ringbuffer_destroy(&bug->raw_read_buffer);
 	}
 
 	if (bug->raw_write_buffer) {
-		switch_buffer_destroy(&bug->raw_write_buffer);
+		switch_ringbuffer_destroy(&bug->raw_write_buffer);
 	}
 
 	if (switch_core_codec_ready(&bug->session->bug_codec)) {
@@ -117,29 +117,30 @@ SWITCH_DECLARE(void *) switch_core_media_bug_get_user_data(switch_media_bug_t *b
 
 SWITCH_DECLARE(void) switch_core_media_bug_flush(switch_media_bug_t *bug)
 {
+	/* zeroing is a consumer side operation on the ring, serialize it with switch_core_media_bug_read */
 	if (bug->raw_read_buffer) {
-		switch_buffer_zero(bug->raw_read_buffer);
+		switch_mutex_lock(bug->read_mutex);
+		switch_ringbuffer_zero(bug->raw_read_buffer);
+		switch_mutex_unlock(bug->read_mutex);
 	}
 
 	if (bug->raw_write_buffer) {
-		switch_buffer_zero(bug->raw_write_buffer);
+		switch_mutex_lock(bug->write_mutex);
+		switch_ringbuffer_zero(bug->raw_write_buffer);
+		switch_mutex_unlock(bug->write_mutex);
 	}
 }
 
 SWITCH_DECLARE(void) switch_core_media_bug_inuse(switch_media_bug_t *bug, switch_size_t *readp, switch_size_t *writep)
 {
 	if (switch_test_flag(bug, SMBF_READ_STREAM)) {
-		switch_mutex_lock(bug->read_mutex);
-		*readp = bug->raw_read_buffer ? switch_buffer_inuse(bug->raw_read_buffer) : 0;
-		switch_mutex_unlock(bug->read_mutex);
+		*readp = bug->raw_read_buffer ? switch_ringbuffer_inuse(bug->raw_read_buffer) : 0;
 	} else {
 		*readp = 0;
 	}
 
 	if (switch_test_flag(bug, SMBF_WRITE_STREAM)) {
-		switch_mutex_lock(bug->write_mutex);
-		*writep = bug->raw_write_buffer ? switch_buffer_inuse(bug->raw_write_buffer) : 0;
-		switch_mutex_unlock(bug->write_mutex);
+		*writep = bug->raw_write_buffer ? switch_ringbuffer_inuse(bug->raw_write_buffer) : 0;
 	} else {
 		*writep = 0;
 	}
@@ -175,19 +176,19 @@ SWITCH_DECLARE(switch_status_t) switch_core_media_bug_read(switch_media_bug_t *b
 	frame->flags = 0;
 	frame->datalen = 0;
 
-	if (!switch_buffer_inuse(bug->raw_read_buffer)) {
+	if (!switch_ringbuffer_inuse(bug->raw_read_buffer)) {
 		return SWITCH_STATUS_FALSE;
 	}
 
 	switch_mutex_lock(bug->read_mutex);
-	frame->datalen = (uint32_t) switch_buffer_read(bug->raw_read_buffer, frame->data, bytes);
+	frame->datalen = (uint32_t) switch_ringbuffer_read(bug->raw_read_buffer, frame->data, bytes);
 	ttl += frame->datalen;
 	switch_mutex_unlock(bug->read_mutex);
 
 	if (switch_test_flag(bug, SMBF_WRITE_STREAM)) {
 		switch_assert(bug->raw_write_buffer);
 		switch_mutex_lock(bug->write_mutex);
-		datalen = (uint32_t) switch_buffer_read(bug->raw_write_buffer, bug->data, bytes);
+		datalen = (uint32_t) switch_ringbuffer_read(bug->raw_write_buffer, bug->data, bytes);
 		ttl += datalen;
 		if (fill && datalen < bytes) {
 			memset(((unsigned char *) bug->data) + datalen, 0, bytes - datalen);
@@ -253,6 +254,22 @@ SWITCH_DECLARE(switch_status_t) switch_core_media_bug_read(switch_media_bug_t *b
 }
 
 #define MAX_BUG_BUFFER 1024 * 512
+
+/* the raw rings are fixed size so give them a few seconds of headroom up front instead of growing on demand */
+static switch_status_t media_bug_ring_create(switch_ringbuffer_t **ring, switch_size_t bytes)
+{
+	switch_size_t len = bytes * SWITCH_BUFFER_START_FRAMES * 4;
+
+	if (len < SWITCH_RECOMMENDED_BUFFER_SIZE) {
+		len = SWITCH_RECOMMENDED_BUFFER_SIZE;
+	}
+
+	if (len > MAX_BUG_BUFFER) {
+		len = MAX_BUG_BUFFER;
+	}
+
+	return switch_ringbuffer_create(NULL, ring, len);
+}
 SWITCH_DECLARE(switch_status_t) switch_core_media_bug_add(switch_core_session_t *session,
 														  const char *function,
 														  const char *target,
@@ -337,14 +354,21 @@ SWITCH_DECLARE(switch_status_t) switch_core_media_bug_add(switch_core_session_t
 	}
 
 	if (switch_test_flag(bug, SMBF_READ_STREAM) || switch_test_flag(bug, SMBF_READ_PING)) {
-		switch_buffer_create_dynamic(&bug->raw_read_buffer, bytes * SWITCH_BUFFER_BLOCK_FRAMES, bytes * SWITCH_BUFFER_START_FRAMES, MAX_BUG_BUFFER);
+		if (media_bug_ring_create(&bug->raw_read_buffer, bytes) != SWITCH_STATUS_SUCCESS) {
+			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_CRIT, "Memory Error!\n");
+			return SWITCH_STATUS_MEMERR;
+		}
 		switch_mutex_init(&bug->read_mutex, SWITCH_MUTEX_NESTED, session->pool);
 	}
 
 	bytes = write_impl.decoded_bytes_per_packet;
 
 	if (switch_test_flag(bug, SMBF_WRITE_STREAM)) {
-		switch_buffer_create_dynamic(&bug->raw_write_buffer, bytes * SWITCH_BUFFER_BLOCK_FRAMES, bytes * SWITCH_BUFFER_START_FRAMES, MAX_BUG_BUFFER);
+		if (media_bug_ring_create(&bug->raw_write_buffer, bytes) != SWITCH_STATUS_SUCCESS) {
+			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_CRIT, "Memory Error!\n");
+			switch_ringbuffer_destroy(&bug->raw_read_buffer);
+			return SWITCH_STATUS_MEMERR;
+		}
 		switch_mutex_init(&bug->write_mutex, SWITCH_MUTEX_NESTED, session->pool);
 	}
 
@@ -381,6 +405,22 @@ SWITCH_DECLARE(switch_status_t) switch_core_media_bug_add(switch_core_session_t
 }
 
 
+SWITCH_DECLARE(uint32_t) switch_core_media_bug_count(switch_core_session_t *session)
+{
+	switch_media_bug_t *bp;
+	uint32_t x = 0;
+
+	if (session->bugs) {
+		switch_thread_rwlock_rdlock(session->bug_rwlock);
+		for (bp = session->bugs; bp; bp = bp->next) {
+			x++;
+		}
+		switch_thread_rwlock_unlock(session->bug_rwlock);
+	}
+
+	return x;
+}
+
 SWITCH_DECLARE(switch_status_t) switch_core_media_bug_flush_all(switch_core_session_t *session)
 {
 	switch_media_bug_t *bp;
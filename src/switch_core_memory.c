@@ -46,6 +46,9 @@
 #define PER_POOL_LOCK 1
 #endif
 
+#define SWITCH_MAX_MEMORY_ARENAS 64
+#define MEMORY_SITE_SLOTS 4096
+
 static struct {
 #ifdef USE_MEM_LOCK
 	switch_mutex_t *mem_lock;
@@ -54,8 +57,94 @@ static struct {
 	switch_queue_t *pool_recycle_queue;
 	switch_memory_pool_t *memory_pool;
 	int pool_thread_running;
+	/* shared allocators new pools draw their blocks from, picked by thread so a thread keeps reusing the blocks it freed */
+	apr_allocator_t *arenas[SWITCH_MAX_MEMORY_ARENAS];
+	uint64_t arena_pools[SWITCH_MAX_MEMORY_ARENAS];
+	uint32_t arena_count;
+	uint32_t arena_max_free;
+	/* unlocked, good enough for a report */
+	uint64_t pools_created;
+	uint64_t pools_destroyed;
 } memory_manager;
 
+typedef struct {
+	const char *file;
+	const char *func;
+	int line;
+	uint64_t count;
+	uint64_t bytes;
+} memory_site_t;
+
+/* per call site accounting of session pool allocations, only paid for while enabled */
+static struct {
+	switch_mutex_t *mutex;
+	int enabled;
+	switch_time_t started;
+	memory_site_t sites[MEMORY_SITE_SLOTS];
+	uint32_t site_count;
+	uint64_t dropped;
+	uint64_t sessions;
+	uint64_t sessions_done;
+	uint64_t session_bytes;
+	uint64_t session_max;
+} memory_telemetry;
+
+static void memory_telemetry_add(switch_core_session_t *session, switch_memory_pool_t *pool, switch_size_t memory, const char *file, const char *func,
+								 int line)
+{
+	memory_site_t *site = NULL;
+	uint32_t hash, i;
+
+	if (!session && !(pool && (session = switch_core_memory_pool_get_data(pool, "__session")))) {
+		return;
+	}
+
+	hash = (uint32_t) (((uintptr_t) file >> 3) ^ ((uint32_t) line * 2654435761U));
+
+	switch_mutex_lock(memory_telemetry.mutex);
+
+	if (!memory_telemetry.enabled) {
+		goto end;
+	}
+
+	/* file and func are string literals so the pointers identify the site */
+	for (i = 0; i < MEMORY_SITE_SLOTS; i++) {
+		memory_site_t *s = &memory_telemetry.sites[(hash + i) & (MEMORY_SITE_SLOTS - 1)];
+
+		if (!s->file) {
+			if (memory_telemetry.site_count < MEMORY_SITE_SLOTS / 2) {
+				s->file = file;
+				s->func = func;
+				s->line = line;
+				memory_telemetry.site_count++;
+				site = s;
+			}
+			break;
+		}
+
+		if (s->file == file && s->line == line) {
+			site = s;
+			break;
+		}
+	}
+
+	if (site) {
+		site->count++;
+		site->bytes += memory;
+	} else {
+		memory_telemetry.dropped += memory;
+	}
+
+	if (session->mem_tracked) {
+		session->mem_bytes += memory;
+	}
+
+  end:
+	switch_mutex_unlock(memory_telemetry.mutex);
+}
+
+#define MEMORY_TELEMETRY(_session, _pool, _memory) if (memory_telemetry.enabled) memory_telemetry_add(_session, _pool, _memory, file, func, line)
+
 SWITCH_DECLARE(switch_memory_pool_t *) switch_core_session_get_pool(switch_core_session_t *session)
 {
 	switch_assert(session != NULL);
@@ -89,6 +178,8 @@ SWITCH_DECLARE(void *) switch_core_perform_session_alloc(switch_core_session_t *
 
 	memset(ptr, 0, memory);
 
+	MEMORY_TELEMETRY(session, NULL, memory);
+
 #ifdef LOCK_MORE
 #ifdef USE_MEM_LOCK
 	switch_mutex_unlock(memory_manager.mem_lock);
@@ -172,7 +263,7 @@ SWITCH_DECLARE(char *) switch_core_session_sprintf(switch_core_session_t *sessio
 	char *result = NULL;
 
 	va_start(ap, fmt);
-	result = switch_core_vsprintf(session->pool, fmt, ap);
+	result = switch_core_session_vsprintf(session, fmt, ap);
 	va_end(ap);
 
 	return result;
@@ -180,7 +271,14 @@ SWITCH_DECLARE(char *) switch_core_session_sprintf(switch_core_session_t *sessio
 
 SWITCH_DECLARE(char *) switch_core_session_vsprintf(switch_core_session_t *session, const char *fmt, va_list ap)
 {
-	return switch_core_vsprintf(session->pool, fmt, ap);
+	char *result = switch_core_vsprintf(session->pool, fmt, ap);
+
+	/* there is no call site to hand down here, these are all booked against the sprintf itself */
+	if (memory_telemetry.enabled) {
+		memory_telemetry_add(session, NULL, strlen(result) + 1, __FILE__, "switch_core_session_sprintf", __LINE__);
+	}
+
+	return result;
 }
 
 SWITCH_DECLARE(char *) switch_core_vsprintf(switch_memory_pool_t *pool, const char *fmt, va_list ap)
@@ -252,6 +350,8 @@ SWITCH_DECLARE(char *) switch_core_perform_session_strdup(switch_core_session_t
 	duped = apr_pstrdup(session->pool, todup);
 	switch_assert(duped != NULL);
 
+	MEMORY_TELEMETRY(session, NULL, strlen(duped) + 1);
+
 #ifdef LOCK_MORE
 #ifdef USE_MEM_LOCK
 	switch_mutex_unlock(memory_manager.mem_lock);
@@ -290,6 +390,8 @@ SWITCH_DECLARE(char *) switch_core_perform_strdup(switch_memory_pool_t *pool, co
 	duped = apr_pstrmemdup(pool, todup, len);
 	switch_assert(duped != NULL);
 
+	MEMORY_TELEMETRY(NULL, pool, len);
+
 #ifdef LOCK_MORE
 #ifdef USE_MEM_LOCK
 	switch_mutex_unlock(memory_manager.mem_lock);
@@ -345,22 +447,44 @@ SWITCH_DECLARE(switch_status_t) switch_core_perform_new_memory_pool(switch_memor
 #endif
 
 #ifdef PER_POOL_LOCK
-		if ((apr_allocator_create(&my_allocator)) != APR_SUCCESS) {
-			abort();
-		}
+		if (memory_manager.arena_count) {
+			uintptr_t tid = (uintptr_t) switch_thread_self();
+			uint32_t idx;
+
+			tid ^= tid >> 16;
+			tid *= 0x45d9f3b;
+			tid ^= tid >> 16;
+			idx = (uint32_t) (tid % memory_manager.arena_count);
+
+			/* the pool gets its own lock for palloc, the arena lock only covers handing out and taking back blocks */
+			if ((apr_pool_create_ex(pool, NULL, NULL, memory_manager.arenas[idx])) != APR_SUCCESS) {
+				abort();
+			}
 
-		if ((apr_pool_create_ex(pool, NULL, NULL, my_allocator)) != APR_SUCCESS) {
-			abort();
-		}
+			if ((apr_thread_mutex_create(&my_mutex, APR_THREAD_MUTEX_NESTED, *pool)) != APR_SUCCESS) {
+				abort();
+			}
 
-		if ((apr_thread_mutex_create(&my_mutex, APR_THREAD_MUTEX_NESTED, *pool)) != APR_SUCCESS) {
-			abort();
-		}
+			apr_pool_mutex_set(*pool, my_mutex);
+			memory_manager.arena_pools[idx]++;
+		} else {
+			if ((apr_allocator_create(&my_allocator)) != APR_SUCCESS) {
+				abort();
+			}
 
-		apr_allocator_mutex_set(my_allocator, my_mutex);
-		apr_allocator_owner_set(my_allocator, *pool);
+			if ((apr_pool_create_ex(pool, NULL, NULL, my_allocator)) != APR_SUCCESS) {
+				abort();
+			}
 
-		apr_pool_mutex_set(*pool, my_mutex);
+			if ((apr_thread_mutex_create(&my_mutex, APR_THREAD_MUTEX_NESTED, *pool)) != APR_SUCCESS) {
+				abort();
+			}
+
+			apr_allocator_mutex_set(my_allocator, my_mutex);
+			apr_allocator_owner_set(my_allocator, *pool);
+
+			apr_pool_mutex_set(*pool, my_mutex);
+		}
 
 #else
 		apr_pool_create(pool, NULL);
@@ -374,6 +498,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_perform_new_memory_pool(switch_memor
 #endif
 	tmp = switch_core_sprintf(*pool, "%s:%d", file, line);
 	apr_pool_tag(*pool, tmp);
+	memory_manager.pools_created++;
 
 
 #ifdef USE_MEM_LOCK
@@ -383,12 +508,43 @@ SWITCH_DECLARE(switch_status_t) switch_core_perform_new_memory_pool(switch_memor
 	return SWITCH_STATUS_SUCCESS;
 }
 
+/* a pool's own lock is normally allocated in the pool, which apr_pool_clear would destroy while holding it,
+   so a clearable pool borrows a lock from its parent and is torn down with it */
+SWITCH_DECLARE(switch_status_t) switch_core_perform_new_clearable_memory_pool(switch_memory_pool_t **pool, switch_memory_pool_t *parent,
+																			  const char *file, const char *func, int line)
+{
+	apr_thread_mutex_t *my_mutex;
+
+	switch_assert(pool != NULL);
+	switch_assert(parent != NULL);
+
+	if ((apr_pool_create_ex(pool, parent, NULL, NULL)) != APR_SUCCESS) {
+		abort();
+	}
+
+	if ((apr_thread_mutex_create(&my_mutex, APR_THREAD_MUTEX_NESTED, parent)) != APR_SUCCESS) {
+		abort();
+	}
+
+	apr_pool_mutex_set(*pool, my_mutex);
+	apr_pool_tag(*pool, switch_core_sprintf(parent, "%s:%d", file, line));
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+SWITCH_DECLARE(void) switch_core_memory_pool_clear(switch_memory_pool_t *pool)
+{
+	switch_assert(pool != NULL);
+	apr_pool_clear(pool);
+}
+
 SWITCH_DECLARE(switch_status_t) switch_core_perform_destroy_memory_pool(switch_memory_pool_t **pool, const char *file, const char *func, int line)
 {
 	switch_assert(pool != NULL);
 	if (switch_core_memory_pool_get_data(*pool, "_in_thread")) {
 		switch_cache_db_detach();
 	}
+	memory_manager.pools_destroyed++;
 #ifdef DEBUG_ALLOC2
 	switch_log_printf(SWITCH_CHANNEL_ID_LOG, file, func, line, NULL, SWITCH_LOG_CONSOLE, "Free Pool\n");
 #endif
@@ -440,6 +596,8 @@ SWITCH_DECLARE(void *) switch_core_perform_alloc(switch_memory_pool_t *pool, swi
 	switch_assert(ptr != NULL);
 	memset(ptr, 0, memory);
 
+	MEMORY_TELEMETRY(NULL, pool, memory);
+
 #ifdef LOCK_MORE
 #ifdef USE_MEM_LOCK
 	switch_mutex_unlock(memory_manager.mem_lock);
@@ -631,6 +789,209 @@ switch_memory_pool_t *switch_core_memory_init(void)
 	return memory_manager.memory_pool;
 }
 
+void switch_core_memory_arena_init(void)
+{
+#ifdef PER_POOL_LOCK
+	apr_thread_mutex_t *my_mutex;
+	uint32_t i, count = runtime.memory_arenas;
+
+	switch_mutex_init(&memory_telemetry.mutex, SWITCH_MUTEX_NESTED, memory_manager.memory_pool);
+
+	if (memory_manager.arena_count) {
+		return;
+	}
+
+	if (count > SWITCH_MAX_MEMORY_ARENAS) {
+		count = SWITCH_MAX_MEMORY_ARENAS;
+	}
+
+	for (i = 0; i < count; i++) {
+		if ((apr_allocator_create(&memory_manager.arenas[i])) != APR_SUCCESS) {
+			abort();
+		}
+
+		if ((apr_thread_mutex_create(&my_mutex, APR_THREAD_MUTEX_NESTED, memory_manager.memory_pool)) != APR_SUCCESS) {
+			abort();
+		}
+
+		apr_allocator_mutex_set(memory_manager.arenas[i], my_mutex);
+
+		/* blocks freed past this go back to the system instead of staying cached for the next pool */
+		if (runtime.memory_arena_max_free) {
+			apr_allocator_max_free_set(memory_manager.arenas[i], (apr_size_t) runtime.memory_arena_max_free * 1024);
+		}
+	}
+
+	memory_manager.arena_max_free = runtime.memory_arena_max_free;
+	memory_manager.arena_count = count;
+#else
+	switch_mutex_init(&memory_telemetry.mutex, SWITCH_MUTEX_NESTED, memory_manager.memory_pool);
+#endif
+
+	if (runtime.memory_telemetry) {
+		switch_core_memory_telemetry(SWITCH_TRUE);
+	}
+}
+
+SWITCH_DECLARE(void) switch_core_memory_telemetry(switch_bool_t on)
+{
+	if (!memory_telemetry.mutex) {
+		return;
+	}
+
+	switch_mutex_lock(memory_telemetry.mutex);
+	if (on && !memory_telemetry.enabled) {
+		memory_telemetry.started = switch_micro_time_now();
+	}
+	memory_telemetry.enabled = on ? 1 : 0;
+	switch_mutex_unlock(memory_telemetry.mutex);
+}
+
+SWITCH_DECLARE(void) switch_core_memory_telemetry_reset(void)
+{
+	if (!memory_telemetry.mutex) {
+		return;
+	}
+
+	switch_mutex_lock(memory_telemetry.mutex);
+	memset(memory_telemetry.sites, 0, sizeof(memory_telemetry.sites));
+	memory_telemetry.site_count = 0;
+	memory_telemetry.dropped = 0;
+	memory_telemetry.sessions = 0;
+	memory_telemetry.sessions_done = 0;
+	memory_telemetry.session_bytes = 0;
+	memory_telemetry.session_max = 0;
+	memory_telemetry.started = switch_micro_time_now();
+	switch_mutex_unlock(memory_telemetry.mutex);
+}
+
+void switch_core_memory_session_start(switch_core_session_t *session)
+{
+	if (!memory_telemetry.enabled) {
+		return;
+	}
+
+	switch_mutex_lock(memory_telemetry.mutex);
+	if (memory_telemetry.enabled) {
+		session->mem_tracked = 1;
+		memory_telemetry.sessions++;
+	}
+	switch_mutex_unlock(memory_telemetry.mutex);
+}
+
+void switch_core_memory_session_end(switch_core_session_t *session)
+{
+	if (!session->mem_tracked) {
+		return;
+	}
+
+	switch_mutex_lock(memory_telemetry.mutex);
+	memory_telemetry.sessions_done++;
+	memory_telemetry.session_bytes += session->mem_bytes;
+	if (session->mem_bytes > memory_telemetry.session_max) {
+		memory_telemetry.session_max = session->mem_bytes;
+	}
+	switch_mutex_unlock(memory_telemetry.mutex);
+}
+
+static int memory_site_file_cmp(const void *a, const void *b)
+{
+	const memory_site_t *sa = (const memory_site_t *) a, *sb = (const memory_site_t *) b;
+	int r = strcmp(switch_cut_path(sa->file), switch_cut_path(sb->file));
+
+	return r ? r : sa->line - sb->line;
+}
+
+static int memory_site_bytes_cmp(const void *a, const void *b)
+{
+	const memory_site_t *sa = (const memory_site_t *) a, *sb = (const memory_site_t *) b;
+
+	if (sa->bytes == sb->bytes) {
+		return 0;
+	}
+
+	return sa->bytes < sb->bytes ? 1 : -1;
+}
+
+SWITCH_DECLARE(void) switch_core_memory_report(switch_stream_handle_t *stream, uint32_t top)
+{
+	memory_site_t *sites, *files;
+	uint32_t i, n = 0, nfiles = 0;
+	uint64_t calls, total = 0;
+
+	stream->write_function(stream, "arenas: %u max-free: %uKB pools created: %" SWITCH_UINT64_T_FMT " destroyed: %" SWITCH_UINT64_T_FMT
+						   " awaiting destroy: %u\n",
+						   memory_manager.arena_count, memory_manager.arena_max_free, memory_manager.pools_created, memory_manager.pools_destroyed,
+						   memory_manager.pool_queue ? switch_queue_size(memory_manager.pool_queue) : 0);
+
+	for (i = 0; i < memory_manager.arena_count; i++) {
+		stream->write_function(stream, "  arena %-3u pools: %" SWITCH_UINT64_T_FMT "\n", i, memory_manager.arena_pools[i]);
+	}
+
+	if (!memory_telemetry.mutex) {
+		return;
+	}
+
+	switch_zmalloc(sites, sizeof(memory_telemetry.sites));
+	switch_zmalloc(files, sizeof(memory_telemetry.sites));
+
+	switch_mutex_lock(memory_telemetry.mutex);
+	for (i = 0; i < MEMORY_SITE_SLOTS; i++) {
+		if (memory_telemetry.sites[i].file) {
+			sites[n++] = memory_telemetry.sites[i];
+			total += memory_telemetry.sites[i].bytes;
+		}
+	}
+
+	stream->write_function(stream, "\ntelemetry: %s for %" SWITCH_INT64_T_FMT "s sessions: %" SWITCH_UINT64_T_FMT " finished: %" SWITCH_UINT64_T_FMT
+						   " avg-bytes/session: %" SWITCH_UINT64_T_FMT " max-bytes/session: %" SWITCH_UINT64_T_FMT " unsited-bytes: %" SWITCH_UINT64_T_FMT "\n",
+						   memory_telemetry.enabled ? "on" : "off",
+						   memory_telemetry.started ? (int64_t) ((switch_micro_time_now() - memory_telemetry.started) / 1000000) : (int64_t) 0,
+						   memory_telemetry.sessions, memory_telemetry.sessions_done,
+						   memory_telemetry.sessions_done ? memory_telemetry.session_bytes / memory_telemetry.sessions_done : 0,
+						   memory_telemetry.session_max, memory_telemetry.dropped);
+	calls = memory_telemetry.sessions ? memory_telemetry.sessions : 1;
+	switch_mutex_unlock(memory_telemetry.mutex);
+
+	/* roll the sites up per source file, which is as close to per module as the call sites get */
+	qsort(sites, n, sizeof(*sites), memory_site_file_cmp);
+
+	for (i = 0; i < n; i++) {
+		if (!nfiles || strcmp(switch_cut_path(files[nfiles - 1].file), switch_cut_path(sites[i].file))) {
+			files[nfiles].file = sites[i].file;
+			nfiles++;
+		}
+		files[nfiles - 1].count += sites[i].count;
+		files[nfiles - 1].bytes += sites[i].bytes;
+	}
+
+	qsort(files, nfiles, sizeof(*files), memory_site_bytes_cmp);
+	qsort(sites, n, sizeof(*sites), memory_site_bytes_cmp);
+
+	stream->write_function(stream, "\n%-40s %12s %14s %12s %7s\n", "file", "allocs", "bytes", "bytes/call", "share");
+	for (i = 0; i < nfiles; i++) {
+		stream->write_function(stream, "%-40s %12" SWITCH_UINT64_T_FMT " %14" SWITCH_UINT64_T_FMT " %12" SWITCH_UINT64_T_FMT " %6.2f%%\n",
+							   switch_cut_path(files[i].file), files[i].count, files[i].bytes, files[i].bytes / calls,
+							   total ? (double) files[i].bytes * 100 / total : 0.0);
+	}
+
+	if (top && top < n) {
+		n = top;
+	}
+
+	stream->write_function(stream, "\n%-56s %12s %14s %12s %10s\n", "call site", "allocs", "bytes", "bytes/call", "avg-size");
+	for (i = 0; i < n; i++) {
+		char where[256];
+
+		switch_snprintf(where, sizeof(where), "%s:%d %s", switch_cut_path(sites[i].file), sites[i].line, sites[i].func);
+		stream->write_function(stream, "%-56s %12" SWITCH_UINT64_T_FMT " %14" SWITCH_UINT64_T_FMT " %12" SWITCH_UINT64_T_FMT " %10" SWITCH_UINT64_T_FMT "\n",
+							   where, sites[i].count, sites[i].bytes, sites[i].bytes / calls, sites[i].count ? sites[i].bytes / sites[i].count : 0);
+	}
+
+	free(sites);
+	free(files);
+}
+
 /* For Emacs:
  * Local Variables:
  * mode:c
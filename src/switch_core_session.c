@@ -1068,7 +1068,9 @@ SWITCH_DECLARE(void) switch_core_session_perform_destroy(switch_core_session_t *
 	switch_buffer_destroy(&(*session)->raw_read_buffer);
 	switch_buffer_destroy(&(*session)->raw_write_buffer);
 	switch_ivr_clear_speech_cache(*session);
+	switch_core_latency_session_end(*session);
 	switch_channel_uninit((*session)->channel);
+	switch_core_memory_session_end(*session);
 
 	pool = (*session)->pool;
 	//#ifndef NDEBUG
@@ -1534,6 +1536,7 @@ SWITCH_DECLARE(switch_core_session_t *) switch_core_session_request_uuid(switch_
 	session->pool = usepool;
 
 	switch_core_memory_pool_set_data(session->pool, "__session", session);
+	switch_core_memory_session_start(session);
 
 	if (switch_channel_alloc(&session->channel, direction, session->pool) != SWITCH_STATUS_SUCCESS) {
 		abort();
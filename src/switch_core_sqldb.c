@@ -46,6 +46,10 @@ static struct {
 	switch_mutex_t *io_mutex;
 	switch_mutex_t *dbh_mutex;
 	switch_hash_t *dbh_hash;
+	struct cache_db_pool *pools;
+	uint32_t pool_max;
+	uint32_t pool_wait;
+	uint32_t health_interval;
 } sql_manager;
 
 
@@ -79,66 +83,149 @@ SWITCH_DECLARE(switch_status_t) _switch_core_db_handle(switch_cache_db_handle_t
 
 #define SQL_CACHE_TIMEOUT 300
 
+/* one pool per database/credential pair, handles are lent to a thread between get and release */
+typedef struct cache_db_pool {
+	char key[CACHE_DB_LEN];
+	char name[CACHE_DB_LEN];
+	switch_cache_db_handle_type_t type;
+	switch_mutex_t *mutex;
+	switch_thread_cond_t *cond;
+	switch_cache_db_handle_t *idle;
+	switch_cache_db_handle_t *busy;
+	uint32_t total;
+	uint32_t idle_count;
+	uint32_t busy_count;
+	uint32_t waiting;
+	uint64_t created;
+	uint64_t destroyed;
+	uint64_t acquired;
+	uint64_t waits;
+	uint64_t timeouts;
+	uint64_t health_failures;
+	switch_time_t wait_total;
+	switch_time_t wait_max;
+	struct cache_db_pool *next;
+} cache_db_pool_t;
+
+static void cache_db_close(switch_cache_db_handle_t *dbh)
+{
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG10, "Dropping DB connection %s\n", dbh->name);
+
+	switch (dbh->type) {
+	case SCDB_TYPE_ODBC:
+		{
+			switch_odbc_handle_destroy(&dbh->native_handle.odbc_dbh);
+		}
+		break;
+	case SCDB_TYPE_CORE_DB:
+		{
+			switch_core_db_close(dbh->native_handle.core_db_dbh);
+			dbh->native_handle.core_db_dbh = NULL;
+		}
+		break;
+	}
+
+	switch_core_destroy_memory_pool(&dbh->pool);
+}
+
+/* must be called with the pool mutex held */
+static void cache_db_unlink(switch_cache_db_handle_t **list, switch_cache_db_handle_t *dbh)
+{
+	switch_cache_db_handle_t *dp, *last = NULL;
+
+	for (dp = *list; dp; dp = dp->next) {
+		if (dp == dbh) {
+			if (last) {
+				last->next = dp->next;
+			} else {
+				*list = dp->next;
+			}
+			dp->next = NULL;
+			break;
+		}
+		last = dp;
+	}
+}
+
+static cache_db_pool_t *cache_db_get_pool(const char *key, const char *db_name, const char *db_user, switch_cache_db_handle_type_t type)
+{
+	cache_db_pool_t *dbp;
+
+	switch_mutex_lock(sql_manager.dbh_mutex);
+	if (!(dbp = switch_core_hash_find(sql_manager.dbh_hash, key))) {
+		dbp = switch_core_alloc(sql_manager.memory_pool, sizeof(*dbp));
+		switch_set_string(dbp->key, key);
+		snprintf(dbp->name, sizeof(dbp->name) - 1, "db=\"%s\";user=\"%s\"", db_name, db_user);
+		dbp->type = type;
+		switch_mutex_init(&dbp->mutex, SWITCH_MUTEX_NESTED, sql_manager.memory_pool);
+		switch_thread_cond_create(&dbp->cond, sql_manager.memory_pool);
+		switch_core_hash_insert(sql_manager.dbh_hash, dbp->key, dbp);
+		dbp->next = sql_manager.pools;
+		sql_manager.pools = dbp;
+	}
+	switch_mutex_unlock(sql_manager.dbh_mutex);
+
+	return dbp;
+}
+
 static void sql_close(time_t prune)
 {
-	switch_hash_index_t *hi;
-	const void *var;
-	void *val;
-	switch_cache_db_handle_t *dbh = NULL;
-	int locked = 0;
-	char *key;
+	cache_db_pool_t *dbp;
+	switch_cache_db_handle_t *dbh, *next, *keep, *drop;
+	int tries;
 
 	switch_mutex_lock(sql_manager.dbh_mutex);
-  top:
-	locked = 0;
 
-	for (hi = switch_hash_first(NULL, sql_manager.dbh_hash); hi; hi = switch_hash_next(hi)) {
-		switch_hash_this(hi, &var, NULL, &val);
-		key = (char *) var;
+	for (dbp = sql_manager.pools; dbp; dbp = dbp->next) {
+		switch_mutex_lock(dbp->mutex);
 
-		if ((dbh = (switch_cache_db_handle_t *) val)) {
+		/* on shutdown give borrowed handles up to 5 seconds to come back so their connections get closed */
+		for (tries = 0; !prune && dbp->busy_count && tries < 50; tries++) {
+			if (!tries) {
+				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Waiting for %u DB handle(s) on %s\n", dbp->busy_count, dbp->name);
+			}
+			switch_thread_cond_timedwait(dbp->cond, dbp->mutex, 100000);
+		}
+
+		keep = drop = NULL;
+		for (dbh = dbp->idle; dbh; dbh = next) {
 			time_t diff = 0;
 
+			next = dbh->next;
+
 			if (prune > 0 && prune > dbh->last_used) {
 				diff = (time_t) prune - dbh->last_used;
 			}
 
 			if (prune > 0 && diff < SQL_CACHE_TIMEOUT) {
-				continue;
+				dbh->next = keep;
+				keep = dbh;
+			} else {
+				dbh->next = drop;
+				drop = dbh;
+				dbp->idle_count--;
+				dbp->total--;
+				dbp->destroyed++;
 			}
+		}
 
-			if (switch_mutex_trylock(dbh->mutex) == SWITCH_STATUS_SUCCESS) {
-				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG10, "Dropping idle DB connection %s\n", key);
-
-				switch (dbh->type) {
-				case SCDB_TYPE_ODBC:
-					{
-						switch_odbc_handle_destroy(&dbh->native_handle.odbc_dbh);
-					}
-					break;
-				case SCDB_TYPE_CORE_DB:
-					{
-						switch_core_db_close(dbh->native_handle.core_db_dbh);
-						dbh->native_handle.core_db_dbh = NULL;
-					}
-					break;
-				}
-
-				switch_core_hash_delete(sql_manager.dbh_hash, key);
-				switch_mutex_unlock(dbh->mutex);
-				switch_core_destroy_memory_pool(&dbh->pool);
-				goto top;
+		/* keep the most recently used handles on top */
+		dbp->idle = NULL;
+		for (dbh = keep; dbh; dbh = next) {
+			next = dbh->next;
+			dbh->next = dbp->idle;
+			dbp->idle = dbh;
+		}
 
-			} else {
-				if (!prune)
-					locked++;
-				continue;
-			}
+		if (drop) {
+			switch_thread_cond_broadcast(dbp->cond);
 		}
-	}
+		switch_mutex_unlock(dbp->mutex);
 
-	if (locked) {
-		goto top;
+		for (dbh = drop; dbh; dbh = next) {
+			next = dbh->next;
+			cache_db_close(dbh);
+		}
 	}
 
 	switch_mutex_unlock(sql_manager.dbh_mutex);
@@ -154,8 +241,23 @@ SWITCH_DECLARE(void) switch_cache_db_flush_handles(void)
 
 SWITCH_DECLARE(void) switch_cache_db_release_db_handle(switch_cache_db_handle_t ** dbh)
 {
+	cache_db_pool_t *dbp;
+
 	if (dbh && *dbh) {
-		switch_mutex_unlock((*dbh)->mutex);
+		dbp = (cache_db_pool_t *) (*dbh)->dsn_pool;
+
+		switch_mutex_lock(dbp->mutex);
+		if (!--(*dbh)->refs) {
+			cache_db_unlink(&dbp->busy, *dbh);
+			dbp->busy_count--;
+			switch_clear_flag((*dbh), CDF_INUSE);
+			(*dbh)->last_used = switch_epoch_time_now(NULL);
+			(*dbh)->next = dbp->idle;
+			dbp->idle = *dbh;
+			dbp->idle_count++;
+			switch_thread_cond_signal(dbp->cond);
+		}
+		switch_mutex_unlock(dbp->mutex);
 		*dbh = NULL;
 	}
 }
@@ -163,74 +265,156 @@ SWITCH_DECLARE(void) switch_cache_db_release_db_handle(switch_cache_db_handle_t
 
 SWITCH_DECLARE(void) switch_cache_db_destroy_db_handle(switch_cache_db_handle_t ** dbh)
 {
+	cache_db_pool_t *dbp;
+
 	if (dbh && *dbh) {
-		switch_mutex_lock(sql_manager.dbh_mutex);
-		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG10, "Deleting DB connection %s\n", (*dbh)->name);
+		dbp = (cache_db_pool_t *) (*dbh)->dsn_pool;
 
-		switch ((*dbh)->type) {
-		case SCDB_TYPE_ODBC:
-			{
-				switch_odbc_handle_destroy(&(*dbh)->native_handle.odbc_dbh);
-			}
-			break;
-		case SCDB_TYPE_CORE_DB:
-			{
-				switch_core_db_close((*dbh)->native_handle.core_db_dbh);
-				(*dbh)->native_handle.core_db_dbh = NULL;
-			}
-			break;
-		}
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG10, "Deleting DB connection %s\n", (*dbh)->name);
 
+		switch_mutex_lock(dbp->mutex);
+		cache_db_unlink(&dbp->busy, *dbh);
+		dbp->busy_count--;
+		dbp->total--;
+		dbp->destroyed++;
+		switch_thread_cond_signal(dbp->cond);
+		switch_mutex_unlock(dbp->mutex);
 
-		switch_core_hash_delete(sql_manager.dbh_hash, (*dbh)->name);
-		switch_mutex_unlock((*dbh)->mutex);
-		switch_core_destroy_memory_pool(&(*dbh)->pool);
+		cache_db_close(*dbh);
 		*dbh = NULL;
-		switch_mutex_unlock(sql_manager.dbh_mutex);
 	}
 }
 
 SWITCH_DECLARE(void) switch_cache_db_detach(void)
 {
-	char thread_str[CACHE_DB_LEN] = "";
-	switch_hash_index_t *hi;
-	const void *var;
-	void *val;
-	char *key;
-	switch_cache_db_handle_t *dbh = NULL;
-
-	snprintf(thread_str, sizeof(thread_str) - 1, "%lu", (unsigned long) (intptr_t) switch_thread_self());
+	switch_thread_id_t self = switch_thread_self();
+	cache_db_pool_t *dbp;
+	switch_cache_db_handle_t *dbh, *next;
+
 	switch_mutex_lock(sql_manager.dbh_mutex);
 
-	for (hi = switch_hash_first(NULL, sql_manager.dbh_hash); hi; hi = switch_hash_next(hi)) {
-		switch_hash_this(hi, &var, NULL, &val);
-		key = (char *) var;
-		if ((dbh = (switch_cache_db_handle_t *) val)) {
-			if (switch_mutex_trylock(dbh->mutex) == SWITCH_STATUS_SUCCESS) {
-				if (strstr(dbh->name, thread_str)) {
-					switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG10,
-									  "Detach cached DB handle %s [%s]\n", thread_str, switch_cache_db_type_name(dbh->type));
-					switch_clear_flag(dbh, CDF_INUSE);
-				}
-				switch_mutex_unlock(dbh->mutex);
+	/* the thread is going away, take back whatever it never released */
+	for (dbp = sql_manager.pools; dbp; dbp = dbp->next) {
+		switch_mutex_lock(dbp->mutex);
+		for (dbh = dbp->busy; dbh; dbh = next) {
+			next = dbh->next;
+			if (dbh->owner == self) {
+				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG10,
+								  "Detach cached DB handle %s [%s]\n", dbh->name, switch_cache_db_type_name(dbh->type));
+				dbh->refs = 1;
+				switch_cache_db_release_db_handle(&dbh);
 			}
 		}
+		switch_mutex_unlock(dbp->mutex);
 	}
 
 	switch_mutex_unlock(sql_manager.dbh_mutex);
 }
 
+static switch_cache_db_handle_t *cache_db_open(switch_cache_db_handle_type_t type, switch_cache_db_connection_options_t *connection_options,
+											   const char *db_str, const char *file, const char *func, int line)
+{
+	switch_memory_pool_t *pool = NULL;
+	switch_core_db_t *db = NULL;
+	switch_odbc_handle_t *odbc_dbh = NULL;
+	switch_cache_db_handle_t *new_dbh = NULL;
+	switch_ssize_t hlen = -1;
+
+	switch (type) {
+	case SCDB_TYPE_ODBC:
+		{
+
+			if (!switch_odbc_available()) {
+				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "Failure! OBDC NOT AVAILABLE!\n");
+				return NULL;
+			}
+
+			if ((odbc_dbh = switch_odbc_handle_new(connection_options->odbc_options.dsn,
+												   connection_options->odbc_options.user, connection_options->odbc_options.pass))) {
+				if (switch_odbc_handle_connect(odbc_dbh) != SWITCH_ODBC_SUCCESS) {
+					switch_odbc_handle_destroy(&odbc_dbh);
+				}
+			}
+
+
+		}
+		break;
+	case SCDB_TYPE_CORE_DB:
+		{
+			db = switch_core_db_open_file(connection_options->core_db_options.db_path);
+		}
+		break;
+
+	default:
+		return NULL;
+	}
+
+	if (!db && !odbc_dbh) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "Failure!\n");
+		return NULL;
+	}
+
+	switch_log_printf(SWITCH_CHANNEL_ID_LOG, file, func, line, NULL, SWITCH_LOG_DEBUG10,
+					  "Create Cached DB handle %s [%s]\n", db_str, switch_cache_db_type_name(type));
+
+	switch_core_new_memory_pool(&pool);
+	new_dbh = switch_core_alloc(pool, sizeof(*new_dbh));
+	new_dbh->pool = pool;
+	new_dbh->type = type;
+	switch_set_string(new_dbh->name, db_str);
+	new_dbh->hash = switch_ci_hashfunc_default(db_str, &hlen);
+
+	if (db)
+		new_dbh->native_handle.core_db_dbh = db;
+	else
+		new_dbh->native_handle.odbc_dbh = odbc_dbh;
+	switch_mutex_init(&new_dbh->mutex, SWITCH_MUTEX_UNNESTED, new_dbh->pool);
+	snprintf(new_dbh->creator, sizeof(new_dbh->creator) - 1, "%s:%d", file, line);
+
+	return new_dbh;
+}
+
+/* liveness check for a handle that sat idle, the cached state can't see a connection the server dropped
+   so ping it with a real query and reconnect ODBC handles once before giving up on them, the ODBC ping
+   is the driver aware probe without the exec path's retry loop so a dead server can't hold the caller */
+static switch_bool_t cache_db_healthy(switch_cache_db_handle_t *dbh)
+{
+	char *err = NULL;
+	switch_bool_t ok;
+
+	if (dbh->type == SCDB_TYPE_CORE_DB) {
+		ok = switch_core_db_exec(dbh->native_handle.core_db_dbh, "SELECT 1", NULL, NULL, &err) == SWITCH_CORE_DB_OK ? SWITCH_TRUE : SWITCH_FALSE;
+		if (err) {
+			switch_core_db_free(err);
+		}
+		return ok;
+	}
+
+	if (switch_odbc_handle_ping(dbh->native_handle.odbc_dbh) == SWITCH_ODBC_SUCCESS) {
+		return SWITCH_TRUE;
+	}
+
+	switch_odbc_handle_disconnect(dbh->native_handle.odbc_dbh);
+
+	if (switch_odbc_handle_connect(dbh->native_handle.odbc_dbh) != SWITCH_ODBC_SUCCESS) {
+		return SWITCH_FALSE;
+	}
+
+	return switch_odbc_handle_ping(dbh->native_handle.odbc_dbh) == SWITCH_ODBC_SUCCESS ? SWITCH_TRUE : SWITCH_FALSE;
+}
+
 SWITCH_DECLARE(switch_status_t) _switch_cache_db_get_db_handle(switch_cache_db_handle_t ** dbh,
 															   switch_cache_db_handle_type_t type,
 															   switch_cache_db_connection_options_t *connection_options,
 															   const char *file, const char *func, int line)
 {
 	switch_thread_id_t self = switch_thread_self();
-	char thread_str[CACHE_DB_LEN] = "";
 	char db_str[CACHE_DB_LEN] = "";
 	char db_callsite_str[CACHE_DB_LEN] = "";
 	switch_cache_db_handle_t *new_dbh = NULL;
-	switch_ssize_t hlen = -1;
+	cache_db_pool_t *dbp;
+	switch_time_t start = 0, now, deadline = 0;
+	time_t idle_for;
 
 	const char *db_name = NULL;
 	const char *db_user = NULL;
@@ -258,111 +442,112 @@ SWITCH_DECLARE(switch_status_t) _switch_cache_db_get_db_handle(switch_cache_db_h
 	}
 
 	snprintf(db_str, sizeof(db_str) - 1, "db=\"%s\";user=\"%s\";pass=\"%s\"", db_name, db_user, db_pass);
-	snprintf(thread_str, sizeof(thread_str) - 1, "%s;thread=\"%lu\"", db_str, (unsigned long) (intptr_t) self);
 	snprintf(db_callsite_str, sizeof(db_callsite_str) - 1, "%s:%d", file, line);
 
-	switch_mutex_lock(sql_manager.dbh_mutex);
-	if ((new_dbh = switch_core_hash_find(sql_manager.dbh_hash, thread_str))) {
-		switch_set_string(new_dbh->last_user, db_callsite_str);
-		switch_log_printf(SWITCH_CHANNEL_ID_LOG, file, func, line, NULL, SWITCH_LOG_DEBUG10,
-						  "Reuse Cached DB handle %s [%s]\n", thread_str, switch_cache_db_type_name(new_dbh->type));
-	} else {
-		switch_hash_index_t *hi;
-		const void *var;
-		void *val;
-		char *key;
-		unsigned long hash = 0;
-
-		hash = switch_ci_hashfunc_default(db_str, &hlen);
-
-		for (hi = switch_hash_first(NULL, sql_manager.dbh_hash); hi; hi = switch_hash_next(hi)) {
-			switch_hash_this(hi, &var, NULL, &val);
-			key = (char *) var;
-
-			if ((new_dbh = (switch_cache_db_handle_t *) val)) {
-				if (hash == new_dbh->hash && !strncasecmp(new_dbh->name, db_str, strlen(db_str)) &&
-					!switch_test_flag(new_dbh, CDF_INUSE) && switch_mutex_trylock(new_dbh->mutex) == SWITCH_STATUS_SUCCESS) {
-					switch_set_flag(new_dbh, CDF_INUSE);
-					switch_set_string(new_dbh->name, thread_str);
-					new_dbh->hash = switch_ci_hashfunc_default(db_str, &hlen);
-					switch_set_string(new_dbh->last_user, db_callsite_str);
-					switch_log_printf(SWITCH_CHANNEL_ID_LOG, file, func, line, NULL, SWITCH_LOG_DEBUG10,
-									  "Reuse Unused Cached DB handle %s [%s]\n", thread_str, switch_cache_db_type_name(new_dbh->type));
-					break;
-				}
-			}
-			new_dbh = NULL;
-		}
-	}
+	dbp = cache_db_get_pool(db_str, db_name, switch_str_nil(db_user), type);
 
-	if (!new_dbh) {
-		switch_memory_pool_t *pool = NULL;
-		switch_core_db_t *db = NULL;
-		switch_odbc_handle_t *odbc_dbh = NULL;
+	switch_mutex_lock(dbp->mutex);
 
-		switch (type) {
-		case SCDB_TYPE_ODBC:
-			{
+	/* a thread asking again before it released its handle keeps using the same one */
+	for (new_dbh = dbp->busy; new_dbh; new_dbh = new_dbh->next) {
+		if (new_dbh->owner == self) {
+			new_dbh->refs++;
+			switch_log_printf(SWITCH_CHANNEL_ID_LOG, file, func, line, NULL, SWITCH_LOG_DEBUG10,
+							  "Reuse Cached DB handle %s [%s]\n", dbp->name, switch_cache_db_type_name(new_dbh->type));
+			goto end;
+		}
+	}
 
-				if (!switch_odbc_available()) {
-					switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "Failure! OBDC NOT AVAILABLE!\n");
-					goto end;
+	for (;;) {
+		if ((new_dbh = dbp->idle)) {
+			dbp->idle = new_dbh->next;
+			dbp->idle_count--;
+			new_dbh->next = NULL;
+
+			idle_for = switch_epoch_time_now(NULL) - new_dbh->last_used;
+			if (sql_manager.health_interval && idle_for >= (time_t) sql_manager.health_interval) {
+				switch_mutex_unlock(dbp->mutex);
+				if (!cache_db_healthy(new_dbh)) {
+					switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Dropping dead DB handle %s after %ld idle second(s)\n",
+									  dbp->name, (long) idle_for);
+					cache_db_close(new_dbh);
+					new_dbh = NULL;
 				}
-
-				if ((odbc_dbh = switch_odbc_handle_new(connection_options->odbc_options.dsn,
-													   connection_options->odbc_options.user, connection_options->odbc_options.pass))) {
-					if (switch_odbc_handle_connect(odbc_dbh) != SWITCH_ODBC_SUCCESS) {
-						switch_odbc_handle_destroy(&odbc_dbh);
-					}
+				switch_mutex_lock(dbp->mutex);
+				if (!new_dbh) {
+					dbp->total--;
+					dbp->destroyed++;
+					dbp->health_failures++;
+					continue;
 				}
-
-
 			}
+
+			switch_log_printf(SWITCH_CHANNEL_ID_LOG, file, func, line, NULL, SWITCH_LOG_DEBUG10,
+							  "Reuse Unused Cached DB handle %s [%s]\n", dbp->name, switch_cache_db_type_name(new_dbh->type));
 			break;
-		case SCDB_TYPE_CORE_DB:
-			{
-				db = switch_core_db_open_file(connection_options->core_db_options.db_path);
+		}
+
+		if (!sql_manager.pool_max || dbp->total < sql_manager.pool_max) {
+			/* reserve the slot and connect without holding the pool */
+			dbp->total++;
+			switch_mutex_unlock(dbp->mutex);
+			new_dbh = cache_db_open(type, connection_options, db_str, file, func, line);
+			switch_mutex_lock(dbp->mutex);
+
+			if (!new_dbh) {
+				dbp->total--;
+				switch_thread_cond_signal(dbp->cond);
+				goto end;
 			}
+
+			new_dbh->dsn_pool = dbp;
+			dbp->created++;
 			break;
+		}
 
-		default:
-			goto end;
+		now = switch_micro_time_now();
+		if (!start) {
+			start = now;
+			deadline = start + (switch_time_t) sql_manager.pool_wait * 1000;
+			dbp->waits++;
 		}
 
-		if (!db && !odbc_dbh) {
-			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "Failure!\n");
+		if (now >= deadline) {
+			dbp->timeouts++;
+			switch_log_printf(SWITCH_CHANNEL_ID_LOG, file, func, line, NULL, SWITCH_LOG_WARNING,
+							  "Timed out after %ums waiting for one of %u DB handle(s) on %s\n", sql_manager.pool_wait, dbp->total, dbp->name);
 			goto end;
 		}
 
-		switch_log_printf(SWITCH_CHANNEL_ID_LOG, file, func, line, NULL, SWITCH_LOG_DEBUG10,
-						  "Create Cached DB handle %s [%s]\n", thread_str, switch_cache_db_type_name(type));
-
-		switch_core_new_memory_pool(&pool);
-		new_dbh = switch_core_alloc(pool, sizeof(*new_dbh));
-		new_dbh->pool = pool;
-		new_dbh->type = type;
-		switch_set_string(new_dbh->name, thread_str);
-		switch_set_flag(new_dbh, CDF_INUSE);
-		new_dbh->hash = switch_ci_hashfunc_default(db_str, &hlen);
-
-
-		if (db)
-			new_dbh->native_handle.core_db_dbh = db;
-		else
-			new_dbh->native_handle.odbc_dbh = odbc_dbh;
-		switch_mutex_init(&new_dbh->mutex, SWITCH_MUTEX_UNNESTED, new_dbh->pool);
-		switch_set_string(new_dbh->creator, db_callsite_str);
-		switch_mutex_lock(new_dbh->mutex);
+		dbp->waiting++;
+		switch_thread_cond_timedwait(dbp->cond, dbp->mutex, deadline - now);
+		dbp->waiting--;
+	}
 
-		switch_core_hash_insert(sql_manager.dbh_hash, new_dbh->name, new_dbh);
+	if (start) {
+		now = switch_micro_time_now() - start;
+		dbp->wait_total += now;
+		if (now > dbp->wait_max) {
+			dbp->wait_max = now;
+		}
 	}
 
+	new_dbh->owner = self;
+	new_dbh->refs = 1;
+	switch_set_flag(new_dbh, CDF_INUSE);
+	new_dbh->next = dbp->busy;
+	dbp->busy = new_dbh;
+	dbp->busy_count++;
+	dbp->acquired++;
+
   end:
 
-	if (new_dbh)
+	if (new_dbh) {
+		switch_set_string(new_dbh->last_user, db_callsite_str);
 		new_dbh->last_used = switch_epoch_time_now(NULL);
+	}
 
-	switch_mutex_unlock(sql_manager.dbh_mutex);
+	switch_mutex_unlock(dbp->mutex);
 
 	*dbh = new_dbh;
 
@@ -817,6 +1002,9 @@ static void *SWITCH_THREAD_FUNC switch_core_sql_thread(switch_thread_t *thread,
 	uint32_t loops = 0, sec = 0;
 	uint32_t l1 = 1000;
 	uint32_t sanity = 120;
+	switch_profile_counter_t *prof_commit = switch_core_profile_counter("sql", "commit");
+	switch_profile_counter_t *prof_stmt = switch_core_profile_counter("sql", "statement");
+	switch_time_t prof_start;
 
 	switch_assert(sqlbuf);
 
@@ -891,9 +1079,13 @@ static void *SWITCH_THREAD_FUNC switch_core_sql_thread(switch_thread_t *thread,
 
 
 		if (trans && ((itterations == target) || (nothing_in_queue && ++lc >= 500))) {
+			switch_core_profile_depth(prof_commit, switch_queue_size(sql_manager.sql_queue[0]) + switch_queue_size(sql_manager.sql_queue[1]));
+			switch_core_profile_count(prof_stmt, itterations);
+			switch_core_profile_start(prof_start);
 			if (switch_cache_db_persistant_execute_trans(sql_manager.event_db, sqlbuf, 1) != SWITCH_STATUS_SUCCESS) {
 				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "SQL thread unable to commit transaction, records lost!\n");
 			}
+			switch_core_profile_stop(prof_commit, prof_start);
 			itterations = 0;
 			trans = 0;
 			nothing_in_queue = 0;
@@ -1297,6 +1489,9 @@ switch_status_t switch_core_sqldb_start(switch_memory_pool_t *pool, switch_bool_
 
 	sql_manager.memory_pool = pool;
 	sql_manager.manage = manage;
+	sql_manager.pool_max = runtime.db_pool_max;
+	sql_manager.pool_wait = runtime.db_pool_wait;
+	sql_manager.health_interval = runtime.db_pool_health_interval;
 
 	switch_mutex_init(&sql_manager.dbh_mutex, SWITCH_MUTEX_NESTED, sql_manager.memory_pool);
 	switch_mutex_init(&sql_manager.io_mutex, SWITCH_MUTEX_NESTED, sql_manager.memory_pool);
@@ -1462,53 +1657,33 @@ void switch_core_sqldb_stop(void)
 SWITCH_DECLARE(void) switch_cache_db_status(switch_stream_handle_t *stream)
 {
 	/* return some status info suitable for the cli */
-	switch_hash_index_t *hi;
-	switch_cache_db_handle_t *dbh = NULL;
-	void *val;
-	const void *var;
-	char *key;
-	switch_bool_t locked = SWITCH_FALSE;
+	cache_db_pool_t *dbp;
+	switch_cache_db_handle_t *dbh;
 	time_t now = switch_epoch_time_now(NULL);
-	char cleankey_str[CACHE_DB_LEN];
-	char *pos1 = NULL;
-	char *pos2 = NULL;
 
 	switch_mutex_lock(sql_manager.dbh_mutex);
 
-	for (hi = switch_hash_first(NULL, sql_manager.dbh_hash); hi; hi = switch_hash_next(hi)) {
-		switch_hash_this(hi, &var, NULL, &val);
-		key = (char *) var;
-
-		if ((dbh = (switch_cache_db_handle_t *) val)) {
-			char *needle = "pass=\"";
-			time_t diff = 0;
-
-			diff = now - dbh->last_used;
-
-			if (switch_mutex_trylock(dbh->mutex) == SWITCH_STATUS_SUCCESS) {
-				switch_mutex_unlock(dbh->mutex);
-				locked = SWITCH_FALSE;
-			} else {
-				locked = SWITCH_TRUE;
-			}
-
-			/* sanitize password */
-			memset(cleankey_str, 0, sizeof(cleankey_str));
-			pos1 = strstr(key, needle) + strlen(needle);
-			pos2 = strstr(pos1, "\"");
-			strncpy(cleankey_str, key, pos1 - key);
-			strcpy(&cleankey_str[pos1 - key], pos2);
-
-
-			stream->write_function(stream, "%s\n\tType: %s\n\tLast used: %d\n\tFlags: %s, %s\n"
-								   "\tCreator: %s\n\tLast User: %s\n",
-								   cleankey_str,
-								   switch_cache_db_type_name(dbh->type),
-								   diff,
-								   locked ? "Locked" : "Unlocked",
-								   switch_test_flag(dbh, CDF_INUSE) ? "Attached" : "Detached", dbh->creator, dbh->last_user);
+	for (dbp = sql_manager.pools; dbp; dbp = dbp->next) {
+		switch_mutex_lock(dbp->mutex);
+
+		stream->write_function(stream, "%s\n\tType: %s\n\tHandles: %u (%u in use, %u idle, max %u)\n\tWaiting: %u\n"
+							   "\tCreated: %" SWITCH_UINT64_T_FMT " Destroyed: %" SWITCH_UINT64_T_FMT " Acquired: %" SWITCH_UINT64_T_FMT "\n"
+							   "\tWaits: %" SWITCH_UINT64_T_FMT " (avg %" SWITCH_INT64_T_FMT "us, max %" SWITCH_INT64_T_FMT "us) Timeouts: %"
+							   SWITCH_UINT64_T_FMT " Health failures: %" SWITCH_UINT64_T_FMT "\n",
+							   dbp->name, switch_cache_db_type_name(dbp->type),
+							   dbp->total, dbp->busy_count, dbp->idle_count, sql_manager.pool_max, dbp->waiting,
+							   dbp->created, dbp->destroyed, dbp->acquired,
+							   dbp->waits, dbp->waits ? (int64_t) (dbp->wait_total / dbp->waits) : 0, (int64_t) dbp->wait_max,
+							   dbp->timeouts, dbp->health_failures);
+
+		for (dbh = dbp->busy; dbh; dbh = dbh->next) {
+			stream->write_function(stream, "\tIn use: %d second(s) Creator: %s Last User: %s\n", (int) (now - dbh->last_used), dbh->creator,
+								   dbh->last_user);
 		}
+
+		switch_mutex_unlock(dbp->mutex);
 	}
+
 	switch_mutex_unlock(sql_manager.dbh_mutex);
 }
 
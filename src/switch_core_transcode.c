@@ -0,0 +1,417 @@
+/*
+ * FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ * Copyright (C) 2005-2010, Anthony Minessale II <anthm@freeswitch.org>
+ *
+ * Version: MPL 1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ *
+ * The Initial Developer of the Original Code is
+ * Anthony Minessale II <anthm@freeswitch.org>
+ * Portions created by the Initial Developer are Copyright (C)
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ * Anthony Minessale II <anthm@freeswitch.org>
+ *
+ *
+ * switch_core_transcode.c -- Transcoding worker pool
+ *
+ * When transcode-threads is set in switch.conf, switch_core_codec_encode() and
+ * switch_core_codec_decode() hand the frame to a small pool of worker threads instead of
+ * running the codec on the session thread.  Workers take the oldest queued frame and every
+ * other queued frame for the same codec implementation, up to transcode-batch-size, and run
+ * them back to back.  A frame that is still queued after transcode-latency-budget is taken
+ * back and transcoded inline by the session so a backlog never adds more than the budget.
+ *
+ */
+
+#include <switch.h>
+#include "private/switch_core_pvt.h"
+
+typedef enum {
+	TRANSCODE_QUEUED,
+	TRANSCODE_RUNNING,
+	TRANSCODE_DONE
+} transcode_state_t;
+
+typedef struct transcode_waiter {
+	switch_thread_cond_t *cond;
+	struct transcode_waiter *next;
+} transcode_waiter_t;
+
+typedef struct transcode_job {
+	int encode;
+	switch_codec_t *codec;
+	switch_codec_t *other_codec;
+	void *in_data;
+	uint32_t in_len;
+	uint32_t in_rate;
+	void *out_data;
+	uint32_t *out_len;
+	uint32_t *out_rate;
+	unsigned int *flag;
+	switch_status_t status;
+	transcode_state_t state;
+	switch_time_t queued;
+	transcode_waiter_t *waiter;
+	struct transcode_job *prev;
+	struct transcode_job *next;
+} transcode_job_t;
+
+typedef struct {
+	const char *name;
+	uint64_t frames;
+	uint64_t batches;
+	uint64_t inline_frames;
+	switch_time_t busy;
+	switch_time_t wait;
+	switch_time_t max_wait;
+} transcode_stats_t;
+
+static struct {
+	switch_memory_pool_t *pool;
+	switch_mutex_t *mutex;
+	switch_thread_cond_t *cond;
+	transcode_job_t *head;
+	transcode_job_t *tail;
+	uint32_t queued;
+	uint32_t max_queued;
+	/* one condition per submitting thread, recycled across frames */
+	transcode_waiter_t *waiters;
+	switch_hash_t *stats;
+	/* iananames allowed to use the pool, NULL for every codec */
+	switch_hash_t *codecs;
+	switch_thread_t **threads;
+	uint32_t thread_count;
+	uint32_t batch;
+	switch_interval_time_t budget;
+	int32_t affinity;
+	int running;
+} transcode;
+
+static switch_status_t transcode_exec(transcode_job_t *job)
+{
+	const switch_codec_implementation_t *imp = job->codec->implementation;
+
+	if (job->encode) {
+		return imp->encode(job->codec, job->other_codec, job->in_data, job->in_len, job->in_rate, job->out_data, job->out_len, job->out_rate,
+						   job->flag);
+	}
+
+	return imp->decode(job->codec, job->other_codec, job->in_data, job->in_len, job->in_rate, job->out_data, job->out_len, job->out_rate, job->flag);
+}
+
+/* must be called with transcode.mutex held */
+static transcode_stats_t *transcode_get_stats(const switch_codec_implementation_t *imp)
+{
+	transcode_stats_t *stats;
+
+	if (!(stats = switch_core_hash_find(transcode.stats, imp->iananame))) {
+		stats = switch_core_alloc(transcode.pool, sizeof(*stats));
+		stats->name = switch_core_strdup(transcode.pool, imp->iananame);
+		switch_core_hash_insert(transcode.stats, stats->name, stats);
+	}
+
+	return stats;
+}
+
+/* must be called with transcode.mutex held */
+static void transcode_unlink(transcode_job_t *job)
+{
+	if (job->prev) {
+		job->prev->next = job->next;
+	} else {
+		transcode.head = job->next;
+	}
+
+	if (job->next) {
+		job->next->prev = job->prev;
+	} else {
+		transcode.tail = job->prev;
+	}
+
+	job->prev = job->next = NULL;
+	transcode.queued--;
+}
+
+static void *SWITCH_THREAD_FUNC transcode_thread_run(switch_thread_t *thread, void *obj)
+{
+	transcode_job_t **batch, *job, *next;
+	const switch_codec_implementation_t *imp;
+	transcode_stats_t *stats;
+	switch_time_t start, wait;
+	uint32_t i, n;
+
+	switch_zmalloc(batch, sizeof(*batch) * transcode.batch);
+
+#ifdef HAVE_CPU_SET_MACROS
+	if (transcode.affinity > -1) {
+		long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		cpu_set_t set;
+
+		if (cpus > 0) {
+			CPU_ZERO(&set);
+			CPU_SET((transcode.affinity + (intptr_t) obj) % cpus, &set);
+			sched_setaffinity(0, sizeof(set), &set);
+		}
+	}
+#endif
+
+	switch_mutex_lock(transcode.mutex);
+
+	for (;;) {
+		while (!transcode.head && transcode.running) {
+			switch_thread_cond_wait(transcode.cond, transcode.mutex);
+		}
+
+		if (!transcode.head) {
+			break;
+		}
+
+		/* everything queued for the same implementation goes in one pass */
+		imp = transcode.head->codec->implementation;
+		n = 0;
+		for (job = transcode.head; job && n < transcode.batch; job = next) {
+			next = job->next;
+			if (job->codec->implementation == imp) {
+				transcode_unlink(job);
+				job->state = TRANSCODE_RUNNING;
+				batch[n++] = job;
+			}
+		}
+
+		start = switch_micro_time_now();
+		stats = transcode_get_stats(imp);
+		for (i = 0; i < n; i++) {
+			wait = start - batch[i]->queued;
+			stats->wait += wait;
+			if (wait > stats->max_wait) {
+				stats->max_wait = wait;
+			}
+		}
+		switch_mutex_unlock(transcode.mutex);
+
+		for (i = 0; i < n; i++) {
+			batch[i]->status = transcode_exec(batch[i]);
+		}
+
+		switch_mutex_lock(transcode.mutex);
+		stats->busy += switch_micro_time_now() - start;
+		stats->frames += n;
+		stats->batches++;
+		for (i = 0; i < n; i++) {
+			batch[i]->state = TRANSCODE_DONE;
+			switch_thread_cond_signal(batch[i]->waiter->cond);
+		}
+	}
+
+	switch_mutex_unlock(transcode.mutex);
+
+	free(batch);
+
+	return NULL;
+}
+
+switch_bool_t switch_core_transcode_wanted(switch_codec_t *codec)
+{
+	if (!transcode.running) {
+		return SWITCH_FALSE;
+	}
+
+	if (transcode.codecs && !switch_core_hash_find(transcode.codecs, codec->implementation->iananame)) {
+		return SWITCH_FALSE;
+	}
+
+	return SWITCH_TRUE;
+}
+
+switch_status_t switch_core_transcode_frame(int encode, switch_codec_t *codec, switch_codec_t *other_codec,
+											void *in_data, uint32_t in_len, uint32_t in_rate,
+											void *out_data, uint32_t *out_len, uint32_t *out_rate, unsigned int *flag)
+{
+	transcode_job_t job = { 0 };
+	switch_time_t now, deadline;
+	int run_inline = 0;
+
+	job.encode = encode;
+	job.codec = codec;
+	job.other_codec = other_codec;
+	job.in_data = in_data;
+	job.in_len = in_len;
+	job.in_rate = in_rate;
+	job.out_data = out_data;
+	job.out_len = out_len;
+	job.out_rate = out_rate;
+	job.flag = flag;
+
+	switch_mutex_lock(transcode.mutex);
+
+	if (!transcode.running) {
+		switch_mutex_unlock(transcode.mutex);
+		return transcode_exec(&job);
+	}
+
+	if ((job.waiter = transcode.waiters)) {
+		transcode.waiters = job.waiter->next;
+	} else {
+		job.waiter = switch_core_alloc(transcode.pool, sizeof(*job.waiter));
+		switch_thread_cond_create(&job.waiter->cond, transcode.pool);
+	}
+
+	job.state = TRANSCODE_QUEUED;
+	job.queued = switch_micro_time_now();
+	if ((job.prev = transcode.tail)) {
+		transcode.tail->next = &job;
+	} else {
+		transcode.head = &job;
+	}
+	transcode.tail = &job;
+	if (++transcode.queued > transcode.max_queued) {
+		transcode.max_queued = transcode.queued;
+	}
+	switch_thread_cond_signal(transcode.cond);
+
+	deadline = job.queued + transcode.budget;
+
+	while (job.state != TRANSCODE_DONE) {
+		if (job.state == TRANSCODE_QUEUED) {
+			if ((now = switch_micro_time_now()) >= deadline) {
+				transcode_unlink(&job);
+				transcode_get_stats(codec->implementation)->inline_frames++;
+				run_inline = 1;
+				break;
+			}
+			switch_thread_cond_timedwait(job.waiter->cond, transcode.mutex, deadline - now);
+		} else {
+			switch_thread_cond_timedwait(job.waiter->cond, transcode.mutex, 1000000);
+		}
+	}
+
+	job.waiter->next = transcode.waiters;
+	transcode.waiters = job.waiter;
+
+	switch_mutex_unlock(transcode.mutex);
+
+	if (run_inline) {
+		job.status = transcode_exec(&job);
+	}
+
+	return job.status;
+}
+
+SWITCH_DECLARE(void) switch_core_transcode_status(switch_stream_handle_t *stream)
+{
+	switch_hash_index_t *hi;
+	void *val;
+	transcode_stats_t *stats;
+
+	if (!transcode.mutex) {
+		stream->write_function(stream, "Transcoding pool disabled, codecs run on the session threads.\n");
+		return;
+	}
+
+	switch_mutex_lock(transcode.mutex);
+	stream->write_function(stream, "threads: %u batch-size: %u latency-budget: %dms queued: %u max-queued: %u\n",
+						   transcode.thread_count, transcode.batch, (int) (transcode.budget / 1000), transcode.queued, transcode.max_queued);
+	stream->write_function(stream, "%-16s %12s %10s %8s %12s %12s %12s %10s\n",
+						   "codec", "frames", "batches", "avg-batch", "inline", "avg-wait-us", "max-wait-us", "avg-us");
+
+	for (hi = switch_hash_first(NULL, transcode.stats); hi; hi = switch_hash_next(hi)) {
+		switch_hash_this(hi, NULL, NULL, &val);
+		stats = (transcode_stats_t *) val;
+		stream->write_function(stream, "%-16s %12" SWITCH_UINT64_T_FMT " %10" SWITCH_UINT64_T_FMT " %8.2f %12" SWITCH_UINT64_T_FMT
+							   " %12" SWITCH_INT64_T_FMT " %12" SWITCH_INT64_T_FMT " %10" SWITCH_INT64_T_FMT "\n",
+							   stats->name, stats->frames, stats->batches,
+							   stats->batches ? (double) stats->frames / stats->batches : 0.0, stats->inline_frames,
+							   stats->frames ? (int64_t) (stats->wait / stats->frames) : 0, (int64_t) stats->max_wait,
+							   stats->frames ? (int64_t) (stats->busy / stats->frames) : 0);
+	}
+	switch_mutex_unlock(transcode.mutex);
+}
+
+void switch_core_transcode_init(switch_memory_pool_t *pool)
+{
+	switch_threadattr_t *thd_attr = NULL;
+	char *list, *argv[64] = { 0 };
+	int argc, i;
+	uint32_t x;
+
+	if (!runtime.transcode_threads) {
+		return;
+	}
+
+	memset(&transcode, 0, sizeof(transcode));
+	transcode.pool = pool;
+	transcode.thread_count = runtime.transcode_threads;
+	transcode.batch = runtime.transcode_batch ? runtime.transcode_batch : 16;
+	transcode.budget = (switch_interval_time_t) (runtime.transcode_budget ? runtime.transcode_budget : 20) * 1000;
+	transcode.affinity = runtime.transcode_affinity;
+
+	switch_mutex_init(&transcode.mutex, SWITCH_MUTEX_NESTED, pool);
+	switch_thread_cond_create(&transcode.cond, pool);
+	switch_core_hash_init_nocase(&transcode.stats, pool);
+
+	if (!zstr(runtime.transcode_codecs) && strcasecmp(runtime.transcode_codecs, "all")) {
+		list = switch_core_strdup(pool, runtime.transcode_codecs);
+		switch_core_hash_init_nocase(&transcode.codecs, pool);
+		argc = switch_separate_string(list, ',', argv, (sizeof(argv) / sizeof(argv[0])));
+		for (i = 0; i < argc; i++) {
+			switch_core_hash_insert(transcode.codecs, argv[i], pool);
+		}
+	}
+
+	transcode.threads = switch_core_alloc(pool, sizeof(switch_thread_t *) * transcode.thread_count);
+	transcode.running = 1;
+
+	switch_threadattr_create(&thd_attr, pool);
+	switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+	for (x = 0; x < transcode.thread_count; x++) {
+		switch_thread_create(&transcode.threads[x], thd_attr, transcode_thread_run, (void *) (intptr_t) x, pool);
+	}
+
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CONSOLE, "Transcoding pool started with %u thread(s), batches of %u, %dms latency budget.\n",
+					  transcode.thread_count, transcode.batch, (int) (transcode.budget / 1000));
+}
+
+void switch_core_transcode_shutdown(void)
+{
+	switch_status_t st;
+	uint32_t x;
+
+	if (!transcode.running) {
+		return;
+	}
+
+	/* workers drain whatever is queued before they exit, later frames run inline */
+	switch_mutex_lock(transcode.mutex);
+	transcode.running = 0;
+	switch_thread_cond_broadcast(transcode.cond);
+	switch_mutex_unlock(transcode.mutex);
+
+	for (x = 0; x < transcode.thread_count; x++) {
+		switch_thread_join(&st, transcode.threads[x]);
+	}
+}
+
+/* For Emacs:
+ * Local Variables:
+ * mode:c
+ * indent-tabs-mode:t
+ * tab-width:4
+ * c-basic-offset:4
+ * End:
+ * For VIM:
+ * vim:set softtabstop=4 shiftwidth=4 tabstop=4:
+ */
@@ -238,6 +238,8 @@ static void *SWITCH_THREAD_FUNC switch_event_dispatch_thread(switch_thread_t *th
 {
 	switch_queue_t *queue = (switch_queue_t *) obj;
 	int my_id = 0;
+	switch_profile_counter_t *prof;
+	char prof_name[32];
 	switch_mutex_lock(EVENT_QUEUE_MUTEX);
 	THREAD_COUNT++;
 	switch_mutex_unlock(EVENT_QUEUE_MUTEX);
@@ -248,9 +250,13 @@ static void *SWITCH_THREAD_FUNC switch_event_dispatch_thread(switch_thread_t *th
 		}
 	}
 
+	switch_snprintf(prof_name, sizeof(prof_name), "dispatch-%d", my_id);
+	prof = switch_core_profile_counter("event", prof_name);
+
 	for (;;) {
 		void *pop = NULL;
 		switch_event_t *event = NULL;
+		switch_time_t prof_start;
 
 		if (!SYSTEM_RUNNING) {
 			break;
@@ -265,7 +271,10 @@ static void *SWITCH_THREAD_FUNC switch_event_dispatch_thread(switch_thread_t *th
 		}
 
 		event = (switch_event_t *) pop;
+		switch_core_profile_depth(prof, switch_queue_size(queue));
+		switch_core_profile_start(prof_start);
 		switch_event_deliver(&event);
+		switch_core_profile_stop(prof, prof_start);
 	}
 
 
@@ -617,6 +617,7 @@ static switch_bool_t eavesdrop_callback(switch_media_bug_t *bug, void *user_data
 					switch_buffer_lock(ep->r_buffer);
 					bytes = (uint32_t) switch_buffer_read(ep->r_buffer, data, rframe->datalen);
 
+					switch_frame_writable(rframe);
 					rframe->datalen = switch_merge_sln(rframe->data, rframe->samples, (int16_t *) data, bytes / 2) * 2;
 					rframe->samples = rframe->datalen / 2;
 
@@ -637,6 +638,7 @@ static switch_bool_t eavesdrop_callback(switch_media_bug_t *bug, void *user_data
 					switch_buffer_lock(ep->w_buffer);
 					bytes = (uint32_t) switch_buffer_read(ep->w_buffer, data, rframe->datalen);
 
+					switch_frame_writable(rframe);
 					rframe->datalen = switch_merge_sln(rframe->data, rframe->samples, (int16_t *) data, bytes / 2) * 2;
 					rframe->samples = rframe->datalen / 2;
 
@@ -1449,6 +1451,8 @@ static switch_bool_t session_audio_callback(switch_media_bug_t *bug, void *user_
 	}
 
 	if (frame) {
+		switch_frame_writable(frame);
+
 		if (mute) {
 			if (mute > 1) {
 				switch_generate_sln_silence(frame->data, frame->datalen / 2, mute);
@@ -160,6 +160,56 @@ struct switch_ivr_bridge_data {
 };
 typedef struct switch_ivr_bridge_data switch_ivr_bridge_data_t;
 
+/* relay a's rtp straight into b's rtp when nothing needs to see or change the media in between,
+   that includes dtmf hooks like bind_meta_app since relayed packets never reach the normal read path */
+static void update_rtp_relay(switch_core_session_t *session_a, switch_core_session_t *session_b, switch_bool_t allow,
+							 switch_rtp_t **relay_from, switch_rtp_t **relay_to)
+{
+	switch_channel_t *chan_a = switch_core_session_get_channel(session_a);
+	switch_channel_t *chan_b = switch_core_session_get_channel(session_b);
+	switch_rtp_t *from = NULL, *to = NULL;
+
+	if (allow && switch_channel_media_ack(chan_a) && switch_channel_media_ack(chan_b) &&
+		!switch_channel_test_flag(chan_a, CF_HOLD) && !switch_channel_test_flag(chan_b, CF_HOLD) &&
+		!switch_channel_test_flag(chan_a, CF_SUSPEND) && !switch_channel_test_flag(chan_b, CF_SUSPEND) &&
+		!switch_channel_test_flag(chan_a, CF_PROXY_MEDIA) && !switch_channel_test_flag(chan_b, CF_PROXY_MEDIA) &&
+		!switch_core_media_bug_count(session_a) && !switch_core_media_bug_count(session_b) &&
+		!switch_core_event_hook_media_attached(session_a) && !switch_core_event_hook_media_attached(session_b)) {
+		switch_codec_implementation_t read_impl = { 0 }, write_impl = { 0 };
+
+		switch_core_session_get_read_impl(session_a, &read_impl);
+		switch_core_session_get_write_impl(session_b, &write_impl);
+
+		if (read_impl.impl_id && read_impl.impl_id == write_impl.impl_id) {
+			from = switch_channel_get_private(chan_a, "__relay_audio_rtp_session");
+			to = switch_channel_get_private(chan_b, "__relay_audio_rtp_session");
+		}
+	}
+
+	if (!(from && to)) {
+		from = to = NULL;
+	}
+
+	if (from == *relay_from && to == *relay_to) {
+		return;
+	}
+
+	if (*relay_from) {
+		switch_rtp_set_relay(*relay_from, NULL);
+		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session_a), SWITCH_LOG_DEBUG, "Stop relaying rtp from %s to %s\n",
+						  switch_channel_get_name(chan_a), switch_channel_get_name(chan_b));
+	}
+
+	*relay_from = *relay_to = NULL;
+
+	if (from && switch_rtp_set_relay(from, to) == SWITCH_STATUS_SUCCESS) {
+		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session_a), SWITCH_LOG_DEBUG, "Relaying rtp from %s to %s\n",
+						  switch_channel_get_name(chan_a), switch_channel_get_name(chan_b));
+		*relay_from = from;
+		*relay_to = to;
+	}
+}
+
 static void *audio_bridge_thread(switch_thread_t *thread, void *obj)
 {
 	switch_ivr_bridge_data_t *data = obj;
@@ -182,6 +232,9 @@ static void *audio_bridge_thread(switch_thread_t *thread, void *obj)
 	const char *bridge_answer_timeout = NULL;
 	int answer_timeout, sent_update = 0;
 	time_t answer_limit = 0;
+	int rtp_relay = 0;
+	switch_rtp_t *relay_from = NULL, *relay_to = NULL;
+	switch_channel_waiter_t *pre_waiter = NULL;
 
 #ifdef SWITCH_VIDEO_IN_THREADS
 	switch_thread_t *vid_thread = NULL;
@@ -214,6 +267,8 @@ static void *audio_bridge_thread(switch_thread_t *thread, void *obj)
 
 	inner_bridge = switch_channel_test_flag(chan_a, CF_INNER_BRIDGE);
 
+	rtp_relay = switch_true(switch_channel_get_variable(chan_a, "bridge_rtp_relay"));
+
 	if (!switch_channel_test_flag(chan_a, CF_ANSWERED) && (bridge_answer_timeout = switch_channel_get_variable(chan_a, "bridge_answer_timeout"))) {
 		if ((answer_timeout = atoi(bridge_answer_timeout)) < 0) {
 			answer_timeout = 0;
@@ -408,7 +463,16 @@ static void *audio_bridge_thread(switch_thread_t *thread, void *obj)
 					pre_b = 1;
 				}
 				if (!pre_b) {
-					switch_yield(10000);
+					/* nothing to relay until the b leg answers or sends early media, sleep until one of the legs changes */
+					if (!pre_waiter && switch_channel_waiter_create(&pre_waiter) == SWITCH_STATUS_SUCCESS) {
+						switch_channel_attach_waiter(chan_b, pre_waiter);
+						switch_channel_attach_waiter(chan_a, pre_waiter);
+					}
+					if (pre_waiter) {
+						switch_channel_waiter_wait(pre_waiter, 100);
+					} else {
+						switch_yield(10000);
+					}
 					continue;
 				}
 			} else {
@@ -450,10 +514,19 @@ static void *audio_bridge_thread(switch_thread_t *thread, void *obj)
 		}
 #endif
 
+		if (rtp_relay) {
+			update_rtp_relay(session_a, session_b, (!input_callback && !silence_val && ans_a && ans_b && !data->skip_frames),
+							 &relay_from, &relay_to);
+		}
+
 		/* read audio from 1 channel and write it to the other */
 		status = switch_core_session_read_frame(session_a, &read_frame, SWITCH_IO_FLAG_NONE, stream_id);
 
 		if (SWITCH_READ_ACCEPTABLE(status)) {
+			if (switch_test_flag(read_frame, SFF_RTP_RELAY)) {
+				continue;
+			}
+
 			if (switch_test_flag(read_frame, SFF_CNG)) {
 				if (silence_val) {
 					switch_generate_sln_silence((int16_t *) silence_frame.data, silence_frame.samples, silence_val);
@@ -483,6 +556,16 @@ static void *audio_bridge_thread(switch_thread_t *thread, void *obj)
 
   end_of_bridge_loop:
 
+	if (pre_waiter) {
+		switch_channel_detach_waiter(chan_b, pre_waiter);
+		switch_channel_detach_waiter(chan_a, pre_waiter);
+		switch_channel_waiter_release(&pre_waiter);
+	}
+
+	if (relay_from) {
+		switch_rtp_set_relay(relay_from, NULL);
+	}
+
 #ifdef SWITCH_VIDEO_IN_THREADS
 	if (vid_thread) {
 		vh.up = -1;
@@ -1188,8 +1271,25 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_multi_threaded_bridge(switch_core_ses
 			switch_channel_stop_broadcast(peer_channel);
 
 
-			while (switch_channel_get_state(peer_channel) == CS_EXCHANGE_MEDIA) {
-				switch_cond_next();
+			if (switch_channel_get_state(peer_channel) == CS_EXCHANGE_MEDIA) {
+				switch_channel_waiter_t *waiter = NULL;
+
+				if (switch_channel_waiter_create(&waiter) == SWITCH_STATUS_SUCCESS) {
+					switch_channel_attach_waiter(peer_channel, waiter);
+				}
+
+				while (switch_channel_get_state(peer_channel) == CS_EXCHANGE_MEDIA) {
+					if (waiter) {
+						switch_channel_waiter_wait(waiter, 100);
+					} else {
+						switch_cond_next();
+					}
+				}
+
+				if (waiter) {
+					switch_channel_detach_waiter(peer_channel, waiter);
+					switch_channel_waiter_release(&waiter);
+				}
 			}
 
 			if (inner_bridge) {
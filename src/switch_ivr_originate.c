@@ -33,6 +33,9 @@
 
 #include <switch.h>
 
+/* longest sleep between checks while waiting on channels, timeouts and cancel causes are polled at this rate */
+#define ORIGINATE_WAIT_MS 100
+
 static const switch_state_handler_table_t originate_state_handlers;
 
 static switch_status_t originate_on_consume_media_transmit(switch_core_session_t *session)
@@ -121,6 +124,8 @@ typedef struct {
 	switch_thread_t *ethread;
 	switch_caller_profile_t *caller_profile_override;
 	switch_memory_pool_t *pool;
+	/* woken by state and flag changes on the caller and peer channels */
+	switch_channel_waiter_t *waiter;
 } originate_global_t;
 
 
@@ -759,6 +764,7 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_wait_for_answer(switch_core_session_t
 	switch_time_t start = 0;
 	const char *cancel_key = NULL;
 	switch_channel_state_t wait_state = 0;
+	switch_channel_waiter_t *waiter = NULL;
 
 	switch_assert(peer_channel);
 
@@ -920,6 +926,13 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_wait_for_answer(switch_core_session_t
 		wait_state = switch_channel_get_state(caller_channel);
 	}
 
+	if (switch_channel_waiter_create(&waiter) == SWITCH_STATUS_SUCCESS) {
+		switch_channel_attach_waiter(peer_channel, waiter);
+		if (caller_channel) {
+			switch_channel_attach_waiter(caller_channel, waiter);
+		}
+	}
+
 	while (switch_channel_ready(peer_channel) && !switch_channel_media_ready(peer_channel)) {
 		int diff = (int) (switch_micro_time_now() - start);
 
@@ -997,6 +1010,8 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_wait_for_answer(switch_core_session_t
 					break;
 				}
 			}
+		} else if (waiter) {
+			switch_channel_waiter_wait(waiter, ORIGINATE_WAIT_MS);
 		} else {
 			switch_cond_next();
 		}
@@ -1004,6 +1019,14 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_wait_for_answer(switch_core_session_t
 
   done:
 
+	if (waiter) {
+		switch_channel_detach_waiter(peer_channel, waiter);
+		if (caller_channel) {
+			switch_channel_detach_waiter(caller_channel, waiter);
+		}
+		switch_channel_waiter_release(&waiter);
+	}
+
 	if (ringback.fh) {
 		switch_core_file_close(ringback.fh);
 		ringback.fh = NULL;
@@ -1764,6 +1787,7 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_originate(switch_core_session_t *sess
 	oglobals.ringback_ok = 1;
 	oglobals.bridge_early_media = -1;
 	switch_core_new_memory_pool(&oglobals.pool);
+	switch_channel_waiter_create(&oglobals.waiter);
 
 	if (caller_profile_override) {
 		oglobals.caller_profile_override = switch_caller_profile_dup(oglobals.pool, caller_profile_override);
@@ -1779,6 +1803,7 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_originate(switch_core_session_t *sess
 		const char *to_var, *bypass_media = NULL, *proxy_media = NULL;
 		caller_channel = switch_core_session_get_channel(session);
 		switch_channel_set_flag(caller_channel, CF_ORIGINATOR);
+		switch_channel_attach_waiter(caller_channel, oglobals.waiter);
 		oglobals.session = session;
 
 
@@ -2541,6 +2566,7 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_originate(switch_core_session_t *sess
 				originate_status[i].peer_channel = switch_core_session_get_channel(new_session);
 				originate_status[i].caller_profile = switch_channel_get_caller_profile(originate_status[i].peer_channel);
 				originate_status[i].peer_session = new_session;
+				switch_channel_attach_waiter(originate_status[i].peer_channel, oglobals.waiter);
 
 				switch_channel_set_flag(originate_status[i].peer_channel, CF_ORIGINATING);
 
@@ -2710,7 +2736,7 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_originate(switch_core_session_t *sess
 						goto notready;
 					}
 
-					switch_cond_next();
+					switch_channel_waiter_wait(oglobals.waiter, ORIGINATE_WAIT_MS);
 				}
 
 				check_per_channel_timeouts(&oglobals, originate_status, and_argc, start, &force_reason);
@@ -2980,7 +3006,7 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_originate(switch_core_session_t *sess
 			do_continue:
 
 				if (!read_packet) {
-					switch_cond_next();
+					switch_channel_waiter_wait(oglobals.waiter, ORIGINATE_WAIT_MS);
 				}
 			}
 
@@ -3471,12 +3497,19 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_originate(switch_core_session_t *sess
 	if (caller_channel) {
 		switch_channel_clear_flag(caller_channel, CF_ORIGINATOR);
 		switch_channel_clear_flag(caller_channel, CF_XFER_ZOMBIE);
+		switch_channel_detach_waiter(caller_channel, oglobals.waiter);
+	}
+
+	if (bleg && *bleg) {
+		switch_channel_detach_waiter(switch_core_session_get_channel(*bleg), oglobals.waiter);
 	}
 
 	if (force_reason != SWITCH_CAUSE_NONE) {
 		*cause = force_reason;
 	}
 
+	/* peers that lost are still holding a reference until their channels are destroyed */
+	switch_channel_waiter_release(&oglobals.waiter);
 	switch_core_destroy_memory_pool(&oglobals.pool);
 
 	return status;
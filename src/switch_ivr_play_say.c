@@ -1050,6 +1050,16 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_play_file(switch_core_session_t *sess
 				file = switch_core_session_sprintf(session, "%s.%s", file, ext);
 				asis = 1;
 			}
+
+			if (!asis && *file != '[' && (p = switch_channel_get_variable(channel, "prompt_cache")) && switch_true(p)) {
+				switch_file_interface_t *cache_interface;
+
+				/* serve the decoded audio from mod_prompt_cache when it is loaded */
+				if ((cache_interface = switch_loadable_module_get_file_interface("prompt_cache"))) {
+					UNPROTECT_INTERFACE(cache_interface);
+					file = switch_core_session_sprintf(session, "prompt_cache://%s", file);
+				}
+			}
 		}
 
 
@@ -1760,41 +1770,18 @@ SWITCH_DECLARE(switch_status_t) switch_play_and_get_digits(switch_core_session_t
 	return SWITCH_STATUS_FALSE;
 }
 
-SWITCH_DECLARE(switch_status_t) switch_ivr_speak_text_handle(switch_core_session_t *session,
-															 switch_speech_handle_t *sh,
-															 switch_codec_t *codec, switch_timer_t *timer, char *text, switch_input_args_t *args)
+/* largest rendering captured for the shared TTS cache */
+#define TTS_CACHE_CAPTURE_MAX (2 * 1024 * 1024)
+
+/* returns a malloced copy of text with * and # spelled out, or NULL when there is nothing to replace */
+static char *speech_expand_text(switch_channel_t *channel, const char *text)
 {
-	switch_channel_t *channel = switch_core_session_get_channel(session);
-	short abuf[960];
-	switch_dtmf_t dtmf = { 0 };
-	uint32_t len = 0;
-	switch_size_t ilen = 0;
-	switch_frame_t write_frame = { 0 };
-	int x;
-	int done = 0;
-	int lead_in_out = 10;
-	switch_status_t status = SWITCH_STATUS_SUCCESS;
-	switch_speech_flag_t flags = SWITCH_SPEECH_FLAG_NONE;
 	switch_size_t extra = 0;
-	char *p, *tmp = NULL;
+	const char *p;
+	char *tmp = NULL;
 	const char *star, *pound;
 	switch_size_t starlen, poundlen;
 
-	if (!sh) {
-		return SWITCH_STATUS_FALSE;
-	}
-
-	if (switch_channel_pre_answer(channel) != SWITCH_STATUS_SUCCESS) {
-		return SWITCH_STATUS_FALSE;
-	}
-
-	write_frame.data = abuf;
-	write_frame.buflen = sizeof(abuf);
-
-	len = sh->samples * 2;
-
-	flags = 0;
-
 	if (!(star = switch_channel_get_variable(channel, "star_replace"))) {
 		star = "star";
 	}
@@ -1816,11 +1803,7 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_speak_text_handle(switch_core_session
 	if (extra) {
 		char *tp;
 		switch_size_t mylen = strlen(text) + extra + 1;
-		tmp = malloc(mylen);
-		if (!tmp) {
-			return SWITCH_STATUS_MEMERR;
-		}
-		memset(tmp, 0, mylen);
+		switch_zmalloc(tmp, mylen);
 		tp = tmp;
 		for (p = text; p && *p; p++) {
 			if (*p == '*') {
@@ -1833,7 +1816,44 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_speak_text_handle(switch_core_session
 				*tp++ = *p;
 			}
 		}
+	}
+
+	return tmp;
+}
 
+static switch_status_t speak_text_handle(switch_core_session_t *session, switch_speech_handle_t *sh, switch_codec_t *codec,
+										 switch_timer_t *timer, char *text, switch_input_args_t *args, switch_buffer_t *capture)
+{
+	switch_channel_t *channel = switch_core_session_get_channel(session);
+	short abuf[960];
+	switch_dtmf_t dtmf = { 0 };
+	uint32_t len = 0;
+	switch_size_t ilen = 0;
+	switch_frame_t write_frame = { 0 };
+	int x;
+	int done = 0;
+	int rendered = 0;
+	int lead_in_out = 10;
+	switch_status_t status = SWITCH_STATUS_SUCCESS;
+	switch_speech_flag_t flags = SWITCH_SPEECH_FLAG_NONE;
+	char *tmp = NULL;
+
+	if (!sh) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	if (switch_channel_pre_answer(channel) != SWITCH_STATUS_SUCCESS) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	write_frame.data = abuf;
+	write_frame.buflen = sizeof(abuf);
+
+	len = sh->samples * 2;
+
+	flags = 0;
+
+	if ((tmp = speech_expand_text(channel, text))) {
 		text = tmp;
 	}
 
@@ -1948,6 +1968,7 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_speak_text_handle(switch_core_session
 		status = switch_core_speech_read_tts(sh, abuf, &ilen, &flags);
 
 		if (status != SWITCH_STATUS_SUCCESS) {
+			rendered = 1;
 			write_frame.datalen = (uint32_t) codec->implementation->decoded_bytes_per_packet;
 			write_frame.samples = (uint32_t) (write_frame.datalen / 2);
 			memset(write_frame.data, 0, write_frame.datalen);
@@ -1971,6 +1992,12 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_speak_text_handle(switch_core_session
 			break;
 		}
 
+		if (capture && ilen && !switch_buffer_write(capture, abuf, ilen)) {
+			/* too long to be worth caching */
+			switch_buffer_zero(capture);
+			capture = NULL;
+		}
+
 		write_frame.datalen = (uint32_t) ilen;
 		write_frame.samples = (uint32_t) (ilen / 2);
 		if (timer) {
@@ -2013,9 +2040,22 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_speak_text_handle(switch_core_session
 	switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_DEBUG, "done speaking text\n");
 	flags = 0;
 	switch_core_speech_flush_tts(sh);
+
+	if (capture && !rendered) {
+		/* only complete renderings may be shared */
+		switch_buffer_zero(capture);
+	}
+
 	return status;
 }
 
+SWITCH_DECLARE(switch_status_t) switch_ivr_speak_text_handle(switch_core_session_t *session,
+															 switch_speech_handle_t *sh,
+															 switch_codec_t *codec, switch_timer_t *timer, char *text, switch_input_args_t *args)
+{
+	return speak_text_handle(session, sh, codec, timer, text, args, NULL);
+}
+
 struct cached_speech_handle {
 	char tts_name[80];
 	char voice_name[80];
@@ -2061,12 +2101,34 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_speak_text(switch_core_session_t *ses
 	cached_speech_handle_t *cache_obj = NULL;
 	int need_create = 1, need_alloc = 1;
 	switch_codec_implementation_t read_impl = { 0 };
+	switch_buffer_t *capture = NULL;
+	char *cache_text = NULL;
 	switch_core_session_get_read_impl(session, &read_impl);
 
 	if (switch_channel_pre_answer(channel) != SWITCH_STATUS_SUCCESS) {
 		return SWITCH_STATUS_FALSE;
 	}
 
+	if (!((var = switch_channel_get_variable(channel, SWITCH_TTS_CACHE_VARIABLE)) && !switch_true(var))) {
+		char cache_path[128] = "";
+		char *tmp;
+
+		cache_text = (tmp = speech_expand_text(channel, text)) ? tmp : strdup(text);
+		rate = read_impl.actual_samples_per_second;
+
+		if (switch_ivr_tts_cache_lookup(tts_name, voice_name, rate, cache_text, cache_path, sizeof(cache_path)) == SWITCH_STATUS_SUCCESS) {
+			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_DEBUG, "Playing cached TTS %s\n", cache_path);
+			/* NOTFOUND means the entry was evicted in the meantime so render it again */
+			if ((status = switch_ivr_play_file(session, NULL, cache_path, args)) != SWITCH_STATUS_NOTFOUND) {
+				free(cache_text);
+				return status;
+			}
+			status = SWITCH_STATUS_SUCCESS;
+		}
+
+		switch_buffer_create_dynamic(&capture, 16384, 16384, TTS_CACHE_CAPTURE_MAX);
+	}
+
 	sh = &lsh;
 	codec = &lcodec;
 	timer = &ltimer;
@@ -2108,7 +2170,7 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_speak_text(switch_core_session_t *ses
 			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_ERROR, "Invalid TTS module!\n");
 			switch_core_session_reset(session, SWITCH_TRUE, SWITCH_TRUE);
 			switch_ivr_clear_speech_cache(session);
-			return status;
+			goto end;
 		}
 	} else if (cache_obj && strcasecmp(cache_obj->voice_name, voice_name)) {
 		switch_copy_string(cache_obj->voice_name, voice_name, sizeof(cache_obj->voice_name));
@@ -2118,7 +2180,7 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_speak_text(switch_core_session_t *ses
 	if (switch_channel_pre_answer(channel) != SWITCH_STATUS_SUCCESS) {
 		flags = 0;
 		switch_core_speech_close(sh, &flags);
-		return SWITCH_STATUS_FALSE;
+		switch_goto_status(SWITCH_STATUS_FALSE, end);
 	}
 	switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_DEBUG, "OPEN TTS %s\n", tts_name);
 
@@ -2137,7 +2199,7 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_speak_text(switch_core_session_t *ses
 			switch_core_speech_close(sh, &flags);
 			switch_core_session_reset(session, SWITCH_TRUE, SWITCH_TRUE);
 			switch_ivr_clear_speech_cache(session);
-			return SWITCH_STATUS_GENERR;
+			switch_goto_status(SWITCH_STATUS_GENERR, end);
 		}
 	}
 
@@ -2152,7 +2214,7 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_speak_text(switch_core_session_t *ses
 				switch_core_speech_close(sh, &flags);
 				switch_core_session_reset(session, SWITCH_TRUE, SWITCH_TRUE);
 				switch_ivr_clear_speech_cache(session);
-				return SWITCH_STATUS_GENERR;
+				switch_goto_status(SWITCH_STATUS_GENERR, end);
 			}
 			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_DEBUG, "Setup timer success %u bytes per %d ms!\n", sh->samples * 2,
 							  interval);
@@ -2162,9 +2224,13 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_speak_text(switch_core_session_t *ses
 
 	}
 
-	status = switch_ivr_speak_text_handle(session, sh, write_frame.codec, timer_name ? timer : NULL, text, args);
+	status = speak_text_handle(session, sh, write_frame.codec, timer_name ? timer : NULL, text, args, capture);
 	flags = 0;
 
+	if (capture && status == SWITCH_STATUS_SUCCESS && switch_buffer_inuse(capture)) {
+		switch_ivr_tts_cache_store(tts_name, voice_name, rate, cache_text, capture);
+	}
+
 	if (!cache_obj) {
 		switch_core_speech_close(sh, &flags);
 		switch_core_codec_destroy(codec);
@@ -2179,6 +2245,14 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_speak_text(switch_core_session_t *ses
 	}
 
 	switch_core_session_reset(session, SWITCH_FALSE, SWITCH_TRUE);
+
+  end:
+
+	if (capture) {
+		switch_buffer_destroy(&capture);
+	}
+	switch_safe_free(cache_text);
+
 	return status;
 }
 
@@ -73,11 +73,26 @@ struct switch_loadable_module_container {
 	switch_hash_t *management_hash;
 	switch_mutex_t *mutex;
 	switch_memory_pool_t *pool;
+	/* resolved codec preference lists keyed by the preference string, flushed whenever codecs come or go */
+	switch_hash_t *codec_prefs_hash;
+	switch_memory_pool_t *codec_prefs_pool;
+	uint32_t codec_prefs_count;
+	uint64_t codec_prefs_hits;
+	uint64_t codec_prefs_misses;
+	uint64_t codec_prefs_flushes;
 };
 
+#define CODEC_PREFS_CACHE_MAX 1024
+
+typedef struct {
+	int count;
+	const switch_codec_implementation_t *array[1];
+} codec_prefs_entry_t;
+
 static struct switch_loadable_module_container loadable_modules;
 static switch_status_t do_shutdown(switch_loadable_module_t *module, switch_bool_t shutdown, switch_bool_t unload, switch_bool_t fail_if_busy,
 								   const char **err);
+static void codec_prefs_flush(void);
 static switch_status_t switch_loadable_module_load_module_ex(char *dir, char *fname, switch_bool_t runtime, switch_bool_t global, const char **err);
 
 static void *SWITCH_THREAD_FUNC switch_loadable_module_exec(switch_thread_t *thread, void *obj)
@@ -188,6 +203,7 @@ static switch_status_t switch_loadable_module_process(char *key, switch_loadable
 							switch_core_hash_insert(loadable_modules.codec_hash, impl->iananame, (const void *) ptr);
 						}
 					}
+					codec_prefs_flush();
 					if (switch_event_create(&event, SWITCH_EVENT_MODULE_LOAD) == SWITCH_STATUS_SUCCESS) {
 						switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "type", "codec");
 						switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "name", ptr->interface_name);
@@ -496,6 +512,7 @@ static switch_status_t switch_loadable_module_unprocess(switch_loadable_module_t
 							switch_core_hash_delete(loadable_modules.codec_hash, impl->iananame);
 						}
 					}
+					codec_prefs_flush();
 					if (switch_event_create(&event, SWITCH_EVENT_MODULE_UNLOAD) == SWITCH_STATUS_SUCCESS) {
 						switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "type", "codec");
 						switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "name", ptr->interface_name);
@@ -1166,9 +1183,12 @@ SWITCH_DECLARE(switch_status_t) switch_loadable_module_init()
 	switch_core_hash_init_nocase(&loadable_modules.management_hash, loadable_modules.pool);
 	switch_core_hash_init_nocase(&loadable_modules.dialplan_hash, loadable_modules.pool);
 	switch_mutex_init(&loadable_modules.mutex, SWITCH_MUTEX_NESTED, loadable_modules.pool);
+	switch_core_new_memory_pool(&loadable_modules.codec_prefs_pool);
+	switch_core_hash_init_nocase(&loadable_modules.codec_prefs_hash, loadable_modules.codec_prefs_pool);
 
 	switch_loadable_module_load_module("", "CORE_SOFTTIMER_MODULE", SWITCH_FALSE, &err);
 	switch_loadable_module_load_module("", "CORE_PCM_MODULE", SWITCH_FALSE, &err);
+	switch_loadable_module_load_module("", "CORE_TTS_CACHE_MODULE", SWITCH_FALSE, &err);
 
 	if ((xml = switch_xml_open_cfg(cf, &cfg, NULL))) {
 		switch_xml_t mods, ld;
@@ -1344,6 +1364,8 @@ SWITCH_DECLARE(void) switch_loadable_module_shutdown(void)
 	switch_core_hash_destroy(&loadable_modules.module_hash);
 	switch_core_hash_destroy(&loadable_modules.endpoint_hash);
 	switch_core_hash_destroy(&loadable_modules.codec_hash);
+	switch_core_hash_destroy(&loadable_modules.codec_prefs_hash);
+	switch_core_destroy_memory_pool(&loadable_modules.codec_prefs_pool);
 	switch_core_hash_destroy(&loadable_modules.timer_hash);
 	switch_core_hash_destroy(&loadable_modules.application_hash);
 	switch_core_hash_destroy(&loadable_modules.api_hash);
@@ -1473,14 +1495,83 @@ SWITCH_DECLARE(int) switch_loadable_module_get_codecs(const switch_codec_impleme
 
 }
 
+/* must be called with loadable_modules.mutex held */
+static void codec_prefs_flush(void)
+{
+	if (!loadable_modules.codec_prefs_pool || !loadable_modules.codec_prefs_count) {
+		return;
+	}
+
+	switch_core_hash_destroy(&loadable_modules.codec_prefs_hash);
+	switch_core_destroy_memory_pool(&loadable_modules.codec_prefs_pool);
+	switch_core_new_memory_pool(&loadable_modules.codec_prefs_pool);
+	switch_core_hash_init_nocase(&loadable_modules.codec_prefs_hash, loadable_modules.codec_prefs_pool);
+	loadable_modules.codec_prefs_count = 0;
+	loadable_modules.codec_prefs_flushes++;
+}
+
+/* build "<arraylen>|pref,pref,..." as the cache key, returns SWITCH_FALSE if it does not fit */
+static switch_bool_t codec_prefs_key(char *buf, switch_size_t len, int arraylen, char **prefs, int preflen)
+{
+	switch_size_t used;
+	int x;
+
+	used = switch_snprintf(buf, len, "%d|", arraylen);
+
+	for (x = 0; x < preflen; x++) {
+		switch_size_t plen = strlen(prefs[x]);
+
+		if (used + plen + 2 > len) {
+			return SWITCH_FALSE;
+		}
+		if (x) {
+			buf[used++] = ',';
+		}
+		memcpy(buf + used, prefs[x], plen);
+		used += plen;
+	}
+	buf[used] = '\0';
+
+	return SWITCH_TRUE;
+}
+
+SWITCH_DECLARE(void) switch_loadable_module_codec_prefs_status(switch_stream_handle_t *stream, switch_bool_t flush)
+{
+	switch_mutex_lock(loadable_modules.mutex);
+	if (flush) {
+		codec_prefs_flush();
+	}
+	stream->write_function(stream, "codec-prefs-cached: %u\n", loadable_modules.codec_prefs_count);
+	stream->write_function(stream, "codec-prefs-hits: %" SWITCH_UINT64_T_FMT "\n", loadable_modules.codec_prefs_hits);
+	stream->write_function(stream, "codec-prefs-misses: %" SWITCH_UINT64_T_FMT "\n", loadable_modules.codec_prefs_misses);
+	stream->write_function(stream, "codec-prefs-flushes: %" SWITCH_UINT64_T_FMT "\n", loadable_modules.codec_prefs_flushes);
+	switch_mutex_unlock(loadable_modules.mutex);
+}
+
 SWITCH_DECLARE(int) switch_loadable_module_get_codecs_sorted(const switch_codec_implementation_t **array, int arraylen, char **prefs, int preflen)
 {
 	int x, i = 0, lock = 0;
 	switch_codec_interface_t *codec_interface;
 	const switch_codec_implementation_t *imp;
+	codec_prefs_entry_t *entry;
+	char key[1024];
+	switch_bool_t cacheable;
 
 	switch_mutex_lock(loadable_modules.mutex);
 
+	cacheable = codec_prefs_key(key, sizeof(key), arraylen, prefs, preflen);
+
+	if (cacheable && (entry = switch_core_hash_find(loadable_modules.codec_prefs_hash, key))) {
+		for (i = 0; i < entry->count; i++) {
+			array[i] = entry->array[i];
+		}
+		loadable_modules.codec_prefs_hits++;
+		switch_mutex_unlock(loadable_modules.mutex);
+		return i;
+	}
+
+	loadable_modules.codec_prefs_misses++;
+
 	for (x = 0; x < preflen; x++) {
 		char *cur, *last = NULL, *next = NULL, *name, *p, buf[256];
 		uint32_t interval = 0, rate = 0;
@@ -1570,6 +1661,20 @@ SWITCH_DECLARE(int) switch_loadable_module_get_codecs_sorted(const switch_codec_
 		}
 	}
 
+	if (cacheable) {
+		if (loadable_modules.codec_prefs_count >= CODEC_PREFS_CACHE_MAX) {
+			codec_prefs_flush();
+		}
+
+		entry = switch_core_alloc(loadable_modules.codec_prefs_pool, sizeof(*entry) + sizeof(entry->array[0]) * (i > 0 ? i : 1));
+		entry->count = i;
+		for (x = 0; x < i; x++) {
+			entry->array[x] = array[x];
+		}
+		switch_core_hash_insert(loadable_modules.codec_prefs_hash, key, entry);
+		loadable_modules.codec_prefs_count++;
+	}
+
 	switch_mutex_unlock(loadable_modules.mutex);
 
 
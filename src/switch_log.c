@@ -280,6 +280,8 @@ static switch_thread_t *thread;
 
 static void *SWITCH_THREAD_FUNC log_thread(switch_thread_t *t, void *obj)
 {
+	switch_profile_counter_t *prof = switch_core_profile_counter("log", "dispatch");
+	switch_time_t prof_start;
 
 	if (!obj) {
 		obj = NULL;
@@ -300,6 +302,8 @@ static void *SWITCH_THREAD_FUNC log_thread(switch_thread_t *t, void *obj)
 		}
 
 		node = (switch_log_node_t *) pop;
+		switch_core_profile_depth(prof, switch_queue_size(LOG_QUEUE));
+		switch_core_profile_start(prof_start);
 		switch_mutex_lock(BINDLOCK);
 		for (binding = BINDINGS; binding; binding = binding->next) {
 			if (binding->level >= node->level) {
@@ -307,6 +311,7 @@ static void *SWITCH_THREAD_FUNC log_thread(switch_thread_t *t, void *obj)
 			}
 		}
 		switch_mutex_unlock(BINDLOCK);
+		switch_core_profile_stop(prof, prof_start);
 
 		switch_log_node_free(&node);
 
@@ -131,29 +131,16 @@ SWITCH_DECLARE(switch_odbc_status_t) switch_odbc_handle_disconnect(switch_odbc_h
 
 
 #ifdef SWITCH_HAVE_ODBC
-static int db_is_up(switch_odbc_handle_t *handle)
+/* one driver aware probe query, returns the column count or 0 and leaves the statement in *stmtp for the error text */
+static int db_ping(switch_odbc_handle_t *handle, SQLHSTMT *stmtp, int *code)
 {
-	int ret = 0;
 	SQLHSTMT stmt = NULL;
 	SQLLEN m = 0;
 	int result;
-	switch_event_t *event;
-	switch_odbc_status_t recon = 0;
-	char *err_str = NULL;
 	SQLCHAR sql[255] = "";
-	int max_tries = 120;
-	int code = 0;
 	SQLRETURN rc;
 	SQLSMALLINT nresultcols;
 
-
-  top:
-
-	if (!handle) {
-		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "No DB Handle\n");
-		goto done;
-	}
-
 	if (handle->is_firebird) {
 		strcpy((char *) sql, "select first 1 * from RDB$RELATIONS");
 	} else {
@@ -161,39 +148,63 @@ static int db_is_up(switch_odbc_handle_t *handle)
 	}
 
 	if (SQLAllocHandle(SQL_HANDLE_STMT, handle->con, &stmt) != SQL_SUCCESS) {
-		code = __LINE__;
-		goto error;
+		*code = __LINE__;
+		return 0;
 	}
 
+	*stmtp = stmt;
+
 	if (SQLPrepare(stmt, sql, SQL_NTS) != SQL_SUCCESS) {
-		code = __LINE__;
-		goto error;
+		*code = __LINE__;
+		return 0;
 	}
 
 	result = SQLExecute(stmt);
 
 	if (result != SQL_SUCCESS && result != SQL_SUCCESS_WITH_INFO) {
-		code = __LINE__;
-		goto error;
+		*code = __LINE__;
+		return 0;
 	}
 
 	SQLRowCount(stmt, &m);
 	rc = SQLNumResultCols(stmt, &nresultcols);
 	if (rc != SQL_SUCCESS) {
-		code = __LINE__;
-		goto error;
+		*code = __LINE__;
+		return 0;
 	}
-	ret = (int) nresultcols;
+
 	/* determine statement type */
 	if (nresultcols <= 0) {
 		/* statement is not a select statement */
-		code = __LINE__;
-		goto error;
+		*code = __LINE__;
+		return 0;
 	}
 
-	goto done;
+	return (int) nresultcols;
+}
+
+static int db_is_up(switch_odbc_handle_t *handle)
+{
+	int ret = 0;
+	SQLHSTMT stmt = NULL;
+	switch_event_t *event;
+	switch_odbc_status_t recon = 0;
+	char *err_str = NULL;
+	int max_tries = 120;
+	int code = 0;
+
+
+  top:
+
+	if (!handle) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "No DB Handle\n");
+		goto done;
+	}
+
+	if ((ret = db_ping(handle, &stmt, &code))) {
+		goto done;
+	}
 
-  error:
 	err_str = switch_odbc_handle_get_error(handle, stmt);
 	recon = switch_odbc_handle_connect(handle);
 
@@ -225,6 +236,12 @@ static int db_is_up(switch_odbc_handle_t *handle)
 	}
 
 	switch_safe_free(err_str);
+
+	if (stmt) {
+		SQLFreeHandle(SQL_HANDLE_STMT, stmt);
+		stmt = NULL;
+	}
+
 	switch_yield(1000000);
 	goto top;
 
@@ -240,6 +257,28 @@ static int db_is_up(switch_odbc_handle_t *handle)
 }
 #endif
 
+SWITCH_DECLARE(switch_odbc_status_t) switch_odbc_handle_ping(switch_odbc_handle_t *handle)
+{
+#ifdef SWITCH_HAVE_ODBC
+	SQLHSTMT stmt = NULL;
+	int code = 0, ok;
+
+	if (!handle || handle->state != SWITCH_ODBC_STATE_CONNECTED) {
+		return SWITCH_ODBC_FAIL;
+	}
+
+	ok = db_ping(handle, &stmt, &code);
+
+	if (stmt) {
+		SQLFreeHandle(SQL_HANDLE_STMT, stmt);
+	}
+
+	return ok ? SWITCH_ODBC_SUCCESS : SWITCH_ODBC_FAIL;
+#else
+	return SWITCH_ODBC_FAIL;
+#endif
+}
+
 SWITCH_DECLARE(switch_odbc_status_t) switch_odbc_statement_handle_free(switch_odbc_statement_handle_t *stmt)
 {
 	if (!stmt || !*stmt) {
@@ -255,6 +294,44 @@ SWITCH_DECLARE(switch_odbc_status_t) switch_odbc_statement_handle_free(switch_od
 }
 
 
+SWITCH_DECLARE(switch_odbc_status_t) switch_odbc_SQLSetAutoCommitAttr(switch_odbc_handle_t *handle, switch_bool_t on)
+{
+#ifdef SWITCH_HAVE_ODBC
+	SQLRETURN result;
+
+	if (!handle || handle->state != SWITCH_ODBC_STATE_CONNECTED) {
+		return SWITCH_ODBC_FAIL;
+	}
+
+	if (on) {
+		result = SQLSetConnectAttr(handle->con, SQL_ATTR_AUTOCOMMIT, (SQLPOINTER *) SQL_AUTOCOMMIT_ON, 0);
+	} else {
+		result = SQLSetConnectAttr(handle->con, SQL_ATTR_AUTOCOMMIT, (SQLPOINTER *) SQL_AUTOCOMMIT_OFF, 0);
+	}
+
+	return (result == SQL_SUCCESS || result == SQL_SUCCESS_WITH_INFO) ? SWITCH_ODBC_SUCCESS : SWITCH_ODBC_FAIL;
+#else
+	return SWITCH_ODBC_FAIL;
+#endif
+}
+
+SWITCH_DECLARE(switch_odbc_status_t) switch_odbc_SQLEndTran(switch_odbc_handle_t *handle, switch_bool_t commit)
+{
+#ifdef SWITCH_HAVE_ODBC
+	SQLRETURN result;
+
+	if (!handle || handle->state != SWITCH_ODBC_STATE_CONNECTED) {
+		return SWITCH_ODBC_FAIL;
+	}
+
+	result = SQLEndTran(SQL_HANDLE_DBC, handle->con, commit ? SQL_COMMIT : SQL_ROLLBACK);
+
+	return (result == SQL_SUCCESS || result == SQL_SUCCESS_WITH_INFO) ? SWITCH_ODBC_SUCCESS : SWITCH_ODBC_FAIL;
+#else
+	return SWITCH_ODBC_FAIL;
+#endif
+}
+
 SWITCH_DECLARE(switch_odbc_status_t) switch_odbc_handle_connect(switch_odbc_handle_t *handle)
 {
 #ifdef SWITCH_HAVE_ODBC
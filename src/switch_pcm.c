@@ -41,6 +41,62 @@ SWITCH_MODULE_LOAD_FUNCTION(core_pcm_load);
 SWITCH_MODULE_SHUTDOWN_FUNCTION(core_pcm_shutdown);
 SWITCH_MODULE_DEFINITION(CORE_PCM_MODULE, core_pcm_load, core_pcm_shutdown, NULL);
 
+/* G.711 lookup tables, filled from g711.h when the module loads.  Encoding indexes the
+   64 KB tables with the sample reinterpreted as unsigned so the per sample segment search
+   disappears from the hot loop, decoding is a 256 entry table. */
+static uint8_t ulaw_encode_table[65536];
+static uint8_t alaw_encode_table[65536];
+static int16_t ulaw_decode_table[256];
+static int16_t alaw_decode_table[256];
+
+static void g711_tables_init(void)
+{
+	int i;
+
+	for (i = 0; i < 65536; i++) {
+		int16_t linear = (int16_t) (uint16_t) i;
+		ulaw_encode_table[i] = linear_to_ulaw(linear);
+		alaw_encode_table[i] = linear_to_alaw(linear);
+	}
+
+	for (i = 0; i < 256; i++) {
+		ulaw_decode_table[i] = ulaw_to_linear((uint8_t) i);
+		alaw_decode_table[i] = alaw_to_linear((uint8_t) i);
+	}
+}
+
+static void g711_encode_block(const uint8_t *table, const int16_t *dbuf, uint8_t *ebuf, uint32_t samples)
+{
+	uint32_t i = 0;
+
+	for (; i + 4 <= samples; i += 4) {
+		ebuf[i] = table[(uint16_t) dbuf[i]];
+		ebuf[i + 1] = table[(uint16_t) dbuf[i + 1]];
+		ebuf[i + 2] = table[(uint16_t) dbuf[i + 2]];
+		ebuf[i + 3] = table[(uint16_t) dbuf[i + 3]];
+	}
+
+	for (; i < samples; i++) {
+		ebuf[i] = table[(uint16_t) dbuf[i]];
+	}
+}
+
+static void g711_decode_block(const int16_t *table, const uint8_t *ebuf, int16_t *dbuf, uint32_t samples)
+{
+	uint32_t i = 0;
+
+	for (; i + 4 <= samples; i += 4) {
+		dbuf[i] = table[ebuf[i]];
+		dbuf[i + 1] = table[ebuf[i + 1]];
+		dbuf[i + 2] = table[ebuf[i + 2]];
+		dbuf[i + 3] = table[ebuf[i + 3]];
+	}
+
+	for (; i < samples; i++) {
+		dbuf[i] = table[ebuf[i]];
+	}
+}
+
 static switch_status_t switch_raw_init(switch_codec_t *codec, switch_codec_flag_t flags, const switch_codec_settings_t *codec_settings)
 {
 	int encoding, decoding;
@@ -147,18 +203,11 @@ static switch_status_t switch_g711u_encode(switch_codec_t *codec,
 										   uint32_t decoded_rate, void *encoded_data, uint32_t *encoded_data_len, uint32_t *encoded_rate,
 										   unsigned int *flag)
 {
-	short *dbuf;
-	unsigned char *ebuf;
-	uint32_t i;
-
-	dbuf = decoded_data;
-	ebuf = encoded_data;
+	uint32_t samples = decoded_data_len / sizeof(short);
 
-	for (i = 0; i < decoded_data_len / sizeof(short); i++) {
-		ebuf[i] = linear_to_ulaw(dbuf[i]);
-	}
+	g711_encode_block(ulaw_encode_table, decoded_data, encoded_data, samples);
 
-	*encoded_data_len = i;
+	*encoded_data_len = samples;
 
 	return SWITCH_STATUS_SUCCESS;
 }
@@ -170,22 +219,13 @@ static switch_status_t switch_g711u_decode(switch_codec_t *codec,
 										   uint32_t encoded_rate, void *decoded_data, uint32_t *decoded_data_len, uint32_t *decoded_rate,
 										   unsigned int *flag)
 {
-	short *dbuf;
-	unsigned char *ebuf;
-	uint32_t i;
-
-	dbuf = decoded_data;
-	ebuf = encoded_data;
-
 	if (*flag & SWITCH_CODEC_FLAG_SILENCE) {
-		memset(dbuf, 0, codec->implementation->decoded_bytes_per_packet);
+		memset(decoded_data, 0, codec->implementation->decoded_bytes_per_packet);
 		*decoded_data_len = codec->implementation->decoded_bytes_per_packet;
 	} else {
-		for (i = 0; i < encoded_data_len; i++) {
-			dbuf[i] = ulaw_to_linear(ebuf[i]);
-		}
+		g711_decode_block(ulaw_decode_table, encoded_data, decoded_data, encoded_data_len);
 
-		*decoded_data_len = i * 2;
+		*decoded_data_len = encoded_data_len * 2;
 	}
 
 	return SWITCH_STATUS_SUCCESS;
@@ -218,18 +258,11 @@ static switch_status_t switch_g711a_encode(switch_codec_t *codec,
 										   uint32_t decoded_rate, void *encoded_data, uint32_t *encoded_data_len, uint32_t *encoded_rate,
 										   unsigned int *flag)
 {
-	short *dbuf;
-	unsigned char *ebuf;
-	uint32_t i;
+	uint32_t samples = decoded_data_len / sizeof(short);
 
-	dbuf = decoded_data;
-	ebuf = encoded_data;
-
-	for (i = 0; i < decoded_data_len / sizeof(short); i++) {
-		ebuf[i] = linear_to_alaw(dbuf[i]);
-	}
+	g711_encode_block(alaw_encode_table, decoded_data, encoded_data, samples);
 
-	*encoded_data_len = i;
+	*encoded_data_len = samples;
 
 	return SWITCH_STATUS_SUCCESS;
 }
@@ -241,22 +274,13 @@ static switch_status_t switch_g711a_decode(switch_codec_t *codec,
 										   uint32_t encoded_rate, void *decoded_data, uint32_t *decoded_data_len, uint32_t *decoded_rate,
 										   unsigned int *flag)
 {
-	short *dbuf;
-	unsigned char *ebuf;
-	uint32_t i;
-
-	dbuf = decoded_data;
-	ebuf = encoded_data;
-
 	if (*flag & SWITCH_CODEC_FLAG_SILENCE) {
-		memset(dbuf, 0, codec->implementation->decoded_bytes_per_packet);
+		memset(decoded_data, 0, codec->implementation->decoded_bytes_per_packet);
 		*decoded_data_len = codec->implementation->decoded_bytes_per_packet;
 	} else {
-		for (i = 0; i < encoded_data_len; i++) {
-			dbuf[i] = alaw_to_linear(ebuf[i]);
-		}
+		g711_decode_block(alaw_decode_table, encoded_data, decoded_data, encoded_data_len);
 
-		*decoded_data_len = i * 2;
+		*decoded_data_len = encoded_data_len * 2;
 	}
 
 	return SWITCH_STATUS_SUCCESS;
@@ -273,6 +297,8 @@ static void mod_g711_load(switch_loadable_module_interface_t ** module_interface
 	switch_codec_interface_t *codec_interface;
 	int mpf = 10000, spf = 80, bpf = 160, ebpf = 80, count;
 
+	g711_tables_init();
+
 	SWITCH_ADD_CODEC(codec_interface, "G.711 ulaw");
 	for (count = 12; count > 0; count--) {
 		switch_core_codec_add_implementation(pool, codec_interface, SWITCH_CODEC_TYPE_AUDIO,	/* enumeration defining the type of the codec */
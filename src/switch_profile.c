@@ -32,7 +32,7 @@
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 #include "switch.h"
-#include "switch_profile.h"
+#include "private/switch_core_pvt.h"
 
 #ifdef __linux__
 #include <stdio.h>
@@ -286,4 +286,278 @@ SWITCH_DECLARE(void) switch_delete_profile_timer(switch_profile_timer_t **p)
 	*p = NULL;
 }
 
+/* hot path counters: every counter is striped over a few slots picked by thread id so the
+   threads that share one rarely touch the same memory, the slots are only added up on report */
+#define PROFILE_SLOTS 8
+
+typedef struct {
+	uint64_t count;
+	uint64_t timed;
+	uint64_t sum;
+	uint32_t max;
+	uint32_t bucket[SWITCH_LATENCY_BUCKETS];
+} profile_slot_t;
+
+struct switch_profile_counter {
+	char *subsystem;
+	char *name;
+	profile_slot_t slot[PROFILE_SLOTS];
+	uint32_t depth;
+	uint32_t depth_max;
+	uint64_t last_count;
+	switch_time_t last_report;
+	struct switch_profile_counter *next;
+};
+
+static struct {
+	switch_mutex_t *mutex;
+	int enabled;
+	switch_time_t started;
+	switch_profile_counter_t *counters;
+} profile;
+
+static profile_slot_t *profile_slot(switch_profile_counter_t *counter)
+{
+	uintptr_t tid = (uintptr_t) switch_thread_self();
+
+	tid ^= tid >> 16;
+	tid *= 0x45d9f3b;
+	tid ^= tid >> 16;
+
+	return &counter->slot[tid % PROFILE_SLOTS];
+}
 
+SWITCH_DECLARE(switch_profile_counter_t *) switch_core_profile_counter(const char *subsystem, const char *name)
+{
+	switch_profile_counter_t *counter;
+
+	if (!profile.mutex || zstr(subsystem) || zstr(name)) {
+		return NULL;
+	}
+
+	switch_mutex_lock(profile.mutex);
+
+	for (counter = profile.counters; counter; counter = counter->next) {
+		if (!strcasecmp(counter->subsystem, subsystem) && !strcasecmp(counter->name, name)) {
+			goto end;
+		}
+	}
+
+	switch_zmalloc(counter, sizeof(*counter));
+	counter->subsystem = strdup(subsystem);
+	counter->name = strdup(name);
+	counter->last_report = switch_micro_time_now();
+	counter->next = profile.counters;
+	profile.counters = counter;
+
+  end:
+
+	switch_mutex_unlock(profile.mutex);
+
+	return counter;
+}
+
+SWITCH_DECLARE(switch_bool_t) switch_core_profile_enabled(void)
+{
+	return profile.enabled ? SWITCH_TRUE : SWITCH_FALSE;
+}
+
+SWITCH_DECLARE(void) switch_core_profile_enable(switch_bool_t on)
+{
+	if (!profile.mutex) {
+		return;
+	}
+
+	switch_mutex_lock(profile.mutex);
+	if (on && !profile.enabled) {
+		profile.started = switch_micro_time_now();
+	}
+	profile.enabled = on ? 1 : 0;
+	switch_mutex_unlock(profile.mutex);
+}
+
+SWITCH_DECLARE(void) switch_core_profile_reset(void)
+{
+	switch_profile_counter_t *counter;
+	switch_time_t now = switch_micro_time_now();
+
+	if (!profile.mutex) {
+		return;
+	}
+
+	switch_mutex_lock(profile.mutex);
+	for (counter = profile.counters; counter; counter = counter->next) {
+		memset(counter->slot, 0, sizeof(counter->slot));
+		counter->depth_max = counter->depth;
+		counter->last_count = 0;
+		counter->last_report = now;
+	}
+	profile.started = now;
+	switch_mutex_unlock(profile.mutex);
+}
+
+SWITCH_DECLARE(void) switch_core_profile_count(switch_profile_counter_t *counter, uint32_t n)
+{
+	if (!counter || !profile.enabled) {
+		return;
+	}
+
+	profile_slot(counter)->count += n;
+}
+
+SWITCH_DECLARE(void) switch_core_profile_time(switch_profile_counter_t *counter, switch_time_t usec)
+{
+	profile_slot_t *slot;
+
+	if (!counter || !profile.enabled) {
+		return;
+	}
+
+	if (usec < 0) {
+		usec = 0;
+	}
+
+	slot = profile_slot(counter);
+	slot->bucket[switch_core_latency_bucket(usec)]++;
+	slot->count++;
+	slot->timed++;
+	slot->sum += usec;
+	if (usec > slot->max) {
+		slot->max = usec > UINT32_MAX ? UINT32_MAX : (uint32_t) usec;
+	}
+}
+
+SWITCH_DECLARE(void) switch_core_profile_depth(switch_profile_counter_t *counter, uint32_t depth)
+{
+	if (!counter || !profile.enabled) {
+		return;
+	}
+
+	counter->depth = depth;
+	if (depth > counter->depth_max) {
+		counter->depth_max = depth;
+	}
+}
+
+static uint32_t profile_percentile(profile_slot_t *sum, double pct)
+{
+	uint64_t want, seen = 0;
+	uint32_t i;
+
+	if (!sum->timed) {
+		return 0;
+	}
+
+	want = (uint64_t) (sum->timed * pct / 100);
+	if (want < 1) {
+		want = 1;
+	}
+
+	for (i = 0; i < SWITCH_LATENCY_BUCKETS; i++) {
+		if ((seen += sum->bucket[i]) >= want) {
+			uint32_t val = switch_core_latency_bucket_value(i);
+			return val < sum->max ? val : sum->max;
+		}
+	}
+
+	return sum->max;
+}
+
+SWITCH_DECLARE(void) switch_core_profile_report(switch_stream_handle_t *stream, const char *subsystem)
+{
+	switch_profile_counter_t *counter;
+	profile_slot_t *sum;
+	switch_time_t now = switch_micro_time_now();
+	int i, j;
+
+	if (!profile.mutex) {
+		stream->write_function(stream, "-ERR profiler not initialized\n");
+		return;
+	}
+
+	switch_zmalloc(sum, sizeof(*sum));
+
+	switch_mutex_lock(profile.mutex);
+
+	stream->write_function(stream, "profiling: %s for %" SWITCH_INT64_T_FMT "s\n", profile.enabled ? "on" : "off",
+						   profile.started ? (int64_t) ((now - profile.started) / 1000000) : (int64_t) 0);
+	stream->write_function(stream, "%-10s %-20s %12s %10s %10s %10s %10s %10s %8s %8s\n", "subsystem", "name", "count", "rate/s", "avg/s", "p50-us",
+						   "p99-us", "max-us", "depth", "max");
+
+	for (counter = profile.counters; counter; counter = counter->next) {
+		double secs, rate, avg;
+
+		if (!zstr(subsystem) && strcasecmp(counter->subsystem, subsystem)) {
+			continue;
+		}
+
+		memset(sum, 0, sizeof(*sum));
+		for (i = 0; i < PROFILE_SLOTS; i++) {
+			profile_slot_t *slot = &counter->slot[i];
+
+			sum->count += slot->count;
+			sum->timed += slot->timed;
+			sum->sum += slot->sum;
+			if (slot->max > sum->max) {
+				sum->max = slot->max;
+			}
+			if (slot->timed) {
+				for (j = 0; j < SWITCH_LATENCY_BUCKETS; j++) {
+					sum->bucket[j] += slot->bucket[j];
+				}
+			}
+		}
+
+		/* the rate covers the time since this counter was last reported, the average the whole run */
+		secs = (double) (now - counter->last_report) / 1000000;
+		rate = secs > 0 && sum->count >= counter->last_count ? (sum->count - counter->last_count) / secs : 0;
+		secs = profile.started ? (double) (now - profile.started) / 1000000 : 0;
+		avg = secs > 0 ? sum->count / secs : 0;
+
+		stream->write_function(stream, "%-10s %-20s %12" SWITCH_UINT64_T_FMT " %10.1f %10.1f %10u %10u %10u %8u %8u\n",
+							   counter->subsystem, counter->name, sum->count, rate, avg,
+							   profile_percentile(sum, 50), profile_percentile(sum, 99), sum->max, counter->depth, counter->depth_max);
+
+		counter->last_count = sum->count;
+		counter->last_report = now;
+	}
+
+	switch_mutex_unlock(profile.mutex);
+
+	free(sum);
+}
+
+void switch_core_profile_init(switch_memory_pool_t *pool)
+{
+	switch_mutex_init(&profile.mutex, SWITCH_MUTEX_NESTED, pool);
+}
+
+void switch_core_profile_shutdown(void)
+{
+	switch_profile_counter_t *counter;
+
+	if (!profile.mutex) {
+		return;
+	}
+
+	switch_mutex_lock(profile.mutex);
+	profile.enabled = 0;
+	while ((counter = profile.counters)) {
+		profile.counters = counter->next;
+		switch_safe_free(counter->subsystem);
+		switch_safe_free(counter->name);
+		free(counter);
+	}
+	switch_mutex_unlock(profile.mutex);
+}
+
+/* For Emacs:
+ * Local Variables:
+ * mode:c
+ * indent-tabs-mode:t
+ * tab-width:4
+ * c-basic-offset:4
+ * End:
+ * For VIM:
+ * vim:set softtabstop=4 shiftwidth=4 tabstop=4:
+ */
@@ -0,0 +1,293 @@
+/* 
+ * FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ * Copyright (C) 2005-2010, Anthony Minessale II <anthm@freeswitch.org>
+ *
+ * Version: MPL 1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ *
+ * The Initial Developer of the Original Code is
+ * Anthony Minessale II <anthm@freeswitch.org>
+ * Portions created by the Initial Developer are Copyright (C)
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ * 
+ * Anthony Minessale II <anthm@freeswitch.org>
+ *
+ *
+ * switch_ringbuffer.c -- Lock Free Single Producer/Single Consumer Ring Buffer
+ *
+ */
+#include <switch.h>
+#include <switch_ringbuffer.h>
+
+/*
+ * head is only ever advanced by the consumer and tail only by the producer.  Both count bytes
+ * forever and are masked on use, so tail - head is always the amount in use (the size being a
+ * power of two keeps that true across integer wrap).  The barrier orders the data copy against
+ * publishing the new position so the other side never sees a position before the bytes behind it.
+ */
+#if defined(_MSC_VER)
+#define switch_ringbuffer_barrier() MemoryBarrier()
+#elif defined(__GNUC__)
+#define switch_ringbuffer_barrier() __sync_synchronize()
+#elif defined(__SUNPRO_C)
+#include <mbarrier.h>
+#define switch_ringbuffer_barrier() __machine_rw_barrier()
+#else
+#error "switch_ringbuffer needs a memory barrier for this compiler"
+#endif
+
+typedef enum {
+	SWITCH_RINGBUFFER_FLAG_DYNAMIC = (1 << 0)
+} switch_ringbuffer_flag_t;
+
+struct switch_ringbuffer {
+	switch_byte_t *data;
+	switch_size_t datalen;
+	switch_size_t mask;
+	volatile switch_size_t head;
+	volatile switch_size_t tail;
+	uint32_t flags;
+};
+
+SWITCH_DECLARE(switch_status_t) switch_ringbuffer_create(switch_memory_pool_t *pool, switch_ringbuffer_t **ring, switch_size_t min_len)
+{
+	switch_ringbuffer_t *new_ring;
+	switch_size_t len = 1;
+
+	*ring = NULL;
+
+	if (!min_len) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	while (len < min_len) {
+		if (len > ((switch_size_t) -1 >> 2)) {
+			return SWITCH_STATUS_MEMERR;
+		}
+		len <<= 1;
+	}
+
+	if (pool) {
+		if (!(new_ring = switch_core_alloc(pool, sizeof(*new_ring))) || !(new_ring->data = switch_core_alloc(pool, len))) {
+			return SWITCH_STATUS_MEMERR;
+		}
+	} else {
+		if (!(new_ring = malloc(sizeof(*new_ring)))) {
+			return SWITCH_STATUS_MEMERR;
+		}
+		memset(new_ring, 0, sizeof(*new_ring));
+
+		if (!(new_ring->data = malloc(len))) {
+			free(new_ring);
+			return SWITCH_STATUS_MEMERR;
+		}
+		switch_set_flag(new_ring, SWITCH_RINGBUFFER_FLAG_DYNAMIC);
+	}
+
+	new_ring->datalen = len;
+	new_ring->mask = len - 1;
+	*ring = new_ring;
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+SWITCH_DECLARE(void) switch_ringbuffer_destroy(switch_ringbuffer_t **ring)
+{
+	if (ring && *ring) {
+		if (switch_test_flag((*ring), SWITCH_RINGBUFFER_FLAG_DYNAMIC)) {
+			switch_safe_free((*ring)->data);
+			free(*ring);
+		}
+		*ring = NULL;
+	}
+}
+
+SWITCH_DECLARE(switch_size_t) switch_ringbuffer_size(switch_ringbuffer_t *ring)
+{
+	return ring->datalen;
+}
+
+SWITCH_DECLARE(switch_size_t) switch_ringbuffer_inuse(switch_ringbuffer_t *ring)
+{
+	switch_size_t head = ring->head;
+	switch_size_t tail = ring->tail;
+
+	return tail - head;
+}
+
+SWITCH_DECLARE(switch_size_t) switch_ringbuffer_freespace(switch_ringbuffer_t *ring)
+{
+	switch_size_t tail = ring->tail;
+	switch_size_t head = ring->head;
+
+	return ring->datalen - (tail - head);
+}
+
+SWITCH_DECLARE(switch_size_t) switch_ringbuffer_write(switch_ringbuffer_t *ring, const void *data, switch_size_t datalen)
+{
+	switch_size_t tail = ring->tail, off, first;
+
+	if (!datalen || ring->datalen - (tail - ring->head) < datalen) {
+		return 0;
+	}
+
+	/* the consumer may have just released the space we are about to fill */
+	switch_ringbuffer_barrier();
+
+	off = tail & ring->mask;
+	first = ring->datalen - off;
+
+	if (first >= datalen) {
+		memcpy(ring->data + off, data, datalen);
+	} else {
+		memcpy(ring->data + off, data, first);
+		memcpy(ring->data, (const switch_byte_t *) data + first, datalen - first);
+	}
+
+	switch_ringbuffer_barrier();
+	ring->tail = tail + datalen;
+
+	return datalen;
+}
+
+SWITCH_DECLARE(switch_size_t) switch_ringbuffer_write_region(switch_ringbuffer_t *ring, void **data)
+{
+	switch_size_t tail = ring->tail, off, free_len, first;
+
+	free_len = ring->datalen - (tail - ring->head);
+	switch_ringbuffer_barrier();
+
+	off = tail & ring->mask;
+	first = ring->datalen - off;
+	*data = ring->data + off;
+
+	return free_len < first ? free_len : first;
+}
+
+SWITCH_DECLARE(switch_size_t) switch_ringbuffer_write_commit(switch_ringbuffer_t *ring, switch_size_t datalen)
+{
+	switch_size_t tail = ring->tail;
+
+	if (ring->datalen - (tail - ring->head) < datalen) {
+		return 0;
+	}
+
+	switch_ringbuffer_barrier();
+	ring->tail = tail + datalen;
+
+	return datalen;
+}
+
+static switch_size_t ringbuffer_copy_out(switch_ringbuffer_t *ring, void *data, switch_size_t datalen, switch_size_t *headp)
+{
+	switch_size_t head = ring->head, inuse, off, first;
+
+	inuse = ring->tail - head;
+
+	/* pairs with the barrier before the producer publishes tail */
+	switch_ringbuffer_barrier();
+
+	if (datalen > inuse) {
+		datalen = inuse;
+	}
+
+	if (datalen) {
+		off = head & ring->mask;
+		first = ring->datalen - off;
+
+		if (first >= datalen) {
+			memcpy(data, ring->data + off, datalen);
+		} else {
+			memcpy(data, ring->data + off, first);
+			memcpy((switch_byte_t *) data + first, ring->data, datalen - first);
+		}
+	}
+
+	*headp = head;
+
+	return datalen;
+}
+
+SWITCH_DECLARE(switch_size_t) switch_ringbuffer_read(switch_ringbuffer_t *ring, void *data, switch_size_t datalen)
+{
+	switch_size_t head, reading;
+
+	if ((reading = ringbuffer_copy_out(ring, data, datalen, &head))) {
+		switch_ringbuffer_barrier();
+		ring->head = head + reading;
+	}
+
+	return reading;
+}
+
+SWITCH_DECLARE(switch_size_t) switch_ringbuffer_peek(switch_ringbuffer_t *ring, void *data, switch_size_t datalen)
+{
+	switch_size_t head;
+
+	return ringbuffer_copy_out(ring, data, datalen, &head);
+}
+
+SWITCH_DECLARE(switch_size_t) switch_ringbuffer_read_region(switch_ringbuffer_t *ring, const void **data)
+{
+	switch_size_t head = ring->head, inuse, off, first;
+
+	inuse = ring->tail - head;
+	switch_ringbuffer_barrier();
+
+	off = head & ring->mask;
+	first = ring->datalen - off;
+	*data = ring->data + off;
+
+	return inuse < first ? inuse : first;
+}
+
+SWITCH_DECLARE(switch_size_t) switch_ringbuffer_toss(switch_ringbuffer_t *ring, switch_size_t datalen)
+{
+	switch_size_t head = ring->head, inuse;
+
+	inuse = ring->tail - head;
+
+	if (datalen > inuse) {
+		datalen = inuse;
+	}
+
+	if (datalen) {
+		/* finish with the bytes before handing the space back to the producer */
+		switch_ringbuffer_barrier();
+		ring->head = head + datalen;
+	}
+
+	return datalen;
+}
+
+SWITCH_DECLARE(void) switch_ringbuffer_zero(switch_ringbuffer_t *ring)
+{
+	switch_size_t tail = ring->tail;
+
+	switch_ringbuffer_barrier();
+	ring->head = tail;
+}
+
+/* For Emacs:
+ * Local Variables:
+ * mode:c
+ * indent-tabs-mode:t
+ * tab-width:4
+ * c-basic-offset:4
+ * End:
+ * For VIM:
+ * vim:set softtabstop=4 shiftwidth=4 tabstop=4:
+ */
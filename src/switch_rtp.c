@@ -83,6 +83,52 @@ static int zrtp_on = 0;
 #endif
 
 static switch_hash_t *alloc_hash = NULL;
+static switch_profile_counter_t *prof_rtp_read = NULL;
+static switch_profile_counter_t *prof_rtp_write = NULL;
+
+/* A socket pair bound ahead of time by the socket pool thread, everything it owns lives in its own pool */
+typedef struct rtp_sock_entry_s {
+	switch_memory_pool_t *pool;
+	switch_socket_t *sock;
+	switch_socket_t *rtcp_sock;
+	switch_port_t port;
+	char key[80];
+	struct rtp_sock_entry_s *next;
+} rtp_sock_entry_t;
+
+typedef struct rtp_sock_pool_s {
+	char *ip;
+	rtp_sock_entry_t *head;
+	rtp_sock_entry_t *tail;
+	uint32_t ready;
+	uint32_t target;
+	uint32_t claims;
+	double cps;
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t created;
+	uint64_t errors;
+	uint64_t discarded;
+	struct rtp_sock_pool_s *next;
+} rtp_sock_pool_t;
+
+#define RTP_SOCK_POOL_INTERVAL 100000
+#define RTP_SOCK_POOL_FILL_MAX 32
+
+static struct {
+	switch_memory_pool_t *pool;
+	switch_hash_t *pools;
+	switch_hash_t *claimed;
+	rtp_sock_pool_t *list;
+	uint32_t claimed_count;
+	uint32_t min;
+	uint32_t max;
+	uint32_t lead;
+	switch_thread_t *thread;
+	switch_mutex_t *cond_mutex;
+	switch_thread_cond_t *cond;
+	int running;
+} sock_pool;
 
 typedef struct {
 	srtp_hdr_t header;
@@ -179,6 +225,8 @@ struct switch_rtp {
 	switch_time_t last_write_timestamp;
 	uint32_t flags;
 	switch_memory_pool_t *pool;
+	switch_memory_pool_t *sock_pool;
+	switch_socket_t *rtcp_pool_sock;
 	switch_sockaddr_t *from_addr, *rtcp_from_addr;
 	char *rx_host;
 	switch_port_t rx_port;
@@ -227,6 +275,10 @@ struct switch_rtp {
 	uint32_t sync_packets;
 	int rtcp_interval;
 	switch_bool_t rtcp_fresh_frame;
+	switch_rtp_t *relay_peer;
+	uint32_t relay_ts_offset;
+	uint8_t relay_ts_set;
+	rtp_msg_t relay_msg;
 
 #ifdef ENABLE_ZRTP
 	zrtp_session_t *zrtp_session;
@@ -602,6 +654,347 @@ static void zrtp_logger(int level, const char *data, int len, int offset)
 }
 #endif
 
+/* port_lock must be held */
+static switch_core_port_allocator_t *rtp_port_allocator(const char *ip)
+{
+	switch_core_port_allocator_t *alloc = NULL;
+
+	if (!(alloc = switch_core_hash_find(alloc_hash, ip))) {
+		if (switch_core_port_allocator_new(START_PORT, END_PORT, SPF_EVEN, &alloc) != SWITCH_STATUS_SUCCESS) {
+			abort();
+		}
+
+		switch_core_hash_insert(alloc_hash, ip, alloc);
+	}
+
+	return alloc;
+}
+
+static void rtp_sock_entry_destroy(rtp_sock_entry_t *entry)
+{
+	switch_memory_pool_t *pool = entry->pool;
+
+	/* the sockets and the entry itself go with the pool */
+	switch_core_destroy_memory_pool(&pool);
+}
+
+static rtp_sock_entry_t *rtp_sock_entry_create(const char *ip, switch_port_t port)
+{
+	switch_memory_pool_t *pool = NULL;
+	switch_sockaddr_t *addr = NULL;
+	rtp_sock_entry_t *entry;
+
+	if (switch_core_new_memory_pool(&pool) != SWITCH_STATUS_SUCCESS) {
+		return NULL;
+	}
+
+	entry = switch_core_alloc(pool, sizeof(*entry));
+	entry->pool = pool;
+	entry->port = port;
+	switch_snprintf(entry->key, sizeof(entry->key), "%s:%u", ip, port);
+
+	if (switch_sockaddr_info_get(&addr, ip, SWITCH_UNSPEC, port, 0, pool) != SWITCH_STATUS_SUCCESS ||
+		switch_socket_create(&entry->sock, switch_sockaddr_get_family(addr), SOCK_DGRAM, 0, pool) != SWITCH_STATUS_SUCCESS ||
+		switch_socket_opt_set(entry->sock, SWITCH_SO_REUSEADDR, 1) != SWITCH_STATUS_SUCCESS ||
+		switch_socket_bind(entry->sock, addr) != SWITCH_STATUS_SUCCESS) {
+		goto fail;
+	}
+
+	if (switch_sockaddr_info_get(&addr, ip, SWITCH_UNSPEC, port + 1, 0, pool) != SWITCH_STATUS_SUCCESS ||
+		switch_socket_create(&entry->rtcp_sock, switch_sockaddr_get_family(addr), SOCK_DGRAM, 0, pool) != SWITCH_STATUS_SUCCESS ||
+		switch_socket_opt_set(entry->rtcp_sock, SWITCH_SO_REUSEADDR, 1) != SWITCH_STATUS_SUCCESS ||
+		switch_socket_bind(entry->rtcp_sock, addr) != SWITCH_STATUS_SUCCESS) {
+		goto fail;
+	}
+
+	return entry;
+
+  fail:
+
+	switch_core_destroy_memory_pool(&pool);
+	return NULL;
+}
+
+/* port_lock must be held */
+static void rtp_sock_pool_discard(rtp_sock_pool_t *sp)
+{
+	rtp_sock_entry_t *entry;
+
+	if ((entry = sp->head)) {
+		if (!(sp->head = entry->next)) {
+			sp->tail = NULL;
+		}
+		sp->ready--;
+		sp->discarded++;
+		switch_core_port_allocator_free_port(rtp_port_allocator(sp->ip), entry->port);
+		rtp_sock_entry_destroy(entry);
+	}
+}
+
+static void rtp_sock_pool_fill(rtp_sock_pool_t *sp)
+{
+	rtp_sock_entry_t *entry;
+	switch_port_t port;
+	uint32_t n = 0;
+
+	for (;;) {
+		switch_mutex_lock(port_lock);
+		if (!sock_pool.running || sp->ready >= sp->target || n++ >= RTP_SOCK_POOL_FILL_MAX ||
+			switch_core_port_allocator_request_port(rtp_port_allocator(sp->ip), &port) != SWITCH_STATUS_SUCCESS) {
+			switch_mutex_unlock(port_lock);
+			break;
+		}
+		switch_mutex_unlock(port_lock);
+
+		/* creating and binding is the slow part, keep it out from under the lock */
+		entry = rtp_sock_entry_create(sp->ip, port);
+
+		switch_mutex_lock(port_lock);
+		if (!entry) {
+			switch_core_port_allocator_free_port(rtp_port_allocator(sp->ip), port);
+			sp->errors++;
+			switch_mutex_unlock(port_lock);
+			break;
+		}
+
+		if (sp->tail) {
+			sp->tail->next = entry;
+		} else {
+			sp->head = entry;
+		}
+		sp->tail = entry;
+		sp->ready++;
+		sp->created++;
+		switch_mutex_unlock(port_lock);
+	}
+}
+
+static void *SWITCH_THREAD_FUNC rtp_sock_pool_thread_run(switch_thread_t *thread, void *obj)
+{
+	switch_time_t last = switch_micro_time_now();
+
+	while (sock_pool.running) {
+		rtp_sock_pool_t *sp, *list;
+		switch_time_t now;
+
+		switch_mutex_lock(sock_pool.cond_mutex);
+		if (sock_pool.running) {
+			switch_thread_cond_timedwait(sock_pool.cond, sock_pool.cond_mutex, RTP_SOCK_POOL_INTERVAL);
+		}
+		switch_mutex_unlock(sock_pool.cond_mutex);
+
+		if (!sock_pool.running) {
+			break;
+		}
+
+		now = switch_micro_time_now();
+
+		switch_mutex_lock(port_lock);
+		list = sock_pool.list;
+
+		if (now - last >= RTP_SOCK_POOL_INTERVAL) {
+			double secs = (double) (now - last) / 1000000;
+
+			/* keep about lead ms worth of the recent call rate bound, smoothed over roughly a second */
+			for (sp = list; sp; sp = sp->next) {
+				uint32_t target;
+
+				sp->cps += (sp->claims / secs - sp->cps) * (secs < 1 ? secs : 1);
+				sp->claims = 0;
+
+				target = (uint32_t) (sp->cps * sock_pool.lead / 1000 + 0.999);
+				if (target < sock_pool.min) {
+					target = sock_pool.min;
+				}
+				if (target > sock_pool.max) {
+					target = sock_pool.max;
+				}
+				sp->target = target;
+
+				/* shrink slowly so a short lull does not throw away sockets we are about to need again */
+				if (sp->ready > sp->target) {
+					rtp_sock_pool_discard(sp);
+				}
+			}
+			last = now;
+		}
+		switch_mutex_unlock(port_lock);
+
+		/* pools are only ever added to the front of the list so walking our snapshot without the lock is safe */
+		for (sp = list; sp && sock_pool.running; sp = sp->next) {
+			rtp_sock_pool_fill(sp);
+		}
+	}
+
+	return NULL;
+}
+
+/* port_lock must be held */
+static switch_port_t rtp_sock_pool_claim(const char *ip)
+{
+	rtp_sock_pool_t *sp;
+	rtp_sock_entry_t *entry;
+	int wake = 0;
+
+	if (!(sp = switch_core_hash_find(sock_pool.pools, ip))) {
+		sp = switch_core_alloc(sock_pool.pool, sizeof(*sp));
+		sp->ip = switch_core_strdup(sock_pool.pool, ip);
+		sp->target = sock_pool.min ? sock_pool.min : 1;
+		sp->next = sock_pool.list;
+		sock_pool.list = sp;
+		switch_core_hash_insert(sock_pool.pools, sp->ip, sp);
+	}
+
+	sp->claims++;
+
+	if (!(entry = sp->head)) {
+		sp->misses++;
+		wake = 1;
+	} else {
+		if (!(sp->head = entry->next)) {
+			sp->tail = NULL;
+		}
+		entry->next = NULL;
+		sp->ready--;
+		sp->hits++;
+		switch_core_hash_insert(sock_pool.claimed, entry->key, entry);
+		sock_pool.claimed_count++;
+		wake = sp->ready < sp->target / 2;
+	}
+
+	if (wake) {
+		switch_mutex_lock(sock_pool.cond_mutex);
+		switch_thread_cond_signal(sock_pool.cond);
+		switch_mutex_unlock(sock_pool.cond_mutex);
+	}
+
+	return entry ? entry->port : 0;
+}
+
+/* port_lock must be held */
+static rtp_sock_entry_t *rtp_sock_pool_unclaim(const char *ip, switch_port_t port)
+{
+	rtp_sock_entry_t *entry = NULL;
+	char key[80];
+
+	if (sock_pool.claimed_count) {
+		switch_snprintf(key, sizeof(key), "%s:%u", ip, port);
+		if ((entry = switch_core_hash_find(sock_pool.claimed, key))) {
+			switch_core_hash_delete(sock_pool.claimed, key);
+			sock_pool.claimed_count--;
+		}
+	}
+
+	return entry;
+}
+
+static rtp_sock_entry_t *rtp_sock_pool_take(const char *ip, switch_port_t port)
+{
+	rtp_sock_entry_t *entry = NULL;
+
+	if (sock_pool.running) {
+		switch_mutex_lock(port_lock);
+		entry = rtp_sock_pool_unclaim(ip, port);
+		switch_mutex_unlock(port_lock);
+	}
+
+	return entry;
+}
+
+static void rtp_sock_pool_start(switch_memory_pool_t *pool)
+{
+	switch_threadattr_t *thd_attr = NULL;
+
+	if (!sock_pool.max) {
+		return;
+	}
+
+	if (sock_pool.min > sock_pool.max) {
+		sock_pool.min = sock_pool.max;
+	}
+
+	sock_pool.pool = pool;
+	switch_core_hash_init(&sock_pool.pools, pool);
+	switch_core_hash_init(&sock_pool.claimed, pool);
+	switch_mutex_init(&sock_pool.cond_mutex, SWITCH_MUTEX_NESTED, pool);
+	switch_thread_cond_create(&sock_pool.cond, pool);
+	sock_pool.running = 1;
+
+	switch_threadattr_create(&thd_attr, pool);
+	switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+	switch_thread_create(&sock_pool.thread, thd_attr, rtp_sock_pool_thread_run, NULL, pool);
+}
+
+static void rtp_sock_pool_stop(void)
+{
+	switch_status_t st;
+	switch_hash_index_t *hi;
+	rtp_sock_pool_t *sp;
+	void *val;
+
+	if (!sock_pool.running) {
+		return;
+	}
+
+	switch_mutex_lock(sock_pool.cond_mutex);
+	sock_pool.running = 0;
+	switch_thread_cond_signal(sock_pool.cond);
+	switch_mutex_unlock(sock_pool.cond_mutex);
+	switch_thread_join(&st, sock_pool.thread);
+
+	switch_mutex_lock(port_lock);
+	for (sp = sock_pool.list; sp; sp = sp->next) {
+		while (sp->head) {
+			rtp_sock_pool_discard(sp);
+		}
+	}
+
+	while ((hi = switch_hash_first(NULL, sock_pool.claimed))) {
+		switch_hash_this(hi, NULL, NULL, &val);
+		switch_core_hash_delete(sock_pool.claimed, ((rtp_sock_entry_t *) val)->key);
+		rtp_sock_entry_destroy((rtp_sock_entry_t *) val);
+	}
+	sock_pool.claimed_count = 0;
+
+	switch_core_hash_destroy(&sock_pool.claimed);
+	switch_core_hash_destroy(&sock_pool.pools);
+	sock_pool.list = NULL;
+	switch_mutex_unlock(port_lock);
+}
+
+SWITCH_DECLARE(void) switch_rtp_set_socket_pool(uint32_t min, uint32_t max, uint32_t lead_ms)
+{
+	sock_pool.min = min;
+	sock_pool.max = max;
+	sock_pool.lead = lead_ms;
+}
+
+SWITCH_DECLARE(void) switch_rtp_socket_pool_status(switch_stream_handle_t *stream)
+{
+	rtp_sock_pool_t *sp;
+
+	if (!sock_pool.running) {
+		stream->write_function(stream, "RTP socket pool disabled, sockets are bound when each call sets up media.\n");
+		return;
+	}
+
+	switch_mutex_lock(port_lock);
+	stream->write_function(stream, "min: %u max: %u lead: %ums claimed-unbound: %u\n", sock_pool.min, sock_pool.max, sock_pool.lead,
+						   sock_pool.claimed_count);
+	stream->write_function(stream, "%-40s %6s %6s %8s %12s %12s %7s %12s %8s %10s\n",
+						   "ip", "ready", "target", "cps", "hits", "misses", "miss%", "created", "errors", "discarded");
+
+	for (sp = sock_pool.list; sp; sp = sp->next) {
+		uint64_t total = sp->hits + sp->misses;
+
+		stream->write_function(stream, "%-40s %6u %6u %8.2f %12" SWITCH_UINT64_T_FMT " %12" SWITCH_UINT64_T_FMT " %7.2f %12" SWITCH_UINT64_T_FMT
+							   " %8" SWITCH_UINT64_T_FMT " %10" SWITCH_UINT64_T_FMT "\n",
+							   sp->ip, sp->ready, sp->target, sp->cps, sp->hits, sp->misses, total ? (double) sp->misses * 100 / total : 0.0,
+							   sp->created, sp->errors, sp->discarded);
+	}
+	switch_mutex_unlock(port_lock);
+}
+
 SWITCH_DECLARE(void) switch_rtp_init(switch_memory_pool_t *pool)
 {
 #ifdef ENABLE_ZRTP
@@ -644,6 +1037,9 @@ SWITCH_DECLARE(void) switch_rtp_init(switch_memory_pool_t *pool)
 #endif
 	srtp_init();
 	switch_mutex_init(&port_lock, SWITCH_MUTEX_NESTED, pool);
+	rtp_sock_pool_start(pool);
+	prof_rtp_read = switch_core_profile_counter("rtp", "read");
+	prof_rtp_write = switch_core_profile_counter("rtp", "write");
 	global_init = 1;
 }
 
@@ -660,6 +1056,8 @@ SWITCH_DECLARE(void) switch_rtp_shutdown(void)
 	const void *var;
 	void *val;
 
+	rtp_sock_pool_stop();
+
 	switch_mutex_lock(port_lock);
 
 	for (hi = switch_hash_first(NULL, alloc_hash); hi; hi = switch_hash_next(hi)) {
@@ -726,12 +1124,17 @@ SWITCH_DECLARE(switch_port_t) switch_rtp_set_end_port(switch_port_t port)
 SWITCH_DECLARE(void) switch_rtp_release_port(const char *ip, switch_port_t port)
 {
 	switch_core_port_allocator_t *alloc = NULL;
+	rtp_sock_entry_t *entry;
 
 	if (!ip) {
 		return;
 	}
 
 	switch_mutex_lock(port_lock);
+	if (sock_pool.running && (entry = rtp_sock_pool_unclaim(ip, port))) {
+		/* handed out but never used to set up media */
+		rtp_sock_entry_destroy(entry);
+	}
 	if ((alloc = switch_core_hash_find(alloc_hash, ip))) {
 		switch_core_port_allocator_free_port(alloc, port);
 	}
@@ -742,19 +1145,15 @@ SWITCH_DECLARE(void) switch_rtp_release_port(const char *ip, switch_port_t port)
 SWITCH_DECLARE(switch_port_t) switch_rtp_request_port(const char *ip)
 {
 	switch_port_t port = 0;
-	switch_core_port_allocator_t *alloc = NULL;
 
 	switch_mutex_lock(port_lock);
-	alloc = switch_core_hash_find(alloc_hash, ip);
-	if (!alloc) {
-		if (switch_core_port_allocator_new(START_PORT, END_PORT, SPF_EVEN, &alloc) != SWITCH_STATUS_SUCCESS) {
-			abort();
-		}
 
-		switch_core_hash_insert(alloc_hash, ip, alloc);
+	if (sock_pool.running && (port = rtp_sock_pool_claim(ip))) {
+		switch_mutex_unlock(port_lock);
+		return port;
 	}
 
-	if (switch_core_port_allocator_request_port(alloc, &port) != SWITCH_STATUS_SUCCESS) {
+	if (switch_core_port_allocator_request_port(rtp_port_allocator(ip), &port) != SWITCH_STATUS_SUCCESS) {
 		port = 0;
 	}
 
@@ -823,19 +1222,25 @@ static switch_status_t enable_local_rtcp_socket(switch_rtp_t *rtp_session, const
 			goto done;
 		}
 		
-		if (switch_socket_create(&rtcp_new_sock, switch_sockaddr_get_family(rtp_session->rtcp_local_addr), SOCK_DGRAM, 0, rtp_session->pool) != SWITCH_STATUS_SUCCESS) {
-			*err = "RTCP Socket Error!";
-			goto done;
-		}
+		if (rtp_session->rtcp_pool_sock) {
+			/* already bound to port + 1 by the socket pool */
+			rtcp_new_sock = rtp_session->rtcp_pool_sock;
+			rtp_session->rtcp_pool_sock = NULL;
+		} else {
+			if (switch_socket_create(&rtcp_new_sock, switch_sockaddr_get_family(rtp_session->rtcp_local_addr), SOCK_DGRAM, 0, rtp_session->pool) != SWITCH_STATUS_SUCCESS) {
+				*err = "RTCP Socket Error!";
+				goto done;
+			}
 		
-		if (switch_socket_opt_set(rtcp_new_sock, SWITCH_SO_REUSEADDR, 1) != SWITCH_STATUS_SUCCESS) {
-			*err = "RTCP Socket Error!";
-			goto done;
-		}
+			if (switch_socket_opt_set(rtcp_new_sock, SWITCH_SO_REUSEADDR, 1) != SWITCH_STATUS_SUCCESS) {
+				*err = "RTCP Socket Error!";
+				goto done;
+			}
 		
-		if (switch_socket_bind(rtcp_new_sock, rtp_session->rtcp_local_addr) != SWITCH_STATUS_SUCCESS) {
-			*err = "RTCP Bind Error!";
-			goto done;
+			if (switch_socket_bind(rtcp_new_sock, rtp_session->rtcp_local_addr) != SWITCH_STATUS_SUCCESS) {
+				*err = "RTCP Bind Error!";
+				goto done;
+			}
 		}
 		
 		if (switch_sockaddr_info_get(&rtp_session->rtcp_from_addr, switch_get_addr(bufa, sizeof(bufa), rtp_session->from_addr),
@@ -875,6 +1280,7 @@ SWITCH_DECLARE(switch_status_t) switch_rtp_set_local_address(switch_rtp_t *rtp_s
 {
 	switch_socket_t *new_sock = NULL, *old_sock = NULL;
 	switch_status_t status = SWITCH_STATUS_FALSE;
+	rtp_sock_entry_t *entry;
 #ifndef WIN32
 	char o[5] = "TEST", i[5] = "";
 	switch_size_t len, ilen = 0;
@@ -917,25 +1323,55 @@ SWITCH_DECLARE(switch_status_t) switch_rtp_set_local_address(switch_rtp_t *rtp_s
 		switch_rtp_kill_socket(rtp_session);
 	}
 
-	if (switch_socket_create(&new_sock, switch_sockaddr_get_family(rtp_session->local_addr), SOCK_DGRAM, 0, rtp_session->pool) != SWITCH_STATUS_SUCCESS) {
-		*err = "Socket Error!";
-		goto done;
+	if (rtp_session->rtcp_pool_sock) {
+		switch_socket_close(rtp_session->rtcp_pool_sock);
+		rtp_session->rtcp_pool_sock = NULL;
 	}
 
-	if (switch_socket_opt_set(new_sock, SWITCH_SO_REUSEADDR, 1) != SWITCH_STATUS_SUCCESS) {
-		*err = "Socket Error!";
-		goto done;
+	if ((entry = rtp_sock_pool_take(host, port))) {
+		if (rtp_session->sock_pool) {
+			/* only one pooled pair per session, the pool is torn down with the session */
+			rtp_sock_entry_destroy(entry);
+			entry = NULL;
+		} else {
+			rtp_session->sock_pool = entry->pool;
+			rtp_session->rtcp_pool_sock = entry->rtcp_sock;
+			new_sock = entry->sock;
+		}
 	}
+
+	if (!entry) {
+		if (switch_socket_create(&new_sock, switch_sockaddr_get_family(rtp_session->local_addr), SOCK_DGRAM, 0, rtp_session->pool) != SWITCH_STATUS_SUCCESS) {
+			*err = "Socket Error!";
+			goto done;
+		}
+
+		if (switch_socket_opt_set(new_sock, SWITCH_SO_REUSEADDR, 1) != SWITCH_STATUS_SUCCESS) {
+			*err = "Socket Error!";
+			goto done;
+		}
 	
-	if (switch_socket_bind(new_sock, rtp_session->local_addr) != SWITCH_STATUS_SUCCESS) {
-		*err = "Bind Error!";
-		goto done;
+		if (switch_socket_bind(new_sock, rtp_session->local_addr) != SWITCH_STATUS_SUCCESS) {
+			*err = "Bind Error!";
+			goto done;
+		}
 	}
 
 #ifndef WIN32
 	len = sizeof(i);
 	switch_socket_opt_set(new_sock, SWITCH_SO_NONBLOCK, TRUE);
 
+	if (entry) {
+		/* a pooled socket may have picked up stray packets for the last call on this port */
+		for (x = 0; x < 100; x++) {
+			ilen = sizeof(i);
+			if (switch_socket_recvfrom(rtp_session->from_addr, new_sock, 0, (void *) i, &ilen) != SWITCH_STATUS_SUCCESS || !ilen) {
+				break;
+			}
+		}
+		ilen = 0;
+	}
+
 	switch_socket_sendto(new_sock, rtp_session->local_addr, 0, (void *) o, &len);
 
 	x = 0;
@@ -1385,6 +1821,10 @@ SWITCH_DECLARE(switch_status_t) switch_rtp_create(switch_rtp_t **new_rtp_session
 
 	if (channel) {
 		switch_channel_set_private(channel, "__rtcp_audio_rtp_session", rtp_session);
+
+		if (!switch_test_flag(rtp_session, SWITCH_RTP_FLAG_VIDEO)) {
+			switch_channel_set_private(channel, "__relay_audio_rtp_session", rtp_session);
+		}
 	}
 
 #ifdef ENABLE_ZRTP
@@ -1500,12 +1940,18 @@ SWITCH_DECLARE(switch_rtp_t *) switch_rtp_new(const char *rx_host,
 
 	if (switch_rtp_set_local_address(rtp_session, rx_host, rx_port, err) != SWITCH_STATUS_SUCCESS) {
 		switch_mutex_unlock(rtp_session->flag_mutex);
+		if (rtp_session->sock_pool) {
+			switch_core_destroy_memory_pool(&rtp_session->sock_pool);
+		}
 		rtp_session = NULL;
 		goto end;
 	}
 
 	if (switch_rtp_set_remote_address(rtp_session, tx_host, tx_port, 0, SWITCH_TRUE, err) != SWITCH_STATUS_SUCCESS) {
 		switch_mutex_unlock(rtp_session->flag_mutex);
+		if (rtp_session->sock_pool) {
+			switch_core_destroy_memory_pool(&rtp_session->sock_pool);
+		}
 		rtp_session = NULL;
 		goto end;
 	}
@@ -1524,6 +1970,38 @@ SWITCH_DECLARE(switch_rtp_t *) switch_rtp_new(const char *rx_host,
 	return rtp_session;
 }
 
+SWITCH_DECLARE(switch_status_t) switch_rtp_set_relay(switch_rtp_t *rtp_session, switch_rtp_t *peer_rtp_session)
+{
+	if (!rtp_session) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	if (peer_rtp_session) {
+		if (!switch_rtp_ready(rtp_session) || !switch_rtp_ready(peer_rtp_session) || rtp_session == peer_rtp_session) {
+			return SWITCH_STATUS_FALSE;
+		}
+
+		if (switch_test_flag(rtp_session, SWITCH_RTP_FLAG_VIDEO) || switch_test_flag(peer_rtp_session, SWITCH_RTP_FLAG_VIDEO) ||
+			switch_test_flag(rtp_session, SWITCH_RTP_FLAG_PROXY_MEDIA) || switch_test_flag(peer_rtp_session, SWITCH_RTP_FLAG_PROXY_MEDIA) ||
+			switch_test_flag(rtp_session, SWITCH_RTP_FLAG_UDPTL) || switch_test_flag(peer_rtp_session, SWITCH_RTP_FLAG_UDPTL) ||
+			switch_test_flag(peer_rtp_session, SWITCH_RTP_FLAG_VAD)) {
+			return SWITCH_STATUS_FALSE;
+		}
+
+		/* we can only pass 2833 through if the other side has negotiated it too */
+		if (rtp_session->recv_te && !peer_rtp_session->te) {
+			return SWITCH_STATUS_FALSE;
+		}
+	}
+
+	READ_INC(rtp_session);
+	rtp_session->relay_peer = peer_rtp_session;
+	rtp_session->relay_ts_set = 0;
+	READ_DEC(rtp_session);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
 SWITCH_DECLARE(void) switch_rtp_set_telephony_event(switch_rtp_t *rtp_session, switch_payload_t te)
 {
 	if (te > 95) {
@@ -1698,6 +2176,7 @@ SWITCH_DECLARE(void) switch_rtp_destroy(switch_rtp_t **rtp_session)
 {
 	void *pop;
 	switch_socket_t *sock;
+	switch_core_session_t *session;
 
 	if (!rtp_session || !*rtp_session || !(*rtp_session)->ready) {
 		return;
@@ -1705,10 +2184,20 @@ SWITCH_DECLARE(void) switch_rtp_destroy(switch_rtp_t **rtp_session)
 
 	switch_set_flag_locked((*rtp_session), SWITCH_RTP_FLAG_SHUTDOWN);
 
+	/* stop a bridge from picking this session up as a relay target, the struct itself lives on in the session pool */
+	if ((session = switch_core_memory_pool_get_data((*rtp_session)->pool, "__session"))) {
+		switch_channel_t *channel = switch_core_session_get_channel(session);
+
+		if (switch_channel_get_private(channel, "__relay_audio_rtp_session") == *rtp_session) {
+			switch_channel_set_private(channel, "__relay_audio_rtp_session", NULL);
+		}
+	}
+
 	READ_INC((*rtp_session));
 	WRITE_INC((*rtp_session));
 
 	(*rtp_session)->ready = 0;
+	(*rtp_session)->relay_peer = NULL;
 
 	READ_DEC((*rtp_session));
 	WRITE_DEC((*rtp_session));
@@ -1781,6 +2270,11 @@ SWITCH_DECLARE(void) switch_rtp_destroy(switch_rtp_t **rtp_session)
 	}
 
 	switch_rtp_release_port((*rtp_session)->rx_host, (*rtp_session)->rx_port);
+
+	if ((*rtp_session)->sock_pool) {
+		/* closes whatever is left of the pre-bound pair */
+		switch_core_destroy_memory_pool(&(*rtp_session)->sock_pool);
+	}
 	switch_mutex_unlock((*rtp_session)->flag_mutex);
 
 	return;
@@ -2072,6 +2566,44 @@ static switch_status_t read_rtp_packet(switch_rtp_t *rtp_session, switch_size_t
 	return status;
 }
 
+static void relay_rtp_packet(switch_rtp_t *rtp_session, switch_size_t bytes)
+{
+	switch_rtp_t *peer = rtp_session->relay_peer;
+	rtp_msg_t *msg = &rtp_session->relay_msg;
+	switch_frame_flag_t frame_flags = SFF_NONE;
+	uint32_t ts = ntohl(rtp_session->recv_msg.header.ts);
+
+	if (!switch_rtp_ready(peer) || bytes > sizeof(*msg)) {
+		return;
+	}
+
+	/* continue the peer's timestamp line so the far end sees one stream */
+	if (!rtp_session->relay_ts_set) {
+		rtp_session->relay_ts_offset = (peer->last_write_ts + peer->samples_per_interval) - ts;
+		rtp_session->relay_ts_set = 1;
+	}
+
+	memcpy(msg, &rtp_session->recv_msg, bytes);
+	msg->header.ts = htonl(ts + rtp_session->relay_ts_offset);
+
+	/* only remap what both sides negotiated, anything else goes through as it came in */
+	if (rtp_session->recv_te && msg->header.pt == rtp_session->recv_te) {
+		frame_flags |= SFF_RFC2833;
+	} else if (msg->header.pt == rtp_session->payload) {
+		msg->header.pt = peer->payload;
+	} else if (rtp_session->cng_pt && msg->header.pt == rtp_session->cng_pt) {
+		if (!peer->cng_pt) {
+			return;
+		}
+		msg->header.pt = peer->cng_pt;
+	}
+
+	/* rtp_common_write puts in the peer's ssrc and seq and does any srtp on the way out */
+	if (rtp_common_write(peer, msg, NULL, (uint32_t) bytes, 0, 0, &frame_flags) > 0) {
+		rtp_session->stats.inbound.relay_packet_count++;
+	}
+}
+
 static switch_status_t read_rtcp_packet(switch_rtp_t *rtp_session, switch_size_t *bytes, switch_frame_flag_t *flags)
 {
 	switch_status_t status = SWITCH_STATUS_FALSE;
@@ -2191,6 +2723,7 @@ static int rtp_common_read(switch_rtp_t *rtp_session, switch_payload_t *payload_
 	int poll_loop = 0;
 	int fdr = 0;
 	int rtcp_fdr = 0;
+	switch_time_t prof_start;
 	int hot_socket = 0;
 
 	if (session) {
@@ -2263,7 +2796,11 @@ static int rtp_common_read(switch_rtp_t *rtp_session, switch_payload_t *payload_
 		}
 
 		if (poll_status == SWITCH_STATUS_SUCCESS) {
+			switch_core_profile_start(prof_start);
 			status = read_rtp_packet(rtp_session, &bytes, flags);
+			if (bytes > 0) {
+				switch_core_profile_stop(prof_rtp_read, prof_start);
+			}
 		} else {
 			if (!SWITCH_STATUS_IS_BREAK(poll_status) && poll_status != SWITCH_STATUS_TIMEOUT) {
 				ret = -1;
@@ -2609,6 +3146,12 @@ static int rtp_common_read(switch_rtp_t *rtp_session, switch_payload_t *payload_
 
 			bytes = sbytes;
 		}
+
+		if (bytes > rtp_header_len && rtp_session->relay_peer) {
+			relay_rtp_packet(rtp_session, bytes);
+			*flags |= SFF_RTP_RELAY;
+			return_cng_frame();
+		}
 #ifdef DEBUG_2833
 		if (rtp_session->dtmf_data.in_digit_sanity && !(rtp_session->dtmf_data.in_digit_sanity % 100)) {
 			printf("sanity %d\n", rtp_session->dtmf_data.in_digit_sanity);
@@ -3072,6 +3615,7 @@ static int rtp_common_write(switch_rtp_t *rtp_session,
 	uint32_t this_ts = 0;
 	int ret;
 	switch_time_t now;
+	switch_time_t prof_start;
 
 	if (!switch_rtp_ready(rtp_session)) {
 		return SWITCH_STATUS_FALSE;
@@ -3343,11 +3887,13 @@ static int rtp_common_write(switch_rtp_t *rtp_session,
 		}
 
 
+		switch_core_profile_start(prof_start);
 		if (switch_socket_sendto(rtp_session->sock_output, rtp_session->remote_addr, 0, (void *) send_msg, &bytes) != SWITCH_STATUS_SUCCESS) {
 			rtp_session->seq--;
 			ret = -1;
 			goto end;
 		}
+		switch_core_profile_stop(prof_rtp_write, prof_start);
 
 		rtp_session->stats.outbound.raw_bytes += bytes;
 		rtp_session->stats.outbound.packet_count++;
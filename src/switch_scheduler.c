@@ -51,14 +51,18 @@ static struct {
 	uint32_t task_id;
 	int task_thread_running;
 	switch_memory_pool_t *memory_pool;
+	switch_profile_counter_t *profile;
 } globals;
 
 static void switch_scheduler_execute(switch_scheduler_task_container_t *tp)
 {
 	switch_event_t *event;
+	switch_time_t prof_start;
 	//switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Executing task %u %s (%s)\n", tp->task.task_id, tp->desc, switch_str_nil(tp->task.group));
 
+	switch_core_profile_start(prof_start);
 	tp->func(&tp->task);
+	switch_core_profile_stop(globals.profile, prof_start);
 
 	if (tp->task.runtime > tp->executed) {
 		tp->executed = 0;
@@ -99,6 +103,7 @@ static void *SWITCH_THREAD_FUNC task_own_thread(switch_thread_t *thread, void *o
 static int task_thread_loop(int done)
 {
 	switch_scheduler_task_container_t *tofree, *tp, *last = NULL;
+	uint32_t due = 0;
 
 
 	switch_mutex_lock(globals.task_mutex);
@@ -110,6 +115,7 @@ static int task_thread_loop(int done)
 			int64_t now = switch_epoch_time_now(NULL);
 			if (now >= tp->task.runtime && !tp->in_thread) {
 				int32_t diff = (int32_t) (now - tp->task.runtime);
+				due++;
 				if (diff > 1) {
 					switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Task was executed late by %d seconds %u %s (%s)\n",
 									  diff, tp->task.task_id, tp->desc, switch_str_nil(tp->task.group));
@@ -130,6 +136,7 @@ static int task_thread_loop(int done)
 		}
 	}
 	switch_mutex_unlock(globals.task_mutex);
+	switch_core_profile_depth(globals.profile, due);
 	switch_mutex_lock(globals.task_mutex);
 	for (tp = globals.task_list; tp;) {
 		if (tp->destroyed && !tp->in_thread) {
@@ -295,6 +302,7 @@ SWITCH_DECLARE(void) switch_scheduler_task_thread_start(void)
 	switch_core_new_memory_pool(&globals.memory_pool);
 	switch_threadattr_create(&thd_attr, globals.memory_pool);
 	switch_mutex_init(&globals.task_mutex, SWITCH_MUTEX_NESTED, globals.memory_pool);
+	globals.profile = switch_core_profile_counter("scheduler", "task");
 
 	switch_threadattr_detach_set(thd_attr, 1);
 	switch_thread_create(&task_thread_p, thd_attr, switch_scheduler_task_thread, NULL, globals.memory_pool);
@@ -740,6 +740,11 @@ SWITCH_MODULE_RUNTIME_FUNCTION(softtimer_runtime)
 			fwd_errs = rev_errs = 0;
 		}
 
+		/* how late this tick fired */
+		if (runtime.latency_enabled) {
+			switch_core_latency_add(NULL, SWITCH_LATENCY_SIDE_READ, SWITCH_LATENCY_TIMER, ts - runtime.reference);
+		}
+
 		runtime.timestamp = ts;
 		current_ms += STEP_MS;
 		tick += STEP_MS;
@@ -0,0 +1,660 @@
+/*
+ * FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ * Copyright (C) 2005-2010, Anthony Minessale II <anthm@freeswitch.org>
+ *
+ * Version: MPL 1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ *
+ * The Initial Developer of the Original Code is
+ * Anthony Minessale II <anthm@freeswitch.org>
+ * Portions created by the Initial Developer are Copyright (C)
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ * Anthony Minessale II <anthm@freeswitch.org>
+ *
+ *
+ * switch_tts_cache.c -- Shared cache of rendered TTS audio
+ *
+ * Rendered speech is keyed on the md5 of (engine, voice, rate, text) and kept as raw
+ * signed linear audio in memory.  When the memory limit is reached the least recently
+ * used entries are spilled to files under the cache directory and finally dropped once
+ * the disk limit is reached too.  Cached audio is served back through the
+ * tts_cache:// file interface so switch_ivr_play_file() handles the playback.
+ *
+ */
+
+#include <switch.h>
+
+#ifdef WIN32
+#undef SWITCH_MOD_DECLARE_DATA
+#define SWITCH_MOD_DECLARE_DATA __declspec(dllexport)
+#endif
+SWITCH_MODULE_LOAD_FUNCTION(core_tts_cache_load);
+SWITCH_MODULE_SHUTDOWN_FUNCTION(core_tts_cache_shutdown);
+SWITCH_MODULE_DEFINITION(CORE_TTS_CACHE_MODULE, core_tts_cache_load, core_tts_cache_shutdown, NULL);
+
+#define TTS_CACHE_PROTO "tts_cache"
+
+struct tts_cache_entry {
+	char key[SWITCH_MD5_DIGEST_STRING_SIZE];
+	uint32_t rate;
+	/* rendered audio while resident in memory, NULL once spilled */
+	int16_t *data;
+	/* spill file while on disk, NULL while resident in memory */
+	char *path;
+	switch_size_t len;
+	uint32_t refs;
+	uint32_t hits;
+	switch_time_t last_used;
+	struct tts_cache_entry *prev;
+	struct tts_cache_entry *next;
+};
+typedef struct tts_cache_entry tts_cache_entry_t;
+
+struct tts_cache_handle {
+	tts_cache_entry_t *entry;
+	switch_file_t *fd;
+	switch_size_t pos;
+};
+typedef struct tts_cache_handle tts_cache_handle_t;
+
+static struct {
+	switch_memory_pool_t *pool;
+	switch_mutex_t *mutex;
+	switch_hash_t *hash;
+	/* most recently used first */
+	tts_cache_entry_t *head;
+	tts_cache_entry_t *tail;
+	char *path;
+	switch_size_t mem_max;
+	switch_size_t disk_max;
+	switch_size_t mem_used;
+	switch_size_t disk_used;
+	uint32_t entries;
+	uint64_t mem_hits;
+	uint64_t disk_hits;
+	uint64_t misses;
+	uint64_t stores;
+	uint64_t spills;
+	uint64_t evictions;
+	int running;
+} globals;
+
+static void tts_cache_make_key(const char *tts_name, const char *voice_name, uint32_t rate, const char *text,
+							   char key[SWITCH_MD5_DIGEST_STRING_SIZE])
+{
+	char *str = switch_mprintf("%s\n%s\n%u\n%s", switch_str_nil(tts_name), switch_str_nil(voice_name), rate, switch_str_nil(text));
+
+	switch_assert(str);
+	switch_md5_string(key, str, strlen(str));
+	free(str);
+}
+
+static void tts_cache_unlink(tts_cache_entry_t *ep)
+{
+	if (ep->prev) {
+		ep->prev->next = ep->next;
+	} else {
+		globals.head = ep->next;
+	}
+
+	if (ep->next) {
+		ep->next->prev = ep->prev;
+	} else {
+		globals.tail = ep->prev;
+	}
+
+	ep->prev = ep->next = NULL;
+}
+
+static void tts_cache_push(tts_cache_entry_t *ep)
+{
+	ep->prev = NULL;
+	ep->next = globals.head;
+
+	if (globals.head) {
+		globals.head->prev = ep;
+	}
+	globals.head = ep;
+
+	if (!globals.tail) {
+		globals.tail = ep;
+	}
+}
+
+/* must be called with globals.mutex locked and no open handles on the entry, the entry is no longer reachable after this */
+static void tts_cache_detach(tts_cache_entry_t *ep)
+{
+	tts_cache_unlink(ep);
+	switch_core_hash_delete(globals.hash, ep->key);
+
+	if (ep->data) {
+		globals.mem_used -= ep->len;
+	}
+
+	if (ep->path) {
+		globals.disk_used -= ep->len;
+	}
+
+	globals.entries--;
+}
+
+/* frees a detached entry, does not need globals.mutex */
+static void tts_cache_free(tts_cache_entry_t *ep)
+{
+	if (ep->path) {
+		switch_file_remove(ep->path, globals.pool);
+		free(ep->path);
+	}
+
+	switch_safe_free(ep->data);
+	free(ep);
+}
+
+/* must be called with globals.mutex locked and no open handles on the entry */
+static void tts_cache_drop(tts_cache_entry_t *ep)
+{
+	tts_cache_detach(ep);
+	tts_cache_free(ep);
+}
+
+/* writes a detached entry to disk, called without globals.mutex so other sessions don't wait on the disk */
+static switch_status_t tts_cache_spill(tts_cache_entry_t *ep)
+{
+	switch_file_t *fd = NULL;
+	switch_size_t len = ep->len;
+	char *path;
+
+	/* the same key can be detached again while an older copy is still being written, so each entry gets its own file */
+	path = switch_mprintf("%s%s%s-%lx.r16", globals.path, SWITCH_PATH_SEPARATOR, ep->key, (unsigned long) (uintptr_t) ep);
+	switch_assert(path);
+
+	if (switch_file_open(&fd, path, SWITCH_FOPEN_WRITE | SWITCH_FOPEN_CREATE | SWITCH_FOPEN_TRUNCATE | SWITCH_FOPEN_BINARY,
+						 SWITCH_FPROT_UREAD | SWITCH_FPROT_UWRITE, globals.pool) != SWITCH_STATUS_SUCCESS) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Cannot open TTS cache file %s\n", path);
+		free(path);
+		return SWITCH_STATUS_FALSE;
+	}
+
+	if (switch_file_write(fd, ep->data, &len) != SWITCH_STATUS_SUCCESS || len != ep->len) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Short write to TTS cache file %s\n", path);
+		switch_file_close(fd);
+		switch_file_remove(path, globals.pool);
+		free(path);
+		return SWITCH_STATUS_FALSE;
+	}
+
+	switch_file_close(fd);
+
+	free(ep->data);
+	ep->data = NULL;
+	ep->path = path;
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+/*
+ * Called without globals.mutex.  Entries over the memory limit are detached under the lock,
+ * written out after it is released and only published again as disk entries under the lock,
+ * entries over the disk limit are detached the same way and their files removed unlocked.
+ */
+static void tts_cache_trim(void)
+{
+	tts_cache_entry_t *ep, *prev, *next, *spill = NULL, *gone = NULL;
+	uint32_t failed = 0;
+
+	switch_mutex_lock(globals.mutex);
+	for (ep = globals.tail; ep && globals.mem_used > globals.mem_max; ep = prev) {
+		prev = ep->prev;
+		if (ep->refs || !ep->data) {
+			continue;
+		}
+		tts_cache_detach(ep);
+		if (globals.path && ep->len <= globals.disk_max) {
+			ep->next = spill;
+			spill = ep;
+		} else {
+			ep->next = gone;
+			gone = ep;
+			globals.evictions++;
+		}
+	}
+	switch_mutex_unlock(globals.mutex);
+
+	for (ep = spill, spill = NULL; ep; ep = next) {
+		next = ep->next;
+		ep->next = NULL;
+		if (tts_cache_spill(ep) == SWITCH_STATUS_SUCCESS) {
+			ep->next = spill;
+			spill = ep;
+		} else {
+			ep->next = gone;
+			gone = ep;
+			failed++;
+		}
+	}
+
+	switch_mutex_lock(globals.mutex);
+	globals.evictions += failed;
+	for (ep = spill; ep; ep = next) {
+		next = ep->next;
+		ep->next = NULL;
+
+		if (!globals.running || switch_core_hash_find(globals.hash, ep->key)) {
+			/* stored again while it was being written or the cache went away */
+			ep->next = gone;
+			gone = ep;
+			continue;
+		}
+
+		/* it was the least recently used, so it goes back at the tail */
+		ep->prev = globals.tail;
+		if (globals.tail) {
+			globals.tail->next = ep;
+		} else {
+			globals.head = ep;
+		}
+		globals.tail = ep;
+
+		switch_core_hash_insert(globals.hash, ep->key, ep);
+		globals.disk_used += ep->len;
+		globals.entries++;
+		globals.spills++;
+	}
+
+	for (ep = globals.tail; ep && globals.disk_used > globals.disk_max; ep = prev) {
+		prev = ep->prev;
+		if (ep->refs || !ep->path) {
+			continue;
+		}
+		tts_cache_detach(ep);
+		ep->next = gone;
+		gone = ep;
+		globals.evictions++;
+	}
+	switch_mutex_unlock(globals.mutex);
+
+	for (ep = gone; ep; ep = next) {
+		next = ep->next;
+		tts_cache_free(ep);
+	}
+}
+
+static void tts_cache_flush(void)
+{
+	tts_cache_entry_t *ep, *next;
+
+	switch_mutex_lock(globals.mutex);
+	for (ep = globals.head; ep; ep = next) {
+		next = ep->next;
+		if (!ep->refs) {
+			tts_cache_drop(ep);
+		}
+	}
+	switch_mutex_unlock(globals.mutex);
+}
+
+SWITCH_DECLARE(switch_status_t) switch_ivr_tts_cache_lookup(const char *tts_name, const char *voice_name, uint32_t rate, const char *text,
+															char *buf, switch_size_t buflen)
+{
+	char key[SWITCH_MD5_DIGEST_STRING_SIZE];
+	tts_cache_entry_t *ep;
+	switch_status_t status = SWITCH_STATUS_FALSE;
+
+	if (!globals.running || zstr(text)) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	tts_cache_make_key(tts_name, voice_name, rate, text, key);
+
+	switch_mutex_lock(globals.mutex);
+	if ((ep = switch_core_hash_find(globals.hash, key))) {
+		if (ep->data) {
+			globals.mem_hits++;
+		} else {
+			globals.disk_hits++;
+		}
+		ep->hits++;
+		ep->last_used = switch_micro_time_now();
+		tts_cache_unlink(ep);
+		tts_cache_push(ep);
+		switch_snprintf(buf, buflen, "%s://%s", TTS_CACHE_PROTO, key);
+		status = SWITCH_STATUS_SUCCESS;
+	} else {
+		globals.misses++;
+	}
+	switch_mutex_unlock(globals.mutex);
+
+	return status;
+}
+
+SWITCH_DECLARE(switch_status_t) switch_ivr_tts_cache_store(const char *tts_name, const char *voice_name, uint32_t rate, const char *text,
+														   switch_buffer_t *audio)
+{
+	char key[SWITCH_MD5_DIGEST_STRING_SIZE];
+	tts_cache_entry_t *ep;
+	switch_size_t len;
+
+	if (!globals.running || zstr(text) || !audio) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	if (!(len = switch_buffer_inuse(audio)) || len > globals.mem_max) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	tts_cache_make_key(tts_name, voice_name, rate, text, key);
+
+	switch_zmalloc(ep, sizeof(*ep));
+	switch_copy_string(ep->key, key, sizeof(ep->key));
+	ep->rate = rate;
+	ep->len = len;
+	ep->last_used = switch_micro_time_now();
+	ep->data = malloc(len);
+	switch_assert(ep->data);
+	switch_buffer_peek(audio, ep->data, len);
+
+	switch_mutex_lock(globals.mutex);
+	if (switch_core_hash_find(globals.hash, key)) {
+		/* another session finished rendering the same prompt first */
+		switch_mutex_unlock(globals.mutex);
+		free(ep->data);
+		free(ep);
+		return SWITCH_STATUS_SUCCESS;
+	}
+
+	switch_core_hash_insert(globals.hash, ep->key, ep);
+	tts_cache_push(ep);
+	globals.mem_used += len;
+	globals.entries++;
+	globals.stores++;
+	switch_mutex_unlock(globals.mutex);
+
+	tts_cache_trim();
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+static switch_status_t tts_cache_file_open(switch_file_handle_t *handle, const char *path)
+{
+	tts_cache_handle_t *context;
+	tts_cache_entry_t *ep;
+
+	if (switch_test_flag(handle, SWITCH_FILE_FLAG_WRITE)) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	if (!(context = switch_core_alloc(handle->memory_pool, sizeof(*context)))) {
+		return SWITCH_STATUS_MEMERR;
+	}
+
+	switch_mutex_lock(globals.mutex);
+	if ((ep = switch_core_hash_find(globals.hash, path))) {
+		ep->refs++;
+	}
+	switch_mutex_unlock(globals.mutex);
+
+	if (!ep) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "TTS cache entry %s is gone\n", path);
+		return SWITCH_STATUS_FALSE;
+	}
+
+	context->entry = ep;
+
+	/* an entry with an open handle is never spilled or dropped so path/data are stable from here */
+	if (!ep->data) {
+		if (switch_file_open(&context->fd, ep->path, SWITCH_FOPEN_READ | SWITCH_FOPEN_BINARY, SWITCH_FPROT_UREAD,
+							 handle->memory_pool) != SWITCH_STATUS_SUCCESS) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Error opening %s\n", ep->path);
+			switch_mutex_lock(globals.mutex);
+			ep->refs--;
+			switch_mutex_unlock(globals.mutex);
+			return SWITCH_STATUS_GENERR;
+		}
+	}
+
+	handle->samples = (unsigned int) (ep->len / 2);
+	handle->samplerate = ep->rate;
+	handle->channels = 1;
+	handle->format = 0;
+	handle->sections = 0;
+	handle->seekable = 1;
+	handle->speed = 0;
+	handle->pos = 0;
+	handle->private_info = context;
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+static switch_status_t tts_cache_file_close(switch_file_handle_t *handle)
+{
+	tts_cache_handle_t *context = handle->private_info;
+
+	if (context->fd) {
+		switch_file_close(context->fd);
+		context->fd = NULL;
+	}
+
+	switch_mutex_lock(globals.mutex);
+	context->entry->refs--;
+	switch_mutex_unlock(globals.mutex);
+
+	tts_cache_trim();
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+static switch_status_t tts_cache_file_read(switch_file_handle_t *handle, void *data, size_t *len)
+{
+	tts_cache_handle_t *context = handle->private_info;
+	tts_cache_entry_t *ep = context->entry;
+	switch_size_t bytes = *len * 2;
+
+	if (context->pos >= ep->len) {
+		*len = 0;
+		return SWITCH_STATUS_FALSE;
+	}
+
+	if (bytes > ep->len - context->pos) {
+		bytes = ep->len - context->pos;
+	}
+
+	if (context->fd) {
+		if (switch_file_read(context->fd, data, &bytes) != SWITCH_STATUS_SUCCESS || !bytes) {
+			*len = 0;
+			return SWITCH_STATUS_FALSE;
+		}
+	} else {
+		memcpy(data, (uint8_t *) ep->data + context->pos, bytes);
+	}
+
+	context->pos += bytes;
+	*len = bytes / 2;
+	handle->pos += *len;
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+static switch_status_t tts_cache_file_seek(switch_file_handle_t *handle, unsigned int *cur_sample, int64_t samples, int whence)
+{
+	tts_cache_handle_t *context = handle->private_info;
+	int64_t total = (int64_t) (context->entry->len / 2);
+	int64_t target;
+
+	switch (whence) {
+	case SEEK_CUR:
+		target = (int64_t) (context->pos / 2) + samples;
+		break;
+	case SEEK_END:
+		target = total + samples;
+		break;
+	default:
+		target = samples;
+		break;
+	}
+
+	if (target < 0) {
+		target = 0;
+	} else if (target > total) {
+		target = total;
+	}
+
+	context->pos = (switch_size_t) target * 2;
+
+	if (context->fd) {
+		int64_t off = (int64_t) context->pos;
+		switch_file_seek(context->fd, SEEK_SET, &off);
+	}
+
+	handle->pos = target;
+	*cur_sample = (unsigned int) target;
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+#define TTS_CACHE_SYNTAX "[stats|flush]"
+SWITCH_STANDARD_API(tts_cache_api_function)
+{
+	if (!zstr(cmd) && !strcasecmp(cmd, "flush")) {
+		tts_cache_flush();
+		stream->write_function(stream, "+OK\n");
+		return SWITCH_STATUS_SUCCESS;
+	}
+
+	if (!zstr(cmd) && strcasecmp(cmd, "stats")) {
+		stream->write_function(stream, "-USAGE: %s\n", TTS_CACHE_SYNTAX);
+		return SWITCH_STATUS_SUCCESS;
+	}
+
+	switch_mutex_lock(globals.mutex);
+	stream->write_function(stream, "entries: %u\n", globals.entries);
+	stream->write_function(stream, "memory: %" SWITCH_SIZE_T_FMT "/%" SWITCH_SIZE_T_FMT " bytes\n", globals.mem_used, globals.mem_max);
+	stream->write_function(stream, "disk: %" SWITCH_SIZE_T_FMT "/%" SWITCH_SIZE_T_FMT " bytes (%s)\n", globals.disk_used, globals.disk_max,
+						   switch_str_nil(globals.path));
+	stream->write_function(stream, "hits: %" SWITCH_UINT64_T_FMT " (memory %" SWITCH_UINT64_T_FMT ", disk %" SWITCH_UINT64_T_FMT ")\n",
+						   globals.mem_hits + globals.disk_hits, globals.mem_hits, globals.disk_hits);
+	stream->write_function(stream, "misses: %" SWITCH_UINT64_T_FMT "\n", globals.misses);
+	stream->write_function(stream, "hit-rate: %.2f%%\n",
+						   (globals.mem_hits + globals.disk_hits + globals.misses) ?
+						   100.0 * (double) (globals.mem_hits + globals.disk_hits) / (double) (globals.mem_hits + globals.disk_hits + globals.misses) : 0.0);
+	stream->write_function(stream, "stores: %" SWITCH_UINT64_T_FMT "\n", globals.stores);
+	stream->write_function(stream, "spills: %" SWITCH_UINT64_T_FMT "\n", globals.spills);
+	stream->write_function(stream, "evictions: %" SWITCH_UINT64_T_FMT "\n", globals.evictions);
+	switch_mutex_unlock(globals.mutex);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+static void tts_cache_load_config(void)
+{
+	switch_xml_t xml, cfg, settings, param;
+	const char *path = NULL;
+
+	/* off unless switch.conf sizes it */
+	globals.mem_max = 0;
+	globals.disk_max = 0;
+
+	if ((xml = switch_xml_open_cfg("switch.conf", &cfg, NULL))) {
+		if ((settings = switch_xml_child(cfg, "settings"))) {
+			for (param = switch_xml_child(settings, "param"); param; param = param->next) {
+				const char *var = switch_xml_attr_soft(param, "name");
+				const char *val = switch_xml_attr_soft(param, "value");
+
+				if (!strcasecmp(var, "tts-cache-memory") && !zstr(val)) {
+					int tmp = atoi(val);
+					globals.mem_max = tmp > 0 ? (switch_size_t) tmp * 1024 : 0;
+				} else if (!strcasecmp(var, "tts-cache-disk") && !zstr(val)) {
+					int tmp = atoi(val);
+					globals.disk_max = tmp > 0 ? (switch_size_t) tmp * 1024 : 0;
+				} else if (!strcasecmp(var, "tts-cache-path") && !zstr(val)) {
+					path = switch_core_strdup(globals.pool, val);
+				}
+			}
+		}
+		switch_xml_free(xml);
+	}
+
+	if (globals.disk_max) {
+		if (!path) {
+			path = switch_core_sprintf(globals.pool, "%s%stts_cache", SWITCH_GLOBAL_dirs.storage_dir, SWITCH_PATH_SEPARATOR);
+		}
+
+		if (switch_dir_make_recursive(path, SWITCH_DEFAULT_DIR_PERMS, globals.pool) == SWITCH_STATUS_SUCCESS) {
+			globals.path = (char *) path;
+		} else {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Cannot create TTS cache directory %s, disk spill disabled\n", path);
+			globals.disk_max = 0;
+		}
+	}
+}
+
+SWITCH_MODULE_LOAD_FUNCTION(core_tts_cache_load)
+{
+	switch_file_interface_t *file_interface;
+	switch_api_interface_t *api_interface;
+	static char *supported_formats[] = { TTS_CACHE_PROTO, NULL };
+
+	memset(&globals, 0, sizeof(globals));
+	globals.pool = pool;
+	switch_mutex_init(&globals.mutex, SWITCH_MUTEX_NESTED, pool);
+	switch_core_hash_init(&globals.hash, pool);
+
+	tts_cache_load_config();
+
+	/* connect my internal structure to the blank pointer passed to me */
+	*module_interface = switch_loadable_module_create_module_interface(pool, modname);
+	file_interface = switch_loadable_module_create_interface(*module_interface, SWITCH_FILE_INTERFACE);
+	file_interface->interface_name = modname;
+	file_interface->extens = supported_formats;
+	file_interface->file_open = tts_cache_file_open;
+	file_interface->file_close = tts_cache_file_close;
+	file_interface->file_read = tts_cache_file_read;
+	file_interface->file_seek = tts_cache_file_seek;
+
+	SWITCH_ADD_API(api_interface, "tts_cache", "Rendered TTS cache", tts_cache_api_function, TTS_CACHE_SYNTAX);
+	switch_console_set_complete("add tts_cache stats");
+	switch_console_set_complete("add tts_cache flush");
+
+	globals.running = globals.mem_max ? 1 : 0;
+
+	if (globals.running) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "TTS cache enabled, %" SWITCH_SIZE_T_FMT " bytes memory, %" SWITCH_SIZE_T_FMT
+						  " bytes disk\n", globals.mem_max, globals.disk_max);
+	}
+
+	/* indicate that the module should continue to be loaded */
+	return SWITCH_STATUS_SUCCESS;
+}
+
+SWITCH_MODULE_SHUTDOWN_FUNCTION(core_tts_cache_shutdown)
+{
+	globals.running = 0;
+	tts_cache_flush();
+	switch_core_hash_destroy(&globals.hash);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+/* For Emacs:
+ * Local Variables:
+ * mode:c
+ * indent-tabs-mode:t
+ * tab-width:4
+ * c-basic-offset:4
+ * End:
+ * For VIM:
+ * vim:set softtabstop=4 shiftwidth=4 tabstop=4:
+ */
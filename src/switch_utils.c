@@ -42,20 +42,37 @@ struct switch_network_node {
 	uint32_t ip;
 	uint32_t mask;
 	uint32_t bits;
+	int family;
 	switch_bool_t ok;
+	switch_bool_t linear;
 	char *token;
 	char *str;
 	struct switch_network_node *next;
 };
 typedef struct switch_network_node switch_network_node_t;
 
+/* Path compressed binary trie over 128 bit keys, IPv4 entries live under ::ffff:0:0/96.
+   Nodes without an entry are glue nodes created where two prefixes diverge. */
+struct switch_network_trie_node {
+	uint8_t key[16];
+	uint32_t bits;
+	switch_network_node_t *node;
+	struct switch_network_trie_node *child[2];
+};
+typedef struct switch_network_trie_node switch_network_trie_node_t;
+
 struct switch_network_list {
 	struct switch_network_node *node_head;
+	switch_network_trie_node_t *trie;
+	uint32_t trie_nodes;
+	uint32_t linear_nodes;
 	switch_bool_t default_type;
 	switch_memory_pool_t *pool;
 	char *name;
 };
 
+#define NETWORK_V4_MAPPED_BITS 96
+
 #ifndef WIN32
 SWITCH_DECLARE(int) switch_inet_pton(int af, const char *src, void *dst)
 {
@@ -63,18 +80,248 @@ SWITCH_DECLARE(int) switch_inet_pton(int af, const char *src, void *dst)
 }
 #endif
 
-SWITCH_DECLARE(switch_status_t) switch_frame_alloc(switch_frame_t **frame, switch_size_t size)
+/* Dynamic frames carry their payload in a refcounted buffer so a frame can be handed to
+   another consumer without copying it. Buffers and frame structs are recycled through
+   size classed free lists instead of going back to malloc on every frame. */
+#define FRAME_BUF_MIN 512
+#define FRAME_BUF_CLASSES 5
+#define FRAME_CACHE_MAX 64		/* per stripe */
+#define FRAME_CACHE_STRIPES 8
+
+typedef struct switch_frame_buf {
+	uint32_t refs;
+	uint32_t size;
+	int klass;
+	struct switch_frame_buf *next;
+} switch_frame_buf_t;
+
+typedef struct switch_frame_node {
+	switch_frame_t frame;
+	switch_frame_buf_t *buf;
+	struct switch_frame_node *next;
+} switch_frame_node_t;
+
+typedef enum {
+	FRAME_STAT_ALLOC,
+	FRAME_STAT_RECYCLE,
+	FRAME_STAT_COPY,
+	FRAME_STAT_SHARE,
+	FRAME_STAT_MAX
+} frame_stat_t;
+
+static const char *frame_stat_names[FRAME_STAT_MAX] = { "alloc", "recycle", "copy", "share" };
+
+/* the free lists are striped by calling thread so media threads rarely meet on a lock, a stripe's lock also
+   guards the refcount of every buffer whose address hashes to it, no thread ever holds two stripe locks */
+typedef struct {
+	switch_mutex_t *mutex;
+	switch_frame_buf_t *bufs[FRAME_BUF_CLASSES];
+	uint32_t buf_count[FRAME_BUF_CLASSES];
+	switch_frame_node_t *nodes;
+	uint32_t node_count;
+	uint64_t gets;
+	uint64_t puts;
+	uint64_t total[FRAME_STAT_MAX];
+} frame_stripe_t;
+
+static struct {
+	int ready;
+	frame_stripe_t stripes[FRAME_CACHE_STRIPES];
+	switch_mutex_t *stats_mutex;
+	switch_time_t stats_time;
+	uint64_t stats_total[FRAME_STAT_MAX];
+} frame_cache;
+
+#define frame_buf_data(_buf) ((uint8_t *) ((_buf) + 1))
+
+static frame_stripe_t *frame_stripe_self(void)
+{
+	uintptr_t tid = (uintptr_t) switch_thread_self();
+
+	tid ^= tid >> 16;
+	tid *= 0x45d9f3b;
+	tid ^= tid >> 16;
+
+	return &frame_cache.stripes[tid % FRAME_CACHE_STRIPES];
+}
+
+static frame_stripe_t *frame_stripe_of(switch_frame_buf_t *buf)
+{
+	return &frame_cache.stripes[((uintptr_t) buf >> 6) % FRAME_CACHE_STRIPES];
+}
+
+static void frame_stripe_lock(frame_stripe_t *stripe)
+{
+	if (frame_cache.ready) {
+		switch_mutex_lock(stripe->mutex);
+	}
+}
+
+static void frame_stripe_unlock(frame_stripe_t *stripe)
+{
+	if (frame_cache.ready) {
+		switch_mutex_unlock(stripe->mutex);
+	}
+}
+
+static int frame_buf_class(switch_size_t size)
+{
+	int klass = 0;
+	switch_size_t len = FRAME_BUF_MIN;
+
+	while (len < size && klass < FRAME_BUF_CLASSES) {
+		len <<= 1;
+		klass++;
+	}
+
+	return klass < FRAME_BUF_CLASSES ? klass : -1;
+}
+
+static switch_frame_buf_t *frame_buf_get(switch_size_t size)
+{
+	frame_stripe_t *stripe = frame_stripe_self();
+	switch_frame_buf_t *buf = NULL;
+	int klass = frame_buf_class(size);
+
+	frame_stripe_lock(stripe);
+	if (klass > -1 && (buf = stripe->bufs[klass])) {
+		stripe->bufs[klass] = buf->next;
+		stripe->buf_count[klass]--;
+		stripe->total[FRAME_STAT_RECYCLE]++;
+	} else {
+		stripe->total[FRAME_STAT_ALLOC]++;
+	}
+	frame_stripe_unlock(stripe);
+
+	if (!buf) {
+		switch_size_t len = klass > -1 ? (switch_size_t) FRAME_BUF_MIN << klass : size;
+
+		buf = malloc(sizeof(*buf) + len);
+		switch_assert(buf);
+		buf->size = (uint32_t) len;
+		buf->klass = klass;
+	}
+
+	buf->refs = 1;
+	buf->next = NULL;
+
+	return buf;
+}
+
+static void frame_buf_release(switch_frame_buf_t *buf)
+{
+	frame_stripe_t *stripe = frame_stripe_of(buf);
+	uint32_t refs;
+
+	frame_stripe_lock(stripe);
+	refs = --buf->refs;
+	frame_stripe_unlock(stripe);
+
+	if (refs) {
+		return;
+	}
+
+	stripe = frame_stripe_self();
+
+	frame_stripe_lock(stripe);
+	if (frame_cache.ready && buf->klass > -1 && stripe->buf_count[buf->klass] < FRAME_CACHE_MAX) {
+		buf->next = stripe->bufs[buf->klass];
+		stripe->bufs[buf->klass] = buf;
+		stripe->buf_count[buf->klass]++;
+		buf = NULL;
+	}
+	frame_stripe_unlock(stripe);
+
+	switch_safe_free(buf);
+}
+
+static switch_frame_node_t *frame_node_get(void)
+{
+	frame_stripe_t *stripe = frame_stripe_self();
+	switch_frame_node_t *node;
+
+	frame_stripe_lock(stripe);
+	if ((node = stripe->nodes)) {
+		stripe->nodes = node->next;
+		stripe->node_count--;
+	}
+	stripe->gets++;
+	frame_stripe_unlock(stripe);
+
+	if (!node) {
+		node = malloc(sizeof(*node));
+		switch_assert(node);
+	}
+
+	memset(node, 0, sizeof(*node));
+
+	return node;
+}
+
+static void frame_stat(frame_stat_t stat)
 {
-	switch_frame_t *new_frame;
+	frame_stripe_t *stripe = frame_stripe_self();
 
-	switch_zmalloc(new_frame, sizeof(*new_frame));
+	frame_stripe_lock(stripe);
+	stripe->total[stat]++;
+	frame_stripe_unlock(stripe);
+}
+
+void switch_core_frame_init(switch_memory_pool_t *pool)
+{
+	int i;
+
+	for (i = 0; i < FRAME_CACHE_STRIPES; i++) {
+		switch_mutex_init(&frame_cache.stripes[i].mutex, SWITCH_MUTEX_NESTED, pool);
+	}
+
+	switch_mutex_init(&frame_cache.stats_mutex, SWITCH_MUTEX_NESTED, pool);
+	frame_cache.stats_time = switch_micro_time_now();
+	frame_cache.ready = 1;
+}
+
+void switch_core_frame_uninit(void)
+{
+	frame_stripe_t *stripe;
+	switch_frame_node_t *node;
+	switch_frame_buf_t *buf;
+	int i, s;
+
+	if (!frame_cache.ready) {
+		return;
+	}
+
+	for (s = 0; s < FRAME_CACHE_STRIPES; s++) {
+		stripe = &frame_cache.stripes[s];
+
+		switch_mutex_lock(stripe->mutex);
+		while ((node = stripe->nodes)) {
+			stripe->nodes = node->next;
+			free(node);
+		}
+		stripe->node_count = 0;
+
+		for (i = 0; i < FRAME_BUF_CLASSES; i++) {
+			while ((buf = stripe->bufs[i])) {
+				stripe->bufs[i] = buf->next;
+				free(buf);
+			}
+			stripe->buf_count[i] = 0;
+		}
+		switch_mutex_unlock(stripe->mutex);
+	}
+}
 
-	switch_set_flag(new_frame, SFF_DYNAMIC);
-	new_frame->buflen = size;
-	new_frame->data = malloc(size);
-	switch_assert(new_frame->data);
+SWITCH_DECLARE(switch_status_t) switch_frame_alloc(switch_frame_t **frame, switch_size_t size)
+{
+	switch_frame_node_t *node = frame_node_get();
 
-	*frame = new_frame;
+	node->buf = frame_buf_get(size);
+	switch_set_flag((&node->frame), SFF_DYNAMIC);
+	node->frame.buflen = (uint32_t) size;
+	node->frame.data = frame_buf_data(node->buf);
+
+	*frame = &node->frame;
 
 	return SWITCH_STATUS_SUCCESS;
 }
@@ -82,7 +329,7 @@ SWITCH_DECLARE(switch_status_t) switch_frame_alloc(switch_frame_t **frame, switc
 
 SWITCH_DECLARE(switch_status_t) switch_frame_dup(switch_frame_t *orig, switch_frame_t **clone)
 {
-	switch_frame_t *new_frame;
+	switch_frame_node_t *node;
 
 	if (!orig) {
 		return SWITCH_STATUS_FALSE;
@@ -90,37 +337,165 @@ SWITCH_DECLARE(switch_status_t) switch_frame_dup(switch_frame_t *orig, switch_fr
 
 	switch_assert(orig->buflen);
 
-	new_frame = malloc(sizeof(*new_frame));
+	node = frame_node_get();
+	node->frame = *orig;
+	switch_set_flag((&node->frame), SFF_DYNAMIC);
+
+	node->buf = frame_buf_get(orig->buflen);
+	node->frame.data = frame_buf_data(node->buf);
+
+	memcpy(node->frame.data, orig->data, orig->datalen);
+	node->frame.codec = NULL;
+
+	frame_stat(FRAME_STAT_COPY);
+
+	*clone = &node->frame;
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+SWITCH_DECLARE(switch_status_t) switch_frame_ref(switch_frame_t *orig, switch_frame_t **clone)
+{
+	switch_frame_node_t *onode = (switch_frame_node_t *) orig, *node;
+	frame_stripe_t *stripe;
+
+	if (!orig) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	/* only frames from switch_frame_alloc/dup have a buffer to share, and only once the locks exist */
+	if (!switch_test_flag(orig, SFF_DYNAMIC) || !frame_cache.ready || orig->data != frame_buf_data(onode->buf)) {
+		return switch_frame_dup(orig, clone);
+	}
+
+	node = frame_node_get();
+	node->frame = *orig;
+	node->frame.codec = NULL;
+	node->buf = onode->buf;
 
-	switch_assert(new_frame);
+	stripe = frame_stripe_of(node->buf);
+	switch_mutex_lock(stripe->mutex);
+	node->buf->refs++;
+	switch_mutex_unlock(stripe->mutex);
 
-	*new_frame = *orig;
-	switch_set_flag(new_frame, SFF_DYNAMIC);
+	frame_stat(FRAME_STAT_SHARE);
+
+	*clone = &node->frame;
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+SWITCH_DECLARE(switch_status_t) switch_frame_writable(switch_frame_t *frame)
+{
+	switch_frame_node_t *node = (switch_frame_node_t *) frame;
+	switch_frame_buf_t *buf, *old;
+	frame_stripe_t *stripe;
+	uint32_t refs;
+
+	if (!frame || !switch_test_flag(frame, SFF_DYNAMIC) || !frame_cache.ready || frame->data != frame_buf_data(node->buf)) {
+		return SWITCH_STATUS_SUCCESS;
+	}
+
+	old = node->buf;
+	stripe = frame_stripe_of(old);
+	switch_mutex_lock(stripe->mutex);
+	refs = old->refs;
+	switch_mutex_unlock(stripe->mutex);
+
+	if (refs < 2) {
+		return SWITCH_STATUS_SUCCESS;
+	}
 
-	new_frame->data = malloc(new_frame->buflen);
-	switch_assert(new_frame->data);
+	/* someone else still sees these samples, give this frame its own copy before it is changed */
+	buf = frame_buf_get(frame->buflen);
+	memcpy(frame_buf_data(buf), frame->data, frame->datalen);
 
-	memcpy(new_frame->data, orig->data, orig->datalen);
-	new_frame->codec = NULL;
+	frame_stat(FRAME_STAT_COPY);
+	frame_buf_release(old);
 
-	*clone = new_frame;
+	node->buf = buf;
+	frame->data = frame_buf_data(buf);
 
 	return SWITCH_STATUS_SUCCESS;
 }
 
 SWITCH_DECLARE(switch_status_t) switch_frame_free(switch_frame_t **frame)
 {
+	switch_frame_node_t *node;
+	frame_stripe_t *stripe;
+
 	if (!frame || !*frame || !switch_test_flag((*frame), SFF_DYNAMIC)) {
 		return SWITCH_STATUS_FALSE;
 	}
 
-	switch_safe_free((*frame)->data);
-	free(*frame);
+	node = (switch_frame_node_t *) *frame;
 	*frame = NULL;
 
+	frame_buf_release(node->buf);
+
+	stripe = frame_stripe_self();
+	frame_stripe_lock(stripe);
+	stripe->puts++;
+	if (frame_cache.ready && stripe->node_count < FRAME_CACHE_MAX) {
+		node->next = stripe->nodes;
+		stripe->nodes = node;
+		stripe->node_count++;
+		node = NULL;
+	}
+	frame_stripe_unlock(stripe);
+
+	switch_safe_free(node);
+
 	return SWITCH_STATUS_SUCCESS;
 }
 
+/* rates are worked out here against the totals seen by the last call, so the hot paths only count */
+SWITCH_DECLARE(void) switch_frame_stats(switch_stream_handle_t *stream)
+{
+	frame_stripe_t *stripe;
+	switch_time_t now = switch_micro_time_now();
+	uint64_t total[FRAME_STAT_MAX] = { 0 }, gets = 0, puts = 0;
+	uint32_t nodes = 0, cached = 0;
+	double secs;
+	int i, s;
+
+	if (!frame_cache.ready) {
+		return;
+	}
+
+	for (s = 0; s < FRAME_CACHE_STRIPES; s++) {
+		stripe = &frame_cache.stripes[s];
+
+		switch_mutex_lock(stripe->mutex);
+		for (i = 0; i < FRAME_BUF_CLASSES; i++) {
+			cached += stripe->buf_count[i];
+		}
+		for (i = 0; i < FRAME_STAT_MAX; i++) {
+			total[i] += stripe->total[i];
+		}
+		nodes += stripe->node_count;
+		gets += stripe->gets;
+		puts += stripe->puts;
+		switch_mutex_unlock(stripe->mutex);
+	}
+
+	switch_mutex_lock(frame_cache.stats_mutex);
+	secs = (double) (now - frame_cache.stats_time) / 1000000;
+
+	stream->write_function(stream, "frames in use: %" SWITCH_INT64_T_FMT " cached frames: %u cached buffers: %u\n\n", (int64_t) (gets - puts), nodes, cached);
+	stream->write_function(stream, "%-10s %14s %10s\n", "event", "total", "per sec");
+
+	for (i = 0; i < FRAME_STAT_MAX; i++) {
+		stream->write_function(stream, "%-10s %14" SWITCH_UINT64_T_FMT " %10.0f\n", frame_stat_names[i], total[i],
+							   secs > 0 ? (double) (total[i] - frame_cache.stats_total[i]) / secs : 0.0);
+		frame_cache.stats_total[i] = total[i];
+	}
+
+	stream->write_function(stream, "\nper sec is averaged over the %.1f second(s) since the last check\n", secs);
+	frame_cache.stats_time = now;
+	switch_mutex_unlock(frame_cache.stats_mutex);
+}
+
 SWITCH_DECLARE(switch_status_t) switch_network_list_create(switch_network_list_t **list, const char *name, switch_bool_t default_type,
 														   switch_memory_pool_t *pool)
 {
@@ -140,38 +515,213 @@ SWITCH_DECLARE(switch_status_t) switch_network_list_create(switch_network_list_t
 	return SWITCH_STATUS_SUCCESS;
 }
 
-SWITCH_DECLARE(switch_bool_t) switch_network_list_validate_ip_token(switch_network_list_t *list, uint32_t ip, const char **token)
+static inline int network_trie_bit(const uint8_t *key, uint32_t bit)
 {
-	switch_network_node_t *node;
-	switch_bool_t ok = list->default_type;
-	uint32_t bits = 0;
+	return (key[bit >> 3] >> (7 - (bit & 7))) & 1;
+}
 
-	for (node = list->node_head; node; node = node->next) {
-		if (node->bits > bits && switch_test_subnet(ip, node->ip, node->mask)) {
-			if (node->ok) {
-				ok = SWITCH_TRUE;
-			} else {
-				ok = SWITCH_FALSE;
+/* number of leading bits a and b share, up to max; the first from bits are already known to match */
+static uint32_t network_trie_common(const uint8_t *a, const uint8_t *b, uint32_t from, uint32_t max)
+{
+	uint32_t i = from >> 3, bytes = max >> 3, n;
+	uint8_t x;
+
+	while (i < bytes && a[i] == b[i]) {
+		i++;
+	}
+
+	if (i < bytes) {
+		x = a[i] ^ b[i];
+	} else if ((max & 7)) {
+		x = (uint8_t) ((a[i] ^ b[i]) | (0xFF >> (max & 7)));
+	} else {
+		return max;
+	}
+
+	for (n = i << 3; !(x & 0x80); x <<= 1) {
+		n++;
+	}
+
+	return n;
+}
+
+static void network_trie_mask(uint8_t *key, uint32_t bits)
+{
+	uint32_t i = bits >> 3;
+
+	if (i < 16) {
+		if ((bits & 7)) {
+			key[i++] &= (uint8_t) (0xFF << (8 - (bits & 7)));
+		}
+		memset(key + i, 0, 16 - i);
+	}
+}
+
+static void network_v4_key(uint8_t *key, uint32_t ip)
+{
+	memset(key, 0, 10);
+	key[10] = key[11] = 0xFF;
+	key[12] = (uint8_t) (ip >> 24);
+	key[13] = (uint8_t) (ip >> 16);
+	key[14] = (uint8_t) (ip >> 8);
+	key[15] = (uint8_t) ip;
+}
+
+static switch_network_trie_node_t *network_trie_new(switch_network_list_t *list, const uint8_t *key, uint32_t bits, switch_network_node_t *node)
+{
+	switch_network_trie_node_t *tnode = switch_core_alloc(list->pool, sizeof(*tnode));
+
+	memcpy(tnode->key, key, sizeof(tnode->key));
+	network_trie_mask(tnode->key, bits);
+	tnode->bits = bits;
+	tnode->node = node;
+	list->trie_nodes++;
+
+	return tnode;
+}
+
+static void network_trie_insert(switch_network_list_t *list, const uint8_t *addr, uint32_t bits, switch_network_node_t *node)
+{
+	switch_network_trie_node_t **link = &list->trie, *cur, *leaf, *glue;
+	uint8_t key[16];
+	uint32_t common, from = 0;
+
+	memcpy(key, addr, sizeof(key));
+	network_trie_mask(key, bits);
+
+	/* new nodes are fully built before they are linked in so a concurrent lookup never sees a partial node */
+	while ((cur = *link)) {
+		common = network_trie_common(cur->key, key, from, cur->bits < bits ? cur->bits : bits);
+
+		if (common == cur->bits) {
+			if (common == bits) {
+				/* same prefix: the most recently added entry wins, as it did with the linear scan */
+				cur->node = node;
+				return;
 			}
+			from = cur->bits;
+			link = &cur->child[network_trie_bit(key, cur->bits)];
+			continue;
+		}
+
+		leaf = network_trie_new(list, key, bits, node);
+
+		if (common == bits) {
+			leaf->child[network_trie_bit(cur->key, bits)] = cur;
+			*link = leaf;
+		} else {
+			glue = network_trie_new(list, key, common, NULL);
+			glue->child[network_trie_bit(key, common)] = leaf;
+			glue->child[network_trie_bit(cur->key, common)] = cur;
+			*link = glue;
+		}
+
+		return;
+	}
+
+	*link = network_trie_new(list, key, bits, node);
+}
+
+static switch_network_trie_node_t *network_trie_lookup(switch_network_list_t *list, const uint8_t *key)
+{
+	switch_network_trie_node_t *cur = list->trie, *best = NULL;
+	uint32_t from = 0;
 
-			bits = node->bits;
+	while (cur) {
+		if (network_trie_common(cur->key, key, from, cur->bits) < cur->bits) {
+			break;
+		}
+
+		/* a /0 entry never overrode the list default, keep it that way */
+		if (cur->node && cur->node->bits) {
+			best = cur;
+		}
+
+		if (cur->bits == 128) {
+			break;
+		}
+
+		from = cur->bits;
+		cur = cur->child[network_trie_bit(key, cur->bits)];
+	}
+
+	return best;
+}
+
+static switch_bool_t network_list_validate(switch_network_list_t *list, const uint8_t *key, switch_bool_t v4, uint32_t ip, const char **token)
+{
+	switch_network_trie_node_t *tnode = network_trie_lookup(list, key);
+	switch_network_node_t *node, *best = NULL;
+	uint32_t bits = 0;
+
+	if (tnode) {
+		best = tnode->node;
+		bits = tnode->bits;
+	}
 
-			if (token) {
-				*token = node->token;
+	/* host/mask entries with a non contiguous mask cannot be expressed as a prefix */
+	if (v4 && list->linear_nodes) {
+		for (node = list->node_head; node; node = node->next) {
+			if (node->linear && node->bits + NETWORK_V4_MAPPED_BITS > bits && switch_test_subnet(ip, node->ip, node->mask)) {
+				best = node;
+				bits = node->bits + NETWORK_V4_MAPPED_BITS;
 			}
 		}
 	}
 
-	return ok;
+	if (!best) {
+		return list->default_type;
+	}
+
+	if (token) {
+		*token = best->token;
+	}
+
+	return best->ok ? SWITCH_TRUE : SWITCH_FALSE;
+}
+
+SWITCH_DECLARE(switch_bool_t) switch_network_list_validate_ip_token(switch_network_list_t *list, uint32_t ip, const char **token)
+{
+	uint8_t key[16];
+
+	network_v4_key(key, ip);
+
+	return network_list_validate(list, key, SWITCH_TRUE, ip, token);
+}
+
+SWITCH_DECLARE(switch_bool_t) switch_network_list_validate_ip6_token(switch_network_list_t *list, const uint8_t *ip6, const char **token)
+{
+	uint8_t v4_prefix[16];
+	switch_bool_t v4;
+	uint32_t ip = 0;
+
+	network_v4_key(v4_prefix, 0);
+
+	if ((v4 = !memcmp(ip6, v4_prefix, 12))) {
+		ip = ((uint32_t) ip6[12] << 24) | ((uint32_t) ip6[13] << 16) | ((uint32_t) ip6[14] << 8) | ip6[15];
+	}
+
+	return network_list_validate(list, ip6, v4, ip, token);
+}
+
+SWITCH_DECLARE(switch_bool_t) switch_test_subnet6(const uint8_t *ip6, const uint8_t *net6, uint32_t bits)
+{
+	if (bits > 128) {
+		return SWITCH_FALSE;
+	}
+
+	return network_trie_common(ip6, net6, 0, bits) == bits ? SWITCH_TRUE : SWITCH_FALSE;
 }
 
 SWITCH_DECLARE(switch_status_t) switch_network_list_perform_add_cidr_token(switch_network_list_t *list, const char *cidr_str, switch_bool_t ok,
 																		   const char *token)
 {
-	uint32_t ip, mask, bits;
+	uint32_t ip = 0, mask = 0, bits;
+	uint8_t key[16];
+	int family = strchr(cidr_str, ':') ? AF_INET6 : AF_INET;
 	switch_network_node_t *node;
 
-	if (switch_parse_cidr(cidr_str, &ip, &mask, &bits)) {
+	if ((family == AF_INET6 ? switch_parse_cidr6(cidr_str, key, &bits) : switch_parse_cidr(cidr_str, &ip, &mask, &bits))) {
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Error Adding %s (%s) [%s] to list %s\n",
 						  cidr_str, ok ? "allow" : "deny", switch_str_nil(token), list->name);
 		return SWITCH_STATUS_GENERR;
@@ -181,6 +731,7 @@ SWITCH_DECLARE(switch_status_t) switch_network_list_perform_add_cidr_token(switc
 
 	node->ip = ip;
 	node->mask = mask;
+	node->family = family;
 	node->ok = ok;
 	node->bits = bits;
 	node->str = switch_core_strdup(list->pool, cidr_str);
@@ -192,6 +743,13 @@ SWITCH_DECLARE(switch_status_t) switch_network_list_perform_add_cidr_token(switc
 	node->next = list->node_head;
 	list->node_head = node;
 
+	if (family == AF_INET) {
+		network_v4_key(key, ip);
+		network_trie_insert(list, key, bits + NETWORK_V4_MAPPED_BITS, node);
+	} else {
+		network_trie_insert(list, key, bits, node);
+	}
+
 	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "Adding %s (%s) [%s] to list %s\n",
 					  cidr_str, ok ? "allow" : "deny", switch_str_nil(token), list->name);
 
@@ -227,7 +785,8 @@ SWITCH_DECLARE(switch_status_t) switch_network_list_add_cidr_token(switch_networ
 
 SWITCH_DECLARE(switch_status_t) switch_network_list_add_host_mask(switch_network_list_t *list, const char *host, const char *mask_str, switch_bool_t ok)
 {
-	int ip, mask;
+	int ip = 0, mask = 0;
+	uint8_t key[16];
 	switch_network_node_t *node;
 
 	switch_inet_pton(AF_INET, host, &ip);
@@ -237,6 +796,7 @@ SWITCH_DECLARE(switch_status_t) switch_network_list_add_host_mask(switch_network
 
 	node->ip = ntohl(ip);
 	node->mask = ntohl(mask);
+	node->family = AF_INET;
 	node->ok = ok;
 
 	/* http://graphics.stanford.edu/~seander/bithacks.html */
@@ -248,6 +808,14 @@ SWITCH_DECLARE(switch_status_t) switch_network_list_add_host_mask(switch_network
 	node->next = list->node_head;
 	list->node_head = node;
 
+	if (node->mask == (node->bits ? 0xFFFFFFFF << (32 - node->bits) : 0)) {
+		network_v4_key(key, node->ip);
+		network_trie_insert(list, key, node->bits + NETWORK_V4_MAPPED_BITS, node);
+	} else {
+		node->linear = SWITCH_TRUE;
+		list->linear_nodes++;
+	}
+
 	return SWITCH_STATUS_SUCCESS;
 }
 
@@ -283,6 +851,59 @@ SWITCH_DECLARE(int) switch_parse_cidr(const char *string, uint32_t *ip, uint32_t
 	return 0;
 }
 
+SWITCH_DECLARE(int) switch_parse_cidr6(const char *string, uint8_t *ip6, uint32_t *bitp)
+{
+	char host[128];
+	char *bit_str;
+	int32_t bits;
+
+	switch_copy_string(host, string, sizeof(host));
+	bit_str = strchr(host, '/');
+
+	if (!bit_str) {
+		return -1;
+	}
+
+	*bit_str++ = '\0';
+	bits = atoi(bit_str);
+
+	if (bits < 0 || bits > 128) {
+		return -2;
+	}
+
+	if (switch_inet_pton(AF_INET6, host, ip6) <= 0) {
+		return -3;
+	}
+
+	network_trie_mask(ip6, bits);
+
+	*bitp = bits;
+
+	return 0;
+}
+
+SWITCH_DECLARE(void) switch_network_list_stats(switch_network_list_t *list, uint32_t *prefixes, uint32_t *trie_nodes, uint32_t *linear_nodes)
+{
+	switch_network_node_t *node;
+	uint32_t count = 0;
+
+	for (node = list->node_head; node; node = node->next) {
+		count++;
+	}
+
+	if (prefixes) {
+		*prefixes = count;
+	}
+
+	if (trie_nodes) {
+		*trie_nodes = list->trie_nodes;
+	}
+
+	if (linear_nodes) {
+		*linear_nodes = list->linear_nodes;
+	}
+}
+
 
 SWITCH_DECLARE(char *) switch_find_end_paren(const char *s, char open, char close)
 {
@@ -1660,6 +1660,30 @@ SWITCH_DECLARE(switch_status_t) switch_xml_locate(const char *section,
 	return SWITCH_STATUS_FALSE;
 }
 
+SWITCH_DECLARE(switch_bool_t) switch_xml_section_has_binding(const char *section)
+{
+	switch_xml_binding_t *binding;
+	switch_xml_section_t sections;
+	switch_bool_t r = SWITCH_FALSE;
+
+	if (!BINDINGS) {
+		return SWITCH_FALSE;
+	}
+
+	sections = switch_xml_parse_section_string(section);
+
+	switch_thread_rwlock_rdlock(B_RWLOCK);
+	for (binding = BINDINGS; binding; binding = binding->next) {
+		if (!binding->sections || (sections & binding->sections)) {
+			r = SWITCH_TRUE;
+			break;
+		}
+	}
+	switch_thread_rwlock_unlock(B_RWLOCK);
+
+	return r;
+}
+
 SWITCH_DECLARE(switch_status_t) switch_xml_locate_domain(const char *domain_name, switch_event_t *params, switch_xml_t *root, switch_xml_t *domain)
 {
 	switch_event_t *my_params = NULL;